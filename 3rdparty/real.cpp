@@ -695,7 +695,9 @@ static real fast_fact(int x)
             tmp >>= 1;
             exponent++;
         }
-        if (multiplier * tmp / tmp != multiplier)
+        /* Flush before `multiplier * tmp` overflows; testing the product
+         * itself is undefined behaviour and gets folded away by GCC. */
+        if (multiplier > 0x7fffffff / tmp)
         {
             ret *= multiplier;
             multiplier = 1;
@@ -8,6 +8,10 @@
 
 #include "../simdglobals.h"
 
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
 // ============================================================================
 // [SimdTests::DeJPEG - Utilities]
 // ============================================================================
@@ -26,6 +30,49 @@ static SIMD_INLINE uint32_t dejepeg_pack32(T a, T b, T c, T d) {
          (static_cast<uint32_t>(d)      ) ;
 }
 
+// Loads 8 bytes as a big-endian 64-bit integer (the host is little-endian).
+static SIMD_INLINE uint64_t dejpeg_load64be(const uint8_t* p) {
+  uint64_t x;
+  ::memcpy(&x, p, 8);
+#if defined(_MSC_VER)
+  return _byteswap_uint64(x);
+#else
+  return __builtin_bswap64(x);
+#endif
+}
+
+// Index of the first set bit of a non-zero `x`.
+static SIMD_INLINE uint32_t dejpeg_ctz(uint32_t x) {
+#if defined(_MSC_VER)
+  unsigned long i;
+  _BitScanForward(&i, x);
+  return static_cast<uint32_t>(i);
+#else
+  return static_cast<uint32_t>(__builtin_ctz(x));
+#endif
+}
+
+static SIMD_INLINE uint32_t dejpeg_ctz64(uint64_t x) {
+#if defined(_MSC_VER)
+  unsigned long i;
+  _BitScanForward64(&i, x);
+  return static_cast<uint32_t>(i);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(x));
+#endif
+}
+
+// Index of the last set bit of a non-zero `x`.
+static SIMD_INLINE uint32_t dejpeg_bsr64(uint64_t x) {
+#if defined(_MSC_VER)
+  unsigned long i;
+  _BitScanReverse64(&i, x);
+  return static_cast<uint32_t>(i);
+#else
+  return static_cast<uint32_t>(63 - __builtin_clzll(x));
+#endif
+}
+
 // ============================================================================
 // [SimdTests::DeJPEG - DeZigZag]
 // ============================================================================
@@ -41,6 +88,19 @@ void dejpeg_dezigzag_ref(int16_t* dst, const int16_t* src);
 void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src);
 void dejpeg_dezigzag_ssse3_v2(int16_t* dst, const int16_t* src);
 
+// Same as `DeJpegDeZigZag8x8Func`, but also returns the zig-zag index of the
+// last non-zero coefficient of `src` (zero if there is none), which can be
+// passed to `dejpeg_idct_islow_sparse_...` as `eob`. SIMD versions find it by
+// comparing all coefficients at once, instead of scanning the block.
+typedef uint32_t (*DeJpegDeZigZagEOBFunc)(int16_t* dst, const int16_t* src);
+
+uint32_t dejpeg_dezigzag_eob_ref(int16_t* dst, const int16_t* src);
+uint32_t dejpeg_dezigzag_eob_avx2(int16_t* dst, const int16_t* src);
+
+// Requires AVX-512BW, check `SimdCpu::features()` before calling. The whole
+// block fits into two ZMM registers, each half of `dst` is a single VPERMT2W.
+uint32_t dejpeg_dezigzag_eob_avx512bw(int16_t* dst, const int16_t* src);
+
 // ============================================================================
 // [SimdTests::DeJPEG - IDCT]
 // ============================================================================
@@ -81,6 +141,221 @@ typedef void (*DeJpegIDCTFunc)(uint8_t* dst, intptr_t dstStride, const int16_t*
 
 void dejpeg_idct_islow_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
 void dejpeg_idct_islow_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_islow_avx2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+
+// Variant of `dejpeg_idct_islow_...` selected by `SimdCpu::tier()`.
+const SimdVariant<DeJpegIDCTFunc>* dejpeg_idct_islow_dispatch(void);
+
+// Dequantize and IDCT `count` blocks stored consecutively in `src` (64
+// coefficients each). The block `i` is dequantized by a quantization table
+// `qTables + qIndex[i] * 64` and stored to `dst[i]`. This is designed to
+// process a whole MCU row by a single call, so the per-block call overhead
+// and constant reloading is paid only once.
+typedef void (*DeJpegIDCTBatchFunc)(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count);
+
+void dejpeg_idct_islow_batch_ref(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count);
+void dejpeg_idct_islow_batch_sse2(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count);
+void dejpeg_idct_islow_batch_avx2(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count);
+
+// Zig-zag index of the last coefficient that still lies in the top-left 2x2
+// and 4x4 corner of the block, respectively. Blocks that end at or before
+// these indexes are routed to the sparse kernels.
+#define JPEG_IDCT_EOB_2X2 2
+#define JPEG_IDCT_EOB_4X4 9
+
+// Same as `DeJpegIDCTFunc`, but also accepts `eob`, which is the zig-zag index
+// of the last non-zero coefficient (the Huffman decoder knows it for free). It
+// is used to select a DC-only, 2x2 or 4x4 kernel, which are all bit-exact with
+// the full transform. Coefficients after `eob` must be zero.
+typedef void (*DeJpegIDCTSparseFunc)(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable, uint32_t eob);
+
+void dejpeg_idct_islow_sparse_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable, uint32_t eob);
+void dejpeg_idct_islow_sparse_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable, uint32_t eob);
+void dejpeg_idct_islow_sparse_avx2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable, uint32_t eob);
+
+// Sparse kernels used by `dejpeg_idct_islow_sparse_...`, exported so other
+// implementations can share them.
+void dejpeg_idct_islow_dconly_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_islow_2x2_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_islow_4x4_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+
+// ============================================================================
+// [SimdTests::DeJPEG - IDCT Scaled]
+// ============================================================================
+
+// Derived from jidctred's `jpeg_idct_4x4`, `jpeg_idct_2x2` and `jpeg_idct_1x1`.
+// These produce a 4x4, 2x2 or 1x1 block of pixels from the 8x8 coefficients,
+// which is used to decode images at 1/2, 1/4 or 1/8 of their size. The 4x4
+// variant uses all coefficients except column and row 4, the 2x2 variant only
+// uses odd columns/rows and the DC term, and the 1x1 variant only uses DC.
+#define JPEG_IDCT_M_0_211164243 -JPEG_IDCT_FIXED(0.211164243)
+#define JPEG_IDCT_M_0_509795579 -JPEG_IDCT_FIXED(0.509795579)
+#define JPEG_IDCT_M_0_601344887 -JPEG_IDCT_FIXED(0.601344887)
+#define JPEG_IDCT_M_0_720959822 -JPEG_IDCT_FIXED(0.720959822)
+#define JPEG_IDCT_M_0_765366865 -JPEG_IDCT_FIXED(0.765366865)
+#define JPEG_IDCT_M_1_272758580 -JPEG_IDCT_FIXED(1.272758580)
+#define JPEG_IDCT_M_2_172734803 -JPEG_IDCT_FIXED(2.172734803)
+#define JPEG_IDCT_P_0_850430095  JPEG_IDCT_FIXED(0.850430095)
+#define JPEG_IDCT_P_0_899976223  JPEG_IDCT_FIXED(0.899976223)
+#define JPEG_IDCT_P_1_061594337  JPEG_IDCT_FIXED(1.061594337)
+#define JPEG_IDCT_P_1_451774981  JPEG_IDCT_FIXED(1.451774981)
+#define JPEG_IDCT_P_1_847759065  JPEG_IDCT_FIXED(1.847759065)
+#define JPEG_IDCT_P_2_562915447  JPEG_IDCT_FIXED(2.562915447)
+#define JPEG_IDCT_P_3_624509785  JPEG_IDCT_FIXED(3.624509785)
+
+// The 4x4 and 2x2 transforms scale their even part by 2 and 4, respectively,
+// so both passes have to shift by 1 or 2 more bits than the 8x8 transform.
+#define JPEG_IDCT_4X4_COL_NORM (JPEG_IDCT_COL_NORM + 1)
+#define JPEG_IDCT_4X4_COL_BIAS JPEG_IDCT_HALF(JPEG_IDCT_4X4_COL_NORM)
+#define JPEG_IDCT_4X4_ROW_NORM (JPEG_IDCT_ROW_NORM + 1)
+#define JPEG_IDCT_4X4_ROW_BIAS (JPEG_IDCT_HALF(JPEG_IDCT_4X4_ROW_NORM) + (128 << JPEG_IDCT_4X4_ROW_NORM))
+
+#define JPEG_IDCT_2X2_COL_NORM (JPEG_IDCT_COL_NORM + 2)
+#define JPEG_IDCT_2X2_COL_BIAS JPEG_IDCT_HALF(JPEG_IDCT_2X2_COL_NORM)
+#define JPEG_IDCT_2X2_ROW_NORM (JPEG_IDCT_ROW_NORM + 2)
+#define JPEG_IDCT_2X2_ROW_BIAS (JPEG_IDCT_HALF(JPEG_IDCT_2X2_ROW_NORM) + (128 << JPEG_IDCT_2X2_ROW_NORM))
+
+// The output is 4x4, 2x2 or 1x1 pixels stored to `dst`, otherwise the same as
+// `DeJpegIDCTFunc`. There is no SIMD version of the 1x1 transform, it's just a
+// single multiplication.
+void dejpeg_idct_scaled4x4_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_scaled4x4_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_scaled4x4_avx2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+
+void dejpeg_idct_scaled2x2_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_scaled2x2_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_scaled2x2_avx2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+
+void dejpeg_idct_scaled1x1_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+
+// ============================================================================
+// [SimdTests::DeJPEG - IDCT Fast]
+// ============================================================================
+
+// Derived from jidctfst's `jpeg_idct_ifast`, which is AAN (Arai, Agui and
+// Nakajima) IDCT that uses only 5 multiplications per pass. It's less accurate
+// than `islow`, but for coefficients of 8-bit samples all intermediate values
+// fit into 16 bits at any quality (see `JPEG_IFAST_PRE_SHIFT`), so SIMD versions
+// process 8 (SSE2) or 16 (AVX2) coefficients per instruction and give exactly
+// the same results as `dejpeg_idct_ifast_ref`.
+//
+// AAN needs the coefficients to be pre-scaled by `aanscales`, which is folded
+// into the quantization table by `dejpeg_idct_ifast_qtable()`. Unlike jidctfst
+// the output is rounded, not truncated.
+#define JPEG_IFAST_PREC 8
+#define JPEG_IFAST_FIXED(x) static_cast<int>(((double)(x) * (double)(1 << JPEG_IFAST_PREC) + 0.5))
+
+#define JPEG_IFAST_P_1_082392200 JPEG_IFAST_FIXED(1.082392200)
+#define JPEG_IFAST_P_1_414213562 JPEG_IFAST_FIXED(1.414213562)
+#define JPEG_IFAST_P_1_847759065 JPEG_IFAST_FIXED(1.847759065)
+#define JPEG_IFAST_P_2_613125930 JPEG_IFAST_FIXED(2.613125930)
+
+// SIMD versions calculate `(x * c) >> JPEG_IFAST_PREC` as `mulhi(x << 1, c << 7)`,
+// which is exact as long as `x << 1` fits into 16 bits (x within -16384..16383).
+// That holds for blocks of 8-bit samples at any quality, their multiplier inputs
+// stay below 14000 (the largest are at quality 1, where the quantization error
+// is the largest). `c << 7` has to fit as well, so the integer part of `c` is
+// applied separately: `x * 1.414` is `x + mulhi(x << 1, 0.414 << 7)` and
+// `x * -2.613` is `mulhi(x << 1, 0.387 << 7) - 3 * x`.
+#define JPEG_IFAST_PRE_SHIFT 1
+#define JPEG_IFAST_MULHI(c) static_cast<int16_t>((c) * (1 << (16 - JPEG_IFAST_PREC - JPEG_IFAST_PRE_SHIFT)))
+
+// Folded quantization table keeps 2 extra bits, which are consumed with 3 bits
+// produced by `2 * sqrt(8)` by the row pass. The bias also normalizes the
+// output from `-128..127` to `0..255`.
+#define JPEG_IFAST_PASS1_BITS 2
+#define JPEG_IFAST_ROW_NORM (JPEG_IFAST_PASS1_BITS + 3)
+#define JPEG_IFAST_ROW_BIAS (JPEG_IDCT_HALF(JPEG_IFAST_ROW_NORM) + (128 << JPEG_IFAST_ROW_NORM))
+
+// Fold AAN scale factors into the quantization table `qTable` (natural order)
+// and store the multipliers to be used by `dejpeg_idct_ifast_...` in `dst`.
+void dejpeg_idct_ifast_qtable(uint16_t* dst, const uint16_t* qTable);
+
+// Same as `DeJpegIDCTFunc`, `qTable` has to be prepared by `dejpeg_idct_ifast_qtable()`.
+void dejpeg_idct_ifast_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_ifast_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+
+// Same as `DeJpegIDCTBatchFunc`, `qTables` have to be prepared by `dejpeg_idct_ifast_qtable()`.
+// The AVX2 version transforms two blocks at a time, one per 128-bit lane.
+void dejpeg_idct_ifast_batch_ref(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count);
+void dejpeg_idct_ifast_batch_sse2(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count);
+void dejpeg_idct_ifast_batch_avx2(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count);
+
+// ============================================================================
+// [SimdTests::DeJPEG - IDCT ZigZag]
+// ============================================================================
+
+// Fused de-zig-zag, dequantization and islow IDCT. Both `src` and `qTable` are
+// in zig-zag order, which is the order used by the Huffman decoder and by the
+// DQT segment. The coefficients are dequantized first (the order doesn't matter
+// for that) and then permuted in registers, so the natural-order coefficients
+// never make a round-trip through memory. The output is bit-exact with
+// `dejpeg_idct_islow_...` applied to de-zig-zagged coefficients and table.
+void dejpeg_idct_islow_zigzag_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+void dejpeg_idct_islow_zigzag_ssse3(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable);
+
+// ============================================================================
+// [SimdTests::DeJPEG - Upsample]
+// ============================================================================
+
+// Chroma upsampling by 2 horizontally (h2v1, used by 4:2:2) or horizontally
+// and vertically (h2v2, used by 4:2:0). `count` is the number of samples in a
+// source row, each destination row receives `count * 2` samples.
+//
+// Box variants just replicate samples. Fancy variants are derived from
+// jdsample's `h2v1_fancy_upsample` and `h2v2_fancy_upsample`, which use a
+// triangle filter (3/4 * nearer + 1/4 * further sample). Samples outside of
+// the row are replicated from the nearest edge sample, which gives the same
+// result as libjpeg's special-cased first and last columns.
+typedef void (*DeJpegUpsampleH2V1Func)(uint8_t* dst, const uint8_t* src, uint32_t count);
+
+// Produces two destination rows from a single source row `src`. Fancy variants
+// use `srcPrev` for the upper row `dst0` and `srcNext` for the lower row `dst1`
+// (pass `src` for rows outside of the image), box variants ignore them.
+typedef void (*DeJpegUpsampleH2V2Func)(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count);
+
+// Scalar fancy upsampling of source samples `i` to `end` of a row that has
+// `count` samples, shared by all implementations to handle edges and tails.
+static SIMD_INLINE void dejpeg_upsample_h2v1_fancy_span(uint8_t* dst, const uint8_t* src, uint32_t i, uint32_t end, uint32_t count) {
+  for (; i < end; i++) {
+    int s0 = static_cast<int>(src[i == 0 ? i : i - 1]);
+    int s1 = static_cast<int>(src[i]) * 3;
+    int s2 = static_cast<int>(src[i + 1 == count ? i : i + 1]);
+
+    dst[i * 2 + 0] = static_cast<uint8_t>((s1 + s0 + 1) >> 2);
+    dst[i * 2 + 1] = static_cast<uint8_t>((s1 + s2 + 2) >> 2);
+  }
+}
+
+static SIMD_INLINE void dejpeg_upsample_h2v2_fancy_span(uint8_t* dst, const uint8_t* near, const uint8_t* src, uint32_t i, uint32_t end, uint32_t count) {
+  // Column sum of the source sample `i` and its vertical neighbor, scaled by 4.
+# define JPEG_UPSAMPLE_COLSUM(i) (static_cast<int>(src[i]) * 3 + static_cast<int>(near[i]))
+  for (; i < end; i++) {
+    int c0 = JPEG_UPSAMPLE_COLSUM(i == 0 ? i : i - 1);
+    int c1 = JPEG_UPSAMPLE_COLSUM(i) * 3;
+    int c2 = JPEG_UPSAMPLE_COLSUM(i + 1 == count ? i : i + 1);
+
+    dst[i * 2 + 0] = static_cast<uint8_t>((c1 + c0 + 8) >> 4);
+    dst[i * 2 + 1] = static_cast<uint8_t>((c1 + c2 + 7) >> 4);
+  }
+# undef JPEG_UPSAMPLE_COLSUM
+}
+
+void dejpeg_upsample_h2v1_ref(uint8_t* dst, const uint8_t* src, uint32_t count);
+void dejpeg_upsample_h2v1_sse2(uint8_t* dst, const uint8_t* src, uint32_t count);
+void dejpeg_upsample_h2v1_avx2(uint8_t* dst, const uint8_t* src, uint32_t count);
+
+void dejpeg_upsample_h2v2_ref(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count);
+void dejpeg_upsample_h2v2_sse2(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count);
+void dejpeg_upsample_h2v2_avx2(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count);
+
+void dejpeg_upsample_h2v1_fancy_ref(uint8_t* dst, const uint8_t* src, uint32_t count);
+void dejpeg_upsample_h2v1_fancy_sse2(uint8_t* dst, const uint8_t* src, uint32_t count);
+void dejpeg_upsample_h2v1_fancy_avx2(uint8_t* dst, const uint8_t* src, uint32_t count);
+
+void dejpeg_upsample_h2v2_fancy_ref(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count);
+void dejpeg_upsample_h2v2_fancy_sse2(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count);
+void dejpeg_upsample_h2v2_fancy_avx2(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count);
 
 // ============================================================================
 // [SimdTests::DeJPEG - YCbCrToRGB32]
@@ -90,9 +365,616 @@ void dejpeg_idct_islow_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src
 #define JPEG_YCBCR_SCALE(x) ((x) << JPEG_YCBCR_PREC)
 #define JPEG_YCBCR_FIXED(x) static_cast<int>(((double)(x) * (double)(1 << JPEG_YCBCR_PREC) + 0.5))
 
+// Converts a single pixel, shared by reference implementations and SIMD tails.
+static SIMD_INLINE uint32_t dejpeg_ycbcr_to_rgb32_pixel(int y, int cb, int cr) {
+  int yy = (y << JPEG_YCBCR_PREC) + (1 << (JPEG_YCBCR_PREC - 1));
+  cr -= 128;
+  cb -= 128;
+
+  int r = yy + cr * JPEG_YCBCR_FIXED(1.40200);
+  int g = yy - cr * JPEG_YCBCR_FIXED(0.71414) - cb * JPEG_YCBCR_FIXED(0.34414);
+  int b = yy + cb * JPEG_YCBCR_FIXED(1.77200);
+
+  return dejepeg_pack32(
+    static_cast<uint8_t>(0xFF),
+    clampToByte(r >> JPEG_YCBCR_PREC),
+    clampToByte(g >> JPEG_YCBCR_PREC),
+    clampToByte(b >> JPEG_YCBCR_PREC));
+}
+
+// Output pixel formats, byte order is given as stored in memory, except RGB32
+// and RGB565, which are native 32-bit `0xFFRRGGBB` and 16-bit `RRRRRGGGGGGBBBBB`
+// integers, respectively. Gray8 is just the luma.
+enum DeJpegPixelFormat {
+  kJpegPixelRGB32  = 0,
+  kJpegPixelRGB24  = 1,
+  kJpegPixelBGR24  = 2,
+  kJpegPixelRGBA32 = 3,
+  kJpegPixelARGB32 = 4,
+  kJpegPixelRGB565 = 5,
+  kJpegPixelGray8  = 6,
+  kJpegPixelCount  = 7
+};
+
+static SIMD_INLINE uint32_t dejpeg_pixel_format_size(uint32_t format) {
+  switch (format) {
+    case kJpegPixelRGB24 :
+    case kJpegPixelBGR24 : return 3;
+    case kJpegPixelRGB565: return 2;
+    case kJpegPixelGray8 : return 1;
+    default              : return 4;
+  }
+}
+
+// Converts a single pixel and stores it in `kFormat` to `dst`.
+template<uint32_t kFormat>
+static SIMD_INLINE void dejpeg_ycbcr_to_pixel(uint8_t* dst, int y, int cb, int cr) {
+  if (kFormat == kJpegPixelGray8) {
+    dst[0] = static_cast<uint8_t>(y);
+    return;
+  }
+
+  uint32_t rgb32 = dejpeg_ycbcr_to_rgb32_pixel(y, cb, cr);
+  uint8_t r = static_cast<uint8_t>(rgb32 >> 16);
+  uint8_t g = static_cast<uint8_t>(rgb32 >>  8);
+  uint8_t b = static_cast<uint8_t>(rgb32      );
+
+  switch (kFormat) {
+    case kJpegPixelRGB32 : reinterpret_cast<uint32_t*>(dst)[0] = rgb32; break;
+    case kJpegPixelRGB24 : dst[0] = r; dst[1] = g; dst[2] = b; break;
+    case kJpegPixelBGR24 : dst[0] = b; dst[1] = g; dst[2] = r; break;
+    case kJpegPixelRGBA32: dst[0] = r; dst[1] = g; dst[2] = b; dst[3] = 0xFF; break;
+    case kJpegPixelARGB32: dst[0] = 0xFF; dst[1] = r; dst[2] = g; dst[3] = b; break;
+    case kJpegPixelRGB565:
+      reinterpret_cast<uint16_t*>(dst)[0] = static_cast<uint16_t>(
+        ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+      break;
+  }
+}
+
 typedef void (*YCbCrToRgbFunc)(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
 
 void dejpeg_ycbcr_to_rgb32_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
 void dejpeg_ycbcr_to_rgb32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgb32_ssse3(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgb32_avx2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+
+// Same as `dejpeg_ycbcr_to_rgb32_...`, implemented once by using `SimdVec` (see
+// dejpeg_vec.h) and compiled for each backend.
+void dejpeg_ycbcr_to_rgb32_vec_scalar(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgb32_vec_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgb32_vec_avx2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+
+// Same as `dejpeg_ycbcr_to_rgb32_...`, but storing other pixel formats. Each
+// is an instance of a single template specialized by `DeJpegPixelFormat`.
+void dejpeg_ycbcr_to_rgb24_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgb24_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_bgr24_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_bgr24_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgba32_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgba32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_argb32_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_argb32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgb565_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_rgb565_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_gray8_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_to_gray8_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+
+// Merged 4:2:0 upsampling and color conversion, like libjpeg's merged upsampler
+// (`h2v2_merged_upsample`). A single chroma row `pCb`/`pCr` having `(count + 1)
+// / 2` samples is box-upsampled and converted together with two luma rows `pY0`
+// and `pY1` having `count` samples each, producing two rows of RGB32 pixels in
+// `dst0` and `dst1`. The result is the same as `dejpeg_ycbcr_to_rgb32_...` of
+// box-upsampled chroma, but full-resolution chroma is never written to memory
+// and the chroma part of the conversion is only calculated once for 4 pixels.
+typedef void (*YCbCrMergedToRgbFunc)(uint8_t* dst0, uint8_t* dst1, const uint8_t* pY0, const uint8_t* pY1, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+
+void dejpeg_ycbcr_h2v2_to_rgb32_ref(uint8_t* dst0, uint8_t* dst1, const uint8_t* pY0, const uint8_t* pY1, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+void dejpeg_ycbcr_h2v2_to_rgb32_sse2(uint8_t* dst0, uint8_t* dst1, const uint8_t* pY0, const uint8_t* pY1, const uint8_t* pCb, const uint8_t* pCr, uint32_t count);
+
+// ============================================================================
+// [SimdTests::DeJPEG - Huffman]
+// ============================================================================
+
+// Baseline (sequential DCT) Huffman decoding. Entropy-coded data is stuffed (a
+// 0xFF byte is always followed by 0x00) and ends at a marker. The stuffing is
+// removed by `dejpeg_huff_unstuff_...` in a separate pass, which is a byte scan
+// SIMD does well, so the bit reader decoding the unstuffed data can refill up
+// to 64 bits at a time without looking at individual bytes.
+
+// Number of bits decoded by a single table lookup.
+#define JPEG_HUFF_LOOKUP_BITS 11
+// Number of zero bytes written after the unstuffed data.
+#define JPEG_HUFF_PADDING 8
+// Returned by `dejpeg_huff_decode_...` on corrupt data.
+#define JPEG_HUFF_INVALID 0xFFFFFFFFU
+
+// Huffman table built from a DHT segment by `dejpeg_huff_build()`.
+struct DeJpegHuffTable {
+  // Lookahead table indexed by the next `JPEG_HUFF_LOOKUP_BITS` bits. If both
+  // the code and the extra bits of the symbol fit, the entry contains the
+  // decoded value (bits 16..31, signed), the symbol (bits 8..15) and the
+  // number of bits to consume (bits 0..7), otherwise it's zero.
+  uint32_t fast[1 << JPEG_HUFF_LOOKUP_BITS];
+  // Code length (bits 8..15) and symbol (bits 0..7) of codes that fit into the
+  // lookahead, but their extra bits don't, zero for longer codes.
+  uint16_t lookup[1 << JPEG_HUFF_LOOKUP_BITS];
+  // Codes of length `i` left-justified to 16 bits are less than `maxCode[i]`,
+  // `maxCode[17]` is a sentinel.
+  uint32_t maxCode[18];
+  // Index to `values` is `code + valOffset[i]` for codes of length `i`.
+  int32_t valOffset[17];
+  uint8_t values[256];
+};
+
+// Builds `table` from `counts` (number of codes of lengths 1 to 16) and their
+// `values`, as stored in DHT. Returns false if the code lengths are invalid.
+bool dejpeg_huff_build(DeJpegHuffTable* table, const uint8_t* counts, const uint8_t* values);
+
+// Copies `size` bytes of entropy-coded data from `src` to `dst`, replacing all
+// 0xFF00 sequences by 0xFF. It stops at a marker (0xFF followed by anything
+// else) or at the end of `src`, stores the number of bytes consumed from `src`
+// to `consumed` and returns the number of bytes written to `dst`. The output is
+// followed by `JPEG_HUFF_PADDING` zero bytes, so `dst` must have a room for
+// `size + JPEG_HUFF_PADDING` bytes.
+typedef size_t (*DeJpegHuffUnstuffFunc)(uint8_t* dst, const uint8_t* src, size_t size, size_t* consumed);
+
+size_t dejpeg_huff_unstuff_ref(uint8_t* dst, const uint8_t* src, size_t size, size_t* consumed);
+size_t dejpeg_huff_unstuff_sse2(uint8_t* dst, const uint8_t* src, size_t size, size_t* consumed);
+size_t dejpeg_huff_unstuff_avx2(uint8_t* dst, const uint8_t* src, size_t size, size_t* consumed);
+
+// MSB-first bit reader of unstuffed data. `bitBuf` holds `bitCount` valid bits
+// aligned to the most significant bit, the bits below them are either zero or
+// the same as the bits that would be loaded next.
+struct DeJpegBitReader {
+  const uint8_t* ptr;
+  const uint8_t* end;
+  uint64_t bitBuf;
+  uint32_t bitCount;
+};
+
+// Initializes `br` to read `size` bytes of `data` followed by the padding
+// written by `dejpeg_huff_unstuff_...`.
+static SIMD_INLINE void dejpeg_bits_init(DeJpegBitReader* br, const uint8_t* data, size_t size) {
+  br->ptr = data;
+  br->end = data + size;
+  br->bitBuf = 0;
+  br->bitCount = 0;
+}
+
+// Makes at least 56 bits available. A reader past the end reads the padding,
+// so corrupt data decodes as zero bits instead of reading out of bounds.
+static SIMD_INLINE void dejpeg_bits_refill(DeJpegBitReader* br) {
+  const uint8_t* p = br->ptr < br->end ? br->ptr : br->end;
+
+  br->bitBuf |= dejpeg_load64be(p) >> br->bitCount;
+  br->ptr = p + ((63 - br->bitCount) >> 3);
+  br->bitCount |= 56;
+}
+
+static SIMD_INLINE uint32_t dejpeg_bits_peek(const DeJpegBitReader* br, uint32_t n) {
+  return static_cast<uint32_t>(br->bitBuf >> (64 - n));
+}
+
+static SIMD_INLINE void dejpeg_bits_consume(DeJpegBitReader* br, uint32_t n) {
+  br->bitBuf <<= n;
+  br->bitCount -= n;
+}
+
+// Sign-extends `s` extra bits `v` of a coefficient as described by F.2.2.1.
+static SIMD_INLINE int32_t dejpeg_huff_extend(uint32_t v, uint32_t s) {
+  return v < (1U << (s - 1)) ? static_cast<int32_t>(v) - static_cast<int32_t>((1U << s) - 1)
+                             : static_cast<int32_t>(v);
+}
+
+// Decodes a symbol that doesn't fit into the `fast` table, returns it or
+// `JPEG_HUFF_INVALID`. The caller refills `br`.
+static SIMD_INLINE uint32_t dejpeg_huff_decode_slow(DeJpegBitReader* br, const DeJpegHuffTable* table) {
+  uint32_t e = table->lookup[dejpeg_bits_peek(br, JPEG_HUFF_LOOKUP_BITS)];
+
+  if (e) {
+    dejpeg_bits_consume(br, e >> 8);
+    return e & 0xFF;
+  }
+
+  uint32_t code = dejpeg_bits_peek(br, 16);
+  uint32_t len = JPEG_HUFF_LOOKUP_BITS + 1;
+
+  while (code >= table->maxCode[len])
+    len++;
+
+  if (len > 16)
+    return JPEG_HUFF_INVALID;
+
+  dejpeg_bits_consume(br, len);
+  return table->values[static_cast<int32_t>(code >> (16 - len)) + table->valOffset[len]];
+}
+
+// Reads `s` extra bits and sign-extends them.
+static SIMD_INLINE int32_t dejpeg_huff_receive(DeJpegBitReader* br, uint32_t s) {
+  if (s == 0)
+    return 0;
+
+  uint32_t v = dejpeg_bits_peek(br, s);
+  dejpeg_bits_consume(br, s);
+  return dejpeg_huff_extend(v, s);
+}
+
+// Decodes a single 8x8 block of coefficients to `dst` in natural order, which
+// is the layout consumed by `dejpeg_idct_islow_...`. The DC coefficient is
+// added to the predictor `dcPred`. Returns the zig-zag index of the last
+// non-zero coefficient, which can be passed to `dejpeg_idct_islow_sparse_...`
+// as `eob`, or `JPEG_HUFF_INVALID` on corrupt data. Corrupt data never makes
+// it access memory out of bounds.
+uint32_t dejpeg_huff_decode_block(DeJpegBitReader* br, int16_t* dst, const DeJpegHuffTable* dcTable, const DeJpegHuffTable* acTable, int32_t* dcPred);
+
+// ============================================================================
+// [SimdTests::DeJPEG - Progressive]
+// ============================================================================
+
+// Progressive images send coefficients in several scans, each either a band
+// of coefficients (spectral selection) or one more bit of the coefficients
+// sent by previous scans (successive approximation), so all coefficients are
+// kept until the last scan. The decoder keeps them in zig-zag order, which
+// makes bands contiguous.
+//
+// Refinement scans read a correction bit for every coefficient that is already
+// non-zero and count only zero coefficients in runs. Instead of testing the
+// coefficients one by one, a bit mask of non-zero coefficients of the block
+// is calculated at once, and the decoder jumps between its set bits.
+
+// Returns a mask having bit `i` set if `block[i]` is non-zero.
+typedef uint64_t (*DeJpegNonZeroMaskFunc)(const int16_t* block);
+
+uint64_t dejpeg_block_nonzero_mask_ref(const int16_t* block);
+uint64_t dejpeg_block_nonzero_mask_sse2(const int16_t* block);
+uint64_t dejpeg_block_nonzero_mask_avx2(const int16_t* block);
+
+// ============================================================================
+// [SimdTests::DeJPEG - RGB32ToYCbCr]
+// ============================================================================
+
+// Derived from jccolor's `rgb_ycc_convert`, the inverse of the conversion done
+// by `dejpeg_ycbcr_to_rgb32_...`. 15 bits of precision is the most that keeps
+// all coefficients (including the bias, which is multiplied by one) in signed
+// 16-bit integers, so SIMD versions can use `pmaddwd` directly.
+#define JPEG_RGB_YCC_PREC 15
+#define JPEG_RGB_YCC_FIXED(x) static_cast<int>(((double)(x) * (double)(1 << JPEG_RGB_YCC_PREC) + 0.5))
+
+// Y is rounded to nearest. Cb and Cr are rounded half down like in libjpeg, so
+// `0.5 * 255 + 128` cannot round up to 256. The 128 offset of Cb and Cr is
+// added after the shift, which gives the same result.
+#define JPEG_RGB_YCC_Y_BIAS (1 << (JPEG_RGB_YCC_PREC - 1))
+#define JPEG_RGB_YCC_C_BIAS ((1 << (JPEG_RGB_YCC_PREC - 1)) - 1)
+
+// Converts a single `0xAARRGGBB` pixel (alpha is ignored), shared by reference
+// implementations and SIMD tails.
+static SIMD_INLINE void dejpeg_rgb32_to_ycbcr_pixel(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, uint32_t pixel) {
+  int r = static_cast<int>((pixel >> 16) & 0xFF);
+  int g = static_cast<int>((pixel >>  8) & 0xFF);
+  int b = static_cast<int>((pixel      ) & 0xFF);
+
+  int y  =  r * JPEG_RGB_YCC_FIXED(0.29900) + g * JPEG_RGB_YCC_FIXED(0.58700) + b * JPEG_RGB_YCC_FIXED(0.11400) + JPEG_RGB_YCC_Y_BIAS;
+  int cb = -r * JPEG_RGB_YCC_FIXED(0.16874) - g * JPEG_RGB_YCC_FIXED(0.33126) + b * JPEG_RGB_YCC_FIXED(0.50000) + JPEG_RGB_YCC_C_BIAS;
+  int cr =  r * JPEG_RGB_YCC_FIXED(0.50000) - g * JPEG_RGB_YCC_FIXED(0.41869) - b * JPEG_RGB_YCC_FIXED(0.08131) + JPEG_RGB_YCC_C_BIAS;
+
+  *pY  = static_cast<uint8_t>(y >> JPEG_RGB_YCC_PREC);
+  *pCb = static_cast<uint8_t>((cb >> JPEG_RGB_YCC_PREC) + 128);
+  *pCr = static_cast<uint8_t>((cr >> JPEG_RGB_YCC_PREC) + 128);
+}
+
+// Converts `count` RGB32 pixels from `src` into separate Y, Cb, and Cr planes.
+typedef void (*RgbToYCbCrFunc)(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, const uint8_t* src, uint32_t count);
+
+void dejpeg_rgb32_to_ycbcr_ref(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, const uint8_t* src, uint32_t count);
+void dejpeg_rgb32_to_ycbcr_sse2(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, const uint8_t* src, uint32_t count);
+void dejpeg_rgb32_to_ycbcr_avx2(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, const uint8_t* src, uint32_t count);
+
+// ============================================================================
+// [SimdTests::DeJPEG - Downsample]
+// ============================================================================
+
+// Chroma downsampling by 2 horizontally (h2v1, used by 4:2:2) or horizontally
+// and vertically (h2v2, used by 4:2:0), derived from jcsample's `h2v1_downsample`
+// and `h2v2_downsample`. `count` is the number of samples in a source row, each
+// destination row receives `(count + 1) / 2` samples. The last sample of a row
+// having odd `count` is replicated, like libjpeg's `expand_right_edge` does.
+//
+// Samples are averaged with a bias alternating between destination samples
+// (0, 1 for h2v1 and 1, 2 for h2v2), so the rounding is not always in the same
+// direction.
+typedef void (*DeJpegDownsampleH2V1Func)(uint8_t* dst, const uint8_t* src, uint32_t count);
+
+// Downsamples two source rows `src0` and `src1` into a single row `dst`.
+typedef void (*DeJpegDownsampleH2V2Func)(uint8_t* dst, const uint8_t* src0, const uint8_t* src1, uint32_t count);
+
+// Scalar downsampling of destination samples `i` to `(count + 1) / 2`, shared
+// by all implementations to handle tails.
+static SIMD_INLINE void dejpeg_downsample_h2v1_span(uint8_t* dst, const uint8_t* src, uint32_t i, uint32_t count) {
+  for (; i * 2 < count; i++) {
+    uint32_t s1 = i * 2 + 1 < count ? i * 2 + 1 : i * 2;
+    dst[i] = static_cast<uint8_t>((static_cast<uint32_t>(src[i * 2]) + src[s1] + (i & 1)) >> 1);
+  }
+}
+
+static SIMD_INLINE void dejpeg_downsample_h2v2_span(uint8_t* dst, const uint8_t* src0, const uint8_t* src1, uint32_t i, uint32_t count) {
+  for (; i * 2 < count; i++) {
+    uint32_t s1 = i * 2 + 1 < count ? i * 2 + 1 : i * 2;
+    uint32_t sum = static_cast<uint32_t>(src0[i * 2]) + src0[s1] + src1[i * 2] + src1[s1];
+    dst[i] = static_cast<uint8_t>((sum + 1 + (i & 1)) >> 2);
+  }
+}
+
+void dejpeg_downsample_h2v1_ref(uint8_t* dst, const uint8_t* src, uint32_t count);
+void dejpeg_downsample_h2v1_sse2(uint8_t* dst, const uint8_t* src, uint32_t count);
+void dejpeg_downsample_h2v1_avx2(uint8_t* dst, const uint8_t* src, uint32_t count);
+
+void dejpeg_downsample_h2v2_ref(uint8_t* dst, const uint8_t* src0, const uint8_t* src1, uint32_t count);
+void dejpeg_downsample_h2v2_sse2(uint8_t* dst, const uint8_t* src0, const uint8_t* src1, uint32_t count);
+void dejpeg_downsample_h2v2_avx2(uint8_t* dst, const uint8_t* src0, const uint8_t* src1, uint32_t count);
+
+// ============================================================================
+// [SimdTests::DeJPEG - FDCT]
+// ============================================================================
+
+// Derived from jfdctint's `jpeg_fdct_islow`, using the same precision as
+// libjpeg, so the coefficients are the same as libjpeg's. Outputs of the
+// transform are scaled up by 8, which is compensated by the quantization.
+#define JPEG_FDCT_PREC 13
+#define JPEG_FDCT_PASS1_BITS 2
+#define JPEG_FDCT_FIXED(x) static_cast<int>(((double)(x) * (double)(1 << JPEG_FDCT_PREC) + 0.5))
+
+#define JPEG_FDCT_P_0_298631336 JPEG_FDCT_FIXED(0.298631336)
+#define JPEG_FDCT_P_0_390180644 JPEG_FDCT_FIXED(0.390180644)
+#define JPEG_FDCT_P_0_541196100 JPEG_FDCT_FIXED(0.541196100)
+#define JPEG_FDCT_P_0_765366865 JPEG_FDCT_FIXED(0.765366865)
+#define JPEG_FDCT_P_0_899976223 JPEG_FDCT_FIXED(0.899976223)
+#define JPEG_FDCT_P_1_175875602 JPEG_FDCT_FIXED(1.175875602)
+#define JPEG_FDCT_P_1_501321110 JPEG_FDCT_FIXED(1.501321110)
+#define JPEG_FDCT_P_1_847759065 JPEG_FDCT_FIXED(1.847759065)
+#define JPEG_FDCT_P_1_961570560 JPEG_FDCT_FIXED(1.961570560)
+#define JPEG_FDCT_P_2_053119869 JPEG_FDCT_FIXED(2.053119869)
+#define JPEG_FDCT_P_2_562915447 JPEG_FDCT_FIXED(2.562915447)
+#define JPEG_FDCT_P_3_072711026 JPEG_FDCT_FIXED(3.072711026)
+
+// Rows are transformed first and keep `JPEG_FDCT_PASS1_BITS` extra bits of
+// precision, which are consumed by the column pass.
+#define JPEG_FDCT_ROW_NORM (JPEG_FDCT_PREC - JPEG_FDCT_PASS1_BITS)
+#define JPEG_FDCT_COL_NORM (JPEG_FDCT_PREC + JPEG_FDCT_PASS1_BITS)
+
+// Quantization is a division of `|x| + corr` by the divisor (8 times the
+// quantization table value), done by multiplying by a reciprocal like in
+// libjpeg-turbo, which gives the same result as libjpeg's rounded division:
+//
+//   |q| = (((|x| + corr) * recip) >> 16) * scale >> 16
+//
+// `dejpeg_fdct_islow_divisors()` calculates `recip`, `corr`, and `scale`
+// (stored in this order, 64 values each, natural order) of a quantization
+// table `qTable` (natural order, values 1..255).
+#define JPEG_FDCT_DIVISORS_SIZE 192
+
+void dejpeg_fdct_islow_divisors(uint16_t* dst, const uint16_t* qTable);
+
+// Forward DCT of 8x8 samples at `src` followed by a quantization by divisors
+// calculated by `dejpeg_fdct_islow_divisors()`. Coefficients are stored to `dst`
+// in natural order, see `dejpeg_zigzag_...` to reorder them for encoding.
+// Both `dst` and `divisors` must be aligned to 16 bytes.
+typedef void (*DeJpegFDCTFunc)(int16_t* dst, const uint8_t* src, intptr_t srcStride, const uint16_t* divisors);
+
+void dejpeg_fdct_islow_ref(int16_t* dst, const uint8_t* src, intptr_t srcStride, const uint16_t* divisors);
+void dejpeg_fdct_islow_sse2(int16_t* dst, const uint8_t* src, intptr_t srcStride, const uint16_t* divisors);
+void dejpeg_fdct_islow_avx2(int16_t* dst, const uint8_t* src, intptr_t srcStride, const uint16_t* divisors);
+
+// ============================================================================
+// [SimdTests::DeJPEG - ZigZag]
+// ============================================================================
+
+// Zig-zag translates a matrix of 8x8 coefficients from the natural order to the
+// zig-zag order used by the Huffman encoder, which is the inverse of de-zig-zag.
+// SIMD versions split coefficients to low and high bytes and permute both by
+// the same PSHUFBs like `dejpeg_dezigzag_ssse3_v2()`. AVX2 keeps low bytes in
+// the low lane and high bytes in the high lane, so each VPSHUFB permutes both.
+typedef void (*DeJpegZigZag8x8Func)(int16_t* dst, const int16_t* src);
+
+void dejpeg_zigzag_ref(int16_t* dst, const int16_t* src);
+void dejpeg_zigzag_ssse3(int16_t* dst, const int16_t* src);
+void dejpeg_zigzag_avx2(int16_t* dst, const int16_t* src);
+
+// ============================================================================
+// [SimdTests::DeJPEG - Thread Pool]
+// ============================================================================
+
+// Number of logical CPUs available to the process.
+uint32_t dejpeg_cpu_count(void);
+
+// Work-stealing thread pool. `dejpeg_thread_pool_run()` splits tasks evenly
+// between workers (the calling thread is worker 0), a worker that runs out of
+// tasks steals the back half of the remaining tasks of another worker. Tasks
+// are identified by their index and run exactly once.
+struct DeJpegThreadPool;
+
+typedef void (*DeJpegTaskFunc)(void* data, uint32_t worker, uint32_t task);
+
+// Creates a pool of `threadCount` workers (including the caller), zero uses
+// `dejpeg_cpu_count()`.
+DeJpegThreadPool* dejpeg_thread_pool_create(uint32_t threadCount);
+void dejpeg_thread_pool_destroy(DeJpegThreadPool* pool);
+
+// Number of workers, one if `pool` is NULL.
+uint32_t dejpeg_thread_pool_thread_count(const DeJpegThreadPool* pool);
+
+// Runs `func(data, worker, task)` for each task in `[0, taskCount)` and returns
+// when all tasks finished.
+void dejpeg_thread_pool_run(DeJpegThreadPool* pool, DeJpegTaskFunc func, void* data, uint32_t taskCount);
+
+// ============================================================================
+// [SimdTests::DeJPEG - Decoder]
+// ============================================================================
+
+// Minimal decoder that glues the kernels above together. It decodes baseline
+// (SOF0) and extended sequential (SOF1) 8-bit Huffman coded images having a
+// single interleaved scan, either grayscale or YCbCr subsampled as 4:4:4,
+// 4:2:2 or 4:2:0, with or without restart intervals. Chroma is upsampled by
+// replication (like libjpeg's merged upsampler with fancy upsampling turned
+// off), and the output is RGB32.
+//
+// Progressive (SOF2) images having the same sampling are decoded to a
+// coefficient arena per component (cache-line aligned, zig-zag order), which
+// is then de-zig-zagged and transformed by the batch IDCT a block row at a
+// time, just before the color conversion of each MCU row.
+//
+// All memory the decoder needs is provided by the caller, the decoder itself
+// is large (it holds all tables), but can be reused to decode any number of
+// images and it never allocates.
+enum DeJpegError {
+  kJpegErrorOk          = 0,
+  kJpegErrorInvalidData = 1,
+  kJpegErrorUnsupported = 2
+};
+
+#define JPEG_MAX_COMPONENTS 3
+
+// Kernels used by the decoder.
+struct DeJpegDecoderFuncs {
+  DeJpegHuffUnstuffFunc unstuff;
+  DeJpegIDCTSparseFunc idct;
+  DeJpegUpsampleH2V1Func upsampleH2V1;
+  YCbCrToRgbFunc ycbcrToRgb32;
+  YCbCrMergedToRgbFunc ycbcrH2V2ToRgb32;
+
+  // Progressive images.
+  DeJpegNonZeroMaskFunc nonzeroMask;
+  DeJpegDeZigZagEOBFunc dezigzag;
+  DeJpegIDCTBatchFunc idctBatch;
+};
+
+// Reference kernels, SSE2 kernels and the fastest kernels that require AVX2
+// (SSE2 kernels are used if there is no AVX2 version). The caller picks the
+// set the CPU supports.
+extern const DeJpegDecoderFuncs dejpeg_decoder_funcs_ref;
+extern const DeJpegDecoderFuncs dejpeg_decoder_funcs_sse2;
+extern const DeJpegDecoderFuncs dejpeg_decoder_funcs_avx2;
+
+// AVX2 kernels and AVX-512BW de-zig-zag.
+extern const DeJpegDecoderFuncs dejpeg_decoder_funcs_avx512bw;
+
+// The fastest set allowed by `SimdCpu::tier()`.
+const DeJpegDecoderFuncs* dejpeg_decoder_funcs_best(void);
+
+struct DeJpegComponent {
+  uint32_t id;
+  // Sampling factors.
+  uint32_t h, v;
+  // Quantization table and DC/AC Huffman table indexes.
+  uint32_t tq, td, ta;
+  // Blocks per line, including blocks of partial MCUs at the right edge.
+  uint32_t blocksPerLine;
+};
+
+struct DeJpegDecoder {
+  const DeJpegDecoderFuncs* funcs;
+
+  uint32_t width;
+  uint32_t height;
+  uint32_t componentCount;
+  uint32_t restartInterval;
+  bool progressive;
+
+  // MCU size in pixels and the number of MCUs.
+  uint32_t mcuWidth, mcuHeight;
+  uint32_t mcusPerLine, mcuRows;
+
+  // Bit masks of tables that were defined by DQT and DHT.
+  uint32_t qMask, dcMask, acMask;
+
+  // Entropy-coded data of the scan (including RST markers) up to the end of
+  // the input. Progressive images start at the first SOS marker instead, as
+  // the rest of the image is a sequence of scans and tables.
+  const uint8_t* scan;
+  size_t scanSize;
+
+  DeJpegComponent components[JPEG_MAX_COMPONENTS];
+
+  // Quantization tables in natural order.
+  uint16_t qTables[4][64];
+
+  DeJpegHuffTable dcTables[4];
+  DeJpegHuffTable acTables[4];
+};
+
+void dejpeg_decoder_init(DeJpegDecoder* d, const DeJpegDecoderFuncs* funcs);
+
+// Parses all markers up to the first SOS. On success the image size is known
+// and `dejpeg_decoder_decode()` can be called. Decoding a progressive image
+// parses tables defined between its scans, so the header must be read again
+// before the same image is decoded again.
+uint32_t dejpeg_decoder_read_header(DeJpegDecoder* d, const uint8_t* data, size_t size);
+
+// Size of the workspace required by `dejpeg_decoder_decode()` to decode the
+// image, which is O(width) plus the size of the scan. Progressive images also
+// need coefficients of the whole image (two bytes per sample).
+size_t dejpeg_decoder_workspace_size(const DeJpegDecoder* d);
+
+// Decodes the image to `dst` (`width * height` RGB32 pixels, rows `dstStride`
+// bytes apart) by using `workspace` of at least `dejpeg_decoder_workspace_size()`
+// bytes.
+uint32_t dejpeg_decoder_decode(DeJpegDecoder* d, uint8_t* dst, intptr_t dstStride, void* workspace);
+
+// Size of the workspace required by `dejpeg_decoder_decode_mt()` when using a
+// pool of `threadCount` workers, each worker needs its own MCU row buffers.
+size_t dejpeg_decoder_workspace_size_mt(const DeJpegDecoder* d, uint32_t threadCount);
+
+// Multi-threaded `dejpeg_decoder_decode()`, the output is identical. Restart
+// intervals make entropy-coded segments independent, so bands of MCU rows are
+// decoded in parallel, each band starts decoding at the restart marker that
+// precedes its first MCU. Images without restart intervals are decoded by a
+// single worker. Scans of progressive images are decoded by a single worker,
+// the IDCT and the color conversion are parallel.
+uint32_t dejpeg_decoder_decode_mt(DeJpegDecoder* d, uint8_t* dst, intptr_t dstStride, void* workspace, DeJpegThreadPool* pool);
+
+// Streaming decoding delivers the image a strip of RGB32 rows at a time, each
+// strip is an MCU row (8 or 16 rows, less at the bottom of the image), so the
+// caller never needs a buffer for the whole image. Sequential images are
+// decoded by unstuffing the scan to a fixed window as it's consumed, so the
+// workspace is O(width) regardless of the image height and the size of the
+// scan. Progressive images still keep all coefficients, only the output is
+// streamed.
+//
+//   DeJpegStream s;
+//   err = dejpeg_decoder_stream_begin(d, &s, workspace);
+//   while (err == kJpegErrorOk && (err = dejpeg_decoder_stream_next(&s)) == kJpegErrorOk && s.rows)
+//     consume(s.pixels, s.stride, s.y, s.rows);
+struct DeJpegStream {
+  // Rows `[y, y + rows)` of the image decoded by the last call to
+  // `dejpeg_decoder_stream_next()`, valid until the next call.
+  const uint8_t* pixels;
+  intptr_t stride;
+  uint32_t y;
+  uint32_t rows;
+
+  // Decoding state - the rest of the scan that wasn't unstuffed yet, whether
+  // it's the end of the current segment, and the position in the image.
+  DeJpegDecoder* d;
+  void* workspace;
+  const uint8_t* src;
+  const uint8_t* srcEnd;
+  bool segmentEnd;
+  DeJpegBitReader br;
+  int32_t dcPred[JPEG_MAX_COMPONENTS];
+  uint32_t restartLeft;
+  uint32_t mcuY;
+};
+
+// Size of the workspace required by `dejpeg_decoder_stream_begin()`.
+size_t dejpeg_decoder_stream_workspace_size(const DeJpegDecoder* d);
+
+// Starts decoding the image whose header was read by `d`. The decoder and the
+// workspace must stay valid until the stream ends. Progressive images are
+// decoded to coefficients here.
+uint32_t dejpeg_decoder_stream_begin(DeJpegDecoder* d, DeJpegStream* s, void* workspace);
+
+// Decodes the next strip, `s->rows` is zero after the last one. A stream that
+// failed doesn't deliver any more strips.
+uint32_t dejpeg_decoder_stream_next(DeJpegStream* s);
 
 #endif // _SIMDTESTS_DEJPEG_H
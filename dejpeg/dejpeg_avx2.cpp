@@ -0,0 +1,1371 @@
+// [SimdTests - DeJPEG]
+// SIMD optimized JPEG decoding utilities.
+//
+// [License]
+// Public Domain <unlicense.org>
+#define USE_AVX2
+
+#include "../simdglobals.h"
+#include "./dejpeg.h"
+#include "./dejpeg_vec.h"
+
+// ============================================================================
+// [IDCT - AVX2]
+// ============================================================================
+
+// The AVX2 implementation keeps two rows of the 8x8 block in each YMM register,
+// one row per 128-bit lane. This means that a single `vpmaddwd` performs two
+// different rotations at once (each lane uses its own constants) and a single
+// butterfly produces two output rows. The only price paid are few cross-lane
+// permutations that are needed to pair the even and odd parts together.
+//
+// Register layout used by the IDCT pass:
+//
+//   Input : [r0|r2] [r4|r6] [r1|r3] [r5|r7]
+//   Output: [r0|r1] [r7|r6] [r3|r2] [r4|r5]
+//
+// The transpose is designed to convert the output layout back to the input
+// layout, so both passes share the same code.
+struct DeJPEG_AVX2Consts {
+  // IDCT.
+  int16_t even_0[16], even_1[16];
+  int16_t odd_0[16], odd_1[16];
+  int16_t odd_2[16];
+
+  int32_t colBias[8];
+  int32_t rowBias[8];
+
+  // IDCT (scaled 4x4).
+  int16_t s4_even[16];
+  int16_t s4_odd0[16], s4_odd2[16];
+  int32_t s4_colBias[8];
+  int32_t s4_rowBias[8];
+
+  // IDCT (scaled 2x2).
+  int16_t s2_odd[16];
+  int16_t s2_rowPlus[16], s2_rowMinus[16];
+  int32_t s2_colBias[8];
+  int32_t s2_rowBias[8];
+
+  // IDCT (fast).
+  int16_t ifast_1_414[16];
+  int16_t ifast_1_847[16];
+  int16_t ifast_1_082[16];
+  int16_t ifast_m2_613[16];
+  int16_t ifast_rowBias[16];
+
+  // Upsample.
+  int16_t upsample_1[16];
+  int16_t upsample_2[16];
+  int16_t upsample_7[16];
+  int16_t upsample_8[16];
+
+  // YCbCr.
+  int16_t ycbcr_tosigned[16];
+  int16_t ycbcr_crMul[16];
+  int16_t ycbcr_cbMul[16];
+  int16_t ycbcr_cbcrMul[16];
+  int32_t ycbcr_round[8];
+  int16_t ycbcr_alpha[16];
+
+  // RGB32ToYCbCr.
+  uint32_t rgbycc_maskBR[8];
+  uint32_t rgbycc_maskG[8];
+  uint32_t rgbycc_one[8];
+  int16_t rgbycc_yBR[16];
+  int16_t rgbycc_yG[16];
+  int16_t rgbycc_cbBR[16];
+  int16_t rgbycc_cbG[16];
+  int16_t rgbycc_crBR[16];
+  int16_t rgbycc_crG[16];
+  uint32_t rgbycc_tounsigned[8];
+  uint32_t rgbycc_order[8];
+
+  // Downsample.
+  int16_t downsample_mask[16];
+  int16_t downsample_bias01[16];
+  int16_t downsample_bias12[16];
+
+  // FDCT.
+  int16_t fdct_center[16];
+  int16_t fdct_even0[16], fdct_even1[16];
+  int16_t fdct_odd0[16], fdct_odd1[16];
+  int16_t fdct_odd2[16], fdct_odd3[16];
+  int32_t fdct_rowBias[8];
+  int32_t fdct_colBias[8];
+};
+
+#define DATA_4X(...) __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__
+#define DATA_8X(...) { __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__ }
+#define DATA_LANES(lo0, lo1, hi0, hi1) { DATA_4X(lo0, lo1), DATA_4X(hi0, hi1) }
+
+SIMD_ALIGN_VAR(static const DeJPEG_AVX2Consts, dejpeg_avx2_consts, 32) = {
+  // [t0e|t3e] from [(r0, r4)|(r2, r6)].
+  DATA_LANES(JPEG_IDCT_SCALE(1)                                ,  JPEG_IDCT_SCALE(1)                                ,
+             JPEG_IDCT_P_0_541196100 + JPEG_IDCT_P_0_765366865 ,  JPEG_IDCT_P_0_541196100                           ),
+  // [t1e|t2e] from [(r0, r4)|(r2, r6)].
+  DATA_LANES(JPEG_IDCT_SCALE(1)                                , -JPEG_IDCT_SCALE(1)                                ,
+             JPEG_IDCT_P_0_541196100                           ,  JPEG_IDCT_P_0_541196100 + JPEG_IDCT_M_1_847759065 ),
+  // [y0o|y1o] from [(r3, r7)|(r1, r5)].
+  DATA_LANES(JPEG_IDCT_M_1_961570560                           ,  JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_0_298631336 ,
+             JPEG_IDCT_M_0_390180644                           ,  JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_2_053119869 ),
+  // [y3o|y2o] from [(r1, r5)|(r3, r7)].
+  DATA_LANES(JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_1_501321110 ,  JPEG_IDCT_M_0_390180644                           ,
+             JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_3_072711026 ,  JPEG_IDCT_M_1_961570560                           ),
+  // [y4o|y5o] from [(r1 + r7, r3 + r5)|(r3 + r5, r1 + r7)].
+  DATA_LANES(JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_0_899976223 ,  JPEG_IDCT_P_1_175875602                           ,
+             JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_2_562915447 ,  JPEG_IDCT_P_1_175875602                           ),
+
+  DATA_8X(JPEG_IDCT_COL_BIAS),
+  DATA_8X(JPEG_IDCT_ROW_BIAS),
+
+  // [tmp2|tmp0] from [(r2, r6)|(r0, 0)].
+  DATA_LANES(JPEG_IDCT_P_1_847759065 , JPEG_IDCT_M_0_765366865 ,
+             JPEG_IDCT_SCALE(2)      , 0                       ),
+  // tmp0 = lo + hi from [(r3, r1)|(r7, r5)].
+  DATA_LANES(JPEG_IDCT_M_2_172734803 , JPEG_IDCT_P_1_061594337 ,
+             JPEG_IDCT_M_0_211164243 , JPEG_IDCT_P_1_451774981 ),
+  // tmp2 = lo + hi from [(r3, r1)|(r7, r5)].
+  DATA_LANES(JPEG_IDCT_P_0_899976223 , JPEG_IDCT_P_2_562915447 ,
+             JPEG_IDCT_M_0_509795579 , JPEG_IDCT_M_0_601344887 ),
+  DATA_8X(JPEG_IDCT_4X4_COL_BIAS),
+  DATA_8X(JPEG_IDCT_4X4_ROW_BIAS),
+
+  // tmp0 = lo + hi from [(r3, r1)|(r7, r5)].
+  DATA_LANES(JPEG_IDCT_M_1_272758580 , JPEG_IDCT_P_3_624509785 ,
+             JPEG_IDCT_M_0_720959822 , JPEG_IDCT_P_0_850430095 ),
+  // Dot products of a whole row producing `tmp10 + tmp0` and `tmp10 - tmp0`.
+  { JPEG_IDCT_SCALE(4),  JPEG_IDCT_P_3_624509785, 0,  JPEG_IDCT_M_1_272758580, 0,  JPEG_IDCT_P_0_850430095, 0,  JPEG_IDCT_M_0_720959822,
+    JPEG_IDCT_SCALE(4),  JPEG_IDCT_P_3_624509785, 0,  JPEG_IDCT_M_1_272758580, 0,  JPEG_IDCT_P_0_850430095, 0,  JPEG_IDCT_M_0_720959822 },
+  { JPEG_IDCT_SCALE(4), -JPEG_IDCT_P_3_624509785, 0, -JPEG_IDCT_M_1_272758580, 0, -JPEG_IDCT_P_0_850430095, 0, -JPEG_IDCT_M_0_720959822,
+    JPEG_IDCT_SCALE(4), -JPEG_IDCT_P_3_624509785, 0, -JPEG_IDCT_M_1_272758580, 0, -JPEG_IDCT_P_0_850430095, 0, -JPEG_IDCT_M_0_720959822 },
+  DATA_8X(JPEG_IDCT_2X2_COL_BIAS),
+  DATA_8X(JPEG_IDCT_2X2_ROW_BIAS),
+
+  DATA_8X(JPEG_IFAST_MULHI(JPEG_IFAST_P_1_414213562 - 256), JPEG_IFAST_MULHI(JPEG_IFAST_P_1_414213562 - 256)),
+  DATA_8X(JPEG_IFAST_MULHI(JPEG_IFAST_P_1_847759065 - 256), JPEG_IFAST_MULHI(JPEG_IFAST_P_1_847759065 - 256)),
+  DATA_8X(JPEG_IFAST_MULHI(JPEG_IFAST_P_1_082392200 - 256), JPEG_IFAST_MULHI(JPEG_IFAST_P_1_082392200 - 256)),
+  DATA_8X(JPEG_IFAST_MULHI(768 - JPEG_IFAST_P_2_613125930), JPEG_IFAST_MULHI(768 - JPEG_IFAST_P_2_613125930)),
+  DATA_8X(JPEG_IFAST_ROW_BIAS, JPEG_IFAST_ROW_BIAS),
+
+  DATA_8X(1, 1),
+  DATA_8X(2, 2),
+  DATA_8X(7, 7),
+  DATA_8X(8, 8),
+
+  DATA_8X(-128, -128),
+  DATA_8X(JPEG_YCBCR_FIXED(1.40200), JPEG_YCBCR_FIXED(1.40200)),
+  DATA_8X(JPEG_YCBCR_FIXED(1.77200), JPEG_YCBCR_FIXED(1.77200)),
+  DATA_8X(-JPEG_YCBCR_FIXED(0.34414), -JPEG_YCBCR_FIXED(0.71414)),
+  DATA_8X(1 << (JPEG_YCBCR_PREC - 1)),
+  DATA_8X(255, 255),
+
+  DATA_8X(0x00FF00FFU),
+  DATA_8X(0x000000FFU),
+  DATA_8X(0x00010000U),
+  DATA_8X( JPEG_RGB_YCC_FIXED(0.11400),  JPEG_RGB_YCC_FIXED(0.29900)),
+  DATA_8X( JPEG_RGB_YCC_FIXED(0.58700),  JPEG_RGB_YCC_Y_BIAS),
+  DATA_8X( JPEG_RGB_YCC_FIXED(0.50000), -JPEG_RGB_YCC_FIXED(0.16874)),
+  DATA_8X(-JPEG_RGB_YCC_FIXED(0.33126),  JPEG_RGB_YCC_C_BIAS),
+  DATA_8X(-JPEG_RGB_YCC_FIXED(0.08131),  JPEG_RGB_YCC_FIXED(0.50000)),
+  DATA_8X(-JPEG_RGB_YCC_FIXED(0.41869),  JPEG_RGB_YCC_C_BIAS),
+  DATA_8X(0x80808080U),
+  { 0, 4, 1, 5, 2, 6, 3, 7 },
+
+  DATA_8X(0x00FF, 0x00FF),
+  DATA_8X(0, 1),
+  DATA_8X(1, 2),
+
+  DATA_8X(128, 128),
+  // [o0|o4] from [(tmp10, tmp11)|(tmp11, tmp10)].
+  DATA_LANES(JPEG_FDCT_FIXED(1)                                ,  JPEG_FDCT_FIXED(1)                                ,
+            -JPEG_FDCT_FIXED(1)                                ,  JPEG_FDCT_FIXED(1)                                ),
+  // [o2|o6] from [(tmp13, tmp12)|(tmp12, tmp13)].
+  DATA_LANES(JPEG_FDCT_P_0_541196100 + JPEG_FDCT_P_0_765366865 ,  JPEG_FDCT_P_0_541196100                           ,
+             JPEG_FDCT_P_0_541196100 - JPEG_FDCT_P_1_847759065 ,  JPEG_FDCT_P_0_541196100                           ),
+  // [p7|p5] from [(tmp4, tmp7)|(tmp5, tmp6)].
+  DATA_LANES(JPEG_FDCT_P_0_298631336 - JPEG_FDCT_P_0_899976223 , -JPEG_FDCT_P_0_899976223                           ,
+             JPEG_FDCT_P_2_053119869 - JPEG_FDCT_P_2_562915447 , -JPEG_FDCT_P_2_562915447                           ),
+  // [p1|p3] from [(tmp4, tmp7)|(tmp5, tmp6)].
+  DATA_LANES(-JPEG_FDCT_P_0_899976223                          ,  JPEG_FDCT_P_1_501321110 - JPEG_FDCT_P_0_899976223 ,
+             -JPEG_FDCT_P_2_562915447                          ,  JPEG_FDCT_P_3_072711026 - JPEG_FDCT_P_2_562915447 ),
+  // [z3|z4] from [(z3, z4)|(z4, z3)].
+  DATA_LANES(JPEG_FDCT_P_1_175875602 - JPEG_FDCT_P_1_961570560 ,  JPEG_FDCT_P_1_175875602                           ,
+             JPEG_FDCT_P_1_175875602 - JPEG_FDCT_P_0_390180644 ,  JPEG_FDCT_P_1_175875602                           ),
+  // [z4|z3] from [(z3, z4)|(z4, z3)].
+  DATA_LANES(JPEG_FDCT_P_1_175875602                           ,  JPEG_FDCT_P_1_175875602 - JPEG_FDCT_P_0_390180644 ,
+             JPEG_FDCT_P_1_175875602                           ,  JPEG_FDCT_P_1_175875602 - JPEG_FDCT_P_1_961570560 ),
+  DATA_8X(1 << (JPEG_FDCT_ROW_NORM - 1)),
+  DATA_8X(1 << (JPEG_FDCT_COL_NORM - 1))
+};
+
+#undef DATA_LANES
+#undef DATA_8X
+#undef DATA_4X
+
+#define JPEG_CONST_YMM(x) (*(const __m256i*)(dejpeg_avx2_consts.x))
+
+// Swap 128-bit lanes of `x`.
+#define JPEG_IDCT_SWAP_YMM(x) _mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 3, 2))
+
+// Load two 128-bit rows into a single YMM register.
+static SIMD_INLINE __m256i dejpeg_load_2x128(const void* lo, const void* hi) {
+  return _mm256_inserti128_si256(
+    _mm256_castsi128_si256(_mm_loadu_si128(static_cast<const __m128i*>(lo))),
+    _mm_loadu_si128(static_cast<const __m128i*>(hi)), 1);
+}
+
+// out = c[even]*x + c[odd]*y   (c, x, y 16-bit, out 32-bit, per lane)
+#define JPEG_IDCT_MADD_YMM(dst, x, y, c) \
+  __m256i dst##_l = _mm256_madd_epi16(_mm256_unpacklo_epi16(x, y), JPEG_CONST_YMM(c)); \
+  __m256i dst##_h = _mm256_madd_epi16(_mm256_unpackhi_epi16(x, y), JPEG_CONST_YMM(c));
+
+// out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit, per lane)
+// out(1) = c1[even]*x + c1[odd]*y
+#define JPEG_IDCT_ROTATE_YMM(dst0, dst1, x, y, c0, c1) \
+  __m256i dst0##_xy_l = _mm256_unpacklo_epi16(x, y); \
+  __m256i dst0##_xy_h = _mm256_unpackhi_epi16(x, y); \
+  \
+  __m256i dst0##_l = _mm256_madd_epi16(dst0##_xy_l, JPEG_CONST_YMM(c0)); \
+  __m256i dst0##_h = _mm256_madd_epi16(dst0##_xy_h, JPEG_CONST_YMM(c0)); \
+  __m256i dst1##_l = _mm256_madd_epi16(dst0##_xy_l, JPEG_CONST_YMM(c1)); \
+  __m256i dst1##_h = _mm256_madd_epi16(dst0##_xy_h, JPEG_CONST_YMM(c1));
+
+// wide permute (cross-lane)
+#define JPEG_IDCT_WPERM_YMM(dst, a, b, imm) \
+  __m256i dst##_l = _mm256_permute2x128_si256(a##_l, b##_l, imm); \
+  __m256i dst##_h = _mm256_permute2x128_si256(a##_h, b##_h, imm);
+
+// wide add
+#define JPEG_IDCT_WADD_YMM(dst, a, b) \
+  __m256i dst##_l = _mm256_add_epi32(a##_l, b##_l); \
+  __m256i dst##_h = _mm256_add_epi32(a##_h, b##_h);
+
+// wide sub
+#define JPEG_IDCT_WSUB_YMM(dst, a, b) \
+  __m256i dst##_l = _mm256_sub_epi32(a##_l, b##_l); \
+  __m256i dst##_h = _mm256_sub_epi32(a##_h, b##_h);
+
+// butterfly a/b, add bias, then shift by `norm` and pack to 16-bit.
+#define JPEG_IDCT_BFLY_YMM(dst0, dst1, a, b, bias, norm) { \
+  __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+  __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+  \
+  JPEG_IDCT_WADD_YMM(sum, abiased, b) \
+  JPEG_IDCT_WSUB_YMM(diff, abiased, b) \
+  \
+  dst0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, norm), _mm256_srai_epi32(sum_h, norm)); \
+  dst1 = _mm256_packs_epi32(_mm256_srai_epi32(diff_l, norm), _mm256_srai_epi32(diff_h, norm)); \
+}
+
+#define JPEG_IDCT_IDCT_PASS_YMM(bias, norm) { \
+  /* Even part. */ \
+  JPEG_IDCT_ROTATE_YMM(t03e, t12e, r02, r46, even_0, even_1) \
+  \
+  JPEG_IDCT_WPERM_YMM(t01e, t03e, t12e, 0x20)   /* [t0e|t1e] */ \
+  JPEG_IDCT_WPERM_YMM(t32e, t03e, t12e, 0x31)   /* [t3e|t2e] */ \
+  \
+  JPEG_IDCT_WADD_YMM(x01, t01e, t32e)           /* [x0|x1]   */ \
+  JPEG_IDCT_WSUB_YMM(x32, t01e, t32e)           /* [x3|x2]   */ \
+  \
+  /* Odd part. */ \
+  __m256i r31 = JPEG_IDCT_SWAP_YMM(r13); \
+  __m256i r75 = JPEG_IDCT_SWAP_YMM(r57); \
+  __m256i sum17_35 = _mm256_add_epi16(r13, r75); \
+  __m256i sum35_17 = _mm256_add_epi16(r31, r57); \
+  \
+  JPEG_IDCT_MADD_YMM(y01o, r31, r75, odd_0)     /* [y0o|y1o] */ \
+  JPEG_IDCT_MADD_YMM(y32o, r13, r57, odd_1)     /* [y3o|y2o] */ \
+  JPEG_IDCT_MADD_YMM(y45o, sum17_35, sum35_17, odd_2) /* [y4o|y5o] */ \
+  \
+  JPEG_IDCT_WADD_YMM(x45, y01o, y45o)           /* [x4|x5]   */ \
+  JPEG_IDCT_WADD_YMM(x76, y32o, y45o)           /* [x7|x6]   */ \
+  \
+  JPEG_IDCT_BFLY_YMM(r01, r76, x01, x76, bias, norm) \
+  JPEG_IDCT_BFLY_YMM(r32, r45, x32, x45, bias, norm) \
+}
+
+// Transpose [r0|r1] [r7|r6] [r3|r2] [r4|r5] into [r0|r2] [r4|r6] [r1|r3] [r5|r7].
+#define JPEG_IDCT_TRANSPOSE_YMM() { \
+  __m256i s01 = _mm256_unpacklo_epi16(r01, r45);         /* [a0a4|b0b4|...] | [a1a5|b1b5|...] */ \
+  __m256i s45 = _mm256_unpackhi_epi16(r01, r45);         /* [e0e4|f0f4|...] | [e1e5|f1f5|...] */ \
+  __m256i s23 = _mm256_unpacklo_epi16(r32, r76);         /* [a3a7|b3b7|...] | [a2a6|b2b6|...] */ \
+  __m256i s67 = _mm256_unpackhi_epi16(r32, r76);         /* [e3e7|f3f7|...] | [e2e6|f2f6|...] */ \
+  \
+  s23 = JPEG_IDCT_SWAP_YMM(s23);                         /* [a2a6|b2b6|...] | [a3a7|b3b7|...] */ \
+  s67 = JPEG_IDCT_SWAP_YMM(s67);                         /* [e2e6|f2f6|...] | [e3e7|f3f7|...] */ \
+  \
+  __m256i u01 = _mm256_unpacklo_epi16(s01, s23);         /* [a0a2|a4a6|b0b2|b4b6] | [a1a3|a5a7|b1b3|b5b7] */ \
+  __m256i u23 = _mm256_unpackhi_epi16(s01, s23);         /* [c0c2|c4c6|d0d2|d4d6] | [c1c3|c5c7|d1d3|d5d7] */ \
+  __m256i u45 = _mm256_unpacklo_epi16(s45, s67);         /* [e0e2|e4e6|f0f2|f4f6] | [e1e3|e5e7|f1f3|f5f7] */ \
+  __m256i u67 = _mm256_unpackhi_epi16(s45, s67);         /* [g0g2|g4g6|h0h2|h4h6] | [g1g3|g5g7|h1h3|h5h7] */ \
+  \
+  __m256i v02 = _mm256_permute2x128_si256(u01, u23, 0x20); \
+  __m256i v13 = _mm256_permute2x128_si256(u01, u23, 0x31); \
+  __m256i v46 = _mm256_permute2x128_si256(u45, u67, 0x20); \
+  __m256i v57 = _mm256_permute2x128_si256(u45, u67, 0x31); \
+  \
+  r02 = _mm256_unpacklo_epi16(v02, v13);                 /* [a0a1|a2a3|a4a5|a6a7] | [c0c1|c2c3|c4c5|c6c7] */ \
+  r13 = _mm256_unpackhi_epi16(v02, v13);                 /* [b0b1|b2b3|b4b5|b6b7] | [d0d1|d2d3|d4d5|d6d7] */ \
+  r46 = _mm256_unpacklo_epi16(v46, v57);                 /* [e0e1|e2e3|e4e5|e6e7] | [g0g1|g2g3|g4g5|g6g7] */ \
+  r57 = _mm256_unpackhi_epi16(v46, v57);                 /* [f0f1|f2f3|f4f5|f6f7] | [h0h1|h2h3|h4h5|h6h7] */ \
+}
+
+static SIMD_INLINE void dejpeg_idct_islow_avx2_block(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  __m256i r01, r76, r32, r45;
+
+  // Load and dequantize.
+  __m256i r02 = _mm256_mullo_epi16(dejpeg_load_2x128(src +  0, src + 16), dejpeg_load_2x128(qTable +  0, qTable + 16));
+  __m256i r46 = _mm256_mullo_epi16(dejpeg_load_2x128(src + 32, src + 48), dejpeg_load_2x128(qTable + 32, qTable + 48));
+  __m256i r13 = _mm256_mullo_epi16(dejpeg_load_2x128(src +  8, src + 24), dejpeg_load_2x128(qTable +  8, qTable + 24));
+  __m256i r57 = _mm256_mullo_epi16(dejpeg_load_2x128(src + 40, src + 56), dejpeg_load_2x128(qTable + 40, qTable + 56));
+
+  // IDCT columns.
+  JPEG_IDCT_IDCT_PASS_YMM(JPEG_CONST_YMM(colBias), 10)
+
+  // Transpose.
+  JPEG_IDCT_TRANSPOSE_YMM()
+
+  // IDCT rows.
+  JPEG_IDCT_IDCT_PASS_YMM(JPEG_CONST_YMM(rowBias), 17)
+
+  // Pack to 8-bit integers, also saturates the result to 0..255.
+  __m256i p03_12 = _mm256_packus_epi16(r01, r32);        // [a0..a7|d0..d7] | [b0..b7|c0..c7]
+  __m256i p47_56 = _mm256_packus_epi16(r45, r76);        // [e0..e7|h0..h7] | [f0..f7|g0..g7]
+
+  // Transpose.
+  __m256i q04 = _mm256_unpacklo_epi8(p03_12, p47_56);    // [a0e0a1e1|...|a6e6a7e7] | [b0f0b1f1|...|b6f6b7f7]
+  __m256i q62 = _mm256_unpackhi_epi8(p03_12, p47_56);    // [d0h0d1h1|...|d6h6d7h7] | [c0g0c1g1|...|c6g6c7g7]
+  __m256i q26 = JPEG_IDCT_SWAP_YMM(q62);
+
+  __m256i w04 = _mm256_unpacklo_epi8(q04, q26);          // [a0c0e0g0|...|a3c3e3g3] | [b0d0f0h0|...|b3d3f3h3]
+  __m256i w26 = _mm256_unpackhi_epi8(q04, q26);          // [a4c4e4g4|...|a7c7e7g7] | [b4d4f4h4|...|b7d7f7h7]
+
+  __m256i z02 = _mm256_permute2x128_si256(w04, w26, 0x20);
+  __m256i z46 = _mm256_permute2x128_si256(w04, w26, 0x31);
+
+  __m256i out0 = _mm256_unpacklo_epi8(z02, z46);         // [a0b0c0d0|e0f0g0h0|a1b1c1d1|e1f1g1h1] | [a4..h4|a5..h5]
+  __m256i out1 = _mm256_unpackhi_epi8(z02, z46);         // [a2b2c2d2|e2f2g2h2|a3b3c3d3|e3f3g3h3] | [a6..h6|a7..h7]
+
+  __m128i row0 = _mm256_castsi256_si128(out0);
+  __m128i row2 = _mm256_extracti128_si256(out0, 1);
+  __m128i row4 = _mm256_castsi256_si128(out1);
+  __m128i row6 = _mm256_extracti128_si256(out1, 1);
+
+  // Store.
+  uint8_t* dst0 = dst;
+  uint8_t* dst1 = dst + dstStride;
+  intptr_t dstStride2 = dstStride * 2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row0)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row0)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row4)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row4)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row2)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row2)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row6));
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row6));
+}
+
+void dejpeg_idct_islow_avx2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  dejpeg_idct_islow_avx2_block(dst, dstStride, src, qTable);
+}
+
+// The block kernel is inlined into the loop so the compiler can keep the
+// IDCT constants in registers across blocks. The next block is prefetched
+// while the current one is being transformed.
+void dejpeg_idct_islow_batch_avx2(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++, src += 64) {
+    _mm_prefetch(reinterpret_cast<const char*>(src + 64), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(src + 96), _MM_HINT_T0);
+    dejpeg_idct_islow_avx2_block(dst[i], dstStride, src, qTables + static_cast<uint32_t>(qIndex[i]) * 64);
+  }
+}
+
+// ============================================================================
+// [IDCT (Sparse) - AVX2]
+// ============================================================================
+
+// Sparse blocks don't have enough work to fill YMM registers, so they are
+// handled by the SSE2 kernels and only dense blocks use the AVX2 transform.
+void dejpeg_idct_islow_sparse_avx2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable, uint32_t eob) {
+  if (eob == 0)
+    dejpeg_idct_islow_dconly_sse2(dst, dstStride, src, qTable);
+  else if (eob <= JPEG_IDCT_EOB_2X2)
+    dejpeg_idct_islow_2x2_sse2(dst, dstStride, src, qTable);
+  else if (eob <= JPEG_IDCT_EOB_4X4)
+    dejpeg_idct_islow_4x4_sse2(dst, dstStride, src, qTable);
+  else
+    dejpeg_idct_islow_avx2_block(dst, dstStride, src, qTable);
+}
+
+// ============================================================================
+// [IDCT Scaled - AVX2]
+// ============================================================================
+
+// The scaled transforms keep two rows per YMM register as well. The odd part is
+// calculated as a sum of both lanes, which halves the number of `vpmaddwd`, and
+// the even part gets the DC term from the high lane. Both passes use the same
+// lane layout, so they share the constants.
+
+// Load and dequantize two rows of coefficients into a single YMM register.
+#define JPEG_IDCT_LOAD_2X_YMM(lo, hi) \
+  _mm256_mullo_epi16(dejpeg_load_2x128(src + (lo) * 8, src + (hi) * 8), dejpeg_load_2x128(qTable + (lo) * 8, qTable + (hi) * 8))
+
+// Adds the low and high lanes of `lo` (columns 0..3) and `hi` (columns 4..7),
+// the result holds all 8 columns.
+#define JPEG_IDCT_LANES_ADD_YMM(lo, hi) \
+  _mm256_add_epi32(_mm256_permute2x128_si256(lo, hi, 0x20), _mm256_permute2x128_si256(lo, hi, 0x31))
+
+static SIMD_INLINE void dejpeg_idct_store4x4_avx2(uint8_t* dst, intptr_t dstStride, __m128i o0, __m128i o1, __m128i o2, __m128i o3) {
+  __m128i x = _mm_packus_epi16(_mm_packs_epi32(o0, o2), _mm_packs_epi32(o1, o3));
+  x = _mm_unpacklo_epi8(x, _mm_srli_si128(x, 8));
+  x = _mm_unpacklo_epi16(x, _mm_srli_si128(x, 8));
+
+  *reinterpret_cast<uint32_t*>(dst) = static_cast<uint32_t>(_mm_cvtsi128_si32(x)); dst += dstStride;
+  *reinterpret_cast<uint32_t*>(dst) = static_cast<uint32_t>(_mm_extract_epi32(x, 1)); dst += dstStride;
+  *reinterpret_cast<uint32_t*>(dst) = static_cast<uint32_t>(_mm_extract_epi32(x, 2)); dst += dstStride;
+  *reinterpret_cast<uint32_t*>(dst) = static_cast<uint32_t>(_mm_extract_epi32(x, 3));
+}
+
+void dejpeg_idct_scaled4x4_avx2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  __m256i zero = _mm256_setzero_si256();
+
+  // Load and dequantize (row 4 is not used).
+  __m256i r20 = JPEG_IDCT_LOAD_2X_YMM(2, 0);
+  __m256i r37 = JPEG_IDCT_LOAD_2X_YMM(3, 7);
+  __m256i r15 = JPEG_IDCT_LOAD_2X_YMM(1, 5);
+  __m256i r6z = _mm256_inserti128_si256(zero,
+    _mm_mullo_epi16(*(const __m128i *)(src + 48), *(const __m128i *)(qTable + 48)), 0);
+
+  // IDCT columns.
+  __m256i p01, p23;
+  {
+    __m256i e_l = _mm256_madd_epi16(_mm256_unpacklo_epi16(r20, r6z), JPEG_CONST_YMM(s4_even));
+    __m256i e_h = _mm256_madd_epi16(_mm256_unpackhi_epi16(r20, r6z), JPEG_CONST_YMM(s4_even));
+
+    __m256i t2e = _mm256_permute2x128_si256(e_l, e_h, 0x20);
+    __m256i t0e = _mm256_permute2x128_si256(e_l, e_h, 0x31);
+
+    __m256i tmp10 = _mm256_add_epi32(_mm256_add_epi32(t0e, t2e), JPEG_CONST_YMM(s4_colBias));
+    __m256i tmp12 = _mm256_add_epi32(_mm256_sub_epi32(t0e, t2e), JPEG_CONST_YMM(s4_colBias));
+
+    __m256i o_l = _mm256_unpacklo_epi16(r37, r15);
+    __m256i o_h = _mm256_unpackhi_epi16(r37, r15);
+
+    __m256i tmp0 = JPEG_IDCT_LANES_ADD_YMM(_mm256_madd_epi16(o_l, JPEG_CONST_YMM(s4_odd0)), _mm256_madd_epi16(o_h, JPEG_CONST_YMM(s4_odd0)));
+    __m256i tmp2 = JPEG_IDCT_LANES_ADD_YMM(_mm256_madd_epi16(o_l, JPEG_CONST_YMM(s4_odd2)), _mm256_madd_epi16(o_h, JPEG_CONST_YMM(s4_odd2)));
+
+    __m256i w0 = _mm256_srai_epi32(_mm256_add_epi32(tmp10, tmp2), JPEG_IDCT_4X4_COL_NORM);
+    __m256i w3 = _mm256_srai_epi32(_mm256_sub_epi32(tmp10, tmp2), JPEG_IDCT_4X4_COL_NORM);
+    __m256i w1 = _mm256_srai_epi32(_mm256_add_epi32(tmp12, tmp0), JPEG_IDCT_4X4_COL_NORM);
+    __m256i w2 = _mm256_srai_epi32(_mm256_sub_epi32(tmp12, tmp0), JPEG_IDCT_4X4_COL_NORM);
+
+    p01 = _mm256_packs_epi32(w0, w1);      // [a0a1a2a3|b0b1b2b3] [a4a5a6a7|b4b5b6b7]
+    p23 = _mm256_packs_epi32(w2, w3);      // [c0c1c2c3|d0d1d2d3] [c4c5c6c7|d4d5d6d7]
+  }
+
+  // Transpose.
+  __m256i u = _mm256_unpacklo_epi16(p01, p23);
+  __m256i v = _mm256_unpackhi_epi16(p01, p23);
+  __m256i q0 = _mm256_unpacklo_epi16(u, v); // [c0|c1] [c4|c5]
+  __m256i q1 = _mm256_unpackhi_epi16(u, v); // [c2|c3] [c6|c7]
+
+  // IDCT rows.
+  {
+    __m256i e = _mm256_unpacklo_epi16(
+      _mm256_permute2x128_si256(q1, q0, 0x20), // [c2|c3] [c0|c1]
+      _mm256_permute2x128_si256(q1, q1, 0x81)); // [c6|c7] [0]
+    e = _mm256_madd_epi16(e, JPEG_CONST_YMM(s4_even));
+
+    __m128i t2e = _mm256_castsi256_si128(e);
+    __m128i t0e = _mm256_extracti128_si256(e, 1);
+
+    __m128i bias = _mm256_castsi256_si128(JPEG_CONST_YMM(s4_rowBias));
+    __m128i tmp10 = _mm_add_epi32(_mm_add_epi32(t0e, t2e), bias);
+    __m128i tmp12 = _mm_add_epi32(_mm_sub_epi32(t0e, t2e), bias);
+
+    // [(c3, c1)|(c7, c5)].
+    __m256i o = _mm256_unpackhi_epi16(q1, q0);
+    __m256i m0 = _mm256_madd_epi16(o, JPEG_CONST_YMM(s4_odd0));
+    __m256i m2 = _mm256_madd_epi16(o, JPEG_CONST_YMM(s4_odd2));
+
+    __m128i tmp0 = _mm_add_epi32(_mm256_castsi256_si128(m0), _mm256_extracti128_si256(m0, 1));
+    __m128i tmp2 = _mm_add_epi32(_mm256_castsi256_si128(m2), _mm256_extracti128_si256(m2, 1));
+
+    __m128i o0 = _mm_srai_epi32(_mm_add_epi32(tmp10, tmp2), JPEG_IDCT_4X4_ROW_NORM);
+    __m128i o3 = _mm_srai_epi32(_mm_sub_epi32(tmp10, tmp2), JPEG_IDCT_4X4_ROW_NORM);
+    __m128i o1 = _mm_srai_epi32(_mm_add_epi32(tmp12, tmp0), JPEG_IDCT_4X4_ROW_NORM);
+    __m128i o2 = _mm_srai_epi32(_mm_sub_epi32(tmp12, tmp0), JPEG_IDCT_4X4_ROW_NORM);
+
+    dejpeg_idct_store4x4_avx2(dst, dstStride, o0, o1, o2, o3);
+  }
+}
+
+void dejpeg_idct_scaled2x2_avx2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  // Load and dequantize (only row 0 and odd rows are used).
+  __m128i r0 = _mm_mullo_epi16(*(const __m128i *)(src + 0), *(const __m128i *)(qTable + 0));
+  __m256i r37 = JPEG_IDCT_LOAD_2X_YMM(3, 7);
+  __m256i r15 = JPEG_IDCT_LOAD_2X_YMM(1, 5);
+
+  // IDCT columns.
+  __m256i w;
+  {
+    __m256i tmp10 = _mm256_add_epi32(
+      _mm256_slli_epi32(_mm256_cvtepi16_epi32(r0), JPEG_IDCT_PREC + 2), JPEG_CONST_YMM(s2_colBias));
+
+    __m256i tmp0 = JPEG_IDCT_LANES_ADD_YMM(
+      _mm256_madd_epi16(_mm256_unpacklo_epi16(r37, r15), JPEG_CONST_YMM(s2_odd)),
+      _mm256_madd_epi16(_mm256_unpackhi_epi16(r37, r15), JPEG_CONST_YMM(s2_odd)));
+
+    __m256i w0 = _mm256_srai_epi32(_mm256_add_epi32(tmp10, tmp0), JPEG_IDCT_2X2_COL_NORM);
+    __m256i w1 = _mm256_srai_epi32(_mm256_sub_epi32(tmp10, tmp0), JPEG_IDCT_2X2_COL_NORM);
+
+    // [w0|w1] - one row per lane.
+    w = _mm256_permute4x64_epi64(_mm256_packs_epi32(w0, w1), _MM_SHUFFLE(3, 1, 2, 0));
+  }
+
+  // IDCT rows - each output is a dot product of a whole row and the row
+  // constants, both rows are processed at once.
+  {
+    __m256i a = _mm256_madd_epi16(w, JPEG_CONST_YMM(s2_rowPlus));
+    __m256i b = _mm256_madd_epi16(w, JPEG_CONST_YMM(s2_rowMinus));
+
+    __m256i ab = _mm256_add_epi32(_mm256_unpacklo_epi32(a, b), _mm256_unpackhi_epi32(a, b));
+    ab = _mm256_add_epi32(ab, _mm256_shuffle_epi32(ab, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    __m128i x = _mm_unpacklo_epi64(_mm256_castsi256_si128(ab), _mm256_extracti128_si256(ab, 1));
+    x = _mm_srai_epi32(_mm_add_epi32(x, _mm256_castsi256_si128(JPEG_CONST_YMM(s2_rowBias))), JPEG_IDCT_2X2_ROW_NORM);
+    x = _mm_packs_epi32(x, x);
+    x = _mm_packus_epi16(x, x);
+
+    uint32_t pixels = static_cast<uint32_t>(_mm_cvtsi128_si32(x));
+    reinterpret_cast<uint16_t*>(dst)[0] = static_cast<uint16_t>(pixels);
+    reinterpret_cast<uint16_t*>(dst + dstStride)[0] = static_cast<uint16_t>(pixels >> 16);
+  }
+}
+
+#undef JPEG_IDCT_LANES_ADD_YMM
+#undef JPEG_IDCT_LOAD_2X_YMM
+
+// ============================================================================
+// [IDCT Fast - AVX2]
+// ============================================================================
+
+// AAN doesn't need any widening, so instead of splitting a single block across
+// lanes, two blocks are transformed at once - the low lane holds a row of the
+// first block and the high lane the same row of the second block. All shuffles
+// used by the transpose work within lanes, so no cross-lane permutations are
+// needed at all.
+
+#define JPEG_IFAST_MULHI_YMM(x, c) _mm256_mulhi_epi16(_mm256_slli_epi16(x, JPEG_IFAST_PRE_SHIFT), JPEG_CONST_YMM(c))
+#define JPEG_IFAST_MUL_YMM(x, c) _mm256_add_epi16(x, JPEG_IFAST_MULHI_YMM(x, c))
+#define JPEG_IFAST_INTERLEAVE16_YMM(a, b) { __m256i t = a; a = _mm256_unpacklo_epi16(a, b); b = _mm256_unpackhi_epi16(t, b); }
+#define JPEG_IFAST_INTERLEAVE8_YMM(a, b) { __m256i t = a; a = _mm256_unpacklo_epi8(a, b); b = _mm256_unpackhi_epi8(t, b); }
+
+#define JPEG_IFAST_PASS_YMM() { \
+  /* Even part. */ \
+  __m256i tmp10 = _mm256_add_epi16(row0, row4); \
+  __m256i tmp11 = _mm256_sub_epi16(row0, row4); \
+  __m256i tmp13 = _mm256_add_epi16(row2, row6); \
+  __m256i tmp12 = _mm256_sub_epi16(JPEG_IFAST_MUL_YMM(_mm256_sub_epi16(row2, row6), ifast_1_414), tmp13); \
+  \
+  __m256i tmp0 = _mm256_add_epi16(tmp10, tmp13); \
+  __m256i tmp3 = _mm256_sub_epi16(tmp10, tmp13); \
+  __m256i tmp1 = _mm256_add_epi16(tmp11, tmp12); \
+  __m256i tmp2 = _mm256_sub_epi16(tmp11, tmp12); \
+  \
+  /* Odd part. */ \
+  __m256i z13 = _mm256_add_epi16(row5, row3); \
+  __m256i z10 = _mm256_sub_epi16(row5, row3); \
+  __m256i z11 = _mm256_add_epi16(row1, row7); \
+  __m256i z12 = _mm256_sub_epi16(row1, row7); \
+  \
+  __m256i tmp7 = _mm256_add_epi16(z11, z13); \
+  tmp11 = JPEG_IFAST_MUL_YMM(_mm256_sub_epi16(z11, z13), ifast_1_414); \
+  \
+  __m256i z5 = JPEG_IFAST_MUL_YMM(_mm256_add_epi16(z10, z12), ifast_1_847); \
+  tmp10 = _mm256_sub_epi16(JPEG_IFAST_MUL_YMM(z12, ifast_1_082), z5); \
+  tmp12 = _mm256_add_epi16(_mm256_sub_epi16(JPEG_IFAST_MULHI_YMM(z10, ifast_m2_613), _mm256_add_epi16(_mm256_add_epi16(z10, z10), z10)), z5); \
+  \
+  __m256i tmp6 = _mm256_sub_epi16(tmp12, tmp7); \
+  __m256i tmp5 = _mm256_sub_epi16(tmp11, tmp6); \
+  __m256i tmp4 = _mm256_add_epi16(tmp10, tmp5); \
+  \
+  row0 = _mm256_add_epi16(tmp0, tmp7); \
+  row7 = _mm256_sub_epi16(tmp0, tmp7); \
+  row1 = _mm256_add_epi16(tmp1, tmp6); \
+  row6 = _mm256_sub_epi16(tmp1, tmp6); \
+  row2 = _mm256_add_epi16(tmp2, tmp5); \
+  row5 = _mm256_sub_epi16(tmp2, tmp5); \
+  row4 = _mm256_add_epi16(tmp3, tmp4); \
+  row3 = _mm256_sub_epi16(tmp3, tmp4); \
+}
+
+static SIMD_INLINE void dejpeg_idct_store8x8_avx2(uint8_t* dst, intptr_t dstStride, __m128i row0, __m128i row2, __m128i row4, __m128i row6) {
+  uint8_t* dst0 = dst;
+  uint8_t* dst1 = dst + dstStride;
+  intptr_t dstStride2 = dstStride * 2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row0)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row0)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row4)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row4)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row2)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row2)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row6));
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row6));
+}
+
+static SIMD_INLINE void dejpeg_idct_ifast_avx2_2x(uint8_t* dstA, uint8_t* dstB, intptr_t dstStride, const int16_t* src, const uint16_t* qTableA, const uint16_t* qTableB) {
+  // Load and dequantize.
+  __m256i row0 = _mm256_mullo_epi16(dejpeg_load_2x128(src +  0, src + 64), dejpeg_load_2x128(qTableA +  0, qTableB +  0));
+  __m256i row1 = _mm256_mullo_epi16(dejpeg_load_2x128(src +  8, src + 72), dejpeg_load_2x128(qTableA +  8, qTableB +  8));
+  __m256i row2 = _mm256_mullo_epi16(dejpeg_load_2x128(src + 16, src + 80), dejpeg_load_2x128(qTableA + 16, qTableB + 16));
+  __m256i row3 = _mm256_mullo_epi16(dejpeg_load_2x128(src + 24, src + 88), dejpeg_load_2x128(qTableA + 24, qTableB + 24));
+  __m256i row4 = _mm256_mullo_epi16(dejpeg_load_2x128(src + 32, src + 96), dejpeg_load_2x128(qTableA + 32, qTableB + 32));
+  __m256i row5 = _mm256_mullo_epi16(dejpeg_load_2x128(src + 40, src +104), dejpeg_load_2x128(qTableA + 40, qTableB + 40));
+  __m256i row6 = _mm256_mullo_epi16(dejpeg_load_2x128(src + 48, src +112), dejpeg_load_2x128(qTableA + 48, qTableB + 48));
+  __m256i row7 = _mm256_mullo_epi16(dejpeg_load_2x128(src + 56, src +120), dejpeg_load_2x128(qTableA + 56, qTableB + 56));
+
+  // IDCT columns.
+  JPEG_IFAST_PASS_YMM()
+
+  // Transpose (both blocks, see the SSE2 version for the data layout).
+  JPEG_IFAST_INTERLEAVE16_YMM(row0, row4)
+  JPEG_IFAST_INTERLEAVE16_YMM(row2, row6)
+  JPEG_IFAST_INTERLEAVE16_YMM(row1, row5)
+  JPEG_IFAST_INTERLEAVE16_YMM(row3, row7)
+
+  JPEG_IFAST_INTERLEAVE16_YMM(row0, row2)
+  JPEG_IFAST_INTERLEAVE16_YMM(row1, row3)
+  JPEG_IFAST_INTERLEAVE16_YMM(row4, row6)
+  JPEG_IFAST_INTERLEAVE16_YMM(row5, row7)
+
+  JPEG_IFAST_INTERLEAVE16_YMM(row0, row1)
+  JPEG_IFAST_INTERLEAVE16_YMM(row2, row3)
+  JPEG_IFAST_INTERLEAVE16_YMM(row4, row5)
+  JPEG_IFAST_INTERLEAVE16_YMM(row6, row7)
+
+  // IDCT rows.
+  row0 = _mm256_add_epi16(row0, JPEG_CONST_YMM(ifast_rowBias));
+  JPEG_IFAST_PASS_YMM()
+
+  // Pack to 8-bit integers, also saturates the result to 0..255.
+  row0 = _mm256_packus_epi16(_mm256_srai_epi16(row0, JPEG_IFAST_ROW_NORM), _mm256_srai_epi16(row1, JPEG_IFAST_ROW_NORM));
+  row2 = _mm256_packus_epi16(_mm256_srai_epi16(row2, JPEG_IFAST_ROW_NORM), _mm256_srai_epi16(row3, JPEG_IFAST_ROW_NORM));
+  row4 = _mm256_packus_epi16(_mm256_srai_epi16(row4, JPEG_IFAST_ROW_NORM), _mm256_srai_epi16(row5, JPEG_IFAST_ROW_NORM));
+  row6 = _mm256_packus_epi16(_mm256_srai_epi16(row6, JPEG_IFAST_ROW_NORM), _mm256_srai_epi16(row7, JPEG_IFAST_ROW_NORM));
+
+  // Transpose.
+  JPEG_IFAST_INTERLEAVE8_YMM(row0, row4)
+  JPEG_IFAST_INTERLEAVE8_YMM(row2, row6)
+  JPEG_IFAST_INTERLEAVE8_YMM(row0, row2)
+  JPEG_IFAST_INTERLEAVE8_YMM(row4, row6)
+  JPEG_IFAST_INTERLEAVE8_YMM(row0, row4)
+  JPEG_IFAST_INTERLEAVE8_YMM(row2, row6)
+
+  // Store.
+  dejpeg_idct_store8x8_avx2(dstA, dstStride,
+    _mm256_castsi256_si128(row0), _mm256_castsi256_si128(row2),
+    _mm256_castsi256_si128(row4), _mm256_castsi256_si128(row6));
+  dejpeg_idct_store8x8_avx2(dstB, dstStride,
+    _mm256_extracti128_si256(row0, 1), _mm256_extracti128_si256(row2, 1),
+    _mm256_extracti128_si256(row4, 1), _mm256_extracti128_si256(row6, 1));
+}
+
+void dejpeg_idct_ifast_batch_avx2(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count) {
+  uint32_t i = 0;
+
+  for (; i + 2 <= count; i += 2, src += 128) {
+    _mm_prefetch(reinterpret_cast<const char*>(src + 128), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(src + 160), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(src + 192), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(src + 224), _MM_HINT_T0);
+
+    dejpeg_idct_ifast_avx2_2x(dst[i], dst[i + 1], dstStride, src,
+      qTables + static_cast<uint32_t>(qIndex[i    ]) * 64,
+      qTables + static_cast<uint32_t>(qIndex[i + 1]) * 64);
+  }
+
+  if (i < count)
+    dejpeg_idct_ifast_sse2(dst[i], dstStride, src, qTables + static_cast<uint32_t>(qIndex[i]) * 64);
+}
+
+#undef JPEG_IFAST_INTERLEAVE8_YMM
+#undef JPEG_IFAST_INTERLEAVE16_YMM
+#undef JPEG_IFAST_MUL_YMM
+
+// ============================================================================
+// [Upsample - AVX2]
+// ============================================================================
+
+void dejpeg_upsample_h2v1_avx2(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  uint32_t i = count;
+
+  while (i >= 32) {
+    // [q0 q1 | q2 q3] -> [q0 q2 | q1 q3], so in-lane unpacks produce outputs
+    // in the right order.
+    __m256i x = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)), _MM_SHUFFLE(3, 1, 2, 0));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst +  0), _mm256_unpacklo_epi8(x, x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), _mm256_unpackhi_epi8(x, x));
+
+    dst += 64;
+    src += 32;
+    i   -= 32;
+  }
+
+  while (i) {
+    dst[0] = src[0];
+    dst[1] = src[0];
+
+    dst += 2;
+    src += 1;
+    i   -= 1;
+  }
+}
+
+void dejpeg_upsample_h2v2_avx2(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count) {
+  (void)srcPrev;
+  (void)srcNext;
+
+  uint32_t i = count;
+
+  while (i >= 32) {
+    __m256i x = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)), _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i lo = _mm256_unpacklo_epi8(x, x);
+    __m256i hi = _mm256_unpackhi_epi8(x, x);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst0 +  0), lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst0 + 32), hi);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst1 +  0), lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst1 + 32), hi);
+
+    dst0 += 64;
+    dst1 += 64;
+    src  += 32;
+    i    -= 32;
+  }
+
+  while (i) {
+    dst0[0] = dst0[1] = src[0];
+    dst1[0] = dst1[1] = src[0];
+
+    dst0 += 2;
+    dst1 += 2;
+    src  += 1;
+    i    -= 1;
+  }
+}
+
+// 16 source samples are zero-extended to 16 bits by `vpmovzxbw`, which keeps
+// them in order, so `even | (odd << 8)` is directly 32 output samples.
+#define JPEG_UPSAMPLE_LOAD_YMM(p) _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))
+
+#define JPEG_UPSAMPLE_FANCY_H2V1_YMM(out, s0, s1, s2) { \
+  __m256i s1x3 = _mm256_add_epi16(s1, _mm256_add_epi16(s1, s1)); \
+  __m256i even = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(s1x3, s0), JPEG_CONST_YMM(upsample_1)), 2); \
+  __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(s1x3, s2), JPEG_CONST_YMM(upsample_2)), 2); \
+  out = _mm256_or_si256(even, _mm256_slli_epi16(odd, 8)); \
+}
+
+#define JPEG_UPSAMPLE_FANCY_H2V2_YMM(out, c0, c1, c2) { \
+  __m256i c1x3 = _mm256_add_epi16(c1, _mm256_add_epi16(c1, c1)); \
+  __m256i even = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(c1x3, c0), JPEG_CONST_YMM(upsample_8)), 4); \
+  __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(c1x3, c2), JPEG_CONST_YMM(upsample_7)), 4); \
+  out = _mm256_or_si256(even, _mm256_slli_epi16(odd, 8)); \
+}
+
+// Column sum `3 * src + near` of 16 samples, at most 1020.
+static SIMD_INLINE __m256i dejpeg_upsample_colsum_avx2(const uint8_t* src, const uint8_t* near) {
+  __m256i s = JPEG_UPSAMPLE_LOAD_YMM(src);
+  return _mm256_add_epi16(_mm256_add_epi16(s, _mm256_add_epi16(s, s)), JPEG_UPSAMPLE_LOAD_YMM(near));
+}
+
+void dejpeg_upsample_h2v1_fancy_avx2(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  uint32_t i = 0;
+
+  // See `dejpeg_upsample_h2v1_fancy_sse2()`.
+  if (count >= 18) {
+    dejpeg_upsample_h2v1_fancy_span(dst, src, 0, 1, count);
+
+    for (i = 1; i + 17 <= count; i += 16) {
+      __m256i out;
+      JPEG_UPSAMPLE_FANCY_H2V1_YMM(out,
+        JPEG_UPSAMPLE_LOAD_YMM(src + i - 1),
+        JPEG_UPSAMPLE_LOAD_YMM(src + i    ),
+        JPEG_UPSAMPLE_LOAD_YMM(src + i + 1))
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), out);
+    }
+  }
+
+  dejpeg_upsample_h2v1_fancy_span(dst, src, i, count, count);
+}
+
+static SIMD_INLINE void dejpeg_upsample_h2v2_fancy_row_avx2(uint8_t* dst, const uint8_t* near, const uint8_t* src, uint32_t count) {
+  uint32_t i = 0;
+
+  if (count >= 18) {
+    dejpeg_upsample_h2v2_fancy_span(dst, near, src, 0, 1, count);
+
+    for (i = 1; i + 17 <= count; i += 16) {
+      __m256i out;
+      JPEG_UPSAMPLE_FANCY_H2V2_YMM(out,
+        dejpeg_upsample_colsum_avx2(src + i - 1, near + i - 1),
+        dejpeg_upsample_colsum_avx2(src + i    , near + i    ),
+        dejpeg_upsample_colsum_avx2(src + i + 1, near + i + 1))
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), out);
+    }
+  }
+
+  dejpeg_upsample_h2v2_fancy_span(dst, near, src, i, count, count);
+}
+
+void dejpeg_upsample_h2v2_fancy_avx2(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count) {
+  dejpeg_upsample_h2v2_fancy_row_avx2(dst0, srcPrev, src, count);
+  dejpeg_upsample_h2v2_fancy_row_avx2(dst1, srcNext, src, count);
+}
+
+#undef JPEG_UPSAMPLE_FANCY_H2V2_YMM
+#undef JPEG_UPSAMPLE_FANCY_H2V1_YMM
+#undef JPEG_UPSAMPLE_LOAD_YMM
+
+// ============================================================================
+// [YCbCrToRGB32 - AVX2]
+// ============================================================================
+
+// Uses the same decomposition as `dejpeg_ycbcr_to_rgb32_ssse3` - chroma parts
+// are calculated separately and added to luma in 16-bit, red and blue by using
+// `vpmulhrsw`, which is exact, and green by using `vpmaddwd`.
+static SIMD_INLINE void dejpeg_ycbcr_to_rgb32_16x_avx2(__m256i* out, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr) {
+  __m256i yy = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pY)));
+  __m256i cb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pCb)));
+  __m256i cr = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pCr)));
+
+  cb = _mm256_add_epi16(cb, JPEG_CONST_YMM(ycbcr_tosigned));
+  cr = _mm256_add_epi16(cr, JPEG_CONST_YMM(ycbcr_tosigned));
+
+  __m256i r = _mm256_mulhrs_epi16(_mm256_slli_epi16(cr, 3), JPEG_CONST_YMM(ycbcr_crMul));
+  __m256i b = _mm256_mulhrs_epi16(_mm256_slli_epi16(cb, 3), JPEG_CONST_YMM(ycbcr_cbMul));
+
+  // Unpack and pack are both in-lane, so the pixel order is preserved.
+  __m256i g_lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(cb, cr), JPEG_CONST_YMM(ycbcr_cbcrMul));
+  __m256i g_hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(cb, cr), JPEG_CONST_YMM(ycbcr_cbcrMul));
+
+  g_lo = _mm256_srai_epi32(_mm256_add_epi32(g_lo, JPEG_CONST_YMM(ycbcr_round)), JPEG_YCBCR_PREC);
+  g_hi = _mm256_srai_epi32(_mm256_add_epi32(g_hi, JPEG_CONST_YMM(ycbcr_round)), JPEG_YCBCR_PREC);
+
+  __m256i g = _mm256_packs_epi32(g_lo, g_hi);
+
+  r = _mm256_add_epi16(yy, r);
+  g = _mm256_add_epi16(yy, g);
+  b = _mm256_add_epi16(yy, b);
+
+  // [b0..7 r0..7 | b8..15 r8..15] and [g0..7 a0..7 | g8..15 a8..15].
+  __m256i br = _mm256_packus_epi16(b, r);
+  __m256i ga = _mm256_packus_epi16(g, JPEG_CONST_YMM(ycbcr_alpha));
+
+  __m256i bg = _mm256_unpacklo_epi8(br, ga);
+  __m256i ra = _mm256_unpackhi_epi8(br, ga);
+
+  // [p0..3 | p8..11] and [p4..7 | p12..15].
+  __m256i p0 = _mm256_unpacklo_epi16(bg, ra);
+  __m256i p1 = _mm256_unpackhi_epi16(bg, ra);
+
+  out[0] = _mm256_permute2x128_si256(p0, p1, 0x20);
+  out[1] = _mm256_permute2x128_si256(p0, p1, 0x31);
+}
+
+void dejpeg_ycbcr_to_rgb32_avx2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  uint32_t i = count;
+  __m256i out[2];
+
+  if (i < 16) {
+    // Short row - the inputs are copied to the stack so the loads don't read
+    // past the end and the output is written by masked stores, which never
+    // touch (or fault on) the masked-out pixels.
+    SIMD_ALIGN_VAR(uint8_t, tmp[48], 16);
+
+    ::memcpy(tmp +  0, pY , i);
+    ::memcpy(tmp + 16, pCb, i);
+    ::memcpy(tmp + 32, pCr, i);
+    dejpeg_ycbcr_to_rgb32_16x_avx2(out, tmp, tmp + 16, tmp + 32);
+
+    __m256i n = _mm256_set1_epi32(static_cast<int>(i));
+    __m256i m0 = _mm256_cmpgt_epi32(n, _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i m1 = _mm256_cmpgt_epi32(n, _mm256_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15));
+
+    _mm256_maskstore_epi32(reinterpret_cast<int*>(dst +  0), m0, out[0]);
+    _mm256_maskstore_epi32(reinterpret_cast<int*>(dst + 32), m1, out[1]);
+    return;
+  }
+
+  for (;;) {
+    dejpeg_ycbcr_to_rgb32_16x_avx2(out, pY, pCb, pCr);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst +  0), out[0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), out[1]);
+
+    dst += 64;
+    pY  += 16;
+    pCb += 16;
+    pCr += 16;
+    i   -= 16;
+
+    if (i >= 16)
+      continue;
+
+    if (i == 0)
+      break;
+
+    // Tail - overlaps with the pixels already converted.
+    uint32_t back = 16 - i;
+
+    dst -= back * 4;
+    pY  -= back;
+    pCb -= back;
+    pCr -= back;
+    i    = 16;
+  }
+}
+
+void dejpeg_ycbcr_to_rgb32_vec_avx2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_to_rgb32_vec(dst, pY, pCb, pCr, count);
+}
+
+// ============================================================================
+// [Huffman - AVX2]
+// ============================================================================
+
+// Stuffed bytes are rare in real data (roughly one per 256 bytes), so 32 bytes
+// are copied at a time until the first 0xFF, which is then handled by scalar
+// code. The store is safe as the output never gets ahead of the input.
+size_t dejpeg_huff_unstuff_avx2(uint8_t* dst, const uint8_t* src, size_t size, size_t* consumed) {
+  uint8_t* dstStart = dst;
+  const uint8_t* srcStart = src;
+  const uint8_t* srcEnd = src + size;
+
+  __m256i ff = _mm256_set1_epi8(-1);
+
+  while (src != srcEnd) {
+    if (static_cast<size_t>(srcEnd - src) >= 32) {
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+      uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, ff)));
+
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), x);
+      if (m == 0) {
+        src += 32;
+        dst += 32;
+        continue;
+      }
+
+      uint32_t n = dejpeg_ctz(m);
+      src += n;
+      dst += n;
+    }
+    else if (*src != 0xFF) {
+      *dst++ = *src++;
+      continue;
+    }
+
+    // 0xFF at `src`, either stuffed or a marker.
+    if (srcEnd - src < 2 || src[1] != 0x00)
+      break;
+
+    *dst++ = 0xFF;
+    src += 2;
+  }
+
+  ::memset(dst, 0, JPEG_HUFF_PADDING);
+  *consumed = static_cast<size_t>(src - srcStart);
+  return static_cast<size_t>(dst - dstStart);
+}
+
+// ============================================================================
+// [Progressive - AVX2]
+// ============================================================================
+
+// VPACKSSWB packs within 128-bit lanes, VPERMQ restores the order before
+// VPMOVMSKB extracts 32 bits of the mask.
+uint64_t dejpeg_block_nonzero_mask_avx2(const int16_t* block) {
+  __m256i zero = _mm256_setzero_si256();
+  uint64_t zeros = 0;
+
+  for (uint32_t i = 0; i < 2; i++) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32 + 16));
+    __m256i m = _mm256_packs_epi16(_mm256_cmpeq_epi16(a, zero), _mm256_cmpeq_epi16(b, zero));
+
+    m = _mm256_permute4x64_epi64(m, _MM_SHUFFLE(3, 1, 2, 0));
+    zeros |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(m))) << (i * 32);
+  }
+
+  return ~zeros;
+}
+
+// ============================================================================
+// [RGB32ToYCbCr - AVX2]
+// ============================================================================
+
+// Same as `JPEG_RGB_YCC_CONVERT4_XMM`, but converts 8 pixels.
+#define JPEG_RGB_YCC_CONVERT8_YMM(y, cb, cr, p) { \
+  __m256i br = _mm256_and_si256(p, JPEG_CONST_YMM(rgbycc_maskBR)); \
+  __m256i g1 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 8), JPEG_CONST_YMM(rgbycc_maskG)), JPEG_CONST_YMM(rgbycc_one)); \
+  \
+  y  = _mm256_add_epi32(_mm256_madd_epi16(br, JPEG_CONST_YMM(rgbycc_yBR )), _mm256_madd_epi16(g1, JPEG_CONST_YMM(rgbycc_yG ))); \
+  cb = _mm256_add_epi32(_mm256_madd_epi16(br, JPEG_CONST_YMM(rgbycc_cbBR)), _mm256_madd_epi16(g1, JPEG_CONST_YMM(rgbycc_cbG))); \
+  cr = _mm256_add_epi32(_mm256_madd_epi16(br, JPEG_CONST_YMM(rgbycc_crBR)), _mm256_madd_epi16(g1, JPEG_CONST_YMM(rgbycc_crG))); \
+  \
+  y  = _mm256_srai_epi32(y , JPEG_RGB_YCC_PREC); \
+  cb = _mm256_srai_epi32(cb, JPEG_RGB_YCC_PREC); \
+  cr = _mm256_srai_epi32(cr, JPEG_RGB_YCC_PREC); \
+}
+
+static SIMD_INLINE void dejpeg_rgb32_to_ycbcr_32x_avx2(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, const uint8_t* src) {
+  __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src +  0));
+  __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+  __m256i p2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 64));
+  __m256i p3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 96));
+
+  __m256i y0, y1, y2, y3;
+  __m256i cb0, cb1, cb2, cb3;
+  __m256i cr0, cr1, cr2, cr3;
+
+  JPEG_RGB_YCC_CONVERT8_YMM(y0, cb0, cr0, p0)
+  JPEG_RGB_YCC_CONVERT8_YMM(y1, cb1, cr1, p1)
+  JPEG_RGB_YCC_CONVERT8_YMM(y2, cb2, cr2, p2)
+  JPEG_RGB_YCC_CONVERT8_YMM(y3, cb3, cr3, p3)
+
+  // Packs are in-lane, which gives [p0..3 p8..11 p16..19 p24..27 | p4..7 p12..15 p20..23 p28..31].
+  __m256i yy = _mm256_packus_epi16(_mm256_packs_epi32(y0, y1), _mm256_packs_epi32(y2, y3));
+  __m256i cb = _mm256_packs_epi16(_mm256_packs_epi32(cb0, cb1), _mm256_packs_epi32(cb2, cb3));
+  __m256i cr = _mm256_packs_epi16(_mm256_packs_epi32(cr0, cr1), _mm256_packs_epi32(cr2, cr3));
+
+  yy = _mm256_permutevar8x32_epi32(yy, JPEG_CONST_YMM(rgbycc_order));
+  cb = _mm256_permutevar8x32_epi32(_mm256_xor_si256(cb, JPEG_CONST_YMM(rgbycc_tounsigned)), JPEG_CONST_YMM(rgbycc_order));
+  cr = _mm256_permutevar8x32_epi32(_mm256_xor_si256(cr, JPEG_CONST_YMM(rgbycc_tounsigned)), JPEG_CONST_YMM(rgbycc_order));
+
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(pY ), yy);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(pCb), cb);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(pCr), cr);
+}
+
+void dejpeg_rgb32_to_ycbcr_avx2(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, const uint8_t* src, uint32_t count) {
+  uint32_t i = count;
+
+  if (i < 32) {
+    for (uint32_t x = 0; x < i; x++)
+      dejpeg_rgb32_to_ycbcr_pixel(pY + x, pCb + x, pCr + x, reinterpret_cast<const uint32_t*>(src)[x]);
+    return;
+  }
+
+  for (;;) {
+    dejpeg_rgb32_to_ycbcr_32x_avx2(pY, pCb, pCr, src);
+
+    pY  += 32;
+    pCb += 32;
+    pCr += 32;
+    src += 128;
+    i   -= 32;
+
+    if (i >= 32)
+      continue;
+
+    if (i == 0)
+      break;
+
+    // Tail - overlaps with the pixels already converted.
+    uint32_t back = 32 - i;
+
+    pY  -= back;
+    pCb -= back;
+    pCr -= back;
+    src -= back * 4;
+    i    = 32;
+  }
+}
+
+// ============================================================================
+// [Downsample - AVX2]
+// ============================================================================
+
+// Adds even and odd samples of `s` as 16-bit integers.
+#define JPEG_DOWNSAMPLE_PAIRS_YMM(s) \
+  _mm256_add_epi16(_mm256_and_si256(s, JPEG_CONST_YMM(downsample_mask)), _mm256_srli_epi16(s, 8))
+
+void dejpeg_downsample_h2v1_avx2(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  uint32_t i = 0;
+
+  for (; i * 2 + 64 <= count; i += 32) {
+    __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2 +  0));
+    __m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2 + 32));
+
+    s0 = _mm256_srli_epi16(_mm256_add_epi16(JPEG_DOWNSAMPLE_PAIRS_YMM(s0), JPEG_CONST_YMM(downsample_bias01)), 1);
+    s1 = _mm256_srli_epi16(_mm256_add_epi16(JPEG_DOWNSAMPLE_PAIRS_YMM(s1), JPEG_CONST_YMM(downsample_bias01)), 1);
+
+    // [d0..7 d16..23 | d8..15 d24..31] -> [d0..15 | d16..31].
+    __m256i d = _mm256_permute4x64_epi64(_mm256_packus_epi16(s0, s1), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), d);
+  }
+
+  dejpeg_downsample_h2v1_span(dst, src, i, count);
+}
+
+void dejpeg_downsample_h2v2_avx2(uint8_t* dst, const uint8_t* src0, const uint8_t* src1, uint32_t count) {
+  uint32_t i = 0;
+
+  for (; i * 2 + 64 <= count; i += 32) {
+    __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src0 + i * 2 +  0));
+    __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src0 + i * 2 + 32));
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + i * 2 +  0));
+    __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + i * 2 + 32));
+
+    __m256i s0 = _mm256_add_epi16(JPEG_DOWNSAMPLE_PAIRS_YMM(a0), JPEG_DOWNSAMPLE_PAIRS_YMM(b0));
+    __m256i s1 = _mm256_add_epi16(JPEG_DOWNSAMPLE_PAIRS_YMM(a1), JPEG_DOWNSAMPLE_PAIRS_YMM(b1));
+
+    s0 = _mm256_srli_epi16(_mm256_add_epi16(s0, JPEG_CONST_YMM(downsample_bias12)), 2);
+    s1 = _mm256_srli_epi16(_mm256_add_epi16(s1, JPEG_CONST_YMM(downsample_bias12)), 2);
+
+    __m256i d = _mm256_permute4x64_epi64(_mm256_packus_epi16(s0, s1), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), d);
+  }
+
+  dejpeg_downsample_h2v2_span(dst, src0, src1, i, count);
+}
+
+// ============================================================================
+// [FDCT - AVX2]
+// ============================================================================
+
+// Like the IDCT, the FDCT keeps two rows in each YMM register and uses per-lane
+// constants so a single `vpmaddwd` calculates two different outputs:
+//
+//   Input : [r0|r1] [r3|r2] [r4|r5] [r7|r6]
+//   Output: [r0|r4] [r2|r6] [r1|r3] [r7|r5]
+//
+// Sums and differences of the input registers give [tmp0|tmp1], [tmp3|tmp2],
+// [tmp7|tmp6], and [tmp4|tmp5] directly.
+
+// Adds bias, shifts by `norm`, and packs a wide value `x` to 16-bit integers.
+#define JPEG_FDCT_DESCALE_YMM(dst, x, bias, norm) \
+  __m256i dst = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(x##_l, bias), norm), \
+                                   _mm256_srai_epi32(_mm256_add_epi32(x##_h, bias), norm));
+
+#define JPEG_FDCT_FDCT_PASS_YMM(bias, norm) \
+  __m256i tmp01 = _mm256_add_epi16(r01, r76); \
+  __m256i tmp76 = _mm256_sub_epi16(r01, r76); \
+  __m256i tmp32 = _mm256_add_epi16(r32, r45); \
+  __m256i tmp45 = _mm256_sub_epi16(r32, r45); \
+  \
+  /* Even part. */ \
+  __m256i tmp10_11 = _mm256_add_epi16(tmp01, tmp32); \
+  __m256i tmp13_12 = _mm256_sub_epi16(tmp01, tmp32); \
+  __m256i tmp11_10 = JPEG_IDCT_SWAP_YMM(tmp10_11); \
+  __m256i tmp12_13 = JPEG_IDCT_SWAP_YMM(tmp13_12); \
+  \
+  JPEG_IDCT_MADD_YMM(x04, tmp10_11, tmp11_10, fdct_even0)  /* [o0|o4] */ \
+  JPEG_IDCT_MADD_YMM(x26, tmp13_12, tmp12_13, fdct_even1)  /* [o2|o6] */ \
+  \
+  /* Odd part. */ \
+  __m256i z34 = _mm256_add_epi16(tmp45, JPEG_IDCT_SWAP_YMM(tmp76)); \
+  __m256i z43 = JPEG_IDCT_SWAP_YMM(z34); \
+  \
+  JPEG_IDCT_ROTATE_YMM(p75, p13, tmp45, tmp76, fdct_odd0, fdct_odd1) \
+  JPEG_IDCT_ROTATE_YMM(z34w, z43w, z34, z43, fdct_odd2, fdct_odd3) \
+  \
+  JPEG_IDCT_WADD_YMM(x75, p75, z34w)                       /* [o7|o5] */ \
+  JPEG_IDCT_WADD_YMM(x13, p13, z43w)                       /* [o1|o3] */ \
+  \
+  JPEG_FDCT_DESCALE_YMM(o04, x04, bias, norm) \
+  JPEG_FDCT_DESCALE_YMM(o26, x26, bias, norm) \
+  JPEG_FDCT_DESCALE_YMM(o13, x13, bias, norm) \
+  JPEG_FDCT_DESCALE_YMM(o75, x75, bias, norm)
+
+// Transpose [r0|r4] [r1|r5] [r2|r6] [r3|r7] into [r0|r1] [r3|r2] [r4|r5] [r7|r6].
+#define JPEG_FDCT_TRANSPOSE_YMM(i04, i15, i26, i37) { \
+  __m256i s01 = _mm256_unpacklo_epi16(i04, i15);         /* [a0a1|b0b1|c0c1|d0d1] | [a4a5|b4b5|c4c5|d4d5] */ \
+  __m256i s45 = _mm256_unpackhi_epi16(i04, i15);         /* [e0e1|f0f1|g0g1|h0h1] | [e4e5|f4f5|g4g5|h4h5] */ \
+  __m256i s23 = _mm256_unpacklo_epi16(i26, i37);         /* [a2a3|b2b3|c2c3|d2d3] | [a6a7|b6b7|c6c7|d6d7] */ \
+  __m256i s67 = _mm256_unpackhi_epi16(i26, i37);         /* [e2e3|f2f3|g2g3|h2h3] | [e6e7|f6f7|g6g7|h6h7] */ \
+  \
+  __m256i u01 = _mm256_unpacklo_epi32(s01, s23);         /* [a0..a3|b0..b3] | [a4..a7|b4..b7] */ \
+  __m256i u23 = _mm256_unpackhi_epi32(s01, s23);         /* [c0..c3|d0..d3] | [c4..c7|d4..d7] */ \
+  __m256i u45 = _mm256_unpacklo_epi32(s45, s67);         /* [e0..e3|f0..f3] | [e4..e7|f4..f7] */ \
+  __m256i u67 = _mm256_unpackhi_epi32(s45, s67);         /* [g0..g3|h0..h3] | [g4..g7|h4..h7] */ \
+  \
+  r01 = _mm256_permute4x64_epi64(u01, _MM_SHUFFLE(3, 1, 2, 0)); \
+  r32 = _mm256_permute4x64_epi64(u23, _MM_SHUFFLE(2, 0, 3, 1)); \
+  r45 = _mm256_permute4x64_epi64(u45, _MM_SHUFFLE(3, 1, 2, 0)); \
+  r76 = _mm256_permute4x64_epi64(u67, _MM_SHUFFLE(2, 0, 3, 1)); \
+}
+
+// Quantizes two rows of coefficients `x` by reciprocal multiplication, see
+// `dejpeg_fdct_islow_divisors()`, and stores them to `dst + i0` and `dst + i1`.
+static SIMD_INLINE void dejpeg_fdct_quantize_avx2(int16_t* dst, __m256i x, uint32_t i0, uint32_t i1, const uint16_t* divisors) {
+  __m256i a = _mm256_abs_epi16(x);
+
+  a = _mm256_add_epi16(a, dejpeg_load_2x128(divisors + 64 + i0, divisors + 64 + i1));
+  a = _mm256_mulhi_epu16(a, dejpeg_load_2x128(divisors + i0, divisors + i1));
+  a = _mm256_mulhi_epu16(a, dejpeg_load_2x128(divisors + 128 + i0, divisors + 128 + i1));
+  a = _mm256_sign_epi16(a, x);
+
+  _mm_store_si128(reinterpret_cast<__m128i*>(dst + i0), _mm256_castsi256_si128(a));
+  _mm_store_si128(reinterpret_cast<__m128i*>(dst + i1), _mm256_extracti128_si256(a, 1));
+}
+
+static SIMD_INLINE __m256i dejpeg_fdct_load_avx2(const uint8_t* src0, const uint8_t* src1) {
+  __m128i x = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src0)),
+                                 _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src1)));
+  return _mm256_sub_epi16(_mm256_cvtepu8_epi16(x), JPEG_CONST_YMM(fdct_center));
+}
+
+void dejpeg_fdct_islow_avx2(int16_t* dst, const uint8_t* src, intptr_t srcStride, const uint16_t* divisors) {
+  __m256i r01, r32, r45, r76;
+
+  // Load and subtract 128 (CENTERJSAMPLE).
+  __m256i i04 = dejpeg_fdct_load_avx2(src + srcStride * 0, src + srcStride * 4);
+  __m256i i15 = dejpeg_fdct_load_avx2(src + srcStride * 1, src + srcStride * 5);
+  __m256i i26 = dejpeg_fdct_load_avx2(src + srcStride * 2, src + srcStride * 6);
+  __m256i i37 = dejpeg_fdct_load_avx2(src + srcStride * 3, src + srcStride * 7);
+
+  // FDCT rows (libjpeg transforms rows first, which matters for rounding).
+  JPEG_FDCT_TRANSPOSE_YMM(i04, i15, i26, i37)
+  {
+    JPEG_FDCT_FDCT_PASS_YMM(JPEG_CONST_YMM(fdct_rowBias), JPEG_FDCT_ROW_NORM)
+
+    // [r1|r3] [r7|r5] -> [r1|r5] [r3|r7].
+    __m256i o15 = _mm256_blend_epi32(o13, o75, 0xF0);
+    __m256i o37 = _mm256_permute2x128_si256(o13, o75, 0x21);
+
+    JPEG_FDCT_TRANSPOSE_YMM(o04, o15, o26, o37)
+  }
+
+  // FDCT columns.
+  JPEG_FDCT_FDCT_PASS_YMM(JPEG_CONST_YMM(fdct_colBias), JPEG_FDCT_COL_NORM)
+
+  dejpeg_fdct_quantize_avx2(dst, o04,  0, 32, divisors);
+  dejpeg_fdct_quantize_avx2(dst, o26, 16, 48, divisors);
+  dejpeg_fdct_quantize_avx2(dst, o13,  8, 24, divisors);
+  dejpeg_fdct_quantize_avx2(dst, o75, 56, 40, divisors);
+}
+
+// ============================================================================
+// [ZigZag - AVX2]
+// ============================================================================
+
+#define Z 0x80
+
+template<int A, int B, int C, int D, int E, int F, int G, int H, int I, int J, int K, int L, int M, int N, int O, int P>
+SIMD_INLINE __m256i _mm256_shuffle_epi8_avx2(__m256i x) {
+  SIMD_ALIGN_VAR(static const uint8_t, mask[32], 32) = {
+    A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P,
+    A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P
+  };
+  return _mm256_shuffle_epi8(x, *reinterpret_cast<const __m256i*>(mask));
+}
+
+// 16 coefficients -> [16 low bytes | 16 high bytes].
+static SIMD_INLINE __m256i dejpeg_zigzag_split_avx2(const int16_t* src) {
+  __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+  x = _mm256_shuffle_epi8_avx2<0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15>(x);
+  return _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// [16 low bytes | 16 high bytes] -> 16 coefficients.
+static SIMD_INLINE void dejpeg_zigzag_join_avx2(int16_t* dst, __m256i x) {
+  x = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 1, 2, 0));
+  x = _mm256_shuffle_epi8_avx2<0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15>(x);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), x);
+}
+
+// Uses the shuffles of `dejpeg_zigzag_ssse3()`. Low bytes are in the low lane
+// and high bytes in the high lane, so each VPSHUFB permutes both at once.
+void dejpeg_zigzag_avx2(int16_t* dst, const int16_t* src) {
+  __m256i x0 = dejpeg_zigzag_split_avx2(src +  0);
+  __m256i x1 = dejpeg_zigzag_split_avx2(src + 16);
+  __m256i x2 = dejpeg_zigzag_split_avx2(src + 32);
+  __m256i x3 = dejpeg_zigzag_split_avx2(src + 48);
+
+  __m256i t0 = _mm256_shuffle_epi8_avx2<0 , 1 , 8 , Z , 9 , 2 , 3 , 10, Z , Z , Z , Z , Z , 11, 4 , 5 >(x0);
+  __m256i t1 = _mm256_shuffle_epi8_avx2<12, Z , Z , Z , Z , Z , Z , Z , Z , Z , 13, 6 , 7 , 14, Z , Z >(x0);
+  __m256i t2 = _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , 15, Z , Z , Z , Z , Z >(x0);
+
+  t0 = _mm256_or_si256(t0, _mm256_shuffle_epi8_avx2<Z , Z , Z , 0 , Z , Z , Z , Z , 1 , 8 , Z , 9 , 2 , Z , Z , Z >(x1));
+  t1 = _mm256_or_si256(t1, _mm256_shuffle_epi8_avx2<Z , 3 , 10, Z , Z , Z , Z , Z , 11, 4 , Z , Z , Z , Z , 5 , 12>(x1));
+  t2 = _mm256_or_si256(t2, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , Z , Z , Z , 13, 6 , Z , 7 , 14, Z , Z , Z >(x1));
+  __m256i t3 =             _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , 15, Z , Z , Z , Z , Z , Z , Z , Z , Z , Z >(x1);
+
+  t0 = _mm256_or_si256(t0, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , 0 , Z , Z , Z , Z , Z >(x2));
+  t1 = _mm256_or_si256(t1, _mm256_shuffle_epi8_avx2<Z , Z , Z , 1 , 8 , Z , 9 , 2 , Z , Z , Z , Z , Z , Z , Z , Z >(x2));
+  t2 = _mm256_or_si256(t2, _mm256_shuffle_epi8_avx2<3 , 10, Z , Z , Z , Z , 11, 4 , Z , Z , Z , Z , Z , 5 , 12, Z >(x2));
+  t3 = _mm256_or_si256(t3, _mm256_shuffle_epi8_avx2<Z , Z , Z , 13, 6 , Z , 7 , 14, Z , Z , Z , Z , 15, Z , Z , Z >(x2));
+
+  t1 = _mm256_or_si256(t1, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , 0 , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z >(x3));
+  t2 = _mm256_or_si256(t2, _mm256_shuffle_epi8_avx2<Z , Z , 1 , 8 , 9 , 2 , Z , Z , Z , Z , Z , Z , Z , Z , Z , 3 >(x3));
+  t3 = _mm256_or_si256(t3, _mm256_shuffle_epi8_avx2<10, 11, 4 , Z , Z , Z , Z , Z , 5 , 12, 13, 6 , Z , 7 , 14, 15>(x3));
+
+  dejpeg_zigzag_join_avx2(dst +  0, t0);
+  dejpeg_zigzag_join_avx2(dst + 16, t1);
+  dejpeg_zigzag_join_avx2(dst + 32, t2);
+  dejpeg_zigzag_join_avx2(dst + 48, t3);
+}
+
+// ============================================================================
+// [DeZigZag - AVX2]
+// ============================================================================
+
+// Mask having bit `i` set if coefficient `i` of two split registers (32
+// coefficients) is zero. Low and high bytes of the same coefficients are
+// brought to the same register by two cross-lane permutes.
+static SIMD_INLINE uint32_t dejpeg_zigzag_zero_mask_avx2(__m256i x0, __m256i x1) {
+  __m256i lo = _mm256_permute2x128_si256(x0, x1, 0x20);
+  __m256i hi = _mm256_permute2x128_si256(x0, x1, 0x31);
+  __m256i z = _mm256_cmpeq_epi8(_mm256_or_si256(lo, hi), _mm256_setzero_si256());
+  return static_cast<uint32_t>(_mm256_movemask_epi8(z));
+}
+
+// Uses the shuffles of `DEZIGZAG_SHUFFLE` (SSSE3) on split registers, like
+// `dejpeg_zigzag_avx2()`. `eob` is calculated from the split input, so it
+// doesn't need another pass over the block.
+uint32_t dejpeg_dezigzag_eob_avx2(int16_t* dst, const int16_t* src) {
+  __m256i x0 = dejpeg_zigzag_split_avx2(src +  0);
+  __m256i x1 = dejpeg_zigzag_split_avx2(src + 16);
+  __m256i x2 = dejpeg_zigzag_split_avx2(src + 32);
+  __m256i x3 = dejpeg_zigzag_split_avx2(src + 48);
+
+  uint64_t nz = ~((static_cast<uint64_t>(dejpeg_zigzag_zero_mask_avx2(x2, x3)) << 32) |
+                  (static_cast<uint64_t>(dejpeg_zigzag_zero_mask_avx2(x0, x1))      ));
+
+  __m256i t0 = _mm256_shuffle_epi8_avx2<0 , 1 , 5 , 6 , 14, 15, Z , Z , 2 , 4 , 7 , 13, Z , Z , Z , Z >(x0);
+  __m256i t1 = _mm256_shuffle_epi8_avx2<3 , 8 , 12, Z , Z , Z , Z , Z , 9 , 11, Z , Z , Z , Z , Z , Z >(x0);
+  __m256i t2 = _mm256_shuffle_epi8_avx2<10, Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z >(x0);
+
+  t0 = _mm256_or_si256(t0, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , Z , 11, 12, Z , Z , Z , Z , 0 , 10, 13, Z >(x1));
+  t1 = _mm256_or_si256(t1, _mm256_shuffle_epi8_avx2<Z , Z , Z , 1 , 9 , 14, Z , Z , Z , Z , 2 , 8 , 15, Z , Z , Z >(x1));
+  t2 = _mm256_or_si256(t2, _mm256_shuffle_epi8_avx2<Z , 3 , 7 , Z , Z , Z , Z , Z , 4 , 6 , Z , Z , Z , Z , Z , Z >(x1));
+  __m256i t3 =             _mm256_shuffle_epi8_avx2<5 , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z >(x1);
+
+  t0 = _mm256_or_si256(t0, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , 10>(x2));
+  t1 = _mm256_or_si256(t1, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , Z , 9 , 11, Z , Z , Z , Z , Z , 8 , 12, Z >(x2));
+  t2 = _mm256_or_si256(t2, _mm256_shuffle_epi8_avx2<Z , Z , Z , 0 , 7 , 13, Z , Z , Z , Z , 1 , 6 , 14, Z , Z , Z >(x2));
+  t3 = _mm256_or_si256(t3, _mm256_shuffle_epi8_avx2<Z , 2 , 5 , 15, Z , Z , Z , Z , 3 , 4 , Z , Z , Z , Z , Z , Z >(x2));
+
+  t1 = _mm256_or_si256(t1, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , 5 >(x3));
+  t2 = _mm256_or_si256(t2, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , Z , Z , 4 , 6 , Z , Z , Z , Z , Z , 3 , 7 , 12>(x3));
+  t3 = _mm256_or_si256(t3, _mm256_shuffle_epi8_avx2<Z , Z , Z , Z , 2 , 8 , 11, 13, Z , Z , 0 , 1 , 9 , 10, 14, 15>(x3));
+
+  dejpeg_zigzag_join_avx2(dst +  0, t0);
+  dejpeg_zigzag_join_avx2(dst + 16, t1);
+  dejpeg_zigzag_join_avx2(dst + 32, t2);
+  dejpeg_zigzag_join_avx2(dst + 48, t3);
+
+  return nz ? dejpeg_bsr64(nz) : 0;
+}
+
+#undef Z
@@ -0,0 +1,44 @@
+// [SimdTests - DeJPEG]
+// SIMD optimized JPEG decoding utilities.
+//
+// [License]
+// Public Domain <unlicense.org>
+#define USE_AVX512BW
+
+#include "../simdglobals.h"
+#include "./dejpeg.h"
+
+// ============================================================================
+// [DeZigZag - AVX-512BW]
+// ============================================================================
+
+// Zig-zag index of each coefficient in natural order. VPERMT2W indexes 64 words
+// of two registers, so the source block is addressed directly by these.
+SIMD_ALIGN_VAR(static const int16_t, dejpeg_zigzag_index_avx512[64], 64) = {
+  0 , 1 , 5 , 6 , 14, 15, 27, 28,
+  2 , 4 , 7 , 13, 16, 26, 29, 42,
+  3 , 8 , 12, 17, 25, 30, 41, 43,
+  9 , 11, 18, 24, 31, 40, 44, 53,
+  10, 19, 23, 32, 39, 45, 52, 54,
+  20, 22, 33, 38, 46, 51, 55, 60,
+  21, 34, 37, 47, 50, 56, 59, 61,
+  35, 36, 48, 49, 57, 58, 62, 63
+};
+
+uint32_t dejpeg_dezigzag_eob_avx512bw(int16_t* dst, const int16_t* src) {
+  const int16_t* index = dejpeg_zigzag_index_avx512;
+
+  __m512i x0 = _mm512_loadu_si512(reinterpret_cast<const void*>(src +  0));
+  __m512i x1 = _mm512_loadu_si512(reinterpret_cast<const void*>(src + 32));
+
+  uint64_t nz = (static_cast<uint64_t>(_mm512_test_epi16_mask(x1, x1)) << 32) |
+                (static_cast<uint64_t>(_mm512_test_epi16_mask(x0, x0))      ) ;
+
+  __m512i y0 = _mm512_permutex2var_epi16(x0, _mm512_load_si512(reinterpret_cast<const void*>(index +  0)), x1);
+  __m512i y1 = _mm512_permutex2var_epi16(x0, _mm512_load_si512(reinterpret_cast<const void*>(index + 32)), x1);
+
+  _mm512_storeu_si512(reinterpret_cast<void*>(dst +  0), y0);
+  _mm512_storeu_si512(reinterpret_cast<void*>(dst + 32), y1);
+
+  return nz ? dejpeg_bsr64(nz) : 0;
+}
@@ -0,0 +1,1424 @@
+// [SimdTests - DeJPEG]
+// SIMD optimized JPEG decoding utilities.
+//
+// [License]
+// Public Domain <unlicense.org>
+#include "../simdglobals.h"
+#include "./dejpeg.h"
+
+// ============================================================================
+// [Decoder - Funcs]
+// ============================================================================
+
+const DeJpegDecoderFuncs dejpeg_decoder_funcs_ref = {
+  dejpeg_huff_unstuff_ref,
+  dejpeg_idct_islow_sparse_ref,
+  dejpeg_upsample_h2v1_ref,
+  dejpeg_ycbcr_to_rgb32_ref,
+  dejpeg_ycbcr_h2v2_to_rgb32_ref,
+  dejpeg_block_nonzero_mask_ref,
+  dejpeg_dezigzag_eob_ref,
+  dejpeg_idct_islow_batch_ref
+};
+
+const DeJpegDecoderFuncs dejpeg_decoder_funcs_sse2 = {
+  dejpeg_huff_unstuff_sse2,
+  dejpeg_idct_islow_sparse_sse2,
+  dejpeg_upsample_h2v1_sse2,
+  dejpeg_ycbcr_to_rgb32_sse2,
+  dejpeg_ycbcr_h2v2_to_rgb32_sse2,
+  dejpeg_block_nonzero_mask_sse2,
+  dejpeg_dezigzag_eob_ref,
+  dejpeg_idct_islow_batch_sse2
+};
+
+const DeJpegDecoderFuncs dejpeg_decoder_funcs_avx2 = {
+  dejpeg_huff_unstuff_avx2,
+  dejpeg_idct_islow_sparse_avx2,
+  dejpeg_upsample_h2v1_avx2,
+  dejpeg_ycbcr_to_rgb32_avx2,
+  dejpeg_ycbcr_h2v2_to_rgb32_sse2,
+  dejpeg_block_nonzero_mask_avx2,
+  dejpeg_dezigzag_eob_avx2,
+  dejpeg_idct_islow_batch_avx2
+};
+
+const DeJpegDecoderFuncs dejpeg_decoder_funcs_avx512bw = {
+  dejpeg_huff_unstuff_avx2,
+  dejpeg_idct_islow_sparse_avx2,
+  dejpeg_upsample_h2v1_avx2,
+  dejpeg_ycbcr_to_rgb32_avx2,
+  dejpeg_ycbcr_h2v2_to_rgb32_sse2,
+  dejpeg_block_nonzero_mask_avx2,
+  dejpeg_dezigzag_eob_avx512bw,
+  dejpeg_idct_islow_batch_avx2
+};
+
+const DeJpegDecoderFuncs* dejpeg_decoder_funcs_best(void) {
+  uint32_t tier = SimdCpu::tier();
+
+  if (tier >= kSimdTierAVX512BW)
+    return &dejpeg_decoder_funcs_avx512bw;
+
+  if (tier >= kSimdTierAVX2)
+    return &dejpeg_decoder_funcs_avx2;
+
+  if (tier >= kSimdTierSSE2)
+    return &dejpeg_decoder_funcs_sse2;
+
+  return &dejpeg_decoder_funcs_ref;
+}
+
+// ============================================================================
+// [Decoder - Markers]
+// ============================================================================
+
+enum DeJpegMarker {
+  kJpegMarkerSOF0 = 0xC0,
+  kJpegMarkerSOF1 = 0xC1,
+  kJpegMarkerSOF2 = 0xC2,
+  kJpegMarkerDHT  = 0xC4,
+  kJpegMarkerDAC  = 0xCC,
+  kJpegMarkerRST0 = 0xD0,
+  kJpegMarkerRST7 = 0xD7,
+  kJpegMarkerSOI  = 0xD8,
+  kJpegMarkerEOI  = 0xD9,
+  kJpegMarkerSOS  = 0xDA,
+  kJpegMarkerDQT  = 0xDB,
+  kJpegMarkerDRI  = 0xDD,
+  kJpegMarkerTEM  = 0x01
+};
+
+static SIMD_INLINE uint32_t dejpeg_read_u16(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 8) | static_cast<uint32_t>(p[1]);
+}
+
+static uint32_t dejpeg_decoder_parse_dqt(DeJpegDecoder* d, const uint8_t* p, size_t size) {
+  while (size) {
+    uint32_t pq = p[0] >> 4;
+    uint32_t tq = p[0] & 15;
+    size_t tableSize = 1 + 64 * (pq + 1);
+
+    if (pq > 1 || tq > 3 || size < tableSize)
+      return kJpegErrorInvalidData;
+
+    int16_t zz[64];
+    for (uint32_t i = 0; i < 64; i++)
+      zz[i] = static_cast<int16_t>(pq ? dejpeg_read_u16(p + 1 + i * 2) : p[1 + i]);
+
+    dejpeg_dezigzag_ref(reinterpret_cast<int16_t*>(d->qTables[tq]), zz);
+    d->qMask |= 1U << tq;
+
+    p += tableSize;
+    size -= tableSize;
+  }
+
+  return kJpegErrorOk;
+}
+
+static uint32_t dejpeg_decoder_parse_dht(DeJpegDecoder* d, const uint8_t* p, size_t size) {
+  while (size) {
+    if (size < 17)
+      return kJpegErrorInvalidData;
+
+    uint32_t tc = p[0] >> 4;
+    uint32_t th = p[0] & 15;
+
+    if (tc > 1 || th > 3)
+      return kJpegErrorInvalidData;
+
+    size_t n = 0;
+    for (uint32_t i = 0; i < 16; i++)
+      n += p[1 + i];
+
+    if (n > 256 || size < 17 + n)
+      return kJpegErrorInvalidData;
+
+    DeJpegHuffTable* table = tc ? &d->acTables[th] : &d->dcTables[th];
+    if (!dejpeg_huff_build(table, p + 1, p + 17))
+      return kJpegErrorInvalidData;
+
+    if (tc)
+      d->acMask |= 1U << th;
+    else
+      d->dcMask |= 1U << th;
+
+    p += 17 + n;
+    size -= 17 + n;
+  }
+
+  return kJpegErrorOk;
+}
+
+static uint32_t dejpeg_decoder_parse_sof(DeJpegDecoder* d, const uint8_t* p, size_t size, bool progressive) {
+  if (d->componentCount != 0 || size < 6)
+    return kJpegErrorInvalidData;
+
+  uint32_t precision = p[0];
+  uint32_t height = dejpeg_read_u16(p + 1);
+  uint32_t width = dejpeg_read_u16(p + 3);
+  uint32_t nf = p[5];
+
+  if (size != 6 + nf * 3 || width == 0)
+    return kJpegErrorInvalidData;
+
+  // Height defined by DNL and 12-bit precision are not supported.
+  if (precision != 8 || height == 0 || (nf != 1 && nf != 3))
+    return kJpegErrorUnsupported;
+
+  for (uint32_t i = 0; i < nf; i++) {
+    DeJpegComponent& comp = d->components[i];
+    const uint8_t* c = p + 6 + i * 3;
+
+    comp.id = c[0];
+    comp.h = c[1] >> 4;
+    comp.v = c[1] & 15;
+    comp.tq = c[2];
+    comp.td = 0;
+    comp.ta = 0;
+
+    if (comp.h < 1 || comp.h > 4 || comp.v < 1 || comp.v > 4 || comp.tq > 3)
+      return kJpegErrorInvalidData;
+  }
+
+  // The MCU of a single component scan is always one block.
+  if (nf == 1) {
+    d->components[0].h = 1;
+    d->components[0].v = 1;
+  }
+  else {
+    uint32_t h = d->components[0].h;
+    uint32_t v = d->components[0].v;
+
+    if (d->components[1].h != 1 || d->components[1].v != 1 ||
+        d->components[2].h != 1 || d->components[2].v != 1 ||
+        !((h == 1 && v == 1) || (h == 2 && v == 1) || (h == 2 && v == 2)))
+      return kJpegErrorUnsupported;
+  }
+
+  d->width = width;
+  d->height = height;
+  d->componentCount = nf;
+  d->progressive = progressive;
+
+  d->mcuWidth = d->components[0].h * 8;
+  d->mcuHeight = d->components[0].v * 8;
+  d->mcusPerLine = (width + d->mcuWidth - 1) / d->mcuWidth;
+  d->mcuRows = (height + d->mcuHeight - 1) / d->mcuHeight;
+
+  for (uint32_t i = 0; i < nf; i++)
+    d->components[i].blocksPerLine = d->mcusPerLine * d->components[i].h;
+
+  return kJpegErrorOk;
+}
+
+static uint32_t dejpeg_decoder_parse_sos(DeJpegDecoder* d, const uint8_t* p, size_t size) {
+  if (d->componentCount == 0 || size < 1)
+    return kJpegErrorInvalidData;
+
+  uint32_t ns = p[0];
+  if (size != 4 + ns * 2)
+    return kJpegErrorInvalidData;
+
+  // Only a single scan having all components in the frame order is supported.
+  if (ns != d->componentCount)
+    return kJpegErrorUnsupported;
+
+  for (uint32_t i = 0; i < ns; i++) {
+    DeJpegComponent& comp = d->components[i];
+    const uint8_t* c = p + 1 + i * 2;
+
+    if (c[0] != comp.id)
+      return kJpegErrorUnsupported;
+
+    comp.td = c[1] >> 4;
+    comp.ta = c[1] & 15;
+
+    if (comp.td > 3 || comp.ta > 3 ||
+        !(d->dcMask & (1U << comp.td)) ||
+        !(d->acMask & (1U << comp.ta)) ||
+        !(d->qMask & (1U << comp.tq)))
+      return kJpegErrorInvalidData;
+  }
+
+  const uint8_t* s = p + 1 + ns * 2;
+  if (s[0] != 0 || s[1] != 63 || s[2] != 0)
+    return kJpegErrorInvalidData;
+
+  return kJpegErrorOk;
+}
+
+static uint32_t dejpeg_decoder_parse_dri(DeJpegDecoder* d, const uint8_t* p, size_t size) {
+  if (size != 2)
+    return kJpegErrorInvalidData;
+
+  d->restartInterval = dejpeg_read_u16(p);
+  return kJpegErrorOk;
+}
+
+// Parameters of a scan of a progressive image.
+struct DeJpegScan {
+  // Indexes of components in the scan.
+  uint32_t count;
+  uint32_t components[JPEG_MAX_COMPONENTS];
+
+  // Spectral selection (zig-zag indexes) and successive approximation.
+  uint32_t ss, se;
+  uint32_t ah, al;
+};
+
+static uint32_t dejpeg_decoder_parse_progressive_sos(DeJpegDecoder* d, DeJpegScan* scan, const uint8_t* p, size_t size) {
+  if (d->componentCount == 0 || size < 1)
+    return kJpegErrorInvalidData;
+
+  uint32_t ns = p[0];
+  if (ns < 1 || ns > d->componentCount || size != 4 + ns * 2)
+    return kJpegErrorInvalidData;
+
+  const uint8_t* s = p + 1 + ns * 2;
+  scan->count = ns;
+  scan->ss = s[0];
+  scan->se = s[1];
+  scan->ah = s[2] >> 4;
+  scan->al = s[2] & 15;
+
+  // DC scans can interleave components, AC scans have a single component. Each
+  // refinement scan refines by one bit (G.1.1.1.1 and G.1.1.1.2).
+  if (scan->ss == 0 ? scan->se != 0 : (scan->se < scan->ss || scan->se > 63 || ns != 1))
+    return kJpegErrorInvalidData;
+
+  if (scan->al > 13 || (scan->ah != 0 && scan->ah != scan->al + 1))
+    return kJpegErrorInvalidData;
+
+  // Components must be in the frame order.
+  uint32_t next = 0;
+  for (uint32_t i = 0; i < ns; i++) {
+    const uint8_t* c = p + 1 + i * 2;
+
+    while (next < d->componentCount && d->components[next].id != c[0])
+      next++;
+
+    if (next == d->componentCount)
+      return kJpegErrorInvalidData;
+
+    DeJpegComponent& comp = d->components[next];
+    comp.td = c[1] >> 4;
+    comp.ta = c[1] & 15;
+
+    // Only the first DC scan decodes Huffman coded DC differences.
+    bool needsDC = scan->ss == 0 && scan->ah == 0;
+    bool needsAC = scan->ss != 0;
+
+    if (comp.td > 3 || comp.ta > 3 ||
+        (needsDC && !(d->dcMask & (1U << comp.td))) ||
+        (needsAC && !(d->acMask & (1U << comp.ta))))
+      return kJpegErrorInvalidData;
+
+    scan->components[i] = next++;
+  }
+
+  return kJpegErrorOk;
+}
+
+// ============================================================================
+// [Decoder - Header]
+// ============================================================================
+
+void dejpeg_decoder_init(DeJpegDecoder* d, const DeJpegDecoderFuncs* funcs) {
+  ::memset(d, 0, sizeof(*d));
+  d->funcs = funcs;
+}
+
+// Reads the marker at `*pSrc`, which can be preceded by any number of 0xFF
+// fill bytes, and its segment (markers without a segment have size zero).
+static uint32_t dejpeg_decoder_next_marker(const uint8_t** pSrc, const uint8_t* end, uint32_t* marker, const uint8_t** segment, size_t* segmentSize) {
+  const uint8_t* p = *pSrc;
+
+  if (p == end || p[0] != 0xFF)
+    return kJpegErrorInvalidData;
+
+  while (p != end && p[0] == 0xFF)
+    p++;
+
+  if (p == end)
+    return kJpegErrorInvalidData;
+
+  uint32_t m = *p++;
+  *marker = m;
+  *segment = p;
+  *segmentSize = 0;
+
+  if (m == kJpegMarkerSOI || m == kJpegMarkerEOI || m == kJpegMarkerTEM || (m >= kJpegMarkerRST0 && m <= kJpegMarkerRST7)) {
+    *pSrc = p;
+    return kJpegErrorOk;
+  }
+
+  if (end - p < 2)
+    return kJpegErrorInvalidData;
+
+  size_t length = dejpeg_read_u16(p);
+  if (length < 2 || length > static_cast<size_t>(end - p))
+    return kJpegErrorInvalidData;
+
+  *segment = p + 2;
+  *segmentSize = length - 2;
+  *pSrc = p + length;
+  return kJpegErrorOk;
+}
+
+uint32_t dejpeg_decoder_read_header(DeJpegDecoder* d, const uint8_t* data, size_t size) {
+  const uint8_t* p = data;
+  const uint8_t* end = data + size;
+
+  d->width = 0;
+  d->height = 0;
+  d->componentCount = 0;
+  d->restartInterval = 0;
+  d->progressive = false;
+  d->qMask = 0;
+  d->dcMask = 0;
+  d->acMask = 0;
+  d->scan = NULL;
+  d->scanSize = 0;
+
+  if (size < 2 || p[0] != 0xFF || p[1] != kJpegMarkerSOI)
+    return kJpegErrorInvalidData;
+  p += 2;
+
+  for (;;) {
+    const uint8_t* markerStart = p;
+    const uint8_t* segment;
+    size_t segmentSize;
+    uint32_t marker;
+
+    uint32_t err = dejpeg_decoder_next_marker(&p, end, &marker, &segment, &segmentSize);
+    if (err != kJpegErrorOk)
+      return err;
+
+    switch (marker) {
+      case kJpegMarkerSOI:
+      case kJpegMarkerEOI:
+        return kJpegErrorInvalidData;
+
+      case kJpegMarkerSOF0:
+      case kJpegMarkerSOF1:
+      case kJpegMarkerSOF2:
+        err = dejpeg_decoder_parse_sof(d, segment, segmentSize, marker == kJpegMarkerSOF2);
+        break;
+
+      case kJpegMarkerDHT:
+        err = dejpeg_decoder_parse_dht(d, segment, segmentSize);
+        break;
+
+      case kJpegMarkerDQT:
+        err = dejpeg_decoder_parse_dqt(d, segment, segmentSize);
+        break;
+
+      case kJpegMarkerDRI:
+        err = dejpeg_decoder_parse_dri(d, segment, segmentSize);
+        break;
+
+      case kJpegMarkerSOS:
+        // The scans of a progressive image are parsed by the decoder, only the
+        // first one is validated here.
+        if (d->progressive) {
+          DeJpegScan scan;
+          err = dejpeg_decoder_parse_progressive_sos(d, &scan, segment, segmentSize);
+          if (err != kJpegErrorOk)
+            return err;
+
+          d->scan = markerStart;
+          d->scanSize = static_cast<size_t>(end - markerStart);
+          return kJpegErrorOk;
+        }
+
+        err = dejpeg_decoder_parse_sos(d, segment, segmentSize);
+        if (err != kJpegErrorOk)
+          return err;
+
+        d->scan = p;
+        d->scanSize = static_cast<size_t>(end - p);
+        return kJpegErrorOk;
+
+      default:
+        // Lossless, hierarchical and arithmetic coding processes.
+        if (marker > kJpegMarkerSOF2 && marker <= 0xCF)
+          return kJpegErrorUnsupported;
+        // APPn, COM, RSTn and other markers are skipped.
+        break;
+    }
+
+    if (err != kJpegErrorOk)
+      return err;
+  }
+}
+
+// ============================================================================
+// [Decoder - Workspace]
+// ============================================================================
+
+// Unstuffed entropy-coded segment (data between two RST markers) within
+// `DeJpegWorkspace::data`, followed by `JPEG_HUFF_PADDING` zero bytes.
+struct DeJpegSegment {
+  size_t offset;
+  size_t size;
+};
+
+// Buffers used by a single worker. IDCT kernels require aligned coefficients.
+// Planes hold one MCU row of samples of each component, rows hold upsampled
+// chroma and the second row of the last MCU row of 4:2:0 images having an odd
+// height.
+struct DeJpegWorker {
+  int16_t* coeff;
+  uint8_t* planes[JPEG_MAX_COMPONENTS];
+  intptr_t strides[JPEG_MAX_COMPONENTS];
+  uint8_t* rowCb;
+  uint8_t* rowCr;
+  uint8_t* rowDummy;
+
+  // Progressive images only - a de-zig-zagged block row and arguments of the
+  // batch IDCT (destination of each block and zero quantization indexes).
+  int16_t* rowCoeff;
+  uint8_t** rowDst;
+  uint8_t* rowQIndex;
+
+  uint32_t err;
+};
+
+// Pointers to the memory provided by the caller. IDCT kernels require aligned
+// quantization tables, so they are copied here.
+//
+// All segments of a sequential image are unstuffed before decoding starts, so
+// any MCU row can be decoded independently of the previous ones by starting
+// at the segment it belongs to. Scans of a progressive image are decoded one
+// segment at a time to the beginning of `data` and their coefficients are
+// kept in `arenas` (a block row after another, blocks in zig-zag order).
+//
+// Streaming of a sequential image uses `data` as a window of unstuffed data
+// that is refilled as the image is decoded, and `strip` holds RGB32 pixels of
+// the MCU row delivered to the caller.
+struct DeJpegWorkspace {
+  uint16_t* qTables;
+  DeJpegSegment* segments;
+  uint8_t* data;
+  int16_t* arenas[JPEG_MAX_COMPONENTS];
+  DeJpegWorker* workers;
+  uint8_t* strip;
+};
+
+// Size of the window of unstuffed data used by streaming.
+#define JPEG_STREAM_WINDOW 16384
+
+// The longest possible block in bytes - 64 codes of 16 bits, each followed by
+// up to 15 extra bits (even if the data is corrupt).
+#define JPEG_MAX_BLOCK_BYTES 248
+
+static uint32_t dejpeg_decoder_segment_count(const DeJpegDecoder* d) {
+  uint32_t mcuCount = d->mcusPerLine * d->mcuRows;
+  uint32_t ri = d->restartInterval;
+  return ri ? (mcuCount + ri - 1) / ri : 1;
+}
+
+// Number of blocks of the coefficient arena of component `comp`.
+static size_t dejpeg_decoder_arena_blocks(const DeJpegDecoder* d, const DeJpegComponent& comp) {
+  return size_t(comp.blocksPerLine) * d->mcuRows * comp.v;
+}
+
+// Assigns `ws` pointers relative to `base` and returns the size of the whole
+// workspace, `base` can be NULL to only calculate the size.
+static size_t dejpeg_decoder_layout(const DeJpegDecoder* d, DeJpegWorkspace* ws, uint8_t* base, uint32_t threadCount, bool stream) {
+  size_t offset = 0;
+  uint32_t nc = d->componentCount;
+  uint32_t i;
+
+# define JPEG_WORKSPACE_ALLOC(dst, type, size) \
+  do { \
+    dst = reinterpret_cast<type*>(base + offset); \
+    offset = SimdUtils::align<size_t>(offset + (size), 64); \
+  } while (0)
+
+  // The workspace provided by the caller doesn't have to be aligned.
+  offset = SimdUtils::alignDiff<uint8_t*>(base, 64);
+
+  JPEG_WORKSPACE_ALLOC(ws->qTables, uint16_t, 4 * 64 * sizeof(uint16_t));
+
+  if (d->progressive) {
+    ws->segments = NULL;
+    JPEG_WORKSPACE_ALLOC(ws->data, uint8_t, d->scanSize + JPEG_HUFF_PADDING);
+
+    for (i = 0; i < nc; i++)
+      JPEG_WORKSPACE_ALLOC(ws->arenas[i], int16_t, dejpeg_decoder_arena_blocks(d, d->components[i]) * 64 * sizeof(int16_t));
+  }
+  else {
+    if (stream) {
+      ws->segments = NULL;
+      JPEG_WORKSPACE_ALLOC(ws->data, uint8_t, JPEG_STREAM_WINDOW + JPEG_HUFF_PADDING);
+    }
+    else {
+      size_t segmentCount = dejpeg_decoder_segment_count(d);
+      JPEG_WORKSPACE_ALLOC(ws->segments, DeJpegSegment, segmentCount * sizeof(DeJpegSegment));
+      JPEG_WORKSPACE_ALLOC(ws->data, uint8_t, d->scanSize + segmentCount * JPEG_HUFF_PADDING);
+    }
+
+    for (i = 0; i < nc; i++)
+      ws->arenas[i] = NULL;
+  }
+
+  if (stream)
+    JPEG_WORKSPACE_ALLOC(ws->strip, uint8_t, size_t(d->width) * 4 * d->mcuHeight);
+  else
+    ws->strip = NULL;
+
+  JPEG_WORKSPACE_ALLOC(ws->workers, DeJpegWorker, threadCount * sizeof(DeJpegWorker));
+
+  // The first component has the most blocks per line.
+  uint32_t maxBlocksPerLine = d->components[0].blocksPerLine;
+  size_t rowSize = d->mcusPerLine * d->mcuWidth;
+
+  for (uint32_t t = 0; t < threadCount; t++) {
+    DeJpegWorker dummy;
+    DeJpegWorker* w = base ? &ws->workers[t] : &dummy;
+
+    JPEG_WORKSPACE_ALLOC(w->coeff, int16_t, 64 * sizeof(int16_t));
+    for (i = 0; i < nc; i++) {
+      const DeJpegComponent& comp = d->components[i];
+      w->strides[i] = static_cast<intptr_t>(comp.blocksPerLine * 8);
+      JPEG_WORKSPACE_ALLOC(w->planes[i], uint8_t, comp.blocksPerLine * 8 * comp.v * 8);
+    }
+
+    JPEG_WORKSPACE_ALLOC(w->rowCb, uint8_t, rowSize);
+    JPEG_WORKSPACE_ALLOC(w->rowCr, uint8_t, rowSize);
+    JPEG_WORKSPACE_ALLOC(w->rowDummy, uint8_t, d->width * 4);
+
+    if (d->progressive) {
+      JPEG_WORKSPACE_ALLOC(w->rowCoeff, int16_t, maxBlocksPerLine * 64 * sizeof(int16_t));
+      JPEG_WORKSPACE_ALLOC(w->rowDst, uint8_t*, maxBlocksPerLine * sizeof(uint8_t*));
+      JPEG_WORKSPACE_ALLOC(w->rowQIndex, uint8_t, maxBlocksPerLine);
+    }
+    else {
+      w->rowCoeff = NULL;
+      w->rowDst = NULL;
+      w->rowQIndex = NULL;
+    }
+  }
+
+# undef JPEG_WORKSPACE_ALLOC
+  return offset;
+}
+
+size_t dejpeg_decoder_workspace_size(const DeJpegDecoder* d) {
+  return dejpeg_decoder_workspace_size_mt(d, 1);
+}
+
+size_t dejpeg_decoder_workspace_size_mt(const DeJpegDecoder* d, uint32_t threadCount) {
+  DeJpegWorkspace ws;
+  return dejpeg_decoder_layout(d, &ws, NULL, threadCount, false) + 64;
+}
+
+size_t dejpeg_decoder_stream_workspace_size(const DeJpegDecoder* d) {
+  DeJpegWorkspace ws;
+  return dejpeg_decoder_layout(d, &ws, NULL, 1, true) + 64;
+}
+
+static void dejpeg_decoder_init_workers(const DeJpegDecoder* d, const DeJpegWorkspace* ws, uint32_t threadCount) {
+  for (uint32_t t = 0; t < threadCount; t++) {
+    DeJpegWorker* w = &ws->workers[t];
+    w->err = kJpegErrorOk;
+
+    if (d->componentCount == 1) {
+      ::memset(w->rowCb, 128, d->width);
+      ::memset(w->rowCr, 128, d->width);
+    }
+
+    if (d->progressive)
+      ::memset(w->rowQIndex, 0, d->components[0].blocksPerLine);
+  }
+}
+
+// ============================================================================
+// [Decoder - Decode]
+// ============================================================================
+
+// Skips a RST marker that is expected at `*pSrc`.
+static uint32_t dejpeg_decoder_restart(const uint8_t** pSrc, const uint8_t* end) {
+  const uint8_t* p = *pSrc;
+
+  if (p == end || p[0] != 0xFF)
+    return kJpegErrorInvalidData;
+
+  while (p != end && p[0] == 0xFF)
+    p++;
+
+  if (p == end || p[0] < kJpegMarkerRST0 || p[0] > kJpegMarkerRST7)
+    return kJpegErrorInvalidData;
+
+  *pSrc = p + 1;
+  return kJpegErrorOk;
+}
+
+// Unstuffs all entropy-coded segments of the scan to `ws->data`. This is a
+// serial pass, but it runs at memory speed and it's what makes decoding of
+// segments independent.
+static uint32_t dejpeg_decoder_unstuff_scan(const DeJpegDecoder* d, DeJpegWorkspace* ws) {
+  const DeJpegDecoderFuncs* funcs = d->funcs;
+  uint32_t segmentCount = dejpeg_decoder_segment_count(d);
+
+  const uint8_t* src = d->scan;
+  const uint8_t* srcEnd = d->scan + d->scanSize;
+  size_t offset = 0;
+
+  for (uint32_t i = 0; i < segmentCount; i++) {
+    if (i != 0 && dejpeg_decoder_restart(&src, srcEnd) != kJpegErrorOk)
+      return kJpegErrorInvalidData;
+
+    size_t consumed;
+    size_t size = funcs->unstuff(ws->data + offset, src, static_cast<size_t>(srcEnd - src), &consumed);
+
+    src += consumed;
+    ws->segments[i].offset = offset;
+    ws->segments[i].size = size;
+    offset += size + JPEG_HUFF_PADDING;
+  }
+
+  return kJpegErrorOk;
+}
+
+// Converts `rows` rows of the MCU row held by `w` to RGB32.
+static void dejpeg_decoder_convert(const DeJpegDecoder* d, const DeJpegWorker* w, uint8_t* dst, intptr_t dstStride, uint32_t rows) {
+  const DeJpegDecoderFuncs* funcs = d->funcs;
+
+  uint32_t width = d->width;
+  uint32_t r;
+
+  const uint8_t* pY = w->planes[0];
+  intptr_t strideY = w->strides[0];
+
+  if (d->componentCount == 1) {
+    // `rowCb` and `rowCr` are filled by 128 (zero chroma).
+    for (r = 0; r < rows; r++, dst += dstStride, pY += strideY)
+      funcs->ycbcrToRgb32(dst, pY, w->rowCb, w->rowCr, width);
+    return;
+  }
+
+  const uint8_t* pCb = w->planes[1];
+  const uint8_t* pCr = w->planes[2];
+  intptr_t strideC = w->strides[1];
+
+  if (d->mcuWidth == 8) {
+    for (r = 0; r < rows; r++, dst += dstStride, pY += strideY, pCb += strideC, pCr += strideC)
+      funcs->ycbcrToRgb32(dst, pY, pCb, pCr, width);
+  }
+  else if (d->mcuHeight == 8) {
+    uint32_t cw = (width + 1) / 2;
+    for (r = 0; r < rows; r++, dst += dstStride, pY += strideY, pCb += strideC, pCr += strideC) {
+      funcs->upsampleH2V1(w->rowCb, pCb, cw);
+      funcs->upsampleH2V1(w->rowCr, pCr, cw);
+      funcs->ycbcrToRgb32(dst, pY, w->rowCb, w->rowCr, width);
+    }
+  }
+  else {
+    for (r = 0; r < rows; r += 2, dst += dstStride * 2, pY += strideY * 2, pCb += strideC, pCr += strideC) {
+      uint8_t* dst1 = r + 1 < rows ? dst + dstStride : w->rowDummy;
+      funcs->ycbcrH2V2ToRgb32(dst, dst1, pY, pY + strideY, pCb, pCr, width);
+    }
+  }
+}
+
+static void dejpeg_decoder_convert_mcu_row(const DeJpegDecoder* d, const DeJpegWorker* w, uint8_t* dst, intptr_t dstStride, uint32_t mcuY) {
+  uint32_t y = mcuY * d->mcuHeight;
+  uint32_t rows = SimdUtils::min<uint32_t>(d->mcuHeight, d->height - y);
+  dejpeg_decoder_convert(d, w, dst + static_cast<intptr_t>(y) * dstStride, dstStride, rows);
+}
+
+// Decodes the MCU at `mcuX` of the current MCU row, its samples are stored to
+// the planes of `w` only if `output` is true.
+static SIMD_INLINE uint32_t dejpeg_decoder_decode_mcu(const DeJpegDecoder* d, const DeJpegWorkspace* ws, DeJpegWorker* w, DeJpegBitReader* br, int32_t* dcPred, uint32_t mcuX, bool output) {
+  const DeJpegDecoderFuncs* funcs = d->funcs;
+  uint32_t nc = d->componentCount;
+
+  for (uint32_t i = 0; i < nc; i++) {
+    const DeJpegComponent& comp = d->components[i];
+    const uint16_t* qTable = ws->qTables + comp.tq * 64;
+    intptr_t stride = w->strides[i];
+
+    uint8_t* pBlock = w->planes[i] + mcuX * comp.h * 8;
+    for (uint32_t by = 0; by < comp.v; by++, pBlock += stride * 8) {
+      for (uint32_t bx = 0; bx < comp.h; bx++) {
+        uint32_t eob = dejpeg_huff_decode_block(br, w->coeff, &d->dcTables[comp.td], &d->acTables[comp.ta], &dcPred[i]);
+        if (eob == JPEG_HUFF_INVALID)
+          return kJpegErrorInvalidData;
+        if (output)
+          funcs->idct(pBlock + bx * 8, stride, w->coeff, qTable, eob);
+      }
+    }
+  }
+
+  return kJpegErrorOk;
+}
+
+// Decodes MCU rows `[rowStart, rowEnd)`. Decoding starts at the segment that
+// contains the first MCU of `rowStart`, MCUs of the previous rows are only
+// entropy decoded to get the bit position and DC predictors right.
+static uint32_t dejpeg_decoder_decode_rows(const DeJpegDecoder* d, const DeJpegWorkspace* ws, DeJpegWorker* w, uint8_t* dst, intptr_t dstStride, uint32_t rowStart, uint32_t rowEnd) {
+  uint32_t nc = d->componentCount;
+  uint32_t ri = d->restartInterval;
+
+  uint32_t segmentIndex = ri ? rowStart * d->mcusPerLine / ri : 0;
+  uint32_t firstMcu = segmentIndex * ri;
+
+  uint32_t mcuX = firstMcu % d->mcusPerLine;
+  uint32_t mcuY = firstMcu / d->mcusPerLine;
+
+  DeJpegBitReader br;
+  int32_t dcPred[JPEG_MAX_COMPONENTS];
+
+  // Number of MCUs left until the next restart marker, zero starts decoding
+  // of the next segment.
+  uint32_t restartLeft = 0;
+
+  for (;;) {
+    if (restartLeft == 0) {
+      const DeJpegSegment& segment = ws->segments[segmentIndex++];
+      dejpeg_bits_init(&br, ws->data + segment.offset, segment.size);
+
+      for (uint32_t i = 0; i < nc; i++)
+        dcPred[i] = 0;
+      restartLeft = ri ? ri : 0xFFFFFFFFU;
+    }
+    restartLeft--;
+
+    bool output = mcuY >= rowStart;
+    if (dejpeg_decoder_decode_mcu(d, ws, w, &br, dcPred, mcuX, output) != kJpegErrorOk)
+      return kJpegErrorInvalidData;
+
+    if (++mcuX == d->mcusPerLine) {
+      mcuX = 0;
+
+      if (output)
+        dejpeg_decoder_convert_mcu_row(d, w, dst, dstStride, mcuY);
+
+      if (++mcuY == rowEnd)
+        return kJpegErrorOk;
+    }
+  }
+}
+
+// ============================================================================
+// [Decoder - Progressive]
+// ============================================================================
+
+static SIMD_INLINE uint32_t dejpeg_bits_get(DeJpegBitReader* br, uint32_t n) {
+  if (br->bitCount < n)
+    dejpeg_bits_refill(br);
+
+  uint32_t v = dejpeg_bits_peek(br, n);
+  dejpeg_bits_consume(br, n);
+  return v;
+}
+
+// Decodes a symbol and its extra bits (sign-extended to `*value`).
+static SIMD_INLINE uint32_t dejpeg_decoder_decode_symbol(DeJpegBitReader* br, const DeJpegHuffTable* table, int32_t* value) {
+  dejpeg_bits_refill(br);
+  uint32_t e = table->fast[dejpeg_bits_peek(br, JPEG_HUFF_LOOKUP_BITS)];
+
+  if (e) {
+    dejpeg_bits_consume(br, e & 0xFF);
+    *value = static_cast<int32_t>(e) >> 16;
+    return (e >> 8) & 0xFF;
+  }
+
+  uint32_t symbol = dejpeg_huff_decode_slow(br, table);
+  if (symbol == JPEG_HUFF_INVALID)
+    return JPEG_HUFF_INVALID;
+
+  *value = dejpeg_huff_receive(br, symbol & 15);
+  return symbol;
+}
+
+// Reads the length of an EOB run (the current block included) that follows
+// an EOBn symbol.
+static SIMD_INLINE uint32_t dejpeg_decoder_eob_run(DeJpegBitReader* br, uint32_t r) {
+  // Up to 14 bits, a refill before the symbol made at least 56 available.
+  uint32_t run = 1U << r;
+  if (r) {
+    run += dejpeg_bits_peek(br, r);
+    dejpeg_bits_consume(br, r);
+  }
+  return run;
+}
+
+// Reads a correction bit of each non-zero coefficient set in `mask`.
+static SIMD_INLINE void dejpeg_decoder_refine(DeJpegBitReader* br, int16_t* block, uint64_t mask, int32_t p1) {
+  while (mask) {
+    uint32_t k = dejpeg_ctz64(mask);
+    mask &= mask - 1;
+
+    if (dejpeg_bits_get(br, 1)) {
+      int32_t c = block[k];
+      if ((c & p1) == 0)
+        block[k] = static_cast<int16_t>(c >= 0 ? c + p1 : c - p1);
+    }
+  }
+}
+
+struct DeJpegScanState {
+  DeJpegBitReader br;
+  int32_t dcPred[JPEG_MAX_COMPONENTS];
+  uint32_t eobRun;
+};
+
+static SIMD_INLINE uint32_t dejpeg_decoder_dc_first(DeJpegScanState* st, int16_t* block, const DeJpegHuffTable* table, int32_t* dcPred, uint32_t al) {
+  int32_t v;
+  uint32_t s = dejpeg_decoder_decode_symbol(&st->br, table, &v);
+
+  if (s > 15)
+    return kJpegErrorInvalidData;
+
+  *dcPred += v;
+  block[0] = static_cast<int16_t>(*dcPred * (1 << al));
+  return kJpegErrorOk;
+}
+
+static SIMD_INLINE uint32_t dejpeg_decoder_dc_refine(DeJpegScanState* st, int16_t* block, uint32_t al) {
+  if (dejpeg_bits_get(&st->br, 1))
+    block[0] = static_cast<int16_t>(block[0] | (1 << al));
+  return kJpegErrorOk;
+}
+
+static SIMD_INLINE uint32_t dejpeg_decoder_ac_first(DeJpegScanState* st, int16_t* block, const DeJpegHuffTable* table, const DeJpegScan* scan) {
+  if (st->eobRun) {
+    st->eobRun--;
+    return kJpegErrorOk;
+  }
+
+  uint32_t se = scan->se;
+  int32_t p1 = 1 << scan->al;
+
+  for (uint32_t k = scan->ss; k <= se; k++) {
+    int32_t v;
+    uint32_t rs = dejpeg_decoder_decode_symbol(&st->br, table, &v);
+
+    if (rs == JPEG_HUFF_INVALID)
+      return kJpegErrorInvalidData;
+
+    uint32_t r = rs >> 4;
+    if (rs & 15) {
+      k += r;
+      if (k > se)
+        return kJpegErrorInvalidData;
+      block[k] = static_cast<int16_t>(v * p1);
+    }
+    else if (r == 15) {
+      k += 15;
+    }
+    else {
+      st->eobRun = dejpeg_decoder_eob_run(&st->br, r) - 1;
+      break;
+    }
+  }
+
+  return kJpegErrorOk;
+}
+
+// Refinement of a band as described by G.1.2.3. The non-zero mask is valid for
+// the whole block - coefficients only grow in magnitude and new ones are only
+// created behind the current position.
+static SIMD_INLINE uint32_t dejpeg_decoder_ac_refine(DeJpegScanState* st, int16_t* block, const DeJpegHuffTable* table, const DeJpegScan* scan, DeJpegNonZeroMaskFunc nonzeroMask) {
+  uint32_t k = scan->ss;
+  uint32_t se = scan->se;
+  int32_t p1 = 1 << scan->al;
+
+  uint64_t band = (~uint64_t(0) >> (63 - se)) & (~uint64_t(0) << k);
+  uint64_t nz = nonzeroMask(block) & band;
+
+  if (st->eobRun == 0) {
+    for (; k <= se; k++) {
+      int32_t v;
+      uint32_t rs = dejpeg_decoder_decode_symbol(&st->br, table, &v);
+
+      if (rs == JPEG_HUFF_INVALID)
+        return kJpegErrorInvalidData;
+
+      uint32_t r = rs >> 4;
+      uint32_t s = rs & 15;
+
+      if (s) {
+        // A new coefficient is always +/-1 (in the current bit position).
+        if (s != 1)
+          return kJpegErrorInvalidData;
+      }
+      else if (r != 15) {
+        st->eobRun = dejpeg_decoder_eob_run(&st->br, r);
+        break;
+      }
+
+      // Skip `r` zero coefficients and stop at the next one, which is where a
+      // new coefficient goes (the 16th zero for ZRL). Non-zero coefficients
+      // skipped on the way are refined.
+      uint64_t zeros = ~nz & band & (~uint64_t(0) << k);
+      for (uint32_t i = 0; i < r && zeros; i++)
+        zeros &= zeros - 1;
+
+      uint32_t pos = zeros ? dejpeg_ctz64(zeros) : se + 1;
+      uint64_t skipped = nz & (~uint64_t(0) << k) & (pos < 64 ? (uint64_t(1) << pos) - 1 : ~uint64_t(0));
+
+      dejpeg_decoder_refine(&st->br, block, skipped, p1);
+      k = pos;
+
+      if (s) {
+        if (k > se)
+          return kJpegErrorInvalidData;
+        block[k] = static_cast<int16_t>(v * p1);
+      }
+    }
+  }
+
+  if (st->eobRun) {
+    if (k <= se)
+      dejpeg_decoder_refine(&st->br, block, nz & (~uint64_t(0) << k), p1);
+    st->eobRun--;
+  }
+
+  return kJpegErrorOk;
+}
+
+// Decodes a scan of a progressive image that starts at `*pSrc` (just after the
+// SOS segment) and advances `*pSrc` to the marker that follows it.
+static uint32_t dejpeg_decoder_decode_scan(const DeJpegDecoder* d, const DeJpegWorkspace* ws, const DeJpegScan* scan, const uint8_t** pSrc, const uint8_t* srcEnd) {
+  const DeJpegDecoderFuncs* funcs = d->funcs;
+  const uint8_t* src = *pSrc;
+
+  // MCUs of non-interleaved scans are single blocks covering the component
+  // (A.2.2), interleaved scans cover whole MCUs, including padding blocks.
+  const DeJpegComponent& first = d->components[scan->components[0]];
+  uint32_t unitsPerLine = d->mcusPerLine;
+  uint32_t unitRows = d->mcuRows;
+
+  if (scan->count == 1) {
+    uint32_t hMax = d->components[0].h;
+    uint32_t vMax = d->components[0].v;
+    uint32_t compW = (d->width * first.h + hMax - 1) / hMax;
+    uint32_t compH = (d->height * first.v + vMax - 1) / vMax;
+
+    unitsPerLine = (compW + 7) / 8;
+    unitRows = (compH + 7) / 8;
+  }
+
+  DeJpegScanState st;
+  uint32_t ri = d->restartInterval;
+  uint32_t restartLeft = 0;
+  uint32_t ux = 0;
+  uint32_t uy = 0;
+
+  const DeJpegHuffTable* acTable = &d->acTables[first.ta];
+  int16_t* arena = ws->arenas[scan->components[0]];
+  size_t arenaStride = size_t(first.blocksPerLine) * 64;
+
+  for (;;) {
+    if (restartLeft == 0) {
+      if ((ux | uy) != 0 && dejpeg_decoder_restart(&src, srcEnd) != kJpegErrorOk)
+        return kJpegErrorInvalidData;
+
+      size_t consumed;
+      size_t dataSize = funcs->unstuff(ws->data, src, static_cast<size_t>(srcEnd - src), &consumed);
+
+      src += consumed;
+      dejpeg_bits_init(&st.br, ws->data, dataSize);
+
+      for (uint32_t i = 0; i < JPEG_MAX_COMPONENTS; i++)
+        st.dcPred[i] = 0;
+      st.eobRun = 0;
+      restartLeft = ri ? ri : 0xFFFFFFFFU;
+    }
+    restartLeft--;
+
+    uint32_t err;
+    if (scan->count == 1) {
+      int16_t* block = arena + uy * arenaStride + ux * 64;
+
+      if (scan->ss == 0) {
+        if (scan->ah == 0)
+          err = dejpeg_decoder_dc_first(&st, block, &d->dcTables[first.td], &st.dcPred[0], scan->al);
+        else
+          err = dejpeg_decoder_dc_refine(&st, block, scan->al);
+      }
+      else {
+        if (scan->ah == 0)
+          err = dejpeg_decoder_ac_first(&st, block, acTable, scan);
+        else
+          err = dejpeg_decoder_ac_refine(&st, block, acTable, scan, funcs->nonzeroMask);
+      }
+
+      if (err != kJpegErrorOk)
+        return err;
+    }
+    else {
+      // Interleaved scans are always DC scans.
+      for (uint32_t i = 0; i < scan->count; i++) {
+        uint32_t index = scan->components[i];
+        const DeJpegComponent& comp = d->components[index];
+        size_t stride = size_t(comp.blocksPerLine) * 64;
+        int16_t* pBlock = ws->arenas[index] + (uy * comp.v) * stride + (ux * comp.h) * 64;
+
+        for (uint32_t by = 0; by < comp.v; by++, pBlock += stride) {
+          for (uint32_t bx = 0; bx < comp.h; bx++) {
+            if (scan->ah == 0)
+              err = dejpeg_decoder_dc_first(&st, pBlock + bx * 64, &d->dcTables[comp.td], &st.dcPred[i], scan->al);
+            else
+              err = dejpeg_decoder_dc_refine(&st, pBlock + bx * 64, scan->al);
+
+            if (err != kJpegErrorOk)
+              return err;
+          }
+        }
+      }
+    }
+
+    if (++ux == unitsPerLine) {
+      ux = 0;
+      if (++uy == unitRows)
+        break;
+    }
+  }
+
+  *pSrc = src;
+  return kJpegErrorOk;
+}
+
+// Decodes all scans of a progressive image to the coefficient arenas. Tables
+// and restart intervals can be redefined between scans. If the data ends
+// before EOI, the image is decoded from the scans received so far. Fails if a
+// quantization table is still missing after the last scan.
+static uint32_t dejpeg_decoder_decode_scans(DeJpegDecoder* d, const DeJpegWorkspace* ws) {
+  const uint8_t* p = d->scan;
+  const uint8_t* end = d->scan + d->scanSize;
+
+  for (uint32_t i = 0; i < d->componentCount; i++)
+    ::memset(ws->arenas[i], 0, dejpeg_decoder_arena_blocks(d, d->components[i]) * 64 * sizeof(int16_t));
+
+  while (p != end) {
+    const uint8_t* segment;
+    size_t segmentSize;
+    uint32_t marker;
+
+    uint32_t err = dejpeg_decoder_next_marker(&p, end, &marker, &segment, &segmentSize);
+    if (err != kJpegErrorOk)
+      return err;
+
+    switch (marker) {
+      case kJpegMarkerEOI:
+        p = end;
+        break;
+
+      case kJpegMarkerDHT:
+        err = dejpeg_decoder_parse_dht(d, segment, segmentSize);
+        break;
+
+      case kJpegMarkerDQT:
+        err = dejpeg_decoder_parse_dqt(d, segment, segmentSize);
+        break;
+
+      case kJpegMarkerDRI:
+        err = dejpeg_decoder_parse_dri(d, segment, segmentSize);
+        break;
+
+      case kJpegMarkerSOS: {
+        DeJpegScan scan;
+        err = dejpeg_decoder_parse_progressive_sos(d, &scan, segment, segmentSize);
+        if (err == kJpegErrorOk)
+          err = dejpeg_decoder_decode_scan(d, ws, &scan, &p, end);
+        break;
+      }
+
+      default:
+        // Another frame or arithmetic coding conditioning.
+        if (marker >= kJpegMarkerSOF0 && marker <= 0xCF)
+          return kJpegErrorInvalidData;
+        break;
+    }
+
+    if (err != kJpegErrorOk)
+      return err;
+  }
+
+  for (uint32_t i = 0; i < d->componentCount; i++) {
+    if (!(d->qMask & (1U << d->components[i].tq)))
+      return kJpegErrorInvalidData;
+  }
+
+  return kJpegErrorOk;
+}
+
+// De-zig-zags and transforms blocks of the MCU row `mcuY` a block row at a
+// time to the planes of `w`. Blocks that end in the top-left 4x4 corner are
+// transformed right away by the sparse IDCT, the rest is batched.
+static void dejpeg_decoder_transform_row(const DeJpegDecoder* d, const DeJpegWorkspace* ws, DeJpegWorker* w, uint32_t mcuY) {
+  const DeJpegDecoderFuncs* funcs = d->funcs;
+  uint32_t nc = d->componentCount;
+
+  for (uint32_t i = 0; i < nc; i++) {
+    const DeJpegComponent& comp = d->components[i];
+    const uint16_t* qTable = ws->qTables + comp.tq * 64;
+
+    uint32_t n = comp.blocksPerLine;
+    intptr_t stride = w->strides[i];
+
+    for (uint32_t by = 0; by < comp.v; by++) {
+      const int16_t* src = ws->arenas[i] + (size_t(mcuY) * comp.v + by) * n * 64;
+      uint8_t* pRow = w->planes[i] + by * 8 * stride;
+
+      uint32_t count = 0;
+      for (uint32_t bx = 0; bx < n; bx++) {
+        int16_t* coeff = w->rowCoeff + count * 64;
+        uint32_t eob = funcs->dezigzag(coeff, src + bx * 64);
+
+        if (eob <= JPEG_IDCT_EOB_4X4) {
+          funcs->idct(pRow + bx * 8, stride, coeff, qTable, eob);
+        }
+        else {
+          w->rowDst[count] = pRow + bx * 8;
+          count++;
+        }
+      }
+
+      if (count)
+        funcs->idctBatch(w->rowDst, stride, w->rowCoeff, qTable, w->rowQIndex, count);
+    }
+  }
+}
+
+static uint32_t dejpeg_decoder_transform_rows(const DeJpegDecoder* d, const DeJpegWorkspace* ws, DeJpegWorker* w, uint8_t* dst, intptr_t dstStride, uint32_t rowStart, uint32_t rowEnd) {
+  for (uint32_t mcuY = rowStart; mcuY < rowEnd; mcuY++) {
+    dejpeg_decoder_transform_row(d, ws, w, mcuY);
+    dejpeg_decoder_convert_mcu_row(d, w, dst, dstStride, mcuY);
+  }
+
+  return kJpegErrorOk;
+}
+
+// ============================================================================
+// [Decoder - API]
+// ============================================================================
+
+// Decoding of bands of `bandRows` MCU rows, a task per band.
+struct DeJpegDecodeJob {
+  const DeJpegDecoder* d;
+  const DeJpegWorkspace* ws;
+  uint8_t* dst;
+  intptr_t dstStride;
+  uint32_t bandRows;
+};
+
+static void dejpeg_decoder_band_task(void* data, uint32_t worker, uint32_t task) {
+  const DeJpegDecodeJob* job = static_cast<const DeJpegDecodeJob*>(data);
+  const DeJpegDecoder* d = job->d;
+
+  uint32_t rowStart = task * job->bandRows;
+  uint32_t rowEnd = SimdUtils::min<uint32_t>(rowStart + job->bandRows, d->mcuRows);
+
+  DeJpegWorker* w = &job->ws->workers[worker];
+  uint32_t err = d->progressive
+    ? dejpeg_decoder_transform_rows(d, job->ws, w, job->dst, job->dstStride, rowStart, rowEnd)
+    : dejpeg_decoder_decode_rows(d, job->ws, w, job->dst, job->dstStride, rowStart, rowEnd);
+
+  if (err != kJpegErrorOk)
+    w->err = err;
+}
+
+uint32_t dejpeg_decoder_decode(DeJpegDecoder* d, uint8_t* dst, intptr_t dstStride, void* workspace) {
+  return dejpeg_decoder_decode_mt(d, dst, dstStride, workspace, NULL);
+}
+
+uint32_t dejpeg_decoder_decode_mt(DeJpegDecoder* d, uint8_t* dst, intptr_t dstStride, void* workspace, DeJpegThreadPool* pool) {
+  if (d->scan == NULL)
+    return kJpegErrorInvalidData;
+
+  uint32_t threadCount = dejpeg_thread_pool_thread_count(pool);
+  uint32_t t;
+
+  DeJpegWorkspace ws;
+  dejpeg_decoder_layout(d, &ws, static_cast<uint8_t*>(workspace), threadCount, false);
+  dejpeg_decoder_init_workers(d, &ws, threadCount);
+
+  // Bands are balanced by having several of them per worker. A band of a
+  // sequential image should be at least as tall as a restart interval, as each
+  // band decodes up to one interval of the previous band to find its start.
+  uint32_t bandRows = d->mcuRows;
+  uint32_t err;
+
+  if (d->progressive) {
+    err = dejpeg_decoder_decode_scans(d, &ws);
+    if (err != kJpegErrorOk)
+      return err;
+
+    if (threadCount > 1)
+      bandRows = (d->mcuRows + threadCount * 4 - 1) / (threadCount * 4);
+  }
+  else {
+    err = dejpeg_decoder_unstuff_scan(d, &ws);
+    if (err != kJpegErrorOk)
+      return err;
+
+    if (threadCount > 1 && d->restartInterval != 0) {
+      uint32_t minRows = (d->restartInterval + d->mcusPerLine - 1) / d->mcusPerLine;
+      bandRows = (d->mcuRows + threadCount * 4 - 1) / (threadCount * 4);
+      bandRows = SimdUtils::max<uint32_t>(bandRows, minRows);
+    }
+  }
+
+  // Quantization tables of progressive images can be defined between scans.
+  ::memcpy(ws.qTables, d->qTables, sizeof(d->qTables));
+
+  DeJpegDecodeJob job;
+  job.d = d;
+  job.ws = &ws;
+  job.dst = dst;
+  job.dstStride = dstStride;
+  job.bandRows = bandRows;
+
+  uint32_t taskCount = (d->mcuRows + bandRows - 1) / bandRows;
+  dejpeg_thread_pool_run(pool, dejpeg_decoder_band_task, &job, taskCount);
+
+  for (t = 0; t < threadCount; t++) {
+    if (ws.workers[t].err != kJpegErrorOk)
+      return ws.workers[t].err;
+  }
+
+  return kJpegErrorOk;
+}
+
+// ============================================================================
+// [Decoder - Stream]
+// ============================================================================
+
+// Makes sure the window holds at least `minBytes` unstuffed bytes not read by
+// `br` yet, unless the segment ends earlier. Bytes not read yet are moved to
+// the beginning of the window, bits already in `br` stay valid as the data
+// that follows them doesn't change.
+static void dejpeg_decoder_stream_fill(const DeJpegDecoder* d, DeJpegStream* s, uint8_t* window, size_t minBytes) {
+  DeJpegBitReader* br = &s->br;
+  size_t left = br->ptr < br->end ? static_cast<size_t>(br->end - br->ptr) : size_t(0);
+
+  if (s->segmentEnd || left >= minBytes)
+    return;
+
+  ::memmove(window, br->ptr, left);
+
+  size_t consumed;
+  size_t chunk = SimdUtils::min<size_t>(static_cast<size_t>(s->srcEnd - s->src), JPEG_STREAM_WINDOW - left);
+  size_t size = d->funcs->unstuff(window + left, s->src, chunk, &consumed);
+
+  // The unstuffer stops before a 0xFF that ends the chunk, the next call will
+  // see whether it's stuffed or a marker.
+  s->src += consumed;
+  s->segmentEnd = s->src == s->srcEnd || (s->src[0] == 0xFF && (s->src + 1 == s->srcEnd || s->src[1] != 0x00));
+
+  br->ptr = window;
+  br->end = window + left + size;
+}
+
+static uint32_t dejpeg_decoder_stream_decode_row(const DeJpegDecoder* d, DeJpegStream* s, const DeJpegWorkspace* ws, DeJpegWorker* w) {
+  uint32_t nc = d->componentCount;
+  uint32_t ri = d->restartInterval;
+
+  // Bytes an MCU can consume plus the lookahead of the bit reader, so no MCU
+  // ever reads past the data in the window.
+  uint32_t blocksPerMcu = 0;
+  for (uint32_t i = 0; i < nc; i++)
+    blocksPerMcu += d->components[i].h * d->components[i].v;
+  size_t minBytes = blocksPerMcu * JPEG_MAX_BLOCK_BYTES + 16;
+
+  for (uint32_t mcuX = 0; mcuX < d->mcusPerLine; mcuX++) {
+    if (s->restartLeft == 0) {
+      // Skips the rest of the previous segment and its RST marker.
+      if (s->mcuY != 0 || mcuX != 0) {
+        while (!s->segmentEnd) {
+          s->br.ptr = s->br.end;
+          dejpeg_decoder_stream_fill(d, s, ws->data, 1);
+        }
+
+        if (dejpeg_decoder_restart(&s->src, s->srcEnd) != kJpegErrorOk)
+          return kJpegErrorInvalidData;
+      }
+
+      s->segmentEnd = false;
+      dejpeg_bits_init(&s->br, ws->data, 0);
+
+      for (uint32_t i = 0; i < nc; i++)
+        s->dcPred[i] = 0;
+      s->restartLeft = ri ? ri : 0xFFFFFFFFU;
+    }
+    s->restartLeft--;
+
+    dejpeg_decoder_stream_fill(d, s, ws->data, minBytes);
+    if (dejpeg_decoder_decode_mcu(d, ws, w, &s->br, s->dcPred, mcuX, true) != kJpegErrorOk)
+      return kJpegErrorInvalidData;
+  }
+
+  return kJpegErrorOk;
+}
+
+uint32_t dejpeg_decoder_stream_begin(DeJpegDecoder* d, DeJpegStream* s, void* workspace) {
+  if (d->scan == NULL)
+    return kJpegErrorInvalidData;
+
+  DeJpegWorkspace ws;
+  dejpeg_decoder_layout(d, &ws, static_cast<uint8_t*>(workspace), 1, true);
+  dejpeg_decoder_init_workers(d, &ws, 1);
+
+  s->pixels = ws.strip;
+  s->stride = static_cast<intptr_t>(d->width * 4);
+  s->y = 0;
+  s->rows = 0;
+
+  s->d = d;
+  s->workspace = workspace;
+  s->src = d->scan;
+  s->srcEnd = d->scan + d->scanSize;
+  s->segmentEnd = false;
+  s->restartLeft = 0;
+  s->mcuY = 0;
+
+  if (d->progressive) {
+    uint32_t err = dejpeg_decoder_decode_scans(d, &ws);
+    if (err != kJpegErrorOk) {
+      s->mcuY = d->mcuRows;
+      return err;
+    }
+  }
+
+  ::memcpy(ws.qTables, d->qTables, sizeof(d->qTables));
+  return kJpegErrorOk;
+}
+
+uint32_t dejpeg_decoder_stream_next(DeJpegStream* s) {
+  const DeJpegDecoder* d = s->d;
+
+  if (s->mcuY >= d->mcuRows) {
+    s->rows = 0;
+    return kJpegErrorOk;
+  }
+
+  DeJpegWorkspace ws;
+  dejpeg_decoder_layout(d, &ws, static_cast<uint8_t*>(s->workspace), 1, true);
+  DeJpegWorker* w = &ws.workers[0];
+
+  if (d->progressive) {
+    dejpeg_decoder_transform_row(d, &ws, w, s->mcuY);
+  }
+  else {
+    uint32_t err = dejpeg_decoder_stream_decode_row(d, s, &ws, w);
+    if (err != kJpegErrorOk) {
+      s->mcuY = d->mcuRows;
+      s->rows = 0;
+      return err;
+    }
+  }
+
+  s->y = s->mcuY * d->mcuHeight;
+  s->rows = SimdUtils::min<uint32_t>(d->mcuHeight, d->height - s->y);
+  dejpeg_decoder_convert(d, w, ws.strip, s->stride, s->rows);
+
+  s->mcuY++;
+  return kJpegErrorOk;
+}
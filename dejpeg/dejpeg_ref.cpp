@@ -5,6 +5,7 @@
 // Public Domain <unlicense.org>
 #include "../simdglobals.h"
 #include "./dejpeg.h"
+#include "./dejpeg_vec.h"
 
 // ============================================================================
 // [DeZigZag - Ref]
@@ -28,6 +29,19 @@ void dejpeg_dezigzag_ref(int16_t* dst, const int16_t* src) {
     dst[table[i]] = src[i];
 }
 
+uint32_t dejpeg_dezigzag_eob_ref(int16_t* dst, const int16_t* src) {
+  const uint8_t* table = dejpeg_dezigzag_table;
+  uint32_t eob = 0;
+
+  for (unsigned int i = 0; i < 64; i++) {
+    dst[table[i]] = src[i];
+    if (src[i] != 0)
+      eob = i;
+  }
+
+  return eob;
+}
+
 // ============================================================================
 // [IDCT - Ref]
 // ============================================================================
@@ -137,25 +151,669 @@ void dejpeg_idct_islow_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src,
   }
 }
 
+void dejpeg_idct_islow_batch_ref(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++, src += 64)
+    dejpeg_idct_islow_ref(dst[i], dstStride, src, qTables + static_cast<uint32_t>(qIndex[i]) * 64);
+}
+
+// The reference already skips columns that have only a DC term, `eob` is not
+// needed here.
+void dejpeg_idct_islow_sparse_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable, uint32_t eob) {
+  (void)eob;
+  dejpeg_idct_islow_ref(dst, dstStride, src, qTable);
+}
+
+// ============================================================================
+// [IDCT Scaled - Ref]
+// ============================================================================
+
+#define JPEG_IDCT_DEQUANT(i) (static_cast<int32_t>(src[i]) * static_cast<int32_t>(qTable[i]))
+
+#define JPEG_IDCT_4X4_PASS(s0, s1, s2, s3, s5, s6, s7) \
+  int32_t tmp0, tmp2, tmp10, tmp12;                         \
+                                                            \
+  tmp0 = (s0) << (JPEG_IDCT_PREC + 1);                      \
+  tmp2 = (s2) * JPEG_IDCT_P_1_847759065 +                   \
+         (s6) * JPEG_IDCT_M_0_765366865;                    \
+                                                            \
+  tmp10 = tmp0 + tmp2;                                      \
+  tmp12 = tmp0 - tmp2;                                      \
+                                                            \
+  tmp0 = (s7) * JPEG_IDCT_M_0_211164243 +                   \
+         (s5) * JPEG_IDCT_P_1_451774981 +                   \
+         (s3) * JPEG_IDCT_M_2_172734803 +                   \
+         (s1) * JPEG_IDCT_P_1_061594337;                    \
+                                                            \
+  tmp2 = (s7) * JPEG_IDCT_M_0_509795579 +                   \
+         (s5) * JPEG_IDCT_M_0_601344887 +                   \
+         (s3) * JPEG_IDCT_P_0_899976223 +                   \
+         (s1) * JPEG_IDCT_P_2_562915447;
+
+void dejpeg_idct_scaled4x4_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  uint32_t i;
+  int32_t* tmp;
+  int32_t tmpData[32];
+
+  // Column 4 is not needed by the row pass.
+  for (i = 0, tmp = tmpData; i < 8; i++, src++, tmp++, qTable++) {
+    if (i == 4)
+      continue;
+
+    if (src[8] == 0 && src[16] == 0 && src[24] == 0 && src[40] == 0 && src[48] == 0 && src[56] == 0) {
+      int32_t dcTerm = JPEG_IDCT_DEQUANT(0) << (JPEG_IDCT_PREC - JPEG_IDCT_COL_NORM);
+      tmp[0] = tmp[8] = tmp[16] = tmp[24] = dcTerm;
+    }
+    else {
+      JPEG_IDCT_4X4_PASS(
+        JPEG_IDCT_DEQUANT( 0), JPEG_IDCT_DEQUANT( 8), JPEG_IDCT_DEQUANT(16), JPEG_IDCT_DEQUANT(24),
+        JPEG_IDCT_DEQUANT(40), JPEG_IDCT_DEQUANT(48), JPEG_IDCT_DEQUANT(56))
+
+      tmp10 += JPEG_IDCT_4X4_COL_BIAS;
+      tmp12 += JPEG_IDCT_4X4_COL_BIAS;
+
+      tmp[ 0] = (tmp10 + tmp2) >> JPEG_IDCT_4X4_COL_NORM;
+      tmp[24] = (tmp10 - tmp2) >> JPEG_IDCT_4X4_COL_NORM;
+      tmp[ 8] = (tmp12 + tmp0) >> JPEG_IDCT_4X4_COL_NORM;
+      tmp[16] = (tmp12 - tmp0) >> JPEG_IDCT_4X4_COL_NORM;
+    }
+  }
+
+  for (i = 0, tmp = tmpData; i < 4; i++, dst += dstStride, tmp += 8) {
+    JPEG_IDCT_4X4_PASS(tmp[0], tmp[1], tmp[2], tmp[3], tmp[5], tmp[6], tmp[7])
+
+    tmp10 += JPEG_IDCT_4X4_ROW_BIAS;
+    tmp12 += JPEG_IDCT_4X4_ROW_BIAS;
+
+    dst[0] = clampToByte((tmp10 + tmp2) >> JPEG_IDCT_4X4_ROW_NORM);
+    dst[3] = clampToByte((tmp10 - tmp2) >> JPEG_IDCT_4X4_ROW_NORM);
+    dst[1] = clampToByte((tmp12 + tmp0) >> JPEG_IDCT_4X4_ROW_NORM);
+    dst[2] = clampToByte((tmp12 - tmp0) >> JPEG_IDCT_4X4_ROW_NORM);
+  }
+}
+
+#define JPEG_IDCT_2X2_PASS(s0, s1, s3, s5, s7) \
+  int32_t tmp0, tmp10;                                      \
+                                                            \
+  tmp10 = (s0) << (JPEG_IDCT_PREC + 2);                     \
+  tmp0 = (s7) * JPEG_IDCT_M_0_720959822 +                   \
+         (s5) * JPEG_IDCT_P_0_850430095 +                   \
+         (s3) * JPEG_IDCT_M_1_272758580 +                   \
+         (s1) * JPEG_IDCT_P_3_624509785;
+
+void dejpeg_idct_scaled2x2_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  uint32_t i;
+  int32_t* tmp;
+  int32_t tmpData[16];
+
+  // Columns 2, 4 and 6 are not needed by the row pass.
+  for (i = 0, tmp = tmpData; i < 8; i++, src++, tmp++, qTable++) {
+    if (i == 2 || i == 4 || i == 6)
+      continue;
+
+    if (src[8] == 0 && src[24] == 0 && src[40] == 0 && src[56] == 0) {
+      int32_t dcTerm = JPEG_IDCT_DEQUANT(0) << (JPEG_IDCT_PREC - JPEG_IDCT_COL_NORM);
+      tmp[0] = tmp[8] = dcTerm;
+    }
+    else {
+      JPEG_IDCT_2X2_PASS(JPEG_IDCT_DEQUANT(0), JPEG_IDCT_DEQUANT(8), JPEG_IDCT_DEQUANT(24), JPEG_IDCT_DEQUANT(40), JPEG_IDCT_DEQUANT(56))
+
+      tmp10 += JPEG_IDCT_2X2_COL_BIAS;
+
+      tmp[0] = (tmp10 + tmp0) >> JPEG_IDCT_2X2_COL_NORM;
+      tmp[8] = (tmp10 - tmp0) >> JPEG_IDCT_2X2_COL_NORM;
+    }
+  }
+
+  for (i = 0, tmp = tmpData; i < 2; i++, dst += dstStride, tmp += 8) {
+    JPEG_IDCT_2X2_PASS(tmp[0], tmp[1], tmp[3], tmp[5], tmp[7])
+
+    tmp10 += JPEG_IDCT_2X2_ROW_BIAS;
+
+    dst[0] = clampToByte((tmp10 + tmp0) >> JPEG_IDCT_2X2_ROW_NORM);
+    dst[1] = clampToByte((tmp10 - tmp0) >> JPEG_IDCT_2X2_ROW_NORM);
+  }
+}
+
+void dejpeg_idct_scaled1x1_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  (void)dstStride;
+
+  // The average of all 64 pixels, which is the DC term divided by 8.
+  dst[0] = clampToByte(((JPEG_IDCT_DEQUANT(0) + 4) >> 3) + 128);
+}
+
+#undef JPEG_IDCT_DEQUANT
+
+// ============================================================================
+// [IDCT Fast - Ref]
+// ============================================================================
+
+// AAN scale factors scaled by 2^14 (from jddctmgr).
+static const int16_t dejpeg_ifast_aanscales[64] = {
+  16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+  22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
+  21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
+  19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
+  16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+  12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
+   8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
+   4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247
+};
+
+void dejpeg_idct_ifast_qtable(uint16_t* dst, const uint16_t* qTable) {
+  const int kShift = 14 - JPEG_IFAST_PASS1_BITS;
+
+  for (uint32_t i = 0; i < 64; i++) {
+    int32_t q = static_cast<int32_t>(qTable[i]) * static_cast<int32_t>(dejpeg_ifast_aanscales[i]);
+    dst[i] = static_cast<uint16_t>((q + (1 << (kShift - 1))) >> kShift);
+  }
+}
+
+#define JPEG_IFAST_MUL(x, c) (((x) * (c)) >> JPEG_IFAST_PREC)
+
+#define JPEG_IFAST_PASS(s0, s1, s2, s3, s4, s5, s6, s7) \
+  int32_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;          \
+  int32_t tmp10, tmp11, tmp12, tmp13;                              \
+  int32_t z5, z10, z11, z12, z13;                                  \
+                                                                   \
+  tmp10 = (s0) + (s4);                                             \
+  tmp11 = (s0) - (s4);                                             \
+  tmp13 = (s2) + (s6);                                             \
+  tmp12 = JPEG_IFAST_MUL((s2) - (s6), JPEG_IFAST_P_1_414213562) - tmp13; \
+                                                                   \
+  tmp0 = tmp10 + tmp13;                                            \
+  tmp3 = tmp10 - tmp13;                                            \
+  tmp1 = tmp11 + tmp12;                                            \
+  tmp2 = tmp11 - tmp12;                                            \
+                                                                   \
+  z13 = (s5) + (s3);                                               \
+  z10 = (s5) - (s3);                                               \
+  z11 = (s1) + (s7);                                               \
+  z12 = (s1) - (s7);                                               \
+                                                                   \
+  tmp7 = z11 + z13;                                                \
+  tmp11 = JPEG_IFAST_MUL(z11 - z13, JPEG_IFAST_P_1_414213562);     \
+                                                                   \
+  z5 = JPEG_IFAST_MUL(z10 + z12, JPEG_IFAST_P_1_847759065);        \
+  tmp10 = JPEG_IFAST_MUL(z12, JPEG_IFAST_P_1_082392200) - z5;      \
+  tmp12 = JPEG_IFAST_MUL(z10, -JPEG_IFAST_P_2_613125930) + z5;     \
+                                                                   \
+  tmp6 = tmp12 - tmp7;                                             \
+  tmp5 = tmp11 - tmp6;                                             \
+  tmp4 = tmp10 + tmp5;
+
+void dejpeg_idct_ifast_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  uint32_t i;
+  int32_t* tmp;
+  int32_t tmpData[64];
+
+  for (i = 0, tmp = tmpData; i < 8; i++, src++, tmp++, qTable++) {
+    // Avoid dequantizing and IDCTing zeros.
+    if (src[8] == 0 && src[16] == 0 && src[24] == 0 && src[32] == 0 && src[40] == 0 && src[48] == 0 && src[56] == 0) {
+      int32_t dcTerm = static_cast<int32_t>(src[0]) * static_cast<int32_t>(qTable[0]);
+      tmp[0] = tmp[8] = tmp[16] = tmp[24] = tmp[32] = tmp[40] = tmp[48] = tmp[56] = dcTerm;
+    }
+    else {
+      JPEG_IFAST_PASS(
+        static_cast<int32_t>(src[ 0]) * static_cast<int32_t>(qTable[ 0]),
+        static_cast<int32_t>(src[ 8]) * static_cast<int32_t>(qTable[ 8]),
+        static_cast<int32_t>(src[16]) * static_cast<int32_t>(qTable[16]),
+        static_cast<int32_t>(src[24]) * static_cast<int32_t>(qTable[24]),
+        static_cast<int32_t>(src[32]) * static_cast<int32_t>(qTable[32]),
+        static_cast<int32_t>(src[40]) * static_cast<int32_t>(qTable[40]),
+        static_cast<int32_t>(src[48]) * static_cast<int32_t>(qTable[48]),
+        static_cast<int32_t>(src[56]) * static_cast<int32_t>(qTable[56]))
+
+      tmp[ 0] = tmp0 + tmp7;
+      tmp[56] = tmp0 - tmp7;
+      tmp[ 8] = tmp1 + tmp6;
+      tmp[48] = tmp1 - tmp6;
+      tmp[16] = tmp2 + tmp5;
+      tmp[40] = tmp2 - tmp5;
+      tmp[32] = tmp3 + tmp4;
+      tmp[24] = tmp3 - tmp4;
+    }
+  }
+
+  // The bias is added to the DC term of each row, which contributes to all 8
+  // outputs without being multiplied.
+  for (i = 0, tmp = tmpData; i < 8; i++, dst += dstStride, tmp += 8) {
+    JPEG_IFAST_PASS(tmp[0] + JPEG_IFAST_ROW_BIAS, tmp[1], tmp[2], tmp[3], tmp[4], tmp[5], tmp[6], tmp[7])
+
+    dst[0] = clampToByte((tmp0 + tmp7) >> JPEG_IFAST_ROW_NORM);
+    dst[7] = clampToByte((tmp0 - tmp7) >> JPEG_IFAST_ROW_NORM);
+    dst[1] = clampToByte((tmp1 + tmp6) >> JPEG_IFAST_ROW_NORM);
+    dst[6] = clampToByte((tmp1 - tmp6) >> JPEG_IFAST_ROW_NORM);
+    dst[2] = clampToByte((tmp2 + tmp5) >> JPEG_IFAST_ROW_NORM);
+    dst[5] = clampToByte((tmp2 - tmp5) >> JPEG_IFAST_ROW_NORM);
+    dst[4] = clampToByte((tmp3 + tmp4) >> JPEG_IFAST_ROW_NORM);
+    dst[3] = clampToByte((tmp3 - tmp4) >> JPEG_IFAST_ROW_NORM);
+  }
+}
+
+void dejpeg_idct_ifast_batch_ref(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++, src += 64)
+    dejpeg_idct_ifast_ref(dst[i], dstStride, src, qTables + static_cast<uint32_t>(qIndex[i]) * 64);
+}
+
+// ============================================================================
+// [IDCT ZigZag - Ref]
+// ============================================================================
+
+void dejpeg_idct_islow_zigzag_ref(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  const uint8_t* table = dejpeg_dezigzag_table;
+
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, quant[64], 16);
+
+  for (unsigned int i = 0; i < 64; i++) {
+    coeff[table[i]] = src[i];
+    quant[table[i]] = qTable[i];
+  }
+
+  dejpeg_idct_islow_ref(dst, dstStride, coeff, quant);
+}
+
+// ============================================================================
+// [Upsample - Ref]
+// ============================================================================
+
+void dejpeg_upsample_h2v1_ref(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    dst[0] = src[i];
+    dst[1] = src[i];
+    dst += 2;
+  }
+}
+
+void dejpeg_upsample_h2v2_ref(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count) {
+  (void)srcPrev;
+  (void)srcNext;
+
+  dejpeg_upsample_h2v1_ref(dst0, src, count);
+  dejpeg_upsample_h2v1_ref(dst1, src, count);
+}
+
+void dejpeg_upsample_h2v1_fancy_ref(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  dejpeg_upsample_h2v1_fancy_span(dst, src, 0, count, count);
+}
+
+void dejpeg_upsample_h2v2_fancy_ref(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count) {
+  dejpeg_upsample_h2v2_fancy_span(dst0, srcPrev, src, 0, count, count);
+  dejpeg_upsample_h2v2_fancy_span(dst1, srcNext, src, 0, count, count);
+}
+
 // ============================================================================
 // [YCbCrToRGB32]
 // ============================================================================
 
+template<uint32_t kFormat>
+static SIMD_INLINE void dejpeg_ycbcr_convert_ref_template(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  const uint32_t bpp = dejpeg_pixel_format_size(kFormat);
+
+  for (uint32_t i = 0; i < count; i++) {
+    dejpeg_ycbcr_to_pixel<kFormat>(dst, pY[i], pCb[i], pCr[i]);
+    dst += bpp;
+  }
+}
+
 void dejpeg_ycbcr_to_rgb32_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_ref_template<kJpegPixelRGB32>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_rgb24_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_ref_template<kJpegPixelRGB24>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_bgr24_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_ref_template<kJpegPixelBGR24>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_rgba32_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_ref_template<kJpegPixelRGBA32>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_argb32_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_ref_template<kJpegPixelARGB32>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_rgb565_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_ref_template<kJpegPixelRGB565>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_gray8_ref(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_ref_template<kJpegPixelGray8>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_rgb32_vec_scalar(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_to_rgb32_vec(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_h2v2_to_rgb32_ref(uint8_t* dst0, uint8_t* dst1, const uint8_t* pY0, const uint8_t* pY1, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
   for (uint32_t i = 0; i < count; i++) {
-    int yy = (static_cast<int>(pY[i]) << JPEG_YCBCR_PREC) + (1 << (JPEG_YCBCR_PREC - 1));
-    int cr = static_cast<int>(pCr[i]) - 128;
-    int cb = static_cast<int>(pCb[i]) - 128;
+    int cb = pCb[i >> 1];
+    int cr = pCr[i >> 1];
+
+    reinterpret_cast<uint32_t*>(dst0)[i] = dejpeg_ycbcr_to_rgb32_pixel(pY0[i], cb, cr);
+    reinterpret_cast<uint32_t*>(dst1)[i] = dejpeg_ycbcr_to_rgb32_pixel(pY1[i], cb, cr);
+  }
+}
+
+// ============================================================================
+// [Huffman - Ref]
+// ============================================================================
+
+bool dejpeg_huff_build(DeJpegHuffTable* table, const uint8_t* counts, const uint8_t* values) {
+  uint32_t i, k = 0;
+  uint32_t code = 0;
+
+  uint8_t sizes[256];
+  uint16_t codes[256];
+
+  ::memset(table->fast, 0, sizeof(table->fast));
+  ::memset(table->lookup, 0, sizeof(table->lookup));
+
+  // Generate canonical codes as described by C.2.
+  for (i = 1; i <= 16; i++) {
+    uint32_t n = counts[i - 1];
+    if (k + n > 256)
+      return false;
+
+    table->valOffset[i] = static_cast<int32_t>(k) - static_cast<int32_t>(code);
+    for (uint32_t j = 0; j < n; j++, k++) {
+      sizes[k] = static_cast<uint8_t>(i);
+      codes[k] = static_cast<uint16_t>(code++);
+    }
+
+    if (code > (1U << i))
+      return false;
+
+    table->maxCode[i] = code << (16 - i);
+    code <<= 1;
+  }
+
+  table->maxCode[0] = 0;
+  table->maxCode[17] = 0xFFFFFFFFU;
+  table->valOffset[0] = 0;
+
+  ::memset(table->values, 0, sizeof(table->values));
+  ::memcpy(table->values, values, k);
+
+  // Fill the lookahead tables. Each code of length `len` occupies all entries
+  // that start with it, which is `1 << (JPEG_HUFF_LOOKUP_BITS - len)` entries.
+  for (i = 0; i < k; i++) {
+    uint32_t len = sizes[i];
+    if (len > JPEG_HUFF_LOOKUP_BITS)
+      break;
+
+    uint32_t symbol = values[i];
+    uint32_t s = symbol & 15;
+    uint32_t shift = JPEG_HUFF_LOOKUP_BITS - len;
+    uint32_t first = static_cast<uint32_t>(codes[i]) << shift;
+
+    for (uint32_t j = 0; j < (1U << shift); j++) {
+      uint32_t index = first + j;
+      table->lookup[index] = static_cast<uint16_t>((len << 8) | symbol);
 
-    int r = yy + cr * JPEG_YCBCR_FIXED(1.40200);
-    int g = yy - cr * JPEG_YCBCR_FIXED(0.71414) - cb * JPEG_YCBCR_FIXED(0.34414);
-    int b = yy + cb * JPEG_YCBCR_FIXED(1.77200);
+      if (len + s <= JPEG_HUFF_LOOKUP_BITS) {
+        int32_t v = 0;
+        if (s) {
+          uint32_t extra = (index >> (shift - s)) & ((1U << s) - 1);
+          v = dejpeg_huff_extend(extra, s);
+        }
+        table->fast[index] = (static_cast<uint32_t>(v) << 16) | (symbol << 8) | (len + s);
+      }
+    }
+  }
+
+  return true;
+}
+
+size_t dejpeg_huff_unstuff_ref(uint8_t* dst, const uint8_t* src, size_t size, size_t* consumed) {
+  uint8_t* dstStart = dst;
+  const uint8_t* srcStart = src;
+  const uint8_t* srcEnd = src + size;
+
+  while (src != srcEnd) {
+    uint8_t b = *src;
+
+    if (b == 0xFF) {
+      if (srcEnd - src < 2 || src[1] != 0x00)
+        break;
+      src++;
+    }
+
+    *dst++ = b;
+    src++;
+  }
+
+  ::memset(dst, 0, JPEG_HUFF_PADDING);
+  *consumed = static_cast<size_t>(src - srcStart);
+  return static_cast<size_t>(dst - dstStart);
+}
+
+uint32_t dejpeg_huff_decode_block(DeJpegBitReader* br, int16_t* dst, const DeJpegHuffTable* dcTable, const DeJpegHuffTable* acTable, int32_t* dcPred) {
+  const uint8_t* table = dejpeg_dezigzag_table;
+  ::memset(dst, 0, 64 * sizeof(int16_t));
+
+  // A single refill covers the longest symbol (16 bits) and its extra bits.
+  dejpeg_bits_refill(br);
+
+  int32_t v;
+  uint32_t e = dcTable->fast[dejpeg_bits_peek(br, JPEG_HUFF_LOOKUP_BITS)];
 
-    reinterpret_cast<uint32_t*>(dst)[0] = dejepeg_pack32(
-      static_cast<uint8_t>(0xFF),
-      clampToByte(r >> JPEG_YCBCR_PREC),
-      clampToByte(g >> JPEG_YCBCR_PREC),
-      clampToByte(b >> JPEG_YCBCR_PREC));
-    dst += 4;
+  if (e) {
+    dejpeg_bits_consume(br, e & 0xFF);
+    v = static_cast<int32_t>(e) >> 16;
   }
+  else {
+    uint32_t s = dejpeg_huff_decode_slow(br, dcTable);
+    if (s > 15)
+      return JPEG_HUFF_INVALID;
+    v = dejpeg_huff_receive(br, s);
+  }
+
+  *dcPred += v;
+  dst[0] = static_cast<int16_t>(*dcPred);
+
+  uint32_t eob = 0;
+  for (uint32_t k = 1; k < 64; k++) {
+    uint32_t rs;
+
+    dejpeg_bits_refill(br);
+    e = acTable->fast[dejpeg_bits_peek(br, JPEG_HUFF_LOOKUP_BITS)];
+
+    if (e) {
+      dejpeg_bits_consume(br, e & 0xFF);
+      rs = (e >> 8) & 0xFF;
+      v = static_cast<int32_t>(e) >> 16;
+    }
+    else {
+      rs = dejpeg_huff_decode_slow(br, acTable);
+      if (rs == JPEG_HUFF_INVALID)
+        return JPEG_HUFF_INVALID;
+      v = dejpeg_huff_receive(br, rs & 15);
+    }
+
+    // EOB, ZRL (0xF0) is handled as a run of 15 zeros followed by a zero.
+    if (rs == 0)
+      break;
+
+    k += rs >> 4;
+    if (k > 63)
+      return JPEG_HUFF_INVALID;
+
+    if (rs & 15) {
+      dst[table[k]] = static_cast<int16_t>(v);
+      eob = k;
+    }
+  }
+
+  return eob;
+}
+
+// ============================================================================
+// [Progressive - Ref]
+// ============================================================================
+
+uint64_t dejpeg_block_nonzero_mask_ref(const int16_t* block) {
+  uint64_t mask = 0;
+  for (uint32_t i = 0; i < 64; i++)
+    mask |= static_cast<uint64_t>(block[i] != 0) << i;
+  return mask;
+}
+
+// ============================================================================
+// [RGB32ToYCbCr - Ref]
+// ============================================================================
+
+void dejpeg_rgb32_to_ycbcr_ref(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, const uint8_t* src, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++)
+    dejpeg_rgb32_to_ycbcr_pixel(pY + i, pCb + i, pCr + i, reinterpret_cast<const uint32_t*>(src)[i]);
+}
+
+// ============================================================================
+// [Downsample - Ref]
+// ============================================================================
+
+void dejpeg_downsample_h2v1_ref(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  dejpeg_downsample_h2v1_span(dst, src, 0, count);
+}
+
+void dejpeg_downsample_h2v2_ref(uint8_t* dst, const uint8_t* src0, const uint8_t* src1, uint32_t count) {
+  dejpeg_downsample_h2v2_span(dst, src0, src1, 0, count);
+}
+
+// ============================================================================
+// [FDCT - Ref]
+// ============================================================================
+
+// All outputs are calculated as `(sum(x * c) + bias) >> norm`, like SIMD
+// versions do. DC and the 4th coefficient use `c = 1 << JPEG_FDCT_PREC`,
+// which is the same as libjpeg's `x << PASS1_BITS` in the first pass and
+// `DESCALE(x, PASS1_BITS)` in the second pass.
+static SIMD_INLINE void dejpeg_fdct_pass_ref(int32_t* data, intptr_t step, intptr_t next, int32_t bias, int norm) {
+  for (uint32_t i = 0; i < 8; i++, data += next) {
+    int32_t tmp0 = data[0] + data[7 * step];
+    int32_t tmp7 = data[0] - data[7 * step];
+    int32_t tmp1 = data[1 * step] + data[6 * step];
+    int32_t tmp6 = data[1 * step] - data[6 * step];
+    int32_t tmp2 = data[2 * step] + data[5 * step];
+    int32_t tmp5 = data[2 * step] - data[5 * step];
+    int32_t tmp3 = data[3 * step] + data[4 * step];
+    int32_t tmp4 = data[3 * step] - data[4 * step];
+
+    int32_t tmp10 = tmp0 + tmp3;
+    int32_t tmp13 = tmp0 - tmp3;
+    int32_t tmp11 = tmp1 + tmp2;
+    int32_t tmp12 = tmp1 - tmp2;
+
+    int32_t z1 = (tmp12 + tmp13) * JPEG_FDCT_P_0_541196100;
+
+    data[0] = ((tmp10 + tmp11) * (1 << JPEG_FDCT_PREC) + bias) >> norm;
+    data[4 * step] = ((tmp10 - tmp11) * (1 << JPEG_FDCT_PREC) + bias) >> norm;
+    data[2 * step] = (z1 + tmp13 * JPEG_FDCT_P_0_765366865 + bias) >> norm;
+    data[6 * step] = (z1 - tmp12 * JPEG_FDCT_P_1_847759065 + bias) >> norm;
+
+    z1 = tmp4 + tmp7;
+    int32_t z2 = tmp5 + tmp6;
+    int32_t z3 = tmp4 + tmp6;
+    int32_t z4 = tmp5 + tmp7;
+    int32_t z5 = (z3 + z4) * JPEG_FDCT_P_1_175875602;
+
+    tmp4 *= JPEG_FDCT_P_0_298631336;
+    tmp5 *= JPEG_FDCT_P_2_053119869;
+    tmp6 *= JPEG_FDCT_P_3_072711026;
+    tmp7 *= JPEG_FDCT_P_1_501321110;
+
+    z1 *= -JPEG_FDCT_P_0_899976223;
+    z2 *= -JPEG_FDCT_P_2_562915447;
+    z3 = z3 * -JPEG_FDCT_P_1_961570560 + z5;
+    z4 = z4 * -JPEG_FDCT_P_0_390180644 + z5;
+
+    data[7 * step] = (tmp4 + z1 + z3 + bias) >> norm;
+    data[5 * step] = (tmp5 + z2 + z4 + bias) >> norm;
+    data[3 * step] = (tmp6 + z2 + z3 + bias) >> norm;
+    data[1 * step] = (tmp7 + z1 + z4 + bias) >> norm;
+  }
+}
+
+void dejpeg_fdct_islow_divisors(uint16_t* dst, const uint16_t* qTable) {
+  for (uint32_t i = 0; i < 64; i++) {
+    uint32_t d = static_cast<uint32_t>(qTable[i]) * 8;
+
+    uint32_t b = 0;
+    while ((d >> (b + 1)) != 0)
+      b++;
+
+    uint32_t r = 16 + b;
+    uint32_t fq = (1u << r) / d;
+    uint32_t fr = (1u << r) % d;
+    uint32_t c = d / 2;
+
+    // Power of two divisors would need a 17-bit reciprocal, use one bit less.
+    if (fr == 0) {
+      fq >>= 1;
+      r--;
+    }
+    else if (fr <= d / 2) {
+      c++;
+    }
+    else {
+      fq++;
+    }
+
+    dst[i      ] = static_cast<uint16_t>(fq);
+    dst[i +  64] = static_cast<uint16_t>(c);
+    dst[i + 128] = static_cast<uint16_t>(1u << (32 - r));
+  }
+}
+
+void dejpeg_fdct_islow_ref(int16_t* dst, const uint8_t* src, intptr_t srcStride, const uint16_t* divisors) {
+  int32_t tmp[64];
+
+  for (uint32_t y = 0; y < 8; y++, src += srcStride)
+    for (uint32_t x = 0; x < 8; x++)
+      tmp[y * 8 + x] = static_cast<int32_t>(src[x]) - 128;
+
+  dejpeg_fdct_pass_ref(tmp, 1, 8, 1 << (JPEG_FDCT_ROW_NORM - 1), JPEG_FDCT_ROW_NORM);
+  dejpeg_fdct_pass_ref(tmp, 8, 1, 1 << (JPEG_FDCT_COL_NORM - 1), JPEG_FDCT_COL_NORM);
+
+  for (uint32_t i = 0; i < 64; i++) {
+    int32_t x = tmp[i];
+    uint32_t a = static_cast<uint32_t>(x < 0 ? -x : x) + divisors[i + 64];
+
+    a = (a * divisors[i]) >> 16;
+    a = (a * divisors[i + 128]) >> 16;
+
+    dst[i] = static_cast<int16_t>(x < 0 ? -static_cast<int32_t>(a) : static_cast<int32_t>(a));
+  }
+}
+
+// ============================================================================
+// [ZigZag - Ref]
+// ============================================================================
+
+void dejpeg_zigzag_ref(int16_t* dst, const int16_t* src) {
+  const uint8_t* table = dejpeg_dezigzag_table;
+
+  for (unsigned int i = 0; i < 64; i++)
+    dst[i] = src[table[i]];
+}
+
+// ============================================================================
+// [Dispatch]
+// ============================================================================
+
+static const SimdVariant<DeJpegIDCTFunc> dejpeg_idct_islow_variants[] = {
+  { kSimdTierRef , "islow-ref" , dejpeg_idct_islow_ref  },
+  { kSimdTierSSE2, "islow-sse2", dejpeg_idct_islow_sse2 },
+  { kSimdTierAVX2, "islow-avx2", dejpeg_idct_islow_avx2 }
+};
+
+const SimdVariant<DeJpegIDCTFunc>* dejpeg_idct_islow_dispatch(void) {
+  static const SimdVariant<DeJpegIDCTFunc>* selected;
+
+  if (selected == NULL)
+    selected = SimdCpu::select(dejpeg_idct_islow_variants, sizeof(dejpeg_idct_islow_variants) / sizeof(dejpeg_idct_islow_variants[0]));
+  return selected;
 }
@@ -7,20 +7,43 @@
 
 #include "../simdglobals.h"
 #include "./dejpeg.h"
+#include "./dejpeg_vec.h"
+#include "./dejpeg_xmm.h"
 
 // ============================================================================
 // [IDCT - SSE2]
 // ============================================================================
 
 struct DeJPEG_SSE2Consts {
-  // IDCT.
-  int16_t rot0_0[8], rot0_1[8];
-  int16_t rot1_0[8], rot1_1[8];
-  int16_t rot2_0[8], rot2_1[8];
-  int16_t rot3_0[8], rot3_1[8];
+  // IDCT (sparse) - rotations folded for blocks having only 4 rows/columns.
+  int16_t sparse_x0[8], sparse_x1[8], sparse_x2[8], sparse_x3[8];
+  int16_t sparse_x4[8], sparse_x5[8], sparse_x6[8], sparse_x7[8];
 
-  int32_t colBias[4];
-  int32_t rowBias[4];
+  // IDCT (scaled 4x4).
+  int16_t s4_even[8];
+  int16_t s4_odd0_75[8], s4_odd0_31[8];
+  int16_t s4_odd2_75[8], s4_odd2_31[8];
+  int32_t s4_colBias[4];
+  int32_t s4_rowBias[4];
+
+  // IDCT (scaled 2x2).
+  int16_t s2_odd_75[8], s2_odd_31[8];
+  int16_t s2_rowPlus[8], s2_rowMinus[8];
+  int32_t s2_colBias[4];
+  int32_t s2_rowBias[4];
+
+  // IDCT (fast).
+  int16_t ifast_1_414[8];
+  int16_t ifast_1_847[8];
+  int16_t ifast_1_082[8];
+  int16_t ifast_m2_613[8];
+  int16_t ifast_rowBias[8];
+
+  // Upsample.
+  int16_t upsample_1[8];
+  int16_t upsample_2[8];
+  int16_t upsample_7[8];
+  int16_t upsample_8[8];
 
   // YCbCr.
   int32_t ycbcr_allones[4];
@@ -29,107 +52,500 @@ struct DeJPEG_SSE2Consts {
   int16_t ycbcr_yycrMul[8];
   int16_t ycbcr_yycbMul[8];
   int16_t ycbcr_cbcrMul[8];
+  int16_t ycbcr_crMulRound[8];
+  int16_t ycbcr_cbMulRound[8];
+  int16_t ycbcr_one[8];
+  uint32_t ycbcr_pack24_lo[4];
+  uint32_t ycbcr_pack24_hi[4];
+  int16_t ycbcr_565r[8];
+  int16_t ycbcr_565g[8];
+
+  // RGB32ToYCbCr.
+  uint32_t rgbycc_maskBR[4];
+  uint32_t rgbycc_maskG[4];
+  uint32_t rgbycc_one[4];
+  int16_t rgbycc_yBR[8];
+  int16_t rgbycc_yG[8];
+  int16_t rgbycc_cbBR[8];
+  int16_t rgbycc_cbG[8];
+  int16_t rgbycc_crBR[8];
+  int16_t rgbycc_crG[8];
+  uint32_t rgbycc_tounsigned[4];
+
+  // Downsample.
+  int16_t downsample_mask[8];
+  int16_t downsample_bias01[8];
+  int16_t downsample_bias12[8];
+
+  // FDCT.
+  int16_t fdct_center[8];
+  int16_t fdct_even0[8], fdct_even1[8];
+  int16_t fdct_even2[8], fdct_even3[8];
+  int16_t fdct_odd0[8], fdct_odd1[8];
+  int16_t fdct_odd2[8], fdct_odd3[8];
+  int16_t fdct_odd4[8], fdct_odd5[8];
+  int32_t fdct_rowBias[4];
+  int32_t fdct_colBias[4];
 };
 
 #define DATA_4X(...) { __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__ }
 SIMD_ALIGN_VAR(static const DeJPEG_SSE2Consts, dejpeg_sse2_consts, 16) = {
-  DATA_4X(JPEG_IDCT_P_0_541196100                          , JPEG_IDCT_P_0_541196100 + JPEG_IDCT_M_1_847759065),
-  DATA_4X(JPEG_IDCT_P_0_541196100 + JPEG_IDCT_P_0_765366865, JPEG_IDCT_P_0_541196100                          ),
-  DATA_4X(JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_0_899976223, JPEG_IDCT_P_1_175875602                          ),
-  DATA_4X(JPEG_IDCT_P_1_175875602                          , JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_2_562915447),
-  DATA_4X(JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_0_298631336, JPEG_IDCT_M_1_961570560                          ),
-  DATA_4X(JPEG_IDCT_M_1_961570560                          , JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_3_072711026),
-  DATA_4X(JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_2_053119869, JPEG_IDCT_M_0_390180644                          ),
-  DATA_4X(JPEG_IDCT_M_0_390180644                          , JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_1_501321110),
-  DATA_4X(JPEG_IDCT_COL_BIAS),
-  DATA_4X(JPEG_IDCT_ROW_BIAS),
+  DATA_4X( JPEG_IDCT_SCALE(1), JPEG_IDCT_P_0_541196100 + JPEG_IDCT_P_0_765366865),
+  DATA_4X( JPEG_IDCT_SCALE(1), JPEG_IDCT_P_0_541196100                          ),
+  DATA_4X( JPEG_IDCT_SCALE(1),-JPEG_IDCT_P_0_541196100                          ),
+  DATA_4X( JPEG_IDCT_SCALE(1),-JPEG_IDCT_P_0_541196100 - JPEG_IDCT_P_0_765366865),
+  DATA_4X(JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_0_899976223, JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_1_961570560),
+  DATA_4X(JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_0_390180644, JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_2_562915447),
+  DATA_4X(JPEG_IDCT_P_1_175875602, JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_2_562915447 + JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_3_072711026),
+  DATA_4X(JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_0_899976223 + JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_1_501321110, JPEG_IDCT_P_1_175875602),
+
+  DATA_4X(JPEG_IDCT_P_1_847759065, JPEG_IDCT_M_0_765366865),
+  DATA_4X(JPEG_IDCT_M_0_211164243, JPEG_IDCT_P_1_451774981),
+  DATA_4X(JPEG_IDCT_M_2_172734803, JPEG_IDCT_P_1_061594337),
+  DATA_4X(JPEG_IDCT_M_0_509795579, JPEG_IDCT_M_0_601344887),
+  DATA_4X(JPEG_IDCT_P_0_899976223, JPEG_IDCT_P_2_562915447),
+  DATA_4X(JPEG_IDCT_4X4_COL_BIAS),
+  DATA_4X(JPEG_IDCT_4X4_ROW_BIAS),
+
+  DATA_4X(JPEG_IDCT_M_0_720959822, JPEG_IDCT_P_0_850430095),
+  DATA_4X(JPEG_IDCT_M_1_272758580, JPEG_IDCT_P_3_624509785),
+  { JPEG_IDCT_SCALE(4),  JPEG_IDCT_P_3_624509785, 0,  JPEG_IDCT_M_1_272758580, 0,  JPEG_IDCT_P_0_850430095, 0,  JPEG_IDCT_M_0_720959822 },
+  { JPEG_IDCT_SCALE(4), -JPEG_IDCT_P_3_624509785, 0, -JPEG_IDCT_M_1_272758580, 0, -JPEG_IDCT_P_0_850430095, 0, -JPEG_IDCT_M_0_720959822 },
+  DATA_4X(JPEG_IDCT_2X2_COL_BIAS),
+  DATA_4X(JPEG_IDCT_2X2_ROW_BIAS),
+
+  DATA_4X(JPEG_IFAST_MULHI(JPEG_IFAST_P_1_414213562 - 256), JPEG_IFAST_MULHI(JPEG_IFAST_P_1_414213562 - 256)),
+  DATA_4X(JPEG_IFAST_MULHI(JPEG_IFAST_P_1_847759065 - 256), JPEG_IFAST_MULHI(JPEG_IFAST_P_1_847759065 - 256)),
+  DATA_4X(JPEG_IFAST_MULHI(JPEG_IFAST_P_1_082392200 - 256), JPEG_IFAST_MULHI(JPEG_IFAST_P_1_082392200 - 256)),
+  DATA_4X(JPEG_IFAST_MULHI(768 - JPEG_IFAST_P_2_613125930), JPEG_IFAST_MULHI(768 - JPEG_IFAST_P_2_613125930)),
+  DATA_4X(JPEG_IFAST_ROW_BIAS, JPEG_IFAST_ROW_BIAS),
+
+  DATA_4X(1, 1),
+  DATA_4X(2, 2),
+  DATA_4X(7, 7),
+  DATA_4X(8, 8),
 
   DATA_4X(-1),
   DATA_4X(-128, -128),
   DATA_4X(1 << (JPEG_YCBCR_PREC - 1)),
   DATA_4X( JPEG_YCBCR_FIXED(1.00000),  JPEG_YCBCR_FIXED(1.40200)),
   DATA_4X( JPEG_YCBCR_FIXED(1.00000),  JPEG_YCBCR_FIXED(1.77200)),
-  DATA_4X(-JPEG_YCBCR_FIXED(0.34414), -JPEG_YCBCR_FIXED(0.71414))
+  DATA_4X(-JPEG_YCBCR_FIXED(0.34414), -JPEG_YCBCR_FIXED(0.71414)),
+  DATA_4X( JPEG_YCBCR_FIXED(1.40200), 1 << (JPEG_YCBCR_PREC - 1)),
+  DATA_4X( JPEG_YCBCR_FIXED(1.77200), 1 << (JPEG_YCBCR_PREC - 1)),
+  DATA_4X(1, 1),
+  { 0x00FFFFFFU, 0x00000000U, 0x00FFFFFFU, 0x00000000U },
+  { 0xFF000000U, 0x0000FFFFU, 0xFF000000U, 0x0000FFFFU },
+  DATA_4X(0xF8, 0xF8),
+  DATA_4X(0xFC, 0xFC),
+
+  DATA_4X(0x00FF00FFU),
+  DATA_4X(0x000000FFU),
+  DATA_4X(0x00010000U),
+  DATA_4X( JPEG_RGB_YCC_FIXED(0.11400),  JPEG_RGB_YCC_FIXED(0.29900)),
+  DATA_4X( JPEG_RGB_YCC_FIXED(0.58700),  JPEG_RGB_YCC_Y_BIAS),
+  DATA_4X( JPEG_RGB_YCC_FIXED(0.50000), -JPEG_RGB_YCC_FIXED(0.16874)),
+  DATA_4X(-JPEG_RGB_YCC_FIXED(0.33126),  JPEG_RGB_YCC_C_BIAS),
+  DATA_4X(-JPEG_RGB_YCC_FIXED(0.08131),  JPEG_RGB_YCC_FIXED(0.50000)),
+  DATA_4X(-JPEG_RGB_YCC_FIXED(0.41869),  JPEG_RGB_YCC_C_BIAS),
+  DATA_4X(0x80808080U),
+
+  DATA_4X(0x00FF, 0x00FF),
+  DATA_4X(0, 1),
+  DATA_4X(1, 2),
+
+  DATA_4X(128, 128),
+  DATA_4X(JPEG_FDCT_FIXED(1)                               , JPEG_FDCT_FIXED(1)                               ),
+  DATA_4X(JPEG_FDCT_FIXED(1)                               ,-JPEG_FDCT_FIXED(1)                              ),
+  DATA_4X(JPEG_FDCT_P_0_541196100 + JPEG_FDCT_P_0_765366865, JPEG_FDCT_P_0_541196100                          ),
+  DATA_4X(JPEG_FDCT_P_0_541196100                          , JPEG_FDCT_P_0_541196100 - JPEG_FDCT_P_1_847759065),
+  DATA_4X(JPEG_FDCT_P_0_298631336 - JPEG_FDCT_P_0_899976223,-JPEG_FDCT_P_0_899976223                          ),
+  DATA_4X(-JPEG_FDCT_P_0_899976223                         , JPEG_FDCT_P_1_501321110 - JPEG_FDCT_P_0_899976223),
+  DATA_4X(JPEG_FDCT_P_2_053119869 - JPEG_FDCT_P_2_562915447,-JPEG_FDCT_P_2_562915447                          ),
+  DATA_4X(-JPEG_FDCT_P_2_562915447                         , JPEG_FDCT_P_3_072711026 - JPEG_FDCT_P_2_562915447),
+  DATA_4X(JPEG_FDCT_P_1_175875602 - JPEG_FDCT_P_1_961570560, JPEG_FDCT_P_1_175875602                          ),
+  DATA_4X(JPEG_FDCT_P_1_175875602                          , JPEG_FDCT_P_1_175875602 - JPEG_FDCT_P_0_390180644),
+  DATA_4X(1 << (JPEG_FDCT_ROW_NORM - 1)),
+  DATA_4X(1 << (JPEG_FDCT_COL_NORM - 1))
 };
 #undef DATA_4X
 
 #define JPEG_CONST_XMM(x) (*(const __m128i*)(dejpeg_sse2_consts.x))
 
-#define JPEG_IDCT_INTERLEAVE8_XMM(a, b) { __m128i t = a; a = _mm_unpacklo_epi8(a, b); b = _mm_unpackhi_epi8(t, b); }
-#define JPEG_IDCT_INTERLEAVE16_XMM(a, b) { __m128i t = a; a = _mm_unpacklo_epi16(a, b); b = _mm_unpackhi_epi16(t, b); }
+static SIMD_INLINE void dejpeg_idct_islow_sse2_block(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  // Load and dequantize.
+  __m128i row0 = _mm_mullo_epi16(*(const __m128i *)(src +  0), *(const __m128i *)(qTable +  0));
+  __m128i row1 = _mm_mullo_epi16(*(const __m128i *)(src +  8), *(const __m128i *)(qTable +  8));
+  __m128i row2 = _mm_mullo_epi16(*(const __m128i *)(src + 16), *(const __m128i *)(qTable + 16));
+  __m128i row3 = _mm_mullo_epi16(*(const __m128i *)(src + 24), *(const __m128i *)(qTable + 24));
+  __m128i row4 = _mm_mullo_epi16(*(const __m128i *)(src + 32), *(const __m128i *)(qTable + 32));
+  __m128i row5 = _mm_mullo_epi16(*(const __m128i *)(src + 40), *(const __m128i *)(qTable + 40));
+  __m128i row6 = _mm_mullo_epi16(*(const __m128i *)(src + 48), *(const __m128i *)(qTable + 48));
+  __m128i row7 = _mm_mullo_epi16(*(const __m128i *)(src + 56), *(const __m128i *)(qTable + 56));
 
-// out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
-// out(1) = c1[even]*x + c1[odd]*y
-#define JPEG_IDCT_ROTATE_XMM(dst0, dst1, x, y, c0, c1) \
-  __m128i c0##_l = _mm_unpacklo_epi16(x, y); \
-  __m128i c0##_h = _mm_unpackhi_epi16(x, y); \
-  \
-  __m128i dst0##_l = _mm_madd_epi16(c0##_l, JPEG_CONST_XMM(c0)); \
-  __m128i dst0##_h = _mm_madd_epi16(c0##_h, JPEG_CONST_XMM(c0)); \
-  __m128i dst1##_l = _mm_madd_epi16(c0##_l, JPEG_CONST_XMM(c1)); \
-  __m128i dst1##_h = _mm_madd_epi16(c0##_h, JPEG_CONST_XMM(c1));
-
-// out = in << 12  (in 16-bit, out 32-bit)
-#define JPEG_IDCT_WIDEN_XMM(dst, in) \
-  __m128i dst##_l = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), (in)), 4); \
-  __m128i dst##_h = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), (in)), 4);
-
-// wide add
-#define JPEG_IDCT_WADD_XMM(dst, a, b) \
-  __m128i dst##_l = _mm_add_epi32(a##_l, b##_l); \
-  __m128i dst##_h = _mm_add_epi32(a##_h, b##_h);
-
-// wide sub
-#define JPEG_IDCT_WSUB_XMM(dst, a, b) \
-  __m128i dst##_l = _mm_sub_epi32(a##_l, b##_l); \
-  __m128i dst##_h = _mm_sub_epi32(a##_h, b##_h);
-
-// butterfly a/b, add bias, then shift by `norm` and pack to 16-bit.
-#define JPEG_IDCT_BFLY_XMM(dst0, dst1, a, b, bias, norm) { \
-  __m128i abiased_l = _mm_add_epi32(a##_l, bias); \
-  __m128i abiased_h = _mm_add_epi32(a##_h, bias); \
-  \
-  JPEG_IDCT_WADD_XMM(sum, abiased, b) \
-  JPEG_IDCT_WSUB_XMM(diff, abiased, b) \
-  \
-  dst0 = _mm_packs_epi32(_mm_srai_epi32(sum_l, norm), _mm_srai_epi32(sum_h, norm)); \
-  dst1 = _mm_packs_epi32(_mm_srai_epi32(diff_l, norm), _mm_srai_epi32(diff_h, norm)); \
+  // IDCT columns.
+  JPEG_IDCT_IDCT_PASS_XMM(JPEG_IDCT_CONST_XMM(colBias), 10)
+
+  // Transpose.
+  JPEG_IDCT_TRANSPOSE_XMM()
+
+  // IDCT rows.
+  JPEG_IDCT_IDCT_PASS_XMM(JPEG_IDCT_CONST_XMM(rowBias), 17)
+
+  dejpeg_idct_store_sse2(dst, dstStride, row0, row1, row2, row3, row4, row5, row6, row7);
+}
+
+void dejpeg_idct_islow_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  dejpeg_idct_islow_sse2_block(dst, dstStride, src, qTable);
+}
+
+// The block kernel is inlined into the loop so the compiler can keep the
+// IDCT constants in registers across blocks. The next block is prefetched
+// while the current one is being transformed.
+void dejpeg_idct_islow_batch_sse2(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++, src += 64) {
+    _mm_prefetch(reinterpret_cast<const char*>(src + 64), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(src + 96), _MM_HINT_T0);
+    dejpeg_idct_islow_sse2_block(dst[i], dstStride, src, qTables + static_cast<uint32_t>(qIndex[i]) * 64);
+  }
+}
+
+// ============================================================================
+// [IDCT (Sparse) - SSE2]
+// ============================================================================
+
+// Most blocks of a typical photo have only a DC term or a few low frequency
+// coefficients. Such blocks are handled by specialized kernels that skip all
+// multiplications by zero, but still produce exactly the same result as the
+// full transform (all additions and shifts are the same as in the full pass,
+// only the rotations are folded as some of their inputs are known zeros).
+
+// out(k) = (a(k) + bias +/- b(k)) >> norm  (32-bit, single register).
+#define JPEG_IDCT_SPARSE_BFLY_XMM(dst0, dst1, a, b, bias, norm) \
+  __m128i dst0 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(a, bias), b), norm); \
+  __m128i dst1 = _mm_srai_epi32(_mm_sub_epi32(_mm_add_epi32(a, bias), b), norm);
+
+// x0..x3 from interleaved (s0, s2) pairs and x4..x7 from (s1, s3) pairs.
+#define JPEG_IDCT_SPARSE_EVEN_XMM(sfx, e) \
+  __m128i x0##sfx = _mm_madd_epi16(e, JPEG_CONST_XMM(sparse_x0)); \
+  __m128i x1##sfx = _mm_madd_epi16(e, JPEG_CONST_XMM(sparse_x1)); \
+  __m128i x2##sfx = _mm_madd_epi16(e, JPEG_CONST_XMM(sparse_x2)); \
+  __m128i x3##sfx = _mm_madd_epi16(e, JPEG_CONST_XMM(sparse_x3));
+
+#define JPEG_IDCT_SPARSE_ODD_XMM(sfx, o) \
+  __m128i x4##sfx = _mm_madd_epi16(o, JPEG_CONST_XMM(sparse_x4)); \
+  __m128i x5##sfx = _mm_madd_epi16(o, JPEG_CONST_XMM(sparse_x5)); \
+  __m128i x6##sfx = _mm_madd_epi16(o, JPEG_CONST_XMM(sparse_x6)); \
+  __m128i x7##sfx = _mm_madd_epi16(o, JPEG_CONST_XMM(sparse_x7));
+
+void dejpeg_idct_islow_dconly_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  // Both passes reduce to a single multiplication by SCALE(1) and a shift, the
+  // column pass loses no bits (its bias is less than 1 << JPEG_IDCT_COL_NORM).
+  int32_t dc = static_cast<int32_t>(src[0]) * static_cast<int32_t>(qTable[0]);
+  int32_t pixel = ((dc << (JPEG_IDCT_PREC + 2)) + JPEG_IDCT_ROW_BIAS) >> JPEG_IDCT_ROW_NORM;
+
+  __m128i row = _mm_set1_epi8(static_cast<char>(clampToByte(pixel)));
+  for (uint32_t i = 0; i < 8; i++, dst += dstStride)
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), row);
+}
+
+// Handles blocks that have non-zero coefficients only in the top-left `kSize`
+// x `kSize` corner, where `kSize` is either 2 or 4.
+template<uint32_t kSize>
+static SIMD_INLINE void dejpeg_idct_islow_sparse_sse2_template(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  __m128i zero = _mm_setzero_si128();
+
+  // Load and dequantize the first 4 coefficients of rows 0..3, two rows per
+  // register: r01 = [row0 c0..c3 | row1 c0..c3], r23 = [row2 c0..c3 | row3 c0..c3].
+  __m128i r01 = _mm_mullo_epi16(
+    _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src +  0)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src +  8))),
+    _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(qTable + 0)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(qTable + 8))));
+
+  // IDCT columns 0..3 (32-bit, one register per output row).
+  __m128i col0, col1, col2, col3, col4, col5, col6, col7;
+  if (kSize == 2) {
+    __m128i x0 = _mm_srai_epi32(_mm_unpacklo_epi16(zero, r01), 4);
+    JPEG_IDCT_SPARSE_ODD_XMM(, _mm_unpackhi_epi16(r01, zero))
+
+    JPEG_IDCT_SPARSE_BFLY_XMM(c0, c7, x0, x7, JPEG_IDCT_CONST_XMM(colBias), 10)
+    JPEG_IDCT_SPARSE_BFLY_XMM(c1, c6, x0, x6, JPEG_IDCT_CONST_XMM(colBias), 10)
+    JPEG_IDCT_SPARSE_BFLY_XMM(c2, c5, x0, x5, JPEG_IDCT_CONST_XMM(colBias), 10)
+    JPEG_IDCT_SPARSE_BFLY_XMM(c3, c4, x0, x4, JPEG_IDCT_CONST_XMM(colBias), 10)
+
+    col0 = c0; col1 = c1; col2 = c2; col3 = c3;
+    col4 = c4; col5 = c5; col6 = c6; col7 = c7;
+  }
+  else {
+    __m128i r23 = _mm_mullo_epi16(
+      _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + 16)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + 24))),
+      _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(qTable + 16)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(qTable + 24))));
+
+    JPEG_IDCT_SPARSE_EVEN_XMM(, _mm_unpacklo_epi16(r01, r23))
+    JPEG_IDCT_SPARSE_ODD_XMM(, _mm_unpackhi_epi16(r01, r23))
+
+    JPEG_IDCT_SPARSE_BFLY_XMM(c0, c7, x0, x7, JPEG_IDCT_CONST_XMM(colBias), 10)
+    JPEG_IDCT_SPARSE_BFLY_XMM(c1, c6, x1, x6, JPEG_IDCT_CONST_XMM(colBias), 10)
+    JPEG_IDCT_SPARSE_BFLY_XMM(c2, c5, x2, x5, JPEG_IDCT_CONST_XMM(colBias), 10)
+    JPEG_IDCT_SPARSE_BFLY_XMM(c3, c4, x3, x4, JPEG_IDCT_CONST_XMM(colBias), 10)
+
+    col0 = c0; col1 = c1; col2 = c2; col3 = c3;
+    col4 = c4; col5 = c5; col6 = c6; col7 = c7;
+  }
+
+  // Pack and transpose 8x4 -> 4x8.
+  __m128i p01 = _mm_packs_epi32(col0, col1);     // [a0a1a2a3|b0b1b2b3]
+  __m128i p23 = _mm_packs_epi32(col2, col3);     // [c0c1c2c3|d0d1d2d3]
+  __m128i p45 = _mm_packs_epi32(col4, col5);     // [e0e1e2e3|f0f1f2f3]
+  __m128i p67 = _mm_packs_epi32(col6, col7);     // [g0g1g2g3|h0h1h2h3]
+
+  JPEG_IDCT_INTERLEAVE16_XMM(p01, p23)           // [a0c0a1c1|a2c2a3c3] | [b0d0b1d1|b2d2b3d3]
+  JPEG_IDCT_INTERLEAVE16_XMM(p45, p67)           // [e0g0e1g1|e2g2e3g3] | [f0h0f1h1|f2h2f3h3]
+  JPEG_IDCT_INTERLEAVE16_XMM(p01, p23)           // [a0b0c0d0|a1b1c1d1] | [a2b2c2d2|a3b3c3d3]
+  JPEG_IDCT_INTERLEAVE16_XMM(p45, p67)           // [e0f0g0h0|e1f1g1h1] | [e2f2g2h2|e3f3g3h3]
+
+  __m128i t0 = _mm_unpacklo_epi64(p01, p45);     // [a0b0c0d0|e0f0g0h0]
+  __m128i t1 = _mm_unpackhi_epi64(p01, p45);     // [a1b1c1d1|e1f1g1h1]
+
+  // IDCT rows (only columns 0..3 are non-zero).
+  __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+  if (kSize == 2) {
+    JPEG_IDCT_WIDEN_XMM(x0, t0)
+    JPEG_IDCT_SPARSE_ODD_XMM(_l, _mm_unpacklo_epi16(t1, zero))
+    JPEG_IDCT_SPARSE_ODD_XMM(_h, _mm_unpackhi_epi16(t1, zero))
+
+    JPEG_IDCT_BFLY_XMM(row0, row7, x0, x7, JPEG_IDCT_CONST_XMM(rowBias), 17)
+    JPEG_IDCT_BFLY_XMM(row1, row6, x0, x6, JPEG_IDCT_CONST_XMM(rowBias), 17)
+    JPEG_IDCT_BFLY_XMM(row2, row5, x0, x5, JPEG_IDCT_CONST_XMM(rowBias), 17)
+    JPEG_IDCT_BFLY_XMM(row3, row4, x0, x4, JPEG_IDCT_CONST_XMM(rowBias), 17)
+  }
+  else {
+    __m128i t2 = _mm_unpacklo_epi64(p23, p67);   // [a2b2c2d2|e2f2g2h2]
+    __m128i t3 = _mm_unpackhi_epi64(p23, p67);   // [a3b3c3d3|e3f3g3h3]
+
+    JPEG_IDCT_SPARSE_EVEN_XMM(_l, _mm_unpacklo_epi16(t0, t2))
+    JPEG_IDCT_SPARSE_EVEN_XMM(_h, _mm_unpackhi_epi16(t0, t2))
+    JPEG_IDCT_SPARSE_ODD_XMM(_l, _mm_unpacklo_epi16(t1, t3))
+    JPEG_IDCT_SPARSE_ODD_XMM(_h, _mm_unpackhi_epi16(t1, t3))
+
+    JPEG_IDCT_BFLY_XMM(row0, row7, x0, x7, JPEG_IDCT_CONST_XMM(rowBias), 17)
+    JPEG_IDCT_BFLY_XMM(row1, row6, x1, x6, JPEG_IDCT_CONST_XMM(rowBias), 17)
+    JPEG_IDCT_BFLY_XMM(row2, row5, x2, x5, JPEG_IDCT_CONST_XMM(rowBias), 17)
+    JPEG_IDCT_BFLY_XMM(row3, row4, x3, x4, JPEG_IDCT_CONST_XMM(rowBias), 17)
+  }
+
+  dejpeg_idct_store_sse2(dst, dstStride, row0, row1, row2, row3, row4, row5, row6, row7);
+}
+
+void dejpeg_idct_islow_2x2_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  dejpeg_idct_islow_sparse_sse2_template<2>(dst, dstStride, src, qTable);
+}
+
+void dejpeg_idct_islow_4x4_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  dejpeg_idct_islow_sparse_sse2_template<4>(dst, dstStride, src, qTable);
+}
+
+void dejpeg_idct_islow_sparse_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable, uint32_t eob) {
+  if (eob == 0)
+    dejpeg_idct_islow_dconly_sse2(dst, dstStride, src, qTable);
+  else if (eob <= JPEG_IDCT_EOB_2X2)
+    dejpeg_idct_islow_sparse_sse2_template<2>(dst, dstStride, src, qTable);
+  else if (eob <= JPEG_IDCT_EOB_4X4)
+    dejpeg_idct_islow_sparse_sse2_template<4>(dst, dstStride, src, qTable);
+  else
+    dejpeg_idct_islow_sse2_block(dst, dstStride, src, qTable);
+}
+
+// ============================================================================
+// [IDCT Scaled - SSE2]
+// ============================================================================
+
+// Load a row of coefficients and dequantize.
+#define JPEG_IDCT_LOAD_XMM(i) \
+  _mm_mullo_epi16(*(const __m128i *)(src + (i) * 8), *(const __m128i *)(qTable + (i) * 8))
+
+// Transposes the 4x8 matrix produced by the column pass so each register holds
+// 2 columns (4 rows each): w0 = [c0|c1], w1 = [c4|c5], w2 = [c2|c3], w3 = [c6|c7].
+#define JPEG_IDCT_TRANSPOSE4X8_XMM(w0, w1, w2, w3) { \
+  JPEG_IDCT_INTERLEAVE16_XMM(w0, w1)         /* [a0b0a1b1|a2b2a3b3] | [a4b4a5b5|a6b6a7b7] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(w2, w3)         /* [c0d0c1d1|c2d2c3d3] | [c4d4c5d5|c6d6c7d7] */ \
+  __m128i t = w0; \
+  w0 = _mm_unpacklo_epi32(t, w2);            /* [a0b0c0d0|a1b1c1d1] */ \
+  w2 = _mm_unpackhi_epi32(t, w2);            /* [a2b2c2d2|a3b3c3d3] */ \
+  t = w1; \
+  w1 = _mm_unpacklo_epi32(t, w3);            /* [a4b4c4d4|a5b5c5d5] */ \
+  w3 = _mm_unpackhi_epi32(t, w3);            /* [a6b6c6d6|a7b7c7d7] */ \
+}
+
+// Packs the 4 output columns (each holding 4 rows) of the 4x4 transform to
+// bytes, transposes them, and stores 4 rows of 4 pixels.
+static SIMD_INLINE void dejpeg_idct_store4x4_sse2(uint8_t* dst, intptr_t dstStride, __m128i o0, __m128i o1, __m128i o2, __m128i o3) {
+  __m128i x = _mm_packus_epi16(_mm_packs_epi32(o0, o2), _mm_packs_epi32(o1, o3));
+  x = _mm_unpacklo_epi8(x, _mm_srli_si128(x, 8));
+  x = _mm_unpacklo_epi16(x, _mm_srli_si128(x, 8));
+
+  *reinterpret_cast<uint32_t*>(dst) = static_cast<uint32_t>(_mm_cvtsi128_si32(x)); dst += dstStride;
+  *reinterpret_cast<uint32_t*>(dst) = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x, 4))); dst += dstStride;
+  *reinterpret_cast<uint32_t*>(dst) = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x, 8))); dst += dstStride;
+  *reinterpret_cast<uint32_t*>(dst) = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x, 12)));
+}
+
+void dejpeg_idct_scaled4x4_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  __m128i zero = _mm_setzero_si128();
+
+  // Load and dequantize (row 4 is not used).
+  __m128i row0 = JPEG_IDCT_LOAD_XMM(0);
+  __m128i row1 = JPEG_IDCT_LOAD_XMM(1);
+  __m128i row2 = JPEG_IDCT_LOAD_XMM(2);
+  __m128i row3 = JPEG_IDCT_LOAD_XMM(3);
+  __m128i row5 = JPEG_IDCT_LOAD_XMM(5);
+  __m128i row6 = JPEG_IDCT_LOAD_XMM(6);
+  __m128i row7 = JPEG_IDCT_LOAD_XMM(7);
+
+  // IDCT columns.
+  __m128i w0, w1, w2, w3;
+  {
+    __m128i e_l = _mm_unpacklo_epi16(row2, row6);
+    __m128i e_h = _mm_unpackhi_epi16(row2, row6);
+
+    __m128i t0e_l = _mm_srai_epi32(_mm_unpacklo_epi16(zero, row0), 3);
+    __m128i t0e_h = _mm_srai_epi32(_mm_unpackhi_epi16(zero, row0), 3);
+    __m128i t2e_l = _mm_madd_epi16(e_l, JPEG_CONST_XMM(s4_even));
+    __m128i t2e_h = _mm_madd_epi16(e_h, JPEG_CONST_XMM(s4_even));
+
+    JPEG_IDCT_WADD_XMM(tmp10, t0e, t2e)
+    JPEG_IDCT_WSUB_XMM(tmp12, t0e, t2e)
+
+    JPEG_IDCT_ROTATE_XMM(t0a, t2a, row7, row5, JPEG_CONST_XMM(s4_odd0_75), JPEG_CONST_XMM(s4_odd2_75))
+    JPEG_IDCT_ROTATE_XMM(t0b, t2b, row3, row1, JPEG_CONST_XMM(s4_odd0_31), JPEG_CONST_XMM(s4_odd2_31))
+
+    JPEG_IDCT_WADD_XMM(tmp0, t0a, t0b)
+    JPEG_IDCT_WADD_XMM(tmp2, t2a, t2b)
+
+    JPEG_IDCT_BFLY_XMM(w0, w3, tmp10, tmp2, JPEG_CONST_XMM(s4_colBias), JPEG_IDCT_4X4_COL_NORM)
+    JPEG_IDCT_BFLY_XMM(w1, w2, tmp12, tmp0, JPEG_CONST_XMM(s4_colBias), JPEG_IDCT_4X4_COL_NORM)
+  }
+
+  // Transpose.
+  JPEG_IDCT_TRANSPOSE4X8_XMM(w0, w1, w2, w3)
+
+  // IDCT rows - w0 = [c0|c1], w2 = [c2|c3], w1 = [c4|c5], w3 = [c6|c7].
+  {
+    __m128i t0e = _mm_srai_epi32(_mm_unpacklo_epi16(zero, w0), 3);
+    __m128i t2e = _mm_madd_epi16(_mm_unpacklo_epi16(w2, w3), JPEG_CONST_XMM(s4_even));
+
+    __m128i tmp10 = _mm_add_epi32(t0e, t2e);
+    __m128i tmp12 = _mm_sub_epi32(t0e, t2e);
+
+    __m128i c75 = _mm_unpackhi_epi16(w3, w1);
+    __m128i c31 = _mm_unpackhi_epi16(w2, w0);
+
+    __m128i tmp0 = _mm_add_epi32(_mm_madd_epi16(c75, JPEG_CONST_XMM(s4_odd0_75)), _mm_madd_epi16(c31, JPEG_CONST_XMM(s4_odd0_31)));
+    __m128i tmp2 = _mm_add_epi32(_mm_madd_epi16(c75, JPEG_CONST_XMM(s4_odd2_75)), _mm_madd_epi16(c31, JPEG_CONST_XMM(s4_odd2_31)));
+
+    JPEG_IDCT_SPARSE_BFLY_XMM(o0, o3, tmp10, tmp2, JPEG_CONST_XMM(s4_rowBias), JPEG_IDCT_4X4_ROW_NORM)
+    JPEG_IDCT_SPARSE_BFLY_XMM(o1, o2, tmp12, tmp0, JPEG_CONST_XMM(s4_rowBias), JPEG_IDCT_4X4_ROW_NORM)
+
+    dejpeg_idct_store4x4_sse2(dst, dstStride, o0, o1, o2, o3);
+  }
 }
 
-#define JPEG_IDCT_IDCT_PASS_XMM(bias, norm) { \
+void dejpeg_idct_scaled2x2_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  __m128i zero = _mm_setzero_si128();
+
+  // Load and dequantize (only row 0 and odd rows are used).
+  __m128i row0 = JPEG_IDCT_LOAD_XMM(0);
+  __m128i row1 = JPEG_IDCT_LOAD_XMM(1);
+  __m128i row3 = JPEG_IDCT_LOAD_XMM(3);
+  __m128i row5 = JPEG_IDCT_LOAD_XMM(5);
+  __m128i row7 = JPEG_IDCT_LOAD_XMM(7);
+
+  // IDCT columns.
+  __m128i w0, w1;
+  {
+    __m128i tmp10_l = _mm_srai_epi32(_mm_unpacklo_epi16(zero, row0), 2);
+    __m128i tmp10_h = _mm_srai_epi32(_mm_unpackhi_epi16(zero, row0), 2);
+
+    __m128i tmp0_l = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(row7, row5), JPEG_CONST_XMM(s2_odd_75)),
+                                   _mm_madd_epi16(_mm_unpacklo_epi16(row3, row1), JPEG_CONST_XMM(s2_odd_31)));
+    __m128i tmp0_h = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(row7, row5), JPEG_CONST_XMM(s2_odd_75)),
+                                   _mm_madd_epi16(_mm_unpackhi_epi16(row3, row1), JPEG_CONST_XMM(s2_odd_31)));
+
+    JPEG_IDCT_BFLY_XMM(w0, w1, tmp10, tmp0, JPEG_CONST_XMM(s2_colBias), JPEG_IDCT_2X2_COL_NORM)
+  }
+
+  // IDCT rows - there are only 2 rows, so instead of transposing, each output
+  // is calculated as a dot product of the whole row and the row constants.
+  {
+    __m128i a = _mm_madd_epi16(w0, JPEG_CONST_XMM(s2_rowPlus));
+    __m128i b = _mm_madd_epi16(w0, JPEG_CONST_XMM(s2_rowMinus));
+    __m128i c = _mm_madd_epi16(w1, JPEG_CONST_XMM(s2_rowPlus));
+    __m128i d = _mm_madd_epi16(w1, JPEG_CONST_XMM(s2_rowMinus));
+
+    __m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+    __m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+    __m128i x = _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+
+    x = _mm_srai_epi32(_mm_add_epi32(x, JPEG_CONST_XMM(s2_rowBias)), JPEG_IDCT_2X2_ROW_NORM);
+    x = _mm_packs_epi32(x, x);
+    x = _mm_packus_epi16(x, x);
+
+    uint32_t pixels = static_cast<uint32_t>(_mm_cvtsi128_si32(x));
+    reinterpret_cast<uint16_t*>(dst)[0] = static_cast<uint16_t>(pixels);
+    reinterpret_cast<uint16_t*>(dst + dstStride)[0] = static_cast<uint16_t>(pixels >> 16);
+  }
+}
+
+#undef JPEG_IDCT_LOAD_XMM
+
+// ============================================================================
+// [IDCT Fast - SSE2]
+// ============================================================================
+
+#define JPEG_IFAST_MULHI_XMM(x, c) _mm_mulhi_epi16(_mm_slli_epi16(x, JPEG_IFAST_PRE_SHIFT), JPEG_CONST_XMM(c))
+#define JPEG_IFAST_MUL_XMM(x, c) _mm_add_epi16(x, JPEG_IFAST_MULHI_XMM(x, c))
+
+// Constants are split as described at `JPEG_IFAST_PRE_SHIFT`, the integer part
+// is added by `JPEG_IFAST_MUL_XMM` (1.0) or subtracted explicitly (-3.0).
+#define JPEG_IFAST_PASS_XMM() { \
   /* Even part. */ \
-  JPEG_IDCT_ROTATE_XMM(t2e, t3e, row2, row6, rot0_0, rot0_1) \
+  __m128i tmp10 = _mm_add_epi16(row0, row4); \
+  __m128i tmp11 = _mm_sub_epi16(row0, row4); \
+  __m128i tmp13 = _mm_add_epi16(row2, row6); \
+  __m128i tmp12 = _mm_sub_epi16(JPEG_IFAST_MUL_XMM(_mm_sub_epi16(row2, row6), ifast_1_414), tmp13); \
   \
-  __m128i sum04 = _mm_add_epi16(row0, row4); \
-  __m128i dif04 = _mm_sub_epi16(row0, row4); \
+  __m128i tmp0 = _mm_add_epi16(tmp10, tmp13); \
+  __m128i tmp3 = _mm_sub_epi16(tmp10, tmp13); \
+  __m128i tmp1 = _mm_add_epi16(tmp11, tmp12); \
+  __m128i tmp2 = _mm_sub_epi16(tmp11, tmp12); \
   \
-  JPEG_IDCT_WIDEN_XMM(t0e, sum04) \
-  JPEG_IDCT_WIDEN_XMM(t1e, dif04) \
+  /* Odd part. */ \
+  __m128i z13 = _mm_add_epi16(row5, row3); \
+  __m128i z10 = _mm_sub_epi16(row5, row3); \
+  __m128i z11 = _mm_add_epi16(row1, row7); \
+  __m128i z12 = _mm_sub_epi16(row1, row7); \
   \
-  JPEG_IDCT_WADD_XMM(x0, t0e, t3e) \
-  JPEG_IDCT_WSUB_XMM(x3, t0e, t3e) \
-  JPEG_IDCT_WADD_XMM(x1, t1e, t2e) \
-  JPEG_IDCT_WSUB_XMM(x2, t1e, t2e) \
+  __m128i tmp7 = _mm_add_epi16(z11, z13); \
+  tmp11 = JPEG_IFAST_MUL_XMM(_mm_sub_epi16(z11, z13), ifast_1_414); \
   \
-  /* Odd part. */ \
-  JPEG_IDCT_ROTATE_XMM(y0o, y2o, row7, row3, rot2_0, rot2_1) \
-  JPEG_IDCT_ROTATE_XMM(y1o, y3o, row5, row1, rot3_0, rot3_1) \
-  __m128i sum17 = _mm_add_epi16(row1, row7); \
-  __m128i sum35 = _mm_add_epi16(row3, row5); \
-  JPEG_IDCT_ROTATE_XMM(y4o,y5o, sum17, sum35, rot1_0, rot1_1) \
+  __m128i z5 = JPEG_IFAST_MUL_XMM(_mm_add_epi16(z10, z12), ifast_1_847); \
+  tmp10 = _mm_sub_epi16(JPEG_IFAST_MUL_XMM(z12, ifast_1_082), z5); \
+  tmp12 = _mm_add_epi16(_mm_sub_epi16(JPEG_IFAST_MULHI_XMM(z10, ifast_m2_613), _mm_add_epi16(_mm_add_epi16(z10, z10), z10)), z5); \
   \
-  JPEG_IDCT_WADD_XMM(x4, y0o, y4o) \
-  JPEG_IDCT_WADD_XMM(x5, y1o, y5o) \
-  JPEG_IDCT_WADD_XMM(x6, y2o, y5o) \
-  JPEG_IDCT_WADD_XMM(x7, y3o, y4o) \
+  __m128i tmp6 = _mm_sub_epi16(tmp12, tmp7); \
+  __m128i tmp5 = _mm_sub_epi16(tmp11, tmp6); \
+  __m128i tmp4 = _mm_add_epi16(tmp10, tmp5); \
   \
-  JPEG_IDCT_BFLY_XMM(row0, row7, x0, x7, bias, norm) \
-  JPEG_IDCT_BFLY_XMM(row1, row6, x1, x6, bias, norm) \
-  JPEG_IDCT_BFLY_XMM(row2, row5, x2, x5, bias, norm) \
-  JPEG_IDCT_BFLY_XMM(row3, row4, x3, x4, bias, norm) \
+  row0 = _mm_add_epi16(tmp0, tmp7); \
+  row7 = _mm_sub_epi16(tmp0, tmp7); \
+  row1 = _mm_add_epi16(tmp1, tmp6); \
+  row6 = _mm_sub_epi16(tmp1, tmp6); \
+  row2 = _mm_add_epi16(tmp2, tmp5); \
+  row5 = _mm_sub_epi16(tmp2, tmp5); \
+  row4 = _mm_add_epi16(tmp3, tmp4); \
+  row3 = _mm_sub_epi16(tmp3, tmp4); \
 }
 
-void dejpeg_idct_islow_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+static SIMD_INLINE void dejpeg_idct_ifast_sse2_block(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
   // Load and dequantize.
   __m128i row0 = _mm_mullo_epi16(*(const __m128i *)(src +  0), *(const __m128i *)(qTable +  0));
   __m128i row1 = _mm_mullo_epi16(*(const __m128i *)(src +  8), *(const __m128i *)(qTable +  8));
@@ -141,67 +557,280 @@ void dejpeg_idct_islow_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src
   __m128i row7 = _mm_mullo_epi16(*(const __m128i *)(src + 56), *(const __m128i *)(qTable + 56));
 
   // IDCT columns.
-  JPEG_IDCT_IDCT_PASS_XMM(JPEG_CONST_XMM(colBias), 10)
+  JPEG_IFAST_PASS_XMM()
 
   // Transpose.
-  JPEG_IDCT_INTERLEAVE16_XMM(row0, row4) // [a0a4|b0b4|c0c4|d0d4] | [e0e4|f0f4|g0g4|h0h4]
-  JPEG_IDCT_INTERLEAVE16_XMM(row2, row6) // [a2a6|b2b6|c2c6|d2d6] | [e2e6|f2f6|g2g6|h2h6]
-  JPEG_IDCT_INTERLEAVE16_XMM(row1, row5) // [a1a5|b1b5|c2c5|d1d5] | [e1e5|f1f5|g1g5|h1h5]
-  JPEG_IDCT_INTERLEAVE16_XMM(row3, row7) // [a3a7|b3b7|c3c7|d3d7] | [e3e7|f3f7|g3g7|h3h7]
+  JPEG_IDCT_TRANSPOSE_XMM()
 
-  JPEG_IDCT_INTERLEAVE16_XMM(row0, row2) // [a0a2|a4a6|b0b2|b4b6] | [c0c2|c4c6|d0d2|d4d6]
-  JPEG_IDCT_INTERLEAVE16_XMM(row1, row3) // [a1a3|a5a7|b1b3|b5b7] | [c1c3|c5c7|d1d3|d5d7]
-  JPEG_IDCT_INTERLEAVE16_XMM(row4, row6) // [e0e2|e4e6|f0f2|f4f6] | [g0g2|g4g6|h0h2|h4h6]
-  JPEG_IDCT_INTERLEAVE16_XMM(row5, row7) // [e1e3|e5e7|f1f3|f5f7] | [g1g3|g5g7|h1h3|h5h7]
+  // IDCT rows - `row0` now holds DC terms of all rows, so the bias added to it
+  // contributes to all outputs.
+  row0 = _mm_add_epi16(row0, JPEG_CONST_XMM(ifast_rowBias));
+  JPEG_IFAST_PASS_XMM()
 
-  JPEG_IDCT_INTERLEAVE16_XMM(row0, row1) // [a0a1|a2a3|a4a5|a6a7] | [b0b1|b2b3|b4b5|b6b7]
-  JPEG_IDCT_INTERLEAVE16_XMM(row2, row3) // [c0c1|c2c3|c4c5|c6c7] | [d0d1|d2d3|d4d5|d6d7]
-  JPEG_IDCT_INTERLEAVE16_XMM(row4, row5) // [e0e1|e2e3|e4e5|e6e7] | [f0f1|f2f3|f4f5|f6f7]
-  JPEG_IDCT_INTERLEAVE16_XMM(row6, row7) // [g0g1|g2g3|g4g5|g6g7] | [h0h1|h2h3|h4h5|h6h7]
+  dejpeg_idct_store_sse2(dst, dstStride,
+    _mm_srai_epi16(row0, JPEG_IFAST_ROW_NORM), _mm_srai_epi16(row1, JPEG_IFAST_ROW_NORM),
+    _mm_srai_epi16(row2, JPEG_IFAST_ROW_NORM), _mm_srai_epi16(row3, JPEG_IFAST_ROW_NORM),
+    _mm_srai_epi16(row4, JPEG_IFAST_ROW_NORM), _mm_srai_epi16(row5, JPEG_IFAST_ROW_NORM),
+    _mm_srai_epi16(row6, JPEG_IFAST_ROW_NORM), _mm_srai_epi16(row7, JPEG_IFAST_ROW_NORM));
+}
 
-  // IDCT rows.
-  JPEG_IDCT_IDCT_PASS_XMM(JPEG_CONST_XMM(rowBias), 17)
+void dejpeg_idct_ifast_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  dejpeg_idct_ifast_sse2_block(dst, dstStride, src, qTable);
+}
 
-  // Pack to 8-bit integers, also saturates the result to 0..255.
-  row0 = _mm_packus_epi16(row0, row1);   // [a0a1a2a3|a4a5a6a7|b0b1b2b3|b4b5b6b7]
-  row2 = _mm_packus_epi16(row2, row3);   // [c0c1c2c3|c4c5c6c7|d0d1d2d3|d4d5d6d7]
-  row4 = _mm_packus_epi16(row4, row5);   // [e0e1e2e3|e4e5e6e7|f0f1f2f3|f4f5f6f7]
-  row6 = _mm_packus_epi16(row6, row7);   // [g0g1g2g3|g4g5g6g7|h0h1h2h3|h4h5h6h7]
+void dejpeg_idct_ifast_batch_sse2(uint8_t* const* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTables, const uint8_t* qIndex, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++, src += 64) {
+    _mm_prefetch(reinterpret_cast<const char*>(src + 64), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(src + 96), _MM_HINT_T0);
+    dejpeg_idct_ifast_sse2_block(dst[i], dstStride, src, qTables + static_cast<uint32_t>(qIndex[i]) * 64);
+  }
+}
 
-  // Transpose.
-  JPEG_IDCT_INTERLEAVE8_XMM(row0, row4); // [a0e0a1e1|a2e2a3e3|a4e4a5e5|a6e6a7e7] | [b0f0b1f1|b2f2b3f3|b4f4b5f5|b6f6b7f7]
-  JPEG_IDCT_INTERLEAVE8_XMM(row2, row6); // [c0g0c1g1|c2g2c3g3|c4g4c5g5|c6g6c7g7] | [d0h0d1h1|d2h2d3h3|d4h4d5h5|d6h6d7h7]
-  JPEG_IDCT_INTERLEAVE8_XMM(row0, row2); // [a0c0e0g0|a1c1e1g1|a2c2e2g2|a3c3e3g3] | [a4c4e4g4|a5c5e5g5|a6c6e6g6|a7c7e7g7]
-  JPEG_IDCT_INTERLEAVE8_XMM(row4, row6); // [b0d0f0h0|b1d1f1h1|b2d2f2h2|b3d3f3h3| | [b4d4f4h4|b5d5f5h5|b6d6f6h6|b7d7f7h7]
-  JPEG_IDCT_INTERLEAVE8_XMM(row0, row4); // [a0b0c0d0|e0f0g0h0|a1b1c1d1|e1f1g1h1] | [a2b2c2d2|e2f2g2h2|a3b3c3d3|e3f3g3h3]
-  JPEG_IDCT_INTERLEAVE8_XMM(row2, row6); // [a4b4c4d4|e4f4g4h4|a5b5c5d5|e5f5g5h5] | [a6b6c6d6|e6f6g6h6|a7b7c7d7|e7f7g7h7]
+// ============================================================================
+// [Upsample - SSE2]
+// ============================================================================
+
+void dejpeg_upsample_h2v1_sse2(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  uint32_t i = count;
+
+  while (i >= 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst +  0), _mm_unpacklo_epi8(x, x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi8(x, x));
+
+    dst += 32;
+    src += 16;
+    i   -= 16;
+  }
+
+  while (i) {
+    dst[0] = src[0];
+    dst[1] = src[0];
+
+    dst += 2;
+    src += 1;
+    i   -= 1;
+  }
+}
+
+void dejpeg_upsample_h2v2_sse2(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count) {
+  (void)srcPrev;
+  (void)srcNext;
+
+  uint32_t i = count;
+
+  while (i >= 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i lo = _mm_unpacklo_epi8(x, x);
+    __m128i hi = _mm_unpackhi_epi8(x, x);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst0 +  0), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst0 + 16), hi);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst1 +  0), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst1 + 16), hi);
+
+    dst0 += 32;
+    dst1 += 32;
+    src  += 16;
+    i    -= 16;
+  }
+
+  while (i) {
+    dst0[0] = dst0[1] = src[0];
+    dst1[0] = dst1[1] = src[0];
+
+    dst0 += 2;
+    dst1 += 2;
+    src  += 1;
+    i    -= 1;
+  }
+}
+
+// Both outputs of a source sample are at most 255, so they are interleaved by
+// `even | (odd << 8)` instead of packing and unpacking.
+#define JPEG_UPSAMPLE_FANCY_H2V1_XMM(out, s0, s1, s2) { \
+  __m128i s1x3 = _mm_add_epi16(s1, _mm_add_epi16(s1, s1)); \
+  __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(s1x3, s0), JPEG_CONST_XMM(upsample_1)), 2); \
+  __m128i odd  = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(s1x3, s2), JPEG_CONST_XMM(upsample_2)), 2); \
+  out = _mm_or_si128(even, _mm_slli_epi16(odd, 8)); \
+}
+
+#define JPEG_UPSAMPLE_FANCY_H2V2_XMM(out, c0, c1, c2) { \
+  __m128i c1x3 = _mm_add_epi16(c1, _mm_add_epi16(c1, c1)); \
+  __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(c1x3, c0), JPEG_CONST_XMM(upsample_8)), 4); \
+  __m128i odd  = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(c1x3, c2), JPEG_CONST_XMM(upsample_7)), 4); \
+  out = _mm_or_si128(even, _mm_slli_epi16(odd, 8)); \
+}
+
+void dejpeg_upsample_h2v1_fancy_sse2(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  __m128i zero = _mm_setzero_si128();
+  uint32_t i = 0;
+
+  // The first sample is handled separately as it has no left neighbor. The
+  // loop reads one sample after the last one processed, so it stops one
+  // sample before the end of the row.
+  if (count >= 18) {
+    dejpeg_upsample_h2v1_fancy_span(dst, src, 0, 1, count);
+
+    for (i = 1; i + 17 <= count; i += 16) {
+      __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i - 1));
+      __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i    ));
+      __m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 1));
+
+      __m128i lo, hi;
+      JPEG_UPSAMPLE_FANCY_H2V1_XMM(lo, _mm_unpacklo_epi8(s0, zero), _mm_unpacklo_epi8(s1, zero), _mm_unpacklo_epi8(s2, zero))
+      JPEG_UPSAMPLE_FANCY_H2V1_XMM(hi, _mm_unpackhi_epi8(s0, zero), _mm_unpackhi_epi8(s1, zero), _mm_unpackhi_epi8(s2, zero))
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2 +  0), lo);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2 + 16), hi);
+    }
+  }
+
+  dejpeg_upsample_h2v1_fancy_span(dst, src, i, count, count);
+}
+
+static SIMD_INLINE void dejpeg_upsample_h2v2_fancy_row_sse2(uint8_t* dst, const uint8_t* near, const uint8_t* src, uint32_t count) {
+  __m128i zero = _mm_setzero_si128();
+  uint32_t i = 0;
 
-  // Store.
-  uint8_t* dst0 = dst;
-  uint8_t* dst1 = dst + dstStride;
-  intptr_t dstStride2 = dstStride * 2;
+  if (count >= 18) {
+    dejpeg_upsample_h2v2_fancy_span(dst, near, src, 0, 1, count);
 
-  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row0)); dst0 += dstStride2;
-  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row0)); dst1 += dstStride2;
+    for (i = 1; i + 17 <= count; i += 16) {
+      __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i - 1));
+      __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i    ));
+      __m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 1));
 
-  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row4)); dst0 += dstStride2;
-  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row4)); dst1 += dstStride2;
+      __m128i n0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(near + i - 1));
+      __m128i n1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(near + i    ));
+      __m128i n2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(near + i + 1));
 
-  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row2)); dst0 += dstStride2;
-  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row2)); dst1 += dstStride2;
+      // Column sums `3 * src + near`, at most 1020.
+      __m128i c0_l = _mm_unpacklo_epi8(s0, zero);
+      __m128i c1_l = _mm_unpacklo_epi8(s1, zero);
+      __m128i c2_l = _mm_unpacklo_epi8(s2, zero);
+      __m128i c0_h = _mm_unpackhi_epi8(s0, zero);
+      __m128i c1_h = _mm_unpackhi_epi8(s1, zero);
+      __m128i c2_h = _mm_unpackhi_epi8(s2, zero);
 
-  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row6));
-  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row6));
+      c0_l = _mm_add_epi16(_mm_add_epi16(c0_l, _mm_add_epi16(c0_l, c0_l)), _mm_unpacklo_epi8(n0, zero));
+      c1_l = _mm_add_epi16(_mm_add_epi16(c1_l, _mm_add_epi16(c1_l, c1_l)), _mm_unpacklo_epi8(n1, zero));
+      c2_l = _mm_add_epi16(_mm_add_epi16(c2_l, _mm_add_epi16(c2_l, c2_l)), _mm_unpacklo_epi8(n2, zero));
+      c0_h = _mm_add_epi16(_mm_add_epi16(c0_h, _mm_add_epi16(c0_h, c0_h)), _mm_unpackhi_epi8(n0, zero));
+      c1_h = _mm_add_epi16(_mm_add_epi16(c1_h, _mm_add_epi16(c1_h, c1_h)), _mm_unpackhi_epi8(n1, zero));
+      c2_h = _mm_add_epi16(_mm_add_epi16(c2_h, _mm_add_epi16(c2_h, c2_h)), _mm_unpackhi_epi8(n2, zero));
+
+      __m128i lo, hi;
+      JPEG_UPSAMPLE_FANCY_H2V2_XMM(lo, c0_l, c1_l, c2_l)
+      JPEG_UPSAMPLE_FANCY_H2V2_XMM(hi, c0_h, c1_h, c2_h)
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2 +  0), lo);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2 + 16), hi);
+    }
+  }
+
+  dejpeg_upsample_h2v2_fancy_span(dst, near, src, i, count, count);
+}
+
+void dejpeg_upsample_h2v2_fancy_sse2(uint8_t* dst0, uint8_t* dst1, const uint8_t* srcPrev, const uint8_t* src, const uint8_t* srcNext, uint32_t count) {
+  dejpeg_upsample_h2v2_fancy_row_sse2(dst0, srcPrev, src, count);
+  dejpeg_upsample_h2v2_fancy_row_sse2(dst1, srcNext, src, count);
 }
 
 // ============================================================================
 // [YCbCrToRGB32]
 // ============================================================================
 
-void dejpeg_ycbcr_to_rgb32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+// Packs 4 pixels stored as 32-bit integers having the most significant byte
+// zero to 12 bytes (in the low part of the result).
+static SIMD_INLINE __m128i dejpeg_pack24_sse2(__m128i x) {
+  // [a0 a1 a2 __ b0 b1 b2 __] -> [a0 a1 a2 b0 b1 b2 __ __] (in each 64-bit half).
+  x = _mm_or_si128(_mm_and_si128(x, JPEG_CONST_XMM(ycbcr_pack24_lo)),
+                   _mm_and_si128(_mm_srli_epi64(x, 8), JPEG_CONST_XMM(ycbcr_pack24_hi)));
+  // Join both 64-bit halves.
+  return _mm_or_si128(_mm_move_epi64(x), _mm_slli_si128(_mm_srli_si128(x, 8), 6));
+}
+
+// Stores 8 pixels given by `r`, `g` and `b`, each holding 8 bytes in the low
+// 64 bits, in `kFormat`.
+template<uint32_t kFormat>
+static SIMD_INLINE void dejpeg_ycbcr_store8_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i ones = JPEG_CONST_XMM(ycbcr_allones);
+
+  switch (kFormat) {
+    case kJpegPixelRGB32:
+    case kJpegPixelRGBA32:
+    case kJpegPixelARGB32: {
+      __m128i lo, hi;
+
+      if (kFormat == kJpegPixelRGB32) {
+        lo = _mm_unpacklo_epi8(b, g);
+        hi = _mm_unpacklo_epi8(r, ones);
+      }
+      else if (kFormat == kJpegPixelRGBA32) {
+        lo = _mm_unpacklo_epi8(r, g);
+        hi = _mm_unpacklo_epi8(b, ones);
+      }
+      else {
+        lo = _mm_unpacklo_epi8(ones, r);
+        hi = _mm_unpacklo_epi8(g, b);
+      }
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst +  0), _mm_unpacklo_epi16(lo, hi));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(lo, hi));
+      break;
+    }
+
+    case kJpegPixelRGB24:
+    case kJpegPixelBGR24: {
+      __m128i lo = kFormat == kJpegPixelRGB24 ? _mm_unpacklo_epi8(r, g) : _mm_unpacklo_epi8(b, g);
+      __m128i hi = kFormat == kJpegPixelRGB24 ? _mm_unpacklo_epi8(b, zero) : _mm_unpacklo_epi8(r, zero);
+
+      __m128i p0 = dejpeg_pack24_sse2(_mm_unpacklo_epi16(lo, hi));
+      __m128i p1 = dejpeg_pack24_sse2(_mm_unpackhi_epi16(lo, hi));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 16), _mm_srli_si128(p1, 4));
+      break;
+    }
+
+    case kJpegPixelRGB565: {
+      r = _mm_slli_epi16(_mm_and_si128(_mm_unpacklo_epi8(r, zero), JPEG_CONST_XMM(ycbcr_565r)), 8);
+      g = _mm_slli_epi16(_mm_and_si128(_mm_unpacklo_epi8(g, zero), JPEG_CONST_XMM(ycbcr_565g)), 3);
+      b = _mm_srli_epi16(_mm_unpacklo_epi8(b, zero), 3);
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(_mm_or_si128(r, g), b));
+      break;
+    }
+  }
+}
+
+template<uint32_t kFormat>
+static SIMD_INLINE void dejpeg_ycbcr_convert_sse2_template(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  const uint32_t bpp = dejpeg_pixel_format_size(kFormat);
+
   uint32_t i = count;
   __m128i zero = _mm_setzero_si128();
 
+  // Gray8 doesn't need any conversion.
+  if (kFormat == kJpegPixelGray8) {
+    while (i >= 16) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pY)));
+
+      dst += 16;
+      pY  += 16;
+      i   -= 16;
+    }
+
+    while (i) {
+      *dst++ = *pY++;
+      i--;
+    }
+    return;
+  }
+
   while (i >= 8) {
     __m128i yy = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pY));
     __m128i cb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pCb));
@@ -249,16 +878,9 @@ void dejpeg_ycbcr_to_rgb32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t*
     g = _mm_packus_epi16(g, g);
     b = _mm_packus_epi16(b, b);
 
-    __m128i ra = _mm_unpacklo_epi8(r, JPEG_CONST_XMM(ycbcr_allones));
-    __m128i bg = _mm_unpacklo_epi8(b, g);
-
-    __m128i bgra0 = _mm_unpacklo_epi16(bg, ra);
-    __m128i bgra1 = _mm_unpackhi_epi16(bg, ra);
-
-    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst +  0), bgra0);
-    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), bgra1);
+    dejpeg_ycbcr_store8_sse2<kFormat>(dst, r, g, b);
 
-    dst += 32;
+    dst += bpp * 8;
     pY  += 8;
     pCb += 8;
     pCr += 8;
@@ -266,24 +888,409 @@ void dejpeg_ycbcr_to_rgb32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t*
   }
 
   while (i) {
-    int yy = (static_cast<int>(pY[0]) << JPEG_YCBCR_PREC) + (1 << (JPEG_YCBCR_PREC - 1));
-    int cr = static_cast<int>(pCr[0]) - 128;
-    int cb = static_cast<int>(pCb[0]) - 128;
+    dejpeg_ycbcr_to_pixel<kFormat>(dst, pY[0], pCb[0], pCr[0]);
+
+    dst += bpp;
+    pY  += 1;
+    pCb += 1;
+    pCr += 1;
+    i   -= 1;
+  }
+}
+
+void dejpeg_ycbcr_to_rgb32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_sse2_template<kJpegPixelRGB32>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_rgb24_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_sse2_template<kJpegPixelRGB24>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_bgr24_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_sse2_template<kJpegPixelBGR24>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_rgba32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_sse2_template<kJpegPixelRGBA32>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_argb32_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_sse2_template<kJpegPixelARGB32>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_rgb565_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_sse2_template<kJpegPixelRGB565>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_gray8_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_convert_sse2_template<kJpegPixelGray8>(dst, pY, pCb, pCr, count);
+}
+
+void dejpeg_ycbcr_to_rgb32_vec_sse2(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  dejpeg_ycbcr_to_rgb32_vec(dst, pY, pCb, pCr, count);
+}
+
+// Luma is an integer, so `((y << 12) + c) >> 12` equals `y + (c >> 12)`. This
+// means that the chroma part `c` (including rounding) can be calculated once
+// in 32-bit precision, shifted, and then added to all luma samples it belongs
+// to in 16-bit precision, which produces exactly the same result as the full
+// conversion.
+static SIMD_INLINE void dejpeg_ycbcr_store_rgb32_sse2(uint8_t* dst, const uint8_t* pY,
+  __m128i rc_lo, __m128i rc_hi, __m128i gc_lo, __m128i gc_hi, __m128i bc_lo, __m128i bc_hi) {
+
+  __m128i zero = _mm_setzero_si128();
+  __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pY));
+  __m128i yy_lo = _mm_unpacklo_epi8(yy, zero);
+  __m128i yy_hi = _mm_unpackhi_epi8(yy, zero);
+
+  __m128i r = _mm_packus_epi16(_mm_add_epi16(yy_lo, rc_lo), _mm_add_epi16(yy_hi, rc_hi));
+  __m128i g = _mm_packus_epi16(_mm_add_epi16(yy_lo, gc_lo), _mm_add_epi16(yy_hi, gc_hi));
+  __m128i b = _mm_packus_epi16(_mm_add_epi16(yy_lo, bc_lo), _mm_add_epi16(yy_hi, bc_hi));
+
+  __m128i ra_lo = _mm_unpacklo_epi8(r, JPEG_CONST_XMM(ycbcr_allones));
+  __m128i ra_hi = _mm_unpackhi_epi8(r, JPEG_CONST_XMM(ycbcr_allones));
+  __m128i bg_lo = _mm_unpacklo_epi8(b, g);
+  __m128i bg_hi = _mm_unpackhi_epi8(b, g);
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst +  0), _mm_unpacklo_epi16(bg_lo, ra_lo));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(bg_lo, ra_lo));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), _mm_unpacklo_epi16(bg_hi, ra_hi));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 48), _mm_unpackhi_epi16(bg_hi, ra_hi));
+}
+
+void dejpeg_ycbcr_h2v2_to_rgb32_sse2(uint8_t* dst0, uint8_t* dst1, const uint8_t* pY0, const uint8_t* pY1, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  uint32_t i = count;
+  __m128i zero = _mm_setzero_si128();
+
+  while (i >= 16) {
+    __m128i cb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pCb));
+    __m128i cr = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pCr));
+
+    cb = _mm_add_epi16(_mm_unpacklo_epi8(cb, zero), JPEG_CONST_XMM(ycbcr_tosigned));
+    cr = _mm_add_epi16(_mm_unpacklo_epi8(cr, zero), JPEG_CONST_XMM(ycbcr_tosigned));
+
+    // Chroma part of 8 chroma samples, rounding is done by `madd` with 1.
+    __m128i r_l = _mm_madd_epi16(_mm_unpacklo_epi16(cr, JPEG_CONST_XMM(ycbcr_one)), JPEG_CONST_XMM(ycbcr_crMulRound));
+    __m128i r_h = _mm_madd_epi16(_mm_unpackhi_epi16(cr, JPEG_CONST_XMM(ycbcr_one)), JPEG_CONST_XMM(ycbcr_crMulRound));
+
+    __m128i b_l = _mm_madd_epi16(_mm_unpacklo_epi16(cb, JPEG_CONST_XMM(ycbcr_one)), JPEG_CONST_XMM(ycbcr_cbMulRound));
+    __m128i b_h = _mm_madd_epi16(_mm_unpackhi_epi16(cb, JPEG_CONST_XMM(ycbcr_one)), JPEG_CONST_XMM(ycbcr_cbMulRound));
+
+    __m128i g_l = _mm_madd_epi16(_mm_unpacklo_epi16(cb, cr), JPEG_CONST_XMM(ycbcr_cbcrMul));
+    __m128i g_h = _mm_madd_epi16(_mm_unpackhi_epi16(cb, cr), JPEG_CONST_XMM(ycbcr_cbcrMul));
+
+    g_l = _mm_add_epi32(g_l, JPEG_CONST_XMM(ycbcr_round));
+    g_h = _mm_add_epi32(g_h, JPEG_CONST_XMM(ycbcr_round));
+
+    __m128i rc = _mm_packs_epi32(_mm_srai_epi32(r_l, JPEG_YCBCR_PREC), _mm_srai_epi32(r_h, JPEG_YCBCR_PREC));
+    __m128i gc = _mm_packs_epi32(_mm_srai_epi32(g_l, JPEG_YCBCR_PREC), _mm_srai_epi32(g_h, JPEG_YCBCR_PREC));
+    __m128i bc = _mm_packs_epi32(_mm_srai_epi32(b_l, JPEG_YCBCR_PREC), _mm_srai_epi32(b_h, JPEG_YCBCR_PREC));
+
+    // Upsample horizontally, vertical upsampling is done by using them twice.
+    __m128i rc_lo = _mm_unpacklo_epi16(rc, rc);
+    __m128i rc_hi = _mm_unpackhi_epi16(rc, rc);
+    __m128i gc_lo = _mm_unpacklo_epi16(gc, gc);
+    __m128i gc_hi = _mm_unpackhi_epi16(gc, gc);
+    __m128i bc_lo = _mm_unpacklo_epi16(bc, bc);
+    __m128i bc_hi = _mm_unpackhi_epi16(bc, bc);
+
+    dejpeg_ycbcr_store_rgb32_sse2(dst0, pY0, rc_lo, rc_hi, gc_lo, gc_hi, bc_lo, bc_hi);
+    dejpeg_ycbcr_store_rgb32_sse2(dst1, pY1, rc_lo, rc_hi, gc_lo, gc_hi, bc_lo, bc_hi);
+
+    dst0 += 64;
+    dst1 += 64;
+    pY0  += 16;
+    pY1  += 16;
+    pCb  += 8;
+    pCr  += 8;
+    i    -= 16;
+  }
+
+  for (uint32_t x = 0; x < i; x++) {
+    int cb = pCb[x >> 1];
+    int cr = pCr[x >> 1];
 
-    int r = yy + cr * JPEG_YCBCR_FIXED(1.40200);
-    int g = yy - cr * JPEG_YCBCR_FIXED(0.71414) - cb * JPEG_YCBCR_FIXED(0.34414);
-    int b = yy + cb * JPEG_YCBCR_FIXED(1.77200);
+    reinterpret_cast<uint32_t*>(dst0)[x] = dejpeg_ycbcr_to_rgb32_pixel(pY0[x], cb, cr);
+    reinterpret_cast<uint32_t*>(dst1)[x] = dejpeg_ycbcr_to_rgb32_pixel(pY1[x], cb, cr);
+  }
+}
+
+// ============================================================================
+// [Huffman - SSE2]
+// ============================================================================
+
+// Stuffed bytes are rare in real data (roughly one per 256 bytes), so 16 bytes
+// are copied at a time until the first 0xFF, which is then handled by scalar
+// code. The store is safe as the output never gets ahead of the input.
+size_t dejpeg_huff_unstuff_sse2(uint8_t* dst, const uint8_t* src, size_t size, size_t* consumed) {
+  uint8_t* dstStart = dst;
+  const uint8_t* srcStart = src;
+  const uint8_t* srcEnd = src + size;
+
+  __m128i ff = _mm_set1_epi8(-1);
+
+  while (src != srcEnd) {
+    if (static_cast<size_t>(srcEnd - src) >= 16) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, ff)));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), x);
+      if (m == 0) {
+        src += 16;
+        dst += 16;
+        continue;
+      }
+
+      uint32_t n = dejpeg_ctz(m);
+      src += n;
+      dst += n;
+    }
+    else if (*src != 0xFF) {
+      *dst++ = *src++;
+      continue;
+    }
+
+    // 0xFF at `src`, either stuffed or a marker.
+    if (srcEnd - src < 2 || src[1] != 0x00)
+      break;
 
-    reinterpret_cast<uint32_t*>(dst)[0] = dejepeg_pack32(
-      static_cast<uint8_t>(0xFF),
-      clampToByte(r >> JPEG_YCBCR_PREC),
-      clampToByte(g >> JPEG_YCBCR_PREC),
-      clampToByte(b >> JPEG_YCBCR_PREC));
+    *dst++ = 0xFF;
+    src += 2;
+  }
+
+  ::memset(dst, 0, JPEG_HUFF_PADDING);
+  *consumed = static_cast<size_t>(src - srcStart);
+  return static_cast<size_t>(dst - dstStart);
+}
+
+// ============================================================================
+// [Progressive - SSE2]
+// ============================================================================
+
+// Compares 16 coefficients at a time, packs both halves of the comparison to
+// bytes so a single PMOVMSKB produces 16 bits of the mask.
+uint64_t dejpeg_block_nonzero_mask_sse2(const int16_t* block) {
+  __m128i zero = _mm_setzero_si128();
+  uint64_t zeros = 0;
+
+  for (uint32_t i = 0; i < 4; i++) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16 + 8));
+    __m128i m = _mm_packs_epi16(_mm_cmpeq_epi16(a, zero), _mm_cmpeq_epi16(b, zero));
+
+    zeros |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(m))) << (i * 16);
+  }
+
+  return ~zeros;
+}
+
+// ============================================================================
+// [RGB32ToYCbCr - SSE2]
+// ============================================================================
+
+// Converts 4 pixels `p` to Y, Cb, and Cr as 32-bit integers. B and R are
+// extracted as [B, R] and G as [G, 1] pairs of 16-bit integers, so each
+// component needs only two PMADDWDs (the second one also adds the bias).
+#define JPEG_RGB_YCC_CONVERT4_XMM(y, cb, cr, p) { \
+  __m128i br = _mm_and_si128(p, JPEG_CONST_XMM(rgbycc_maskBR)); \
+  __m128i g1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), JPEG_CONST_XMM(rgbycc_maskG)), JPEG_CONST_XMM(rgbycc_one)); \
+  \
+  y  = _mm_add_epi32(_mm_madd_epi16(br, JPEG_CONST_XMM(rgbycc_yBR )), _mm_madd_epi16(g1, JPEG_CONST_XMM(rgbycc_yG ))); \
+  cb = _mm_add_epi32(_mm_madd_epi16(br, JPEG_CONST_XMM(rgbycc_cbBR)), _mm_madd_epi16(g1, JPEG_CONST_XMM(rgbycc_cbG))); \
+  cr = _mm_add_epi32(_mm_madd_epi16(br, JPEG_CONST_XMM(rgbycc_crBR)), _mm_madd_epi16(g1, JPEG_CONST_XMM(rgbycc_crG))); \
+  \
+  y  = _mm_srai_epi32(y , JPEG_RGB_YCC_PREC); \
+  cb = _mm_srai_epi32(cb, JPEG_RGB_YCC_PREC); \
+  cr = _mm_srai_epi32(cr, JPEG_RGB_YCC_PREC); \
+}
+
+void dejpeg_rgb32_to_ycbcr_sse2(uint8_t* pY, uint8_t* pCb, uint8_t* pCr, const uint8_t* src, uint32_t count) {
+  uint32_t i = count;
+
+  while (i >= 16) {
+    __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src +  0));
+    __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+    __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+    __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+
+    __m128i y0, y1, y2, y3;
+    __m128i cb0, cb1, cb2, cb3;
+    __m128i cr0, cr1, cr2, cr3;
+
+    JPEG_RGB_YCC_CONVERT4_XMM(y0, cb0, cr0, p0)
+    JPEG_RGB_YCC_CONVERT4_XMM(y1, cb1, cr1, p1)
+    JPEG_RGB_YCC_CONVERT4_XMM(y2, cb2, cr2, p2)
+    JPEG_RGB_YCC_CONVERT4_XMM(y3, cb3, cr3, p3)
+
+    // Y is 0..255, Cb and Cr are -128..127 until 128 is added by XOR.
+    __m128i yy = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3));
+    __m128i cb = _mm_packs_epi16(_mm_packs_epi32(cb0, cb1), _mm_packs_epi32(cb2, cb3));
+    __m128i cr = _mm_packs_epi16(_mm_packs_epi32(cr0, cr1), _mm_packs_epi32(cr2, cr3));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pY ), yy);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pCb), _mm_xor_si128(cb, JPEG_CONST_XMM(rgbycc_tounsigned)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pCr), _mm_xor_si128(cr, JPEG_CONST_XMM(rgbycc_tounsigned)));
+
+    pY  += 16;
+    pCb += 16;
+    pCr += 16;
+    src += 64;
+    i   -= 16;
+  }
+
+  while (i) {
+    dejpeg_rgb32_to_ycbcr_pixel(pY, pCb, pCr, reinterpret_cast<const uint32_t*>(src)[0]);
 
-    dst += 4;
     pY  += 1;
     pCb += 1;
     pCr += 1;
+    src += 4;
     i   -= 1;
   }
 }
+
+// ============================================================================
+// [Downsample - SSE2]
+// ============================================================================
+
+// Adds even and odd samples of `s` as 16-bit integers.
+#define JPEG_DOWNSAMPLE_PAIRS_XMM(s) \
+  _mm_add_epi16(_mm_and_si128(s, JPEG_CONST_XMM(downsample_mask)), _mm_srli_epi16(s, 8))
+
+void dejpeg_downsample_h2v1_sse2(uint8_t* dst, const uint8_t* src, uint32_t count) {
+  uint32_t i = 0;
+
+  // Destination index `i` is always a multiple of 16, so the alternating bias
+  // starts with 0 in each iteration.
+  for (; i * 2 + 32 <= count; i += 16) {
+    __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 +  0));
+    __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 16));
+
+    s0 = _mm_srli_epi16(_mm_add_epi16(JPEG_DOWNSAMPLE_PAIRS_XMM(s0), JPEG_CONST_XMM(downsample_bias01)), 1);
+    s1 = _mm_srli_epi16(_mm_add_epi16(JPEG_DOWNSAMPLE_PAIRS_XMM(s1), JPEG_CONST_XMM(downsample_bias01)), 1);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(s0, s1));
+  }
+
+  dejpeg_downsample_h2v1_span(dst, src, i, count);
+}
+
+void dejpeg_downsample_h2v2_sse2(uint8_t* dst, const uint8_t* src0, const uint8_t* src1, uint32_t count) {
+  uint32_t i = 0;
+
+  for (; i * 2 + 32 <= count; i += 16) {
+    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + i * 2 +  0));
+    __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + i * 2 + 16));
+    __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + i * 2 +  0));
+    __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + i * 2 + 16));
+
+    __m128i s0 = _mm_add_epi16(JPEG_DOWNSAMPLE_PAIRS_XMM(a0), JPEG_DOWNSAMPLE_PAIRS_XMM(b0));
+    __m128i s1 = _mm_add_epi16(JPEG_DOWNSAMPLE_PAIRS_XMM(a1), JPEG_DOWNSAMPLE_PAIRS_XMM(b1));
+
+    s0 = _mm_srli_epi16(_mm_add_epi16(s0, JPEG_CONST_XMM(downsample_bias12)), 2);
+    s1 = _mm_srli_epi16(_mm_add_epi16(s1, JPEG_CONST_XMM(downsample_bias12)), 2);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(s0, s1));
+  }
+
+  dejpeg_downsample_h2v2_span(dst, src0, src1, i, count);
+}
+
+// ============================================================================
+// [FDCT - SSE2]
+// ============================================================================
+
+// Adds bias, shifts by `norm`, and packs a wide value `x` to 16-bit integers.
+#define JPEG_FDCT_DESCALE_XMM(dst, x, bias, norm) \
+  dst = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(x##_l, bias), norm), \
+                        _mm_srai_epi32(_mm_add_epi32(x##_h, bias), norm));
+
+// Transforms `row0..row7` in vertical direction. Each output is a sum of two
+// rotations, which are exact in 32-bit integers, so the result is the same as
+// `dejpeg_fdct_islow_ref()` produces.
+#define JPEG_FDCT_FDCT_PASS_XMM(bias, norm) { \
+  __m128i tmp0 = _mm_add_epi16(row0, row7); \
+  __m128i tmp7 = _mm_sub_epi16(row0, row7); \
+  __m128i tmp1 = _mm_add_epi16(row1, row6); \
+  __m128i tmp6 = _mm_sub_epi16(row1, row6); \
+  __m128i tmp2 = _mm_add_epi16(row2, row5); \
+  __m128i tmp5 = _mm_sub_epi16(row2, row5); \
+  __m128i tmp3 = _mm_add_epi16(row3, row4); \
+  __m128i tmp4 = _mm_sub_epi16(row3, row4); \
+  \
+  /* Even part. */ \
+  __m128i tmp10 = _mm_add_epi16(tmp0, tmp3); \
+  __m128i tmp13 = _mm_sub_epi16(tmp0, tmp3); \
+  __m128i tmp11 = _mm_add_epi16(tmp1, tmp2); \
+  __m128i tmp12 = _mm_sub_epi16(tmp1, tmp2); \
+  \
+  JPEG_IDCT_ROTATE_XMM(out0, out4, tmp10, tmp11, JPEG_CONST_XMM(fdct_even0), JPEG_CONST_XMM(fdct_even1)) \
+  JPEG_IDCT_ROTATE_XMM(out2, out6, tmp13, tmp12, JPEG_CONST_XMM(fdct_even2), JPEG_CONST_XMM(fdct_even3)) \
+  \
+  /* Odd part. */ \
+  __m128i z3 = _mm_add_epi16(tmp4, tmp6); \
+  __m128i z4 = _mm_add_epi16(tmp5, tmp7); \
+  \
+  JPEG_IDCT_ROTATE_XMM(p7, p1, tmp4, tmp7, JPEG_CONST_XMM(fdct_odd0), JPEG_CONST_XMM(fdct_odd1)) \
+  JPEG_IDCT_ROTATE_XMM(p5, p3, tmp5, tmp6, JPEG_CONST_XMM(fdct_odd2), JPEG_CONST_XMM(fdct_odd3)) \
+  JPEG_IDCT_ROTATE_XMM(z3r, z4r, z3, z4, JPEG_CONST_XMM(fdct_odd4), JPEG_CONST_XMM(fdct_odd5)) \
+  \
+  JPEG_IDCT_WADD_XMM(out7, p7, z3r) \
+  JPEG_IDCT_WADD_XMM(out5, p5, z4r) \
+  JPEG_IDCT_WADD_XMM(out3, p3, z3r) \
+  JPEG_IDCT_WADD_XMM(out1, p1, z4r) \
+  \
+  JPEG_FDCT_DESCALE_XMM(row0, out0, bias, norm) \
+  JPEG_FDCT_DESCALE_XMM(row1, out1, bias, norm) \
+  JPEG_FDCT_DESCALE_XMM(row2, out2, bias, norm) \
+  JPEG_FDCT_DESCALE_XMM(row3, out3, bias, norm) \
+  JPEG_FDCT_DESCALE_XMM(row4, out4, bias, norm) \
+  JPEG_FDCT_DESCALE_XMM(row5, out5, bias, norm) \
+  JPEG_FDCT_DESCALE_XMM(row6, out6, bias, norm) \
+  JPEG_FDCT_DESCALE_XMM(row7, out7, bias, norm) \
+}
+
+// Quantizes 8 coefficients `x` by reciprocal multiplication, see
+// `dejpeg_fdct_islow_divisors()`, and stores them to `dst`.
+static SIMD_INLINE void dejpeg_fdct_quantize_sse2(int16_t* dst, __m128i x, const uint16_t* divisors) {
+  __m128i sign = _mm_srai_epi16(x, 15);
+  __m128i a = _mm_sub_epi16(_mm_xor_si128(x, sign), sign);
+
+  a = _mm_add_epi16(a, *reinterpret_cast<const __m128i*>(divisors + 64));
+  a = _mm_mulhi_epu16(a, *reinterpret_cast<const __m128i*>(divisors));
+  a = _mm_mulhi_epu16(a, *reinterpret_cast<const __m128i*>(divisors + 128));
+
+  _mm_store_si128(reinterpret_cast<__m128i*>(dst), _mm_sub_epi16(_mm_xor_si128(a, sign), sign));
+}
+
+void dejpeg_fdct_islow_sse2(int16_t* dst, const uint8_t* src, intptr_t srcStride, const uint16_t* divisors) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i center = JPEG_CONST_XMM(fdct_center);
+
+  // Load and subtract 128 (CENTERJSAMPLE).
+  __m128i row0 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + srcStride * 0)), zero), center);
+  __m128i row1 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + srcStride * 1)), zero), center);
+  __m128i row2 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + srcStride * 2)), zero), center);
+  __m128i row3 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + srcStride * 3)), zero), center);
+  __m128i row4 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + srcStride * 4)), zero), center);
+  __m128i row5 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + srcStride * 5)), zero), center);
+  __m128i row6 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + srcStride * 6)), zero), center);
+  __m128i row7 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + srcStride * 7)), zero), center);
+
+  // FDCT rows (libjpeg transforms rows first, which matters for rounding).
+  JPEG_IDCT_TRANSPOSE_XMM()
+  JPEG_FDCT_FDCT_PASS_XMM(JPEG_CONST_XMM(fdct_rowBias), JPEG_FDCT_ROW_NORM)
+
+  // FDCT columns.
+  JPEG_IDCT_TRANSPOSE_XMM()
+  JPEG_FDCT_FDCT_PASS_XMM(JPEG_CONST_XMM(fdct_colBias), JPEG_FDCT_COL_NORM)
+
+  dejpeg_fdct_quantize_sse2(dst +  0, row0, divisors +  0);
+  dejpeg_fdct_quantize_sse2(dst +  8, row1, divisors +  8);
+  dejpeg_fdct_quantize_sse2(dst + 16, row2, divisors + 16);
+  dejpeg_fdct_quantize_sse2(dst + 24, row3, divisors + 24);
+  dejpeg_fdct_quantize_sse2(dst + 32, row4, divisors + 32);
+  dejpeg_fdct_quantize_sse2(dst + 40, row5, divisors + 40);
+  dejpeg_fdct_quantize_sse2(dst + 48, row6, divisors + 48);
+  dejpeg_fdct_quantize_sse2(dst + 56, row7, divisors + 56);
+}
@@ -7,6 +7,7 @@
 
 #include "../simdglobals.h"
 #include "./dejpeg.h"
+#include "./dejpeg_xmm.h"
 
 // ============================================================================
 // [DeZigZag - SSSE3]
@@ -43,10 +44,12 @@ SIMD_INLINE __m128i _mm_shuffle_epi16_ssse3(__m128i x) {
 // [21 | 34 | 37 | 47 | 50 | 56 | 59 | 61]
 // [35 | 36 | 48 | 49 | 57 | 58 | 62 | 63]
 
-void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
-  // They are not used all at the same time, just to become more readable.
-  __m128i x0, x1, x2, x3, x4, x5, x6, x7;
-  __m128i y0, y1, y2, y3, y4, y5, y6, y7;
+// De-zig-zag 8 registers `x0..x7` holding 64 coefficients in zig-zag order to
+// `y0..y7` holding the same coefficients in natural order.
+static SIMD_INLINE void dejpeg_dezigzag_ssse3_xmm(
+  __m128i& y0, __m128i& y1, __m128i& y2, __m128i& y3, __m128i& y4, __m128i& y5, __m128i& y6, __m128i& y7,
+  __m128i x0, __m128i x1, __m128i x2, __m128i x3, __m128i x4, __m128i x5, __m128i x6, __m128i x7) {
+
   __m128i t0, t1;
 
   // y0 <- [0:0 0:1 0:5 0:6 1:6 1:7 3:3 3:4]
@@ -58,11 +61,6 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
   // y6 <- [2:5 4:2 4:5 5:7 6:2 7:0 7:3 7:5]
   // y7 <- [4:3 4:4 6:0 6:1 7:1 7:2 7:6 7:7]
 
-  x0 = _mm_load_si128((const __m128i *)(src +  0));         // [0:0 0:1 0:2 0:3 0:4 0:5 0:6 0:7]
-  x1 = _mm_load_si128((const __m128i *)(src +  8));         // [1:0 1:1 1:2 1:3 1:4 1:5 1:6 1:7]
-  x2 = _mm_load_si128((const __m128i *)(src + 16));         // [2:0 2:1 2:2 2:3 2:4 2:5 2:6 2:7]
-  x3 = _mm_load_si128((const __m128i *)(src + 24));         // [3:0 3:1 3:2 3:3 3:4 3:5 3:6 3:7]
-
   y0 = _mm_shuffle_epi16_ssse3<0, 1, 5, 6, Z, Z, Z, Z>(x0); // [0:0 0:1 0:5 0:6 ___ ___ ___ ___]
   y1 = _mm_shuffle_epi16_ssse3<2, 4, 7, Z, Z, Z, Z, Z>(x0); // [0:2 0:4 0:7 ___ ___ ___ ___ ___]
   y2 = _mm_shuffle_epi16_ssse3<3, Z, Z, Z, Z, Z, Z, Z>(x0); // [0:3 ___ ___ ___ ___ ___ ___ ___]
@@ -76,9 +74,7 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
   t1 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, Z, 2, 5, Z>(x3); // [___ ___ ___ ___ ___ 3:2 3:5 ___]
   y0 = _mm_or_si128(y0, t0);                                // [0:0 0:1 0:5 0:6 1:6 1:7 3:3 3:4]
   y1 = _mm_or_si128(y1, t1);                                // [0:2 0:4 0:7 1:5 ___ 3:2 3:5 ___]
-  _mm_store_si128((__m128i*)(dst +  0), y0);
 
-  x5 = _mm_load_si128((const __m128i *)(src + 40));         // [5:0 5:1 5:2 5:3 5:4 5:5 5:6 5:7]
   t0 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, 0, Z, Z, Z>(x2); // [___ ___ ___ ___ 2:0 ___ ___ ___]
   t1 = _mm_shuffle_epi16_ssse3<Z, Z, Z, 1, Z, Z, Z, Z>(x2); // [___ ___ ___ 2:1 ___ ___ ___ ___]
   y1 = _mm_or_si128(y1, t0);                                // [0:2 0:4 0:7 1:5 2:0 3:2 3:5 ___]
@@ -88,7 +84,6 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
   t1 = _mm_shuffle_epi16_ssse3<Z, 0, 4, Z, Z, Z, Z, Z>(x1); // [___ 1:0 1:4 ___ ___ ___ ___ ___]
   y1 = _mm_or_si128(y1, t0);                                // [0:2 0:4 0:7 1:5 2:0 3:2 3:5 5:2]
   y2 = _mm_or_si128(y2, t1);                                // [0:3 1:0 1:4 2:1 ___ ___ ___ ___]
-  _mm_store_si128((__m128i*)(dst +  8), y1);
 
   t0 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, 1, 6, Z, Z>(x3); // [___ ___ ___ ___ 3:1 3:6 ___ ___]
   y3 = _mm_shuffle_epi16_ssse3<1, 3, Z, Z, Z, Z, Z, Z>(x1); // [1:1 1:3 ___ ___ ___ ___ ___ ___]
@@ -98,9 +93,7 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
   t1 = _mm_shuffle_epi16_ssse3<Z, Z, 2, Z, Z, Z, Z, Z>(x2); // [___ ___ 2:2 ___ ___ ___ ___ ___]
   y2 = _mm_or_si128(y2, t0);                                // [0:3 1:0 1:4 2:1 3:1 3:6 5:1 5:3]
   y3 = _mm_or_si128(y3, t1);                                // [1:1 1:3 2:2 ___ ___ ___ ___ ___]
-  _mm_store_si128((__m128i*)(dst + 16), y2);
 
-  x4 = _mm_load_si128((const __m128i *)(src + 32));         // [4:0 4:1 4:2 4:3 4:4 4:5 4:6 4:7]
   y4 = _mm_shuffle_epi16_ssse3<2, Z, Z, Z, Z, Z, Z, Z>(x1); // [1:2 ___ ___ ___ ___ ___ ___ ___]
 
   t0 = _mm_shuffle_epi16_ssse3<Z, Z, Z, 0, 7, Z, Z, Z>(x3); // [___ ___ ___ 3:0 3:7 ___ ___ ___]
@@ -108,7 +101,6 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
   y3 = _mm_or_si128(y3, t0);                                // [1:1 1:3 2:2 3:0 3:7 ___ ___ ___]
   y4 = _mm_or_si128(y4, t1);                                // [1:2 2:3 2:7 ___ ___ ___ ___ ___]
 
-  x6 = _mm_load_si128((const __m128i *)(src + 48));         // [6:0 6:1 6:2 6:3 6:4 6:5 6:6 6:7]
   t0 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, Z, 0, 4, Z>(x5); // [___ ___ ___ ___ ___ 5:0 5:4 ___]
   t1 = _mm_shuffle_epi16_ssse3<Z, Z, Z, 0, 7, Z, Z, Z>(x4); // [___ ___ ___ 4:0 4:7 ___ ___ ___]
   y3 = _mm_or_si128(y3, t0);                                // [1:1 1:3 2:2 3:0 3:7 5:0 5:4 ___]
@@ -118,7 +110,6 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
   t1 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, Z, 5, Z, Z>(x5); // [___ ___ ___ ___ ___ 5:5 ___ ___]
   y3 = _mm_or_si128(y3, t0);                                // [1:1 1:3 2:2 3:0 3:7 5:0 5:4 6:5]
   y4 = _mm_or_si128(y4, t1);                                // [1:2 2:3 2:7 4:0 4:7 5:5 ___ ___]
-  _mm_store_si128((__m128i*)(dst + 24), y3);
 
   y5 = _mm_shuffle_epi16_ssse3<4, 6, Z, Z, Z, Z, Z, Z>(x2); // [2:4 2:6 ___ ___ ___ ___ ___ ___]
   y6 = _mm_shuffle_epi16_ssse3<5, Z, Z, Z, Z, Z, Z, Z>(x2); // [2:5 ___ ___ ___ ___ ___ ___ ___]
@@ -128,7 +119,6 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
 
   y4 = _mm_or_si128(y4, t0);                                // [1:2 2:3 2:7 4:0 4:7 5:5 6:4 6:6]
   y5 = _mm_or_si128(y5, t1);                                // [2:4 2:6 4:1 4:6 ___ ___ ___ ___]
-  _mm_store_si128((__m128i*)(dst + 32), y4);
 
   t0 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, 6, Z, Z, Z>(x5); // [___ ___ ___ ___ 5:6 ___ ___ ___]
   t1 = _mm_shuffle_epi16_ssse3<Z, Z, Z, 7, Z, Z, Z, Z>(x5); // [___ ___ ___ 5:7 ___ ___ ___ ___]
@@ -140,14 +130,12 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
   y5 = _mm_or_si128(y5, t0);                                // [2:4 2:6 4:1 4:6 5:6 6:3 6:7 ___]
   y6 = _mm_or_si128(y6, t1);                                // [2:5 4:2 4:5 5:7 ___ ___ ___ ___]
 
-  x7 = _mm_load_si128((const __m128i *)(src + 56));         // [7:0 7:1 7:2 7:3 7:4 7:5 7:6 7:7]
   y7 = _mm_shuffle_epi16_ssse3<3, 4, Z, Z, Z, Z, Z, Z>(x4); // [4:3 4:4 ___ ___ ___ ___ ___ ___]
 
   t0 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, Z, Z, Z, 4>(x7); // [___ ___ ___ ___ ___ ___ ___ 7:4]
   t1 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, 2, Z, Z, Z>(x6); // [___ ___ ___ ___ 6:2 ___ ___ ___]
   y5 = _mm_or_si128(y5, t0);                                // [2:4 2:6 4:1 4:6 5:6 6:3 6:7 7:4]
   y6 = _mm_or_si128(y6, t1);                                // [2:5 4:2 4:5 5:7 6:2 ___ ___ ___]
-  _mm_store_si128((__m128i*)(dst + 40), y5);
 
   t0 = _mm_shuffle_epi16_ssse3<Z, Z, 0, 1, Z, Z, Z, Z>(x6); // [___ ___ 6:0 6:1 ___ ___ ___ ___]
   t1 = _mm_shuffle_epi16_ssse3<Z, Z, Z, Z, Z, 0, 3, 5>(x7); // [___ ___ ___ ___ ___ 7:0 7:3 7:5]
@@ -156,7 +144,27 @@ void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
   y7 = _mm_or_si128(y7, t0);                                // [4:3 4:4 6:0 6:1 ___ ___ ___ ___]
   y6 = _mm_or_si128(y6, t1);                                // [2:5 4:2 4:5 5:7 6:2 7:0 7:3 7:5]
   y7 = _mm_or_si128(y7, x7);                                // [4:3 4:4 6:0 6:1 7:1 7:2 7:6 7:7]
+}
+
+void dejpeg_dezigzag_ssse3_v1(int16_t* dst, const int16_t* src) {
+  __m128i y0, y1, y2, y3, y4, y5, y6, y7;
+
+  dejpeg_dezigzag_ssse3_xmm(y0, y1, y2, y3, y4, y5, y6, y7,
+    _mm_load_si128((const __m128i *)(src +  0)), // [0:0 0:1 0:2 0:3 0:4 0:5 0:6 0:7]
+    _mm_load_si128((const __m128i *)(src +  8)), // [1:0 1:1 1:2 1:3 1:4 1:5 1:6 1:7]
+    _mm_load_si128((const __m128i *)(src + 16)), // [2:0 2:1 2:2 2:3 2:4 2:5 2:6 2:7]
+    _mm_load_si128((const __m128i *)(src + 24)), // [3:0 3:1 3:2 3:3 3:4 3:5 3:6 3:7]
+    _mm_load_si128((const __m128i *)(src + 32)), // [4:0 4:1 4:2 4:3 4:4 4:5 4:6 4:7]
+    _mm_load_si128((const __m128i *)(src + 40)), // [5:0 5:1 5:2 5:3 5:4 5:5 5:6 5:7]
+    _mm_load_si128((const __m128i *)(src + 48)), // [6:0 6:1 6:2 6:3 6:4 6:5 6:6 6:7]
+    _mm_load_si128((const __m128i *)(src + 56))); // [7:0 7:1 7:2 7:3 7:4 7:5 7:6 7:7]
 
+  _mm_store_si128((__m128i*)(dst +  0), y0);
+  _mm_store_si128((__m128i*)(dst +  8), y1);
+  _mm_store_si128((__m128i*)(dst + 16), y2);
+  _mm_store_si128((__m128i*)(dst + 24), y3);
+  _mm_store_si128((__m128i*)(dst + 32), y4);
+  _mm_store_si128((__m128i*)(dst + 40), y5);
   _mm_store_si128((__m128i*)(dst + 48), y6);
   _mm_store_si128((__m128i*)(dst + 56), y7);
 }
@@ -251,3 +259,231 @@ void dejpeg_dezigzag_ssse3_v2(int16_t* dst, const int16_t* src) {
   _mm_store_si128((__m128i*)(dst + 48), z3);
   _mm_store_si128((__m128i*)(dst + 56), z7);
 }
+
+// ============================================================================
+// [ZigZag - SSSE3]
+// ============================================================================
+
+// Inverse of `DEZIGZAG_SHUFFLE`, `x0..x3` hold 64 bytes in natural order and
+// `t0..t3` receive them in zig-zag order.
+//
+// t0 <- [0:00 0:01 0:08 1:00 0:09 0:02 0:03 0:10 1:01 1:08 2:00 1:09 1:02 0:11 0:04 0:05]
+// t1 <- [0:12 1:03 1:10 2:01 2:08 3:00 2:09 2:02 1:11 1:04 0:13 0:06 0:07 0:14 1:05 1:12]
+// t2 <- [2:03 2:10 3:01 3:08 3:09 3:02 2:11 2:04 1:13 1:06 0:15 1:07 1:14 2:05 2:12 3:03]
+// t3 <- [3:10 3:11 3:04 2:13 2:06 1:15 2:07 2:14 3:05 3:12 3:13 3:06 2:15 3:07 3:14 3:15]
+#define ZIGZAG_SHUFFLE(x0, x1, x2, x3, t0, t1, t2, t3) \
+  t0 = _mm_shuffle_epi8_ssse3<0 , 1 , 8 , Z , 9 , 2 , 3 , 10, Z , Z , Z , Z , Z , 11, 4 , 5 >(x0); \
+  t1 = _mm_shuffle_epi8_ssse3<12, Z , Z , Z , Z , Z , Z , Z , Z , Z , 13, 6 , 7 , 14, Z , Z >(x0); \
+  t2 = _mm_shuffle_epi8_ssse3<Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , 15, Z , Z , Z , Z , Z >(x0); \
+  \
+  t0 = _mm_or_si128(t0, _mm_shuffle_epi8_ssse3<Z , Z , Z , 0 , Z , Z , Z , Z , 1 , 8 , Z , 9 , 2 , Z , Z , Z >(x1)); \
+  t1 = _mm_or_si128(t1, _mm_shuffle_epi8_ssse3<Z , 3 , 10, Z , Z , Z , Z , Z , 11, 4 , Z , Z , Z , Z , 5 , 12>(x1)); \
+  t2 = _mm_or_si128(t2, _mm_shuffle_epi8_ssse3<Z , Z , Z , Z , Z , Z , Z , Z , 13, 6 , Z , 7 , 14, Z , Z , Z >(x1)); \
+  t3 =                  _mm_shuffle_epi8_ssse3<Z , Z , Z , Z , Z , 15, Z , Z , Z , Z , Z , Z , Z , Z , Z , Z >(x1);  \
+  \
+  t0 = _mm_or_si128(t0, _mm_shuffle_epi8_ssse3<Z , Z , Z , Z , Z , Z , Z , Z , Z , Z , 0 , Z , Z , Z , Z , Z >(x2)); \
+  t1 = _mm_or_si128(t1, _mm_shuffle_epi8_ssse3<Z , Z , Z , 1 , 8 , Z , 9 , 2 , Z , Z , Z , Z , Z , Z , Z , Z >(x2)); \
+  t2 = _mm_or_si128(t2, _mm_shuffle_epi8_ssse3<3 , 10, Z , Z , Z , Z , 11, 4 , Z , Z , Z , Z , Z , 5 , 12, Z >(x2)); \
+  t3 = _mm_or_si128(t3, _mm_shuffle_epi8_ssse3<Z , Z , Z , 13, 6 , Z , 7 , 14, Z , Z , Z , Z , 15, Z , Z , Z >(x2)); \
+  \
+  t1 = _mm_or_si128(t1, _mm_shuffle_epi8_ssse3<Z , Z , Z , Z , Z , 0 , Z , Z , Z , Z , Z , Z , Z , Z , Z , Z >(x3)); \
+  t2 = _mm_or_si128(t2, _mm_shuffle_epi8_ssse3<Z , Z , 1 , 8 , 9 , 2 , Z , Z , Z , Z , Z , Z , Z , Z , Z , 3 >(x3)); \
+  t3 = _mm_or_si128(t3, _mm_shuffle_epi8_ssse3<10, 11, 4 , Z , Z , Z , Z , Z , 5 , 12, 13, 6 , Z , 7 , 14, 15>(x3));
+
+// Same approach as `dejpeg_dezigzag_ssse3_v2()`, low and high bytes are split
+// so both halves can be permuted by the same shuffles.
+void dejpeg_zigzag_ssse3(int16_t* dst, const int16_t* src) {
+  __m128i x0 = _mm_load_si128((const __m128i *)(src +  0));
+  __m128i x4 = _mm_load_si128((const __m128i *)(src +  8));
+  __m128i x1 = _mm_load_si128((const __m128i *)(src + 16));
+  __m128i x5 = _mm_load_si128((const __m128i *)(src + 24));
+  __m128i x2 = _mm_load_si128((const __m128i *)(src + 32));
+  __m128i x6 = _mm_load_si128((const __m128i *)(src + 40));
+  __m128i x3 = _mm_load_si128((const __m128i *)(src + 48));
+  __m128i x7 = _mm_load_si128((const __m128i *)(src + 56));
+
+  __m128i y0 = _mm_packus_epi16(_mm_and_si128(x0, SIMD_GET_PI(zigzag_lo)), _mm_and_si128(x4, SIMD_GET_PI(zigzag_lo)));
+  __m128i y1 = _mm_packus_epi16(_mm_and_si128(x1, SIMD_GET_PI(zigzag_lo)), _mm_and_si128(x5, SIMD_GET_PI(zigzag_lo)));
+  __m128i y2 = _mm_packus_epi16(_mm_and_si128(x2, SIMD_GET_PI(zigzag_lo)), _mm_and_si128(x6, SIMD_GET_PI(zigzag_lo)));
+  __m128i y3 = _mm_packus_epi16(_mm_and_si128(x3, SIMD_GET_PI(zigzag_lo)), _mm_and_si128(x7, SIMD_GET_PI(zigzag_lo)));
+
+  __m128i t0, t1, t2, t3;
+  ZIGZAG_SHUFFLE(y0, y1, y2, y3, t0, t1, t2, t3)
+
+  __m128i y4 = _mm_packus_epi16(_mm_srli_epi16(x0, 8), _mm_srli_epi16(x4, 8));
+  __m128i y5 = _mm_packus_epi16(_mm_srli_epi16(x1, 8), _mm_srli_epi16(x5, 8));
+  __m128i y6 = _mm_packus_epi16(_mm_srli_epi16(x2, 8), _mm_srli_epi16(x6, 8));
+  __m128i y7 = _mm_packus_epi16(_mm_srli_epi16(x3, 8), _mm_srli_epi16(x7, 8));
+
+  __m128i t4, t5, t6, t7;
+  ZIGZAG_SHUFFLE(y4, y5, y6, y7, t4, t5, t6, t7)
+
+  _mm_store_si128((__m128i*)(dst +  0), _mm_unpacklo_epi8(t0, t4));
+  _mm_store_si128((__m128i*)(dst +  8), _mm_unpackhi_epi8(t0, t4));
+  _mm_store_si128((__m128i*)(dst + 16), _mm_unpacklo_epi8(t1, t5));
+  _mm_store_si128((__m128i*)(dst + 24), _mm_unpackhi_epi8(t1, t5));
+  _mm_store_si128((__m128i*)(dst + 32), _mm_unpacklo_epi8(t2, t6));
+  _mm_store_si128((__m128i*)(dst + 40), _mm_unpackhi_epi8(t2, t6));
+  _mm_store_si128((__m128i*)(dst + 48), _mm_unpacklo_epi8(t3, t7));
+  _mm_store_si128((__m128i*)(dst + 56), _mm_unpackhi_epi8(t3, t7));
+}
+
+// ============================================================================
+// [Constants - SSSE3]
+// ============================================================================
+
+struct DeJPEG_SSSE3Consts {
+  // YCbCr.
+  int16_t ycbcr_tosigned[8];
+  int16_t ycbcr_crMul[8];
+  int16_t ycbcr_cbMul[8];
+  int16_t ycbcr_cbcrMul[8];
+  int32_t ycbcr_round[4];
+  int32_t ycbcr_allones[4];
+};
+
+#define DATA_4X(...) { __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__ }
+SIMD_ALIGN_VAR(static const DeJPEG_SSSE3Consts, dejpeg_ssse3_consts, 16) = {
+  DATA_4X(-128, -128),
+  DATA_4X(JPEG_YCBCR_FIXED(1.40200), JPEG_YCBCR_FIXED(1.40200)),
+  DATA_4X(JPEG_YCBCR_FIXED(1.77200), JPEG_YCBCR_FIXED(1.77200)),
+  DATA_4X(-JPEG_YCBCR_FIXED(0.34414), -JPEG_YCBCR_FIXED(0.71414)),
+  DATA_4X(1 << (JPEG_YCBCR_PREC - 1)),
+  DATA_4X(-1)
+};
+#undef DATA_4X
+
+#define JPEG_CONST_XMM(x) (*(const __m128i*)(dejpeg_ssse3_consts.x))
+
+// ============================================================================
+// [IDCT - SSSE3]
+// ============================================================================
+
+void dejpeg_idct_islow_zigzag_ssse3(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+
+  // Dequantize in zig-zag order, both `src` and `qTable` use the same order so
+  // this is just a multiplication, then de-zig-zag in registers.
+  dejpeg_dezigzag_ssse3_xmm(row0, row1, row2, row3, row4, row5, row6, row7,
+    _mm_mullo_epi16(*(const __m128i *)(src +  0), *(const __m128i *)(qTable +  0)),
+    _mm_mullo_epi16(*(const __m128i *)(src +  8), *(const __m128i *)(qTable +  8)),
+    _mm_mullo_epi16(*(const __m128i *)(src + 16), *(const __m128i *)(qTable + 16)),
+    _mm_mullo_epi16(*(const __m128i *)(src + 24), *(const __m128i *)(qTable + 24)),
+    _mm_mullo_epi16(*(const __m128i *)(src + 32), *(const __m128i *)(qTable + 32)),
+    _mm_mullo_epi16(*(const __m128i *)(src + 40), *(const __m128i *)(qTable + 40)),
+    _mm_mullo_epi16(*(const __m128i *)(src + 48), *(const __m128i *)(qTable + 48)),
+    _mm_mullo_epi16(*(const __m128i *)(src + 56), *(const __m128i *)(qTable + 56)));
+
+  // IDCT columns.
+  JPEG_IDCT_IDCT_PASS_XMM(JPEG_IDCT_CONST_XMM(colBias), 10)
+
+  // Transpose.
+  JPEG_IDCT_TRANSPOSE_XMM()
+
+  // IDCT rows.
+  JPEG_IDCT_IDCT_PASS_XMM(JPEG_IDCT_CONST_XMM(rowBias), 17)
+
+  dejpeg_idct_store_sse2(dst, dstStride, row0, row1, row2, row3, row4, row5, row6, row7);
+}
+
+// ============================================================================
+// [YCbCrToRGB32 - SSSE3]
+// ============================================================================
+
+// Luma is an integer, so `((y << 12) + c) >> 12` equals `y + (c >> 12)` and
+// only the chroma part `c` needs more than 16 bits. Red and blue chroma parts
+// are a single product, which is calculated exactly by `pmulhrsw`:
+//
+//   pmulhrsw(x << 3, k) = ((x * 8 * k) + (1 << 14)) >> 15
+//                       = ((x * k) + (1 << 11)) >> 12
+//
+// Green is a sum of two products rounded once, so it uses `pmaddwd`.
+static SIMD_INLINE void dejpeg_ycbcr_to_rgb32_16x_ssse3(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr) {
+  __m128i zero = _mm_setzero_si128();
+
+  __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pY));
+  __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCb));
+  __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCr));
+
+  __m128i yy_lo = _mm_unpacklo_epi8(yy, zero);
+  __m128i yy_hi = _mm_unpackhi_epi8(yy, zero);
+  __m128i cb_lo = _mm_add_epi16(_mm_unpacklo_epi8(cb, zero), JPEG_CONST_XMM(ycbcr_tosigned));
+  __m128i cb_hi = _mm_add_epi16(_mm_unpackhi_epi8(cb, zero), JPEG_CONST_XMM(ycbcr_tosigned));
+  __m128i cr_lo = _mm_add_epi16(_mm_unpacklo_epi8(cr, zero), JPEG_CONST_XMM(ycbcr_tosigned));
+  __m128i cr_hi = _mm_add_epi16(_mm_unpackhi_epi8(cr, zero), JPEG_CONST_XMM(ycbcr_tosigned));
+
+  __m128i r_lo = _mm_mulhrs_epi16(_mm_slli_epi16(cr_lo, 3), JPEG_CONST_XMM(ycbcr_crMul));
+  __m128i r_hi = _mm_mulhrs_epi16(_mm_slli_epi16(cr_hi, 3), JPEG_CONST_XMM(ycbcr_crMul));
+  __m128i b_lo = _mm_mulhrs_epi16(_mm_slli_epi16(cb_lo, 3), JPEG_CONST_XMM(ycbcr_cbMul));
+  __m128i b_hi = _mm_mulhrs_epi16(_mm_slli_epi16(cb_hi, 3), JPEG_CONST_XMM(ycbcr_cbMul));
+
+  __m128i g_0 = _mm_madd_epi16(_mm_unpacklo_epi16(cb_lo, cr_lo), JPEG_CONST_XMM(ycbcr_cbcrMul));
+  __m128i g_1 = _mm_madd_epi16(_mm_unpackhi_epi16(cb_lo, cr_lo), JPEG_CONST_XMM(ycbcr_cbcrMul));
+  __m128i g_2 = _mm_madd_epi16(_mm_unpacklo_epi16(cb_hi, cr_hi), JPEG_CONST_XMM(ycbcr_cbcrMul));
+  __m128i g_3 = _mm_madd_epi16(_mm_unpackhi_epi16(cb_hi, cr_hi), JPEG_CONST_XMM(ycbcr_cbcrMul));
+
+  g_0 = _mm_srai_epi32(_mm_add_epi32(g_0, JPEG_CONST_XMM(ycbcr_round)), JPEG_YCBCR_PREC);
+  g_1 = _mm_srai_epi32(_mm_add_epi32(g_1, JPEG_CONST_XMM(ycbcr_round)), JPEG_YCBCR_PREC);
+  g_2 = _mm_srai_epi32(_mm_add_epi32(g_2, JPEG_CONST_XMM(ycbcr_round)), JPEG_YCBCR_PREC);
+  g_3 = _mm_srai_epi32(_mm_add_epi32(g_3, JPEG_CONST_XMM(ycbcr_round)), JPEG_YCBCR_PREC);
+
+  __m128i g_lo = _mm_packs_epi32(g_0, g_1);
+  __m128i g_hi = _mm_packs_epi32(g_2, g_3);
+
+  __m128i r = _mm_packus_epi16(_mm_add_epi16(yy_lo, r_lo), _mm_add_epi16(yy_hi, r_hi));
+  __m128i g = _mm_packus_epi16(_mm_add_epi16(yy_lo, g_lo), _mm_add_epi16(yy_hi, g_hi));
+  __m128i b = _mm_packus_epi16(_mm_add_epi16(yy_lo, b_lo), _mm_add_epi16(yy_hi, b_hi));
+
+  __m128i ra_lo = _mm_unpacklo_epi8(r, JPEG_CONST_XMM(ycbcr_allones));
+  __m128i ra_hi = _mm_unpackhi_epi8(r, JPEG_CONST_XMM(ycbcr_allones));
+  __m128i bg_lo = _mm_unpacklo_epi8(b, g);
+  __m128i bg_hi = _mm_unpackhi_epi8(b, g);
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst +  0), _mm_unpacklo_epi16(bg_lo, ra_lo));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(bg_lo, ra_lo));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), _mm_unpacklo_epi16(bg_hi, ra_hi));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 48), _mm_unpackhi_epi16(bg_hi, ra_hi));
+}
+
+void dejpeg_ycbcr_to_rgb32_ssse3(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  uint32_t i = count;
+
+  if (i < 16) {
+    // Short row - SSSE3 has no 32-bit masked store (MASKMOVDQU is non-temporal
+    // and byte-granular), so the row is converted in a stack buffer instead.
+    SIMD_ALIGN_VAR(uint8_t, tmp[48 + 64], 16);
+
+    ::memcpy(tmp +  0, pY , i);
+    ::memcpy(tmp + 16, pCb, i);
+    ::memcpy(tmp + 32, pCr, i);
+    dejpeg_ycbcr_to_rgb32_16x_ssse3(tmp + 48, tmp, tmp + 16, tmp + 32);
+    ::memcpy(dst, tmp + 48, i * 4);
+    return;
+  }
+
+  for (;;) {
+    dejpeg_ycbcr_to_rgb32_16x_ssse3(dst, pY, pCb, pCr);
+
+    dst += 64;
+    pY  += 16;
+    pCb += 16;
+    pCr += 16;
+    i   -= 16;
+
+    if (i >= 16)
+      continue;
+
+    if (i == 0)
+      break;
+
+    // Tail - convert the last 16 pixels again, overlapping with the pixels
+    // already converted. They are converted to the same values, so it's safe.
+    uint32_t back = 16 - i;
+
+    dst -= back * 4;
+    pY  -= back;
+    pCb -= back;
+    pCr -= back;
+    i    = 16;
+  }
+}
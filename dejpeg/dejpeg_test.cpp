@@ -9,7 +9,17 @@
 #define BENCH_COUNT 3
 #define BENCH_ITER_DEZIGZAG 5000000
 #define BENCH_ITER_IDCT 1000000
+#define BENCH_IDCT_BATCH 128
 #define BENCH_YCBCR 1000000
+#define BENCH_UPSAMPLE 200000
+#define BENCH_UPSAMPLE_WIDTH 640
+#define BENCH_MERGED 200000
+#define BENCH_MERGED_WIDTH 640
+#define BENCH_HUFF 200
+#define BENCH_HUFF_BLOCKS 8192
+#define BENCH_MASK 2000
+#define BENCH_MASK_BLOCKS 4096
+#define BENCH_DECODE_PIXELS 10000000
 
 // ============================================================================
 // [SimdTests::DeJPEG - Utilities]
@@ -166,7 +176,7 @@ static void dejpeg_check_dezigzag8x8(const char* name, DeJpegDeZigZag8x8Func a,
 
 static void dejpeg_bench_dezigzag8x8(const char* name, DeJpegDeZigZag8x8Func func) {
   SimdTimer timer;
-  uint32_t best = 0xFFFFFFFFU;
+  SimdBenchTime best;
 
   SIMD_ALIGN_VAR(int16_t, coeff0[64], 16);
   SIMD_ALIGN_VAR(int16_t, coeff1[64], 16);
@@ -182,11 +192,71 @@ static void dejpeg_bench_dezigzag8x8(const char* name, DeJpegDeZigZag8x8Func fun
         func(coeff0, coeff1);
     }
     timer.stop();
-    if (timer.get() < best)
-      best = timer.get();
+    best.update(timer);
   }
 
-  printf("[BENCH] IMPL=%-15s [%.2u.%.3u s]\n", name, best / 1000, best % 1000);
+  printf("[BENCH] IMPL=%-15s %s\n", name, best.format(BENCH_ITER_DEZIGZAG, "block", BENCH_ITER_DEZIGZAG * 128.0));
+}
+
+// Checks blocks ending at every zig-zag index (and an empty block). Values
+// are either high bytes only or low bytes only, so an implementation that
+// tests just one half of coefficients would find a wrong `eob`.
+static void dejpeg_check_dezigzag_eob(const char* name, DeJpegDeZigZagEOBFunc a, DeJpegDeZigZagEOBFunc b) {
+  SIMD_ALIGN_VAR(int16_t, data[64], 64);
+  SIMD_ALIGN_VAR(int16_t, out_a[64], 64);
+  SIMD_ALIGN_VAR(int16_t, out_b[64], 64);
+
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  SimdRandom rnd(0x7A11);
+  for (uint32_t last = 0; last <= 64; last++) {
+    for (uint32_t iter = 0; iter < 64; iter++) {
+      for (uint32_t i = 0; i < 64; i++) {
+        uint32_t r = rnd.nextUInt32();
+        int16_t v = (r & 0x300) == 0 ? static_cast<int16_t>(0) :
+                    (r & 0x400) != 0 ? static_cast<int16_t>(r & 0xFF00) : static_cast<int16_t>(r & 0x00FF);
+        data[i] = i < last ? v : static_cast<int16_t>(0);
+      }
+
+      // Block of `last` coefficients, the last one is always non-zero.
+      if (last)
+        data[last - 1] = iter & 1 ? static_cast<int16_t>(-256) : static_cast<int16_t>(1);
+
+      uint32_t eob_a = a(out_a, data);
+      uint32_t eob_b = b(out_b, data);
+
+      if (eob_a != eob_b)
+        printf("FAILED [last=%u] eob a=%u b=%u\n", last, eob_a, eob_b);
+      dejpeg_compare_data8x8(out_a, out_b);
+    }
+  }
+}
+
+static void dejpeg_bench_dezigzag_eob(const char* name, DeJpegDeZigZagEOBFunc func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  // Dummy counter to prevent optimizations.
+  uint32_t dummy = 0;
+
+  SIMD_ALIGN_VAR(int16_t, coeff0[64], 64);
+  SIMD_ALIGN_VAR(int16_t, coeff1[64], 64);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    dejpeg_fill_seq8x8(coeff0);
+
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITER_DEZIGZAG; i++) {
+      if ((i & 1) == 0)
+        dummy += func(coeff1, coeff0);
+      else
+        dummy += func(coeff0, coeff1);
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  printf("[BENCH] IMPL=%-15s %s {dummy=%u}\n", name, best.format(BENCH_ITER_DEZIGZAG, "block", BENCH_ITER_DEZIGZAG * 128.0), dummy);
 }
 
 // ============================================================================
@@ -214,7 +284,7 @@ static void dejpeg_check_idct(const char* name, DeJpegIDCTFunc a, DeJpegIDCTFunc
 
 static void dejpeg_bench_idct(const char* name, DeJpegIDCTFunc func) {
   SimdTimer timer;
-  uint32_t best = 0xFFFFFFFFU;
+  SimdBenchTime best;
 
   // Dummy counter to prevent optimizations.
   uint32_t dummy = 0;
@@ -234,106 +304,3474 @@ static void dejpeg_bench_idct(const char* name, DeJpegIDCTFunc func) {
       dummy += pixels[0];
     }
     timer.stop();
-    if (timer.get() < best)
-      best = timer.get();
+    best.update(timer);
   }
 
-  printf("[BENCH] IMPL=%-15s [%.2u.%.3u s] {dummy=%u}\n", name, best / 1000, best % 1000, dummy);
+  printf("[BENCH] IMPL=%-15s %s {dummy=%u}\n", name, best.format(BENCH_ITER_IDCT, "block", BENCH_ITER_IDCT * 64.0), dummy);
 }
 
 // ============================================================================
-// [SimdTests::DeJPEG - YCbCrToRGB32]
+// [SimdTests::DeJPEG - IDCT Batch]
 // ============================================================================
 
-static void dejpeg_check_ycbcr_to_rgb32(const char* name, YCbCrToRgbFunc a, YCbCrToRgbFunc b) {
+// Simulates an MCU row of 4:2:0 image - 4 luma blocks followed by 2 chroma
+// blocks, each using a different quantization table than luma.
+static void dejpeg_fill_batch(int16_t* coeff, uint16_t* quant, uint8_t* qIndex, uint8_t** dst, uint8_t* pixels, uint32_t count) {
+  dejpeg_fill_data8x8(quant +  0, 1, 8, 11);
+  dejpeg_fill_data8x8(quant + 64, 1, 8, 17);
+
+  for (uint32_t i = 0; i < count; i++) {
+    dejpeg_fill_data8x8(coeff + i * 64, -128, 127, i * 13);
+    qIndex[i] = static_cast<uint8_t>((i % 6) >= 4);
+    dst[i] = pixels + i * 8;
+  }
+}
+
+static void dejpeg_check_idct_batch(const char* name, DeJpegIDCTBatchFunc a, DeJpegIDCTBatchFunc b) {
   printf("[CHECK] IMPL=%-15s\n", name);
 
-  uint8_t y[256];
-  uint8_t cb[256];
-  uint8_t cr[256];
+  enum { kCount = 30 };
+  intptr_t stride = kCount * 8;
 
-  uint32_t i, j, k;
+  int16_t* coeff = static_cast<int16_t*>(::malloc(kCount * 64 * sizeof(int16_t)));
+  uint16_t* quant = static_cast<uint16_t*>(::malloc(2 * 64 * sizeof(uint16_t)));
+  uint8_t* out_a = static_cast<uint8_t*>(::malloc(kCount * 64));
+  uint8_t* out_b = static_cast<uint8_t*>(::malloc(kCount * 64));
 
-  uint32_t aDst[256];
-  uint32_t bDst[256];
+  uint8_t qIndex[kCount];
+  uint8_t* dst_a[kCount];
+  uint8_t* dst_b[kCount];
 
-  for (i = 0; i < 256; i++)
-    cr[i] = static_cast<uint8_t>(i);
+  dejpeg_fill_batch(coeff, quant, qIndex, dst_a, out_a, kCount);
+  dejpeg_fill_batch(coeff, quant, qIndex, dst_b, out_b, kCount);
 
-  for (i = 0; i < 256; i++) {
-    ::memset(y, i, 256);
-    for (j = 0; j < 256; j++) {
-      ::memset(cb, j, 256);
+  a(dst_a, stride, coeff, quant, qIndex, kCount);
+  b(dst_b, stride, coeff, quant, qIndex, kCount);
 
-      a(reinterpret_cast<uint8_t*>(aDst), y, cb, cr, 256);
-      b(reinterpret_cast<uint8_t*>(bDst), y, cb, cr, 256);
+  for (uint32_t i = 0; i < kCount * 64; i++) {
+    if (out_a[i] != out_b[i]) {
+      printf("FAILED [block=%u x=%u y=%u] a=%d b=%d\n",
+        static_cast<unsigned int>((i % stride) / 8),
+        static_cast<unsigned int>(i % 8),
+        static_cast<unsigned int>(i / stride), out_a[i], out_b[i]);
+    }
+  }
 
-      for (k = 0; k < 256; k++) {
-        uint32_t aVal = aDst[k];
-        uint32_t bVal = bDst[k];
+  ::free(coeff);
+  ::free(quant);
+  ::free(out_a);
+  ::free(out_b);
+}
 
-        if (aVal != bVal) {
-          printf("FAILED [y=%d cb=%d cr=%d] a=0x%08X b=0x%08X\n", i, j, k, aVal, bVal);
+static void dejpeg_bench_idct_batch(const char* name, DeJpegIDCTBatchFunc func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  // Dummy counter to prevent optimizations.
+  uint32_t dummy = 0;
+  intptr_t stride = BENCH_IDCT_BATCH * 8;
+
+  int16_t* coeff = static_cast<int16_t*>(::malloc(BENCH_IDCT_BATCH * 64 * sizeof(int16_t)));
+  uint16_t* quant = static_cast<uint16_t*>(::malloc(2 * 64 * sizeof(uint16_t)));
+  uint8_t* pixels = static_cast<uint8_t*>(::malloc(BENCH_IDCT_BATCH * 64));
+
+  uint8_t qIndex[BENCH_IDCT_BATCH];
+  uint8_t* dst[BENCH_IDCT_BATCH];
+
+  dejpeg_fill_batch(coeff, quant, qIndex, dst, pixels, BENCH_IDCT_BATCH);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITER_IDCT / BENCH_IDCT_BATCH; i++) {
+      func(dst, stride, coeff, quant, qIndex, BENCH_IDCT_BATCH);
+      dummy += pixels[0];
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  printf("[BENCH] IMPL=%-15s %s {dummy=%u}\n", name, best.format(double(BENCH_ITER_IDCT / BENCH_IDCT_BATCH) * BENCH_IDCT_BATCH, "block", double(BENCH_ITER_IDCT / BENCH_IDCT_BATCH) * BENCH_IDCT_BATCH * 64.0), dummy);
+
+  ::free(coeff);
+  ::free(quant);
+  ::free(pixels);
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - IDCT Sparse]
+// ============================================================================
+
+// Distribution of blocks by their last non-zero coefficient, in 1/20ths. The
+// rest of blocks is dense (eob > JPEG_IDCT_EOB_4X4).
+struct DeJpegSparsityMix {
+  const char* name;
+  uint32_t dcOnly;
+  uint32_t only2x2;
+  uint32_t only4x4;
+};
+
+static const DeJpegSparsityMix dejpeg_sparsity_mixes[] = {
+  { "smooth", 14, 3, 2 },
+  { "q75"   ,  9, 4, 4 },
+  { "q95"   ,  2, 2, 4 },
+  { "dense" ,  0, 0, 0 }
+};
+
+// Fills a block having non-zero coefficients only up to the zig-zag index
+// `eob` and stores it in natural order.
+static void dejpeg_fill_sparse8x8(int16_t* coeff, uint32_t eob, unsigned int offset) {
+  SIMD_ALIGN_VAR(int16_t, zz[64], 16);
+
+  dejpeg_fill_data8x8(zz, -128, 127, offset);
+  for (uint32_t i = eob + 1; i < 64; i++)
+    zz[i] = 0;
+
+  // Make sure the coefficient at `eob` is really the last non-zero one.
+  if (zz[eob] == 0)
+    zz[eob] = 1;
+
+  dejpeg_dezigzag_ref(coeff, zz);
+}
+
+static uint32_t dejpeg_mix_eob(const DeJpegSparsityMix& mix, uint32_t i) {
+  uint32_t bucket = i % 20;
+
+  if (bucket < mix.dcOnly)
+    return 0;
+  bucket -= mix.dcOnly;
+
+  if (bucket < mix.only2x2)
+    return 1 + (i % JPEG_IDCT_EOB_2X2);
+  bucket -= mix.only2x2;
+
+  if (bucket < mix.only4x4)
+    return JPEG_IDCT_EOB_2X2 + 1 + (i % (JPEG_IDCT_EOB_4X4 - JPEG_IDCT_EOB_2X2));
+
+  return JPEG_IDCT_EOB_4X4 + 1 + (i % (63 - JPEG_IDCT_EOB_4X4));
+}
+
+static void dejpeg_check_idct_sparse(const char* name, DeJpegIDCTSparseFunc a, DeJpegIDCTSparseFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, quant[64], 16);
+
+  // Not aligned on purpose.
+  uint8_t out_a[64];
+  uint8_t out_b[64];
+
+  dejpeg_fill_data8x8(quant, 1, 8, 11);
+
+  // Every possible `eob`, each with a few different coefficient sets.
+  for (uint32_t eob = 0; eob < 64; eob++) {
+    for (uint32_t k = 0; k < 8; k++) {
+      dejpeg_fill_sparse8x8(coeff, eob, eob * 7 + k * 29);
+
+      a(out_a, 8, coeff, quant, eob);
+      b(out_b, 8, coeff, quant, eob);
+
+      for (uint32_t i = 0; i < 64; i++) {
+        if (out_a[i] != out_b[i]) {
+          printf("FAILED [eob=%u x=%u y=%u] a=%d b=%d\n",
+            static_cast<unsigned int>(eob),
+            static_cast<unsigned int>(i % 8),
+            static_cast<unsigned int>(i / 8), out_a[i], out_b[i]);
         }
       }
     }
   }
 }
 
-static void dejpeg_bench_ycbcr_to_rgb32(const char* name, YCbCrToRgbFunc func) {
+// The full SSE2 transform wrapped so it can be benchmarked on the same data.
+static void dejpeg_idct_islow_full_sse2(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable, uint32_t eob) {
+  (void)eob;
+  dejpeg_idct_islow_sse2(dst, dstStride, src, qTable);
+}
+
+static void dejpeg_bench_idct_sparse(const char* name, const DeJpegSparsityMix& mix, DeJpegIDCTSparseFunc func) {
   SimdTimer timer;
-  uint32_t best = 0xFFFFFFFFU;
+  SimdBenchTime best;
 
   // Dummy counter to prevent optimizations.
   uint32_t dummy = 0;
+  intptr_t stride = BENCH_IDCT_BATCH * 8;
 
-  SIMD_ALIGN_VAR(uint8_t, yy[128], 16);
-  SIMD_ALIGN_VAR(uint8_t, cb[128], 16);
-  SIMD_ALIGN_VAR(uint8_t, cr[128], 16);
+  int16_t* coeff = static_cast<int16_t*>(::malloc(BENCH_IDCT_BATCH * 64 * sizeof(int16_t)));
+  uint8_t* pixels = static_cast<uint8_t*>(::malloc(BENCH_IDCT_BATCH * 64));
 
-  for (uint32_t k = 0; k < 128; k++) {
-    yy[k] = k;
-    cb[k] = 255 - k;
-    cr[k] = 64 + k;
-  }
+  SIMD_ALIGN_VAR(uint16_t, quant[64], 16);
+  uint32_t eob[BENCH_IDCT_BATCH];
 
-  uint32_t pixels[128];
+  dejpeg_fill_data8x8(quant, 1, 8, 11);
+  for (uint32_t i = 0; i < BENCH_IDCT_BATCH; i++) {
+    eob[i] = dejpeg_mix_eob(mix, i);
+    dejpeg_fill_sparse8x8(coeff + i * 64, eob[i], i * 13);
+  }
 
   for (uint32_t z = 0; z < BENCH_COUNT; z++) {
     timer.start();
-    for (uint32_t i = 0; i < BENCH_YCBCR; i++) {
-      func(reinterpret_cast<uint8_t*>(pixels), yy, cb, cr, 128);
+    for (uint32_t i = 0; i < BENCH_ITER_IDCT / BENCH_IDCT_BATCH; i++) {
+      for (uint32_t j = 0; j < BENCH_IDCT_BATCH; j++)
+        func(pixels + j * 8, stride, coeff + j * 64, quant, eob[j]);
       dummy += pixels[0];
     }
     timer.stop();
-    if (timer.get() < best)
-      best = timer.get();
+    best.update(timer);
   }
 
-  printf("[BENCH] IMPL=%-15s [%.2u.%.3u s] {dummy=%u}\n", name, best / 1000, best % 1000, dummy);
+  double blocks = double(BENCH_ITER_IDCT / BENCH_IDCT_BATCH) * BENCH_IDCT_BATCH;
+  printf("[BENCH] IMPL=%-15s MIX=%-7s %s {dummy=%u}\n", name, mix.name, best.format(blocks, "block", blocks * 64.0), dummy);
+
+  ::free(coeff);
+  ::free(pixels);
 }
 
 // ============================================================================
-// [SimdTests::DeJPEG - Main]
+// [SimdTests::DeJPEG - IDCT Scaled]
 // ============================================================================
 
-int main(int argc, char* argv[]) {
-  dejpeg_check_dezigzag8x8("zzag-ssse3-v1", dejpeg_dezigzag_ref, dejpeg_dezigzag_ssse3_v1);
-  dejpeg_check_dezigzag8x8("zzag-ssse3-v2", dejpeg_dezigzag_ref, dejpeg_dezigzag_ssse3_v2);
-  dejpeg_bench_dezigzag8x8("zzag-ref"  , dejpeg_dezigzag_ref);
-  dejpeg_bench_dezigzag8x8("zzag-ssse3-v1", dejpeg_dezigzag_ssse3_v1);
-  dejpeg_bench_dezigzag8x8("zzag-ssse3-v2", dejpeg_dezigzag_ssse3_v2);
+static void dejpeg_check_idct_scaled(const char* name, uint32_t size, DeJpegIDCTFunc a, DeJpegIDCTFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
 
-  printf("\n");
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, quant[64], 16);
 
-  dejpeg_check_idct("islow-sse2", dejpeg_idct_islow_ref, dejpeg_idct_islow_sse2);
-  dejpeg_bench_idct("islow-ref" , dejpeg_idct_islow_ref);
-  dejpeg_bench_idct("islow-sse2", dejpeg_idct_islow_sse2);
+  // Not aligned on purpose.
+  uint8_t out_a[64];
+  uint8_t out_b[64];
+
+  for (uint32_t k = 0; k < 64; k++) {
+    dejpeg_fill_data8x8(coeff, -256, 255, k * 17);
+    dejpeg_fill_data8x8(quant, 1, 8, k * 5);
+
+    ::memset(out_a, 0, sizeof(out_a));
+    ::memset(out_b, 0, sizeof(out_b));
+
+    a(out_a, 8, coeff, quant);
+    b(out_b, 8, coeff, quant);
+
+    for (uint32_t y = 0; y < size; y++) {
+      for (uint32_t x = 0; x < size; x++) {
+        uint32_t i = y * 8 + x;
+        if (out_a[i] != out_b[i])
+          printf("FAILED [k=%u x=%u y=%u] a=%d b=%d\n", k, x, y, out_a[i], out_b[i]);
+      }
+    }
+  }
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - IDCT Accuracy]
+// ============================================================================
+
+#define ACCURACY_BLOCKS 10000
+
+// Random number generator specified by IEEE 1180, returns a value in [-lo, hi].
+static int32_t dejpeg_ieee1180_random(uint32_t& seed, int32_t lo, int32_t hi) {
+  seed = seed * 1103515245U + 12345U;
+  double x = static_cast<double>(seed & 0x7FFFFFFEU) / 2147483647.0;
+  return static_cast<int32_t>(x * static_cast<double>(lo + hi + 1)) - lo;
+}
+
+// Basis of 1D DCT, `dejpeg_dct_basis()[u * 8 + x] = C(u) / 2 * cos((2x + 1) * u * PI / 16)`.
+static const double* dejpeg_dct_basis() {
+  static double basis[64];
+  static bool initialized;
+
+  if (!initialized) {
+    for (uint32_t u = 0; u < 8; u++) {
+      double scale = u == 0 ? 0.5 * 0.70710678118654752440 : 0.5;
+      for (uint32_t x = 0; x < 8; x++)
+        basis[u * 8 + x] = scale * cos(static_cast<double>((2 * x + 1) * u) * 3.14159265358979323846 / 16.0);
+    }
+    initialized = true;
+  }
+
+  return basis;
+}
+
+// Double precision (exact) forward and inverse DCT, both in natural order. The
+// 2D transform is separable, so it's calculated as 1D transforms of columns
+// and rows.
+static void dejpeg_fdct_double(double* dst, const double* src) {
+  const double* basis = dejpeg_dct_basis();
+  double tmp[64];
+
+  for (uint32_t y = 0; y < 8; y++)
+    for (uint32_t u = 0; u < 8; u++) {
+      double sum = 0.0;
+      for (uint32_t x = 0; x < 8; x++)
+        sum += src[y * 8 + x] * basis[u * 8 + x];
+      tmp[y * 8 + u] = sum;
+    }
+
+  for (uint32_t v = 0; v < 8; v++)
+    for (uint32_t u = 0; u < 8; u++) {
+      double sum = 0.0;
+      for (uint32_t y = 0; y < 8; y++)
+        sum += tmp[y * 8 + u] * basis[v * 8 + y];
+      dst[v * 8 + u] = sum;
+    }
+}
+
+static void dejpeg_idct_double(double* dst, const double* src) {
+  const double* basis = dejpeg_dct_basis();
+  double tmp[64];
+
+  for (uint32_t v = 0; v < 8; v++)
+    for (uint32_t x = 0; x < 8; x++) {
+      double sum = 0.0;
+      for (uint32_t u = 0; u < 8; u++)
+        sum += src[v * 8 + u] * basis[u * 8 + x];
+      tmp[v * 8 + x] = sum;
+    }
+
+  for (uint32_t y = 0; y < 8; y++)
+    for (uint32_t x = 0; x < 8; x++) {
+      double sum = 0.0;
+      for (uint32_t v = 0; v < 8; v++)
+        sum += tmp[v * 8 + x] * basis[v * 8 + y];
+      dst[y * 8 + x] = sum;
+    }
+}
+
+// Generates a block of random pixels in [-range, range] (clamped to a valid
+// sample range), transforms and quantizes it. The expected output (computed by
+// the exact IDCT) is stored to `expected`, if not NULL.
+static void dejpeg_random_block(int16_t* coeff, uint8_t* expected, const uint16_t* qTable, uint32_t& seed, int32_t range) {
+  double pixels[64];
+  double freq[64];
+
+  for (uint32_t i = 0; i < 64; i++) {
+    int32_t p = dejpeg_ieee1180_random(seed, range, range);
+    pixels[i] = static_cast<double>(p < -128 ? -128 : p > 127 ? 127 : p);
+  }
+
+  dejpeg_fdct_double(freq, pixels);
+  for (uint32_t i = 0; i < 64; i++) {
+    double q = static_cast<double>(qTable[i]);
+    coeff[i] = static_cast<int16_t>(floor(freq[i] / q + 0.5));
+    freq[i] = static_cast<double>(coeff[i]) * q;
+  }
+
+  if (expected) {
+    dejpeg_idct_double(pixels, freq);
+    for (uint32_t i = 0; i < 64; i++)
+      expected[i] = clampToByte(static_cast<int>(floor(pixels[i] + 128.5)));
+  }
+}
+
+// Quantization tables used by checks: all ones (IEEE 1180) and Annex K luminance
+// table scaled to quality 75.
+static void dejpeg_accuracy_qtable(uint16_t* dst, uint32_t quality) {
+  static const uint16_t table[64] = {
+    16, 11, 10, 16, 24 , 40 , 51 , 61 ,
+    12, 12, 14, 19, 26 , 58 , 60 , 55 ,
+    14, 13, 16, 24, 40 , 57 , 69 , 56 ,
+    14, 17, 22, 29, 51 , 87 , 80 , 62 ,
+    18, 22, 37, 56, 68 , 109, 103, 77 ,
+    24, 35, 55, 64, 81 , 104, 113, 92 ,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103, 99
+  };
+
+  uint32_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+  for (uint32_t i = 0; i < 64; i++) {
+    uint32_t q = (table[i] * scale + 50) / 100;
+    dst[i] = static_cast<uint16_t>(q < 1 ? 1 : q > 255 ? 255 : q);
+  }
+}
+
+// Checks that `b` gives exactly the same results as `a` (both use tables
+// folded by `dejpeg_idct_ifast_qtable()`) on blocks produced from pixel data.
+// Qualities 100 and 10 have the largest multiplier inputs on both sides of the
+// quantization error, see `JPEG_IFAST_PRE_SHIFT`.
+static void dejpeg_check_idct_ifast(const char* name, DeJpegIDCTFunc a, DeJpegIDCTFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  static const uint32_t qualities[] = { 100, 95, 75, 50, 10 };
+  static const int32_t ranges[] = { 5, 64, 128, 256 };
+
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, quant[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, folded[64], 16);
+
+  uint8_t out_a[64];
+  uint8_t out_b[64];
+
+  for (uint32_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+    dejpeg_accuracy_qtable(quant, qualities[q]);
+    dejpeg_idct_ifast_qtable(folded, quant);
+
+    for (uint32_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+      uint32_t seed = 1;
+      uint32_t failed = 0;
+
+      for (uint32_t k = 0; k < ACCURACY_BLOCKS; k++) {
+        dejpeg_random_block(coeff, NULL, quant, seed, ranges[r]);
+
+        a(out_a, 8, coeff, folded);
+        b(out_b, 8, coeff, folded);
+        failed += ::memcmp(out_a, out_b, 64) != 0;
+      }
+
+      if (failed)
+        printf("FAILED [quality=%u range=%d] %u blocks of %u differ\n", qualities[q], ranges[r], failed, ACCURACY_BLOCKS);
+    }
+  }
+}
+
+static void dejpeg_check_idct_ifast_batch(const char* name, DeJpegIDCTBatchFunc a, DeJpegIDCTBatchFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  enum { kCount = 31 };
+  intptr_t stride = kCount * 8;
+
+  SIMD_ALIGN_VAR(int16_t, coeff[kCount * 64], 16);
+  SIMD_ALIGN_VAR(uint16_t, quant[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, folded[192], 16);
+
+  static const uint32_t qualities[] = { 75, 50, 100 };
+
+  uint8_t out_a[kCount * 64];
+  uint8_t out_b[kCount * 64];
+
+  uint8_t qIndex[kCount];
+  uint8_t* dst_a[kCount];
+  uint8_t* dst_b[kCount];
+
+  for (uint32_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+    dejpeg_accuracy_qtable(quant, qualities[q]);
+    dejpeg_idct_ifast_qtable(folded + q * 64, quant);
+  }
+
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < kCount; i++) {
+    qIndex[i] = static_cast<uint8_t>((i % 7) < 3 ? 0 : (i % 7) < 5 ? 1 : 2);
+    dst_a[i] = out_a + i * 8;
+    dst_b[i] = out_b + i * 8;
+    dejpeg_accuracy_qtable(quant, qualities[qIndex[i]]);
+    dejpeg_random_block(coeff + i * 64, NULL, quant, seed, 64);
+  }
+
+  a(dst_a, stride, coeff, folded, qIndex, kCount);
+  b(dst_b, stride, coeff, folded, qIndex, kCount);
+
+  for (uint32_t i = 0; i < kCount * 64; i++) {
+    if (out_a[i] != out_b[i]) {
+      printf("FAILED [block=%u x=%u y=%u] a=%d b=%d\n",
+        static_cast<unsigned int>((i % stride) / 8),
+        static_cast<unsigned int>(i % 8),
+        static_cast<unsigned int>(i / stride), out_a[i], out_b[i]);
+    }
+  }
+}
+
+// Reports accuracy of `func` compared to the exact IDCT of the same dequantized
+// coefficients, in a similar way as IEEE 1180 does (peak error, mean square
+// error, and mean error per pixel). Quality 100 (all ones quantization table)
+// matches IEEE 1180 test conditions, however, the output here is rounded to 8
+// bits, so even the exact IDCT would not pass its limits.
+static void dejpeg_report_idct_accuracy(const char* name, DeJpegIDCTFunc func, bool ifast) {
+  static const uint32_t qualities[] = { 100, 90, 75, 50 };
+
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, quant[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, folded[64], 16);
+
+  uint8_t expected[64];
+  uint8_t out[64];
+
+  for (uint32_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+    dejpeg_accuracy_qtable(quant, qualities[q]);
+    if (ifast)
+      dejpeg_idct_ifast_qtable(folded, quant);
+    else
+      ::memcpy(folded, quant, sizeof(quant));
+
+    uint32_t seed = 1;
+    int32_t peak = 0;
+    double sumErr = 0.0;
+    double sumSqr = 0.0;
+
+    for (uint32_t k = 0; k < ACCURACY_BLOCKS; k++) {
+      dejpeg_random_block(coeff, expected, quant, seed, 128);
+      func(out, 8, coeff, folded);
+
+      for (uint32_t i = 0; i < 64; i++) {
+        int32_t err = static_cast<int32_t>(out[i]) - static_cast<int32_t>(expected[i]);
+        int32_t absErr = err < 0 ? -err : err;
+
+        if (absErr > peak)
+          peak = absErr;
+        sumErr += static_cast<double>(err);
+        sumSqr += static_cast<double>(err * err);
+      }
+    }
+
+    double n = static_cast<double>(ACCURACY_BLOCKS) * 64.0;
+    printf("[ACCUR] IMPL=%-15s QUALITY=%-3u peak=%d mse=%.4f me=%+.4f\n", name, qualities[q], peak, sumSqr / n, sumErr / n);
+  }
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - IDCT ZigZag]
+// ============================================================================
+
+// Checks the fused kernel `b` against `a` and also checks that `a` matches the
+// islow IDCT of the de-zig-zagged coefficients and quantization table.
+static void dejpeg_check_idct_zigzag(const char* name, DeJpegIDCTFunc a, DeJpegIDCTFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+  SIMD_ALIGN_VAR(uint16_t, quant[64], 16);
+  SIMD_ALIGN_VAR(int16_t, coeffNatural[64], 16);
+  SIMD_ALIGN_VAR(int16_t, quantNatural[64], 16);
+
+  // Not aligned on purpose.
+  uint8_t out_a[64];
+  uint8_t out_b[64];
+  uint8_t out_n[64];
+
+  // Keep the range where the SIMD islow transform doesn't overflow 16 bits.
+  for (unsigned int k = 0; k < 16; k++) {
+    dejpeg_fill_data8x8(coeff, -128, 127, k * 7);
+    dejpeg_fill_data8x8(quant, 1, 8, k * 3);
+
+    dejpeg_dezigzag_ref(coeffNatural, coeff);
+    dejpeg_dezigzag_ref(quantNatural, reinterpret_cast<const int16_t*>(quant));
+
+    a(out_a, 8, coeff, quant);
+    b(out_b, 8, coeff, quant);
+    dejpeg_idct_islow_ref(out_n, 8, coeffNatural, reinterpret_cast<const uint16_t*>(quantNatural));
+
+    dejpeg_compare_data8x8(out_a, out_b);
+    dejpeg_compare_data8x8(out_n, out_a);
+  }
+}
+
+// De-zig-zag followed by a separate IDCT, used to benchmark the fused kernel
+// against. The quantization table is used as is, like a decoder that keeps it
+// in natural order would do.
+static void dejpeg_idct_islow_zigzag_2pass_ssse3(uint8_t* dst, intptr_t dstStride, const int16_t* src, const uint16_t* qTable) {
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+
+  dejpeg_dezigzag_ssse3_v1(coeff, src);
+  dejpeg_idct_islow_sse2(dst, dstStride, coeff, qTable);
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - Upsample]
+// ============================================================================
+
+#define UPSAMPLE_CHECK_WIDTH 100
+
+// Fills a source row by a pattern that also contains both extremes.
+static void dejpeg_fill_upsample_row(uint8_t* dst, uint32_t count, unsigned int offset) {
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t k = i + offset;
+    dst[i] = (k % 11) == 0 ? static_cast<uint8_t>(0) :
+             (k % 7 ) == 0 ? static_cast<uint8_t>(255) : static_cast<uint8_t>(k * 37 + (k >> 3) * 101);
+  }
+}
+
+static void dejpeg_compare_upsample_row(const uint8_t* a, const uint8_t* b, uint32_t count, uint32_t row) {
+  for (uint32_t i = 0; i < count * 2; i++) {
+    if (a[i] != b[i]) {
+      printf("FAILED [width=%u row=%u x=%u] a=%d b=%d\n",
+        static_cast<unsigned int>(count),
+        static_cast<unsigned int>(row),
+        static_cast<unsigned int>(i), a[i], b[i]);
+    }
+  }
+}
+
+// Checks all widths up to `UPSAMPLE_CHECK_WIDTH`, which covers short rows and
+// all tail lengths of both SSE2 and AVX2 loops.
+static void dejpeg_check_upsample_h2v1(const char* name, DeJpegUpsampleH2V1Func a, DeJpegUpsampleH2V1Func b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  uint8_t src[UPSAMPLE_CHECK_WIDTH];
+  uint8_t out_a[UPSAMPLE_CHECK_WIDTH * 2];
+  uint8_t out_b[UPSAMPLE_CHECK_WIDTH * 2];
+
+  for (uint32_t count = 1; count <= UPSAMPLE_CHECK_WIDTH; count++) {
+    dejpeg_fill_upsample_row(src, count, count);
+
+    a(out_a, src, count);
+    b(out_b, src, count);
+    dejpeg_compare_upsample_row(out_a, out_b, count, 0);
+  }
+}
+
+static void dejpeg_check_upsample_h2v2(const char* name, DeJpegUpsampleH2V2Func a, DeJpegUpsampleH2V2Func b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  uint8_t prev[UPSAMPLE_CHECK_WIDTH];
+  uint8_t src[UPSAMPLE_CHECK_WIDTH];
+  uint8_t next[UPSAMPLE_CHECK_WIDTH];
+
+  uint8_t out_a[2][UPSAMPLE_CHECK_WIDTH * 2];
+  uint8_t out_b[2][UPSAMPLE_CHECK_WIDTH * 2];
+
+  for (uint32_t count = 1; count <= UPSAMPLE_CHECK_WIDTH; count++) {
+    dejpeg_fill_upsample_row(prev, count, count * 3);
+    dejpeg_fill_upsample_row(src , count, count * 5);
+    dejpeg_fill_upsample_row(next, count, count * 7);
+
+    a(out_a[0], out_a[1], prev, src, next, count);
+    b(out_b[0], out_b[1], prev, src, next, count);
+    dejpeg_compare_upsample_row(out_a[0], out_b[0], count, 0);
+    dejpeg_compare_upsample_row(out_a[1], out_b[1], count, 1);
+  }
+}
+
+// Samples are bytes, so the time is reported per sample of all `rows` written.
+static void dejpeg_print_upsample_bench(const char* name, SimdBenchTime& best, uint32_t rows) {
+  double samples = double(BENCH_UPSAMPLE) * double(BENCH_UPSAMPLE_WIDTH * 2 * rows);
+  printf("[BENCH] IMPL=%-15s %s\n", name, best.format(samples, "px", samples));
+}
+
+static void dejpeg_bench_upsample_h2v1(const char* name, DeJpegUpsampleH2V1Func func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  SIMD_ALIGN_VAR(uint8_t, src[BENCH_UPSAMPLE_WIDTH], 16);
+  SIMD_ALIGN_VAR(uint8_t, dst[BENCH_UPSAMPLE_WIDTH * 2], 16);
+
+  dejpeg_fill_upsample_row(src, BENCH_UPSAMPLE_WIDTH, 0);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_UPSAMPLE; i++) {
+      func(dst, src, BENCH_UPSAMPLE_WIDTH);
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  dejpeg_print_upsample_bench(name, best, 1);
+}
+
+static void dejpeg_bench_upsample_h2v2(const char* name, DeJpegUpsampleH2V2Func func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  SIMD_ALIGN_VAR(uint8_t, prev[BENCH_UPSAMPLE_WIDTH], 16);
+  SIMD_ALIGN_VAR(uint8_t, src[BENCH_UPSAMPLE_WIDTH], 16);
+  SIMD_ALIGN_VAR(uint8_t, next[BENCH_UPSAMPLE_WIDTH], 16);
+  SIMD_ALIGN_VAR(uint8_t, dst0[BENCH_UPSAMPLE_WIDTH * 2], 16);
+  SIMD_ALIGN_VAR(uint8_t, dst1[BENCH_UPSAMPLE_WIDTH * 2], 16);
+
+  dejpeg_fill_upsample_row(prev, BENCH_UPSAMPLE_WIDTH, 3);
+  dejpeg_fill_upsample_row(src , BENCH_UPSAMPLE_WIDTH, 5);
+  dejpeg_fill_upsample_row(next, BENCH_UPSAMPLE_WIDTH, 7);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_UPSAMPLE; i++) {
+      func(dst0, dst1, prev, src, next, BENCH_UPSAMPLE_WIDTH);
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  dejpeg_print_upsample_bench(name, best, 2);
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - YCbCrToRGB32]
+// ============================================================================
+
+static void dejpeg_check_ycbcr_convert(const char* name, uint32_t format, YCbCrToRgbFunc a, YCbCrToRgbFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  uint8_t y[256];
+  uint8_t cb[256];
+  uint8_t cr[256];
+
+  uint32_t i, j, k;
+  uint32_t bpp = dejpeg_pixel_format_size(format);
+
+  uint8_t aDst[256 * 4];
+  uint8_t bDst[256 * 4];
+
+  for (i = 0; i < 256; i++)
+    cr[i] = static_cast<uint8_t>(i);
+
+  for (i = 0; i < 256; i++) {
+    ::memset(y, i, 256);
+    for (j = 0; j < 256; j++) {
+      ::memset(cb, j, 256);
+
+      a(aDst, y, cb, cr, 256);
+      b(bDst, y, cb, cr, 256);
+
+      for (k = 0; k < 256; k++) {
+        if (::memcmp(aDst + k * bpp, bDst + k * bpp, bpp) != 0) {
+          uint32_t aVal = 0;
+          uint32_t bVal = 0;
+
+          ::memcpy(&aVal, aDst + k * bpp, bpp);
+          ::memcpy(&bVal, bDst + k * bpp, bpp);
+          printf("FAILED [y=%d cb=%d cr=%d] a=0x%08X b=0x%08X\n", i, j, k, aVal, bVal);
+        }
+      }
+    }
+  }
+}
+
+// Checks all widths from 1 to 100, which covers scalar paths of short rows and
+// overlapping tails of the vector paths. Nothing may be written past `count`.
+static void dejpeg_check_ycbcr_widths(const char* name, uint32_t format, YCbCrToRgbFunc a, YCbCrToRgbFunc b) {
+  printf("[CHECK] IMPL=%-15s (widths)\n", name);
+
+  uint8_t y[100];
+  uint8_t cb[100];
+  uint8_t cr[100];
+
+  uint32_t bpp = dejpeg_pixel_format_size(format);
+
+  uint8_t aDst[101 * 4];
+  uint8_t bDst[101 * 4];
+
+  for (uint32_t k = 0; k < 100; k++) {
+    y[k]  = static_cast<uint8_t>(k * 37 + 11);
+    cb[k] = static_cast<uint8_t>(k * 91 + 3);
+    cr[k] = static_cast<uint8_t>(255 - k * 53);
+  }
+
+  for (uint32_t count = 1; count <= 100; count++) {
+    ::memset(aDst, 0xCD, sizeof(aDst));
+    ::memset(bDst, 0xCD, sizeof(bDst));
+
+    a(aDst, y, cb, cr, count);
+    b(bDst, y, cb, cr, count);
+
+    if (::memcmp(aDst, bDst, sizeof(aDst)) != 0)
+      printf("FAILED [count=%u] output mismatch\n", count);
+
+    if (bDst[count * bpp] != 0xCD)
+      printf("FAILED [count=%u] written past the end\n", count);
+  }
+}
+
+static void dejpeg_bench_ycbcr_convert(const char* name, YCbCrToRgbFunc func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  // Dummy counter to prevent optimizations.
+  uint32_t dummy = 0;
+
+  SIMD_ALIGN_VAR(uint8_t, yy[128], 16);
+  SIMD_ALIGN_VAR(uint8_t, cb[128], 16);
+  SIMD_ALIGN_VAR(uint8_t, cr[128], 16);
+
+  for (uint32_t k = 0; k < 128; k++) {
+    yy[k] = k;
+    cb[k] = 255 - k;
+    cr[k] = 64 + k;
+  }
+
+  uint32_t pixels[128];
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_YCBCR; i++) {
+      func(reinterpret_cast<uint8_t*>(pixels), yy, cb, cr, 128);
+      dummy += pixels[0];
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  printf("[BENCH] IMPL=%-15s %s {dummy=%u}\n", name, best.format(BENCH_YCBCR * 128.0, "px", BENCH_YCBCR * 128.0 * 4.0), dummy);
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - YCbCrMergedToRGB32]
+// ============================================================================
+
+// Separate box upsampling and color conversion, which is what the merged
+// kernels are checked and benchmarked against.
+#define DEJPEG_SEPARATE_H2V2(NAME, UPSAMPLE, CONVERT) \
+static void NAME(uint8_t* dst0, uint8_t* dst1, const uint8_t* pY0, const uint8_t* pY1, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) { \
+  SIMD_ALIGN_VAR(uint8_t, cb[BENCH_MERGED_WIDTH + 1], 16); \
+  SIMD_ALIGN_VAR(uint8_t, cr[BENCH_MERGED_WIDTH + 1], 16); \
+  \
+  UPSAMPLE(cb, pCb, (count + 1) / 2); \
+  UPSAMPLE(cr, pCr, (count + 1) / 2); \
+  \
+  CONVERT(dst0, pY0, cb, cr, count); \
+  CONVERT(dst1, pY1, cb, cr, count); \
+}
+
+DEJPEG_SEPARATE_H2V2(dejpeg_ycbcr_h2v2_to_rgb32_separate_ref, dejpeg_upsample_h2v1_ref, dejpeg_ycbcr_to_rgb32_ref)
+DEJPEG_SEPARATE_H2V2(dejpeg_ycbcr_h2v2_to_rgb32_separate_sse2, dejpeg_upsample_h2v1_sse2, dejpeg_ycbcr_to_rgb32_sse2)
+
+#undef DEJPEG_SEPARATE_H2V2
+
+static void dejpeg_check_ycbcr_h2v2_to_rgb32(const char* name, YCbCrMergedToRgbFunc a, YCbCrMergedToRgbFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  uint8_t y0[512];
+  uint8_t y1[512];
+  uint8_t cb[256];
+  uint8_t cr[256];
+
+  uint32_t aDst[2][512];
+  uint32_t bDst[2][512];
+
+  uint32_t i, j, k;
+
+  for (k = 0; k < 256; k++)
+    cr[k] = static_cast<uint8_t>(k);
+
+  // All Cb/Cr combinations, each with several luma values in both rows.
+  for (i = 0; i < 16; i++) {
+    for (k = 0; k < 512; k++) {
+      y0[k] = static_cast<uint8_t>(k * 13 + i * 17);
+      y1[k] = static_cast<uint8_t>(k * 29 + i * 5);
+    }
+
+    for (j = 0; j < 256; j++) {
+      ::memset(cb, j, 256);
+
+      a(reinterpret_cast<uint8_t*>(aDst[0]), reinterpret_cast<uint8_t*>(aDst[1]), y0, y1, cb, cr, 512);
+      b(reinterpret_cast<uint8_t*>(bDst[0]), reinterpret_cast<uint8_t*>(bDst[1]), y0, y1, cb, cr, 512);
+
+      for (uint32_t row = 0; row < 2; row++) {
+        for (k = 0; k < 512; k++) {
+          uint32_t aVal = aDst[row][k];
+          uint32_t bVal = bDst[row][k];
+
+          if (aVal != bVal) {
+            printf("FAILED [row=%u x=%u cb=%u] a=0x%08X b=0x%08X\n", row, k, j, aVal, bVal);
+          }
+        }
+      }
+    }
+  }
+
+  // All widths up to 64 (tails and odd widths).
+  for (i = 1; i <= 64; i++) {
+    ::memset(aDst, 0, sizeof(aDst));
+    ::memset(bDst, 0, sizeof(bDst));
+
+    a(reinterpret_cast<uint8_t*>(aDst[0]), reinterpret_cast<uint8_t*>(aDst[1]), y0, y1, cr, cr + 100, i);
+    b(reinterpret_cast<uint8_t*>(bDst[0]), reinterpret_cast<uint8_t*>(bDst[1]), y0, y1, cr, cr + 100, i);
+
+    if (::memcmp(aDst, bDst, sizeof(aDst)) != 0)
+      printf("FAILED [width=%u]\n", i);
+  }
+}
+
+static void dejpeg_bench_ycbcr_h2v2_to_rgb32(const char* name, YCbCrMergedToRgbFunc func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  // Dummy counter to prevent optimizations.
+  uint32_t dummy = 0;
+
+  SIMD_ALIGN_VAR(uint8_t, y0[BENCH_MERGED_WIDTH], 16);
+  SIMD_ALIGN_VAR(uint8_t, y1[BENCH_MERGED_WIDTH], 16);
+  SIMD_ALIGN_VAR(uint8_t, cb[BENCH_MERGED_WIDTH / 2], 16);
+  SIMD_ALIGN_VAR(uint8_t, cr[BENCH_MERGED_WIDTH / 2], 16);
+
+  for (uint32_t k = 0; k < BENCH_MERGED_WIDTH; k++) {
+    y0[k] = static_cast<uint8_t>(k);
+    y1[k] = static_cast<uint8_t>(k * 3);
+  }
+
+  for (uint32_t k = 0; k < BENCH_MERGED_WIDTH / 2; k++) {
+    cb[k] = static_cast<uint8_t>(255 - k);
+    cr[k] = static_cast<uint8_t>(64 + k);
+  }
+
+  uint32_t pixels[2][BENCH_MERGED_WIDTH];
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_MERGED; i++) {
+      func(reinterpret_cast<uint8_t*>(pixels[0]), reinterpret_cast<uint8_t*>(pixels[1]), y0, y1, cb, cr, BENCH_MERGED_WIDTH);
+      dummy += pixels[1][0];
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  printf("[BENCH] IMPL=%-15s %s {dummy=%u}\n", name, best.format(BENCH_MERGED * BENCH_MERGED_WIDTH * 2.0, "px", BENCH_MERGED * BENCH_MERGED_WIDTH * 2.0 * 4.0), dummy);
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - Huffman]
+// ============================================================================
+
+// Standard luminance tables from Annex K.3, used to generate synthetic scans.
+static const uint8_t dejpeg_std_dc_luma_counts[16] = {
+  0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const uint8_t dejpeg_std_dc_luma_values[12] = {
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+static const uint8_t dejpeg_std_ac_luma_counts[16] = {
+  0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D
+};
+
+static const uint8_t dejpeg_std_ac_luma_values[162] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+  0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+  0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+  0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+  0xF9, 0xFA
+};
+
+// Minimal Huffman encoder used to produce test data, the opposite of
+// `dejpeg_huff_build()` and `dejpeg_huff_decode_block()`.
+struct DeJpegTestHuffCodes {
+  uint16_t code[256];
+  uint8_t size[256];
+};
+
+static void dejpeg_test_huff_codes(DeJpegTestHuffCodes* dst, const uint8_t* counts, const uint8_t* values) {
+  uint32_t code = 0;
+  uint32_t k = 0;
+
+  ::memset(dst, 0, sizeof(*dst));
+  for (uint32_t i = 1; i <= 16; i++) {
+    for (uint32_t j = 0; j < counts[i - 1]; j++, k++) {
+      dst->code[values[k]] = static_cast<uint16_t>(code++);
+      dst->size[values[k]] = static_cast<uint8_t>(i);
+    }
+    code <<= 1;
+  }
+}
+
+struct DeJpegTestBitWriter {
+  uint8_t* ptr;
+  uint64_t acc;
+  uint32_t count;
+};
+
+static void dejpeg_test_bits_put(DeJpegTestBitWriter* w, uint32_t bits, uint32_t n) {
+  w->acc = (w->acc << n) | (bits & ((1U << n) - 1));
+  w->count += n;
+
+  while (w->count >= 8) {
+    uint8_t b = static_cast<uint8_t>(w->acc >> (w->count - 8));
+    w->count -= 8;
+
+    *w->ptr++ = b;
+    if (b == 0xFF)
+      *w->ptr++ = 0x00;
+  }
+}
+
+// Pads the last byte with 1 bits as described by F.1.2.3.
+static void dejpeg_test_bits_flush(DeJpegTestBitWriter* w) {
+  if (w->count)
+    dejpeg_test_bits_put(w, 0x7F, 8 - w->count);
+}
+
+static uint32_t dejpeg_test_bit_size(int32_t v) {
+  uint32_t a = static_cast<uint32_t>(v < 0 ? -v : v);
+  uint32_t s = 0;
+
+  while (a) {
+    a >>= 1;
+    s++;
+  }
+  return s;
+}
+
+static void dejpeg_test_put_value(DeJpegTestBitWriter* w, const DeJpegTestHuffCodes* codes, uint32_t symbol, int32_t v, uint32_t s) {
+  dejpeg_test_bits_put(w, codes->code[symbol], codes->size[symbol]);
+  if (s)
+    dejpeg_test_bits_put(w, static_cast<uint32_t>(v < 0 ? v - 1 : v), s);
+}
+
+// Encodes a block of coefficients `zz` given in zig-zag order.
+static void dejpeg_test_encode_block(DeJpegTestBitWriter* w, const int16_t* zz, const DeJpegTestHuffCodes* dcCodes, const DeJpegTestHuffCodes* acCodes, int32_t* dcPred) {
+  int32_t diff = zz[0] - *dcPred;
+  uint32_t s = dejpeg_test_bit_size(diff);
+
+  *dcPred = zz[0];
+  dejpeg_test_put_value(w, dcCodes, s, diff, s);
+
+  uint32_t run = 0;
+  for (uint32_t k = 1; k < 64; k++) {
+    int32_t v = zz[k];
+    if (v == 0) {
+      run++;
+      continue;
+    }
+
+    for (; run > 15; run -= 16)
+      dejpeg_test_bits_put(w, acCodes->code[0xF0], acCodes->size[0xF0]);
+
+    s = dejpeg_test_bit_size(v);
+    dejpeg_test_put_value(w, acCodes, (run << 4) | s, v, s);
+    run = 0;
+  }
+
+  if (run)
+    dejpeg_test_bits_put(w, acCodes->code[0x00], acCodes->size[0x00]);
+}
+
+// Random block in zig-zag order. Stress blocks use the whole range of values
+// and long runs of zeros, other blocks look like a typical photo encoded with
+// a medium quality - most energy in low frequencies and short blocks.
+static void dejpeg_test_random_block(SimdRandom& rnd, int16_t* zz, bool stress) {
+  ::memset(zz, 0, 64 * sizeof(int16_t));
+
+  if (stress) {
+    uint32_t end = rnd.nextUInt32() % 64;
+
+    zz[0] = static_cast<int16_t>(static_cast<int32_t>(rnd.nextUInt32() % 2047) - 1023);
+    for (uint32_t k = 1; k <= end; k++) {
+      uint32_t r = rnd.nextUInt32();
+      if ((r & 7) == 0)
+        k += (r >> 3) % 24;
+      if (k > end || (r & 8))
+        continue;
+
+      uint32_t s = 1 + (r >> 8) % 10;
+      int32_t v = static_cast<int32_t>((1U << (s - 1)) + (r >> 16) % (1U << (s - 1)));
+      zz[k] = static_cast<int16_t>((r & 16) ? -v : v);
+    }
+  }
+  else {
+    zz[0] = static_cast<int16_t>(static_cast<int32_t>(rnd.nextUInt32() % 64) - 32);
+    for (uint32_t k = 1; k < 40; k++) {
+      uint32_t r = rnd.nextUInt32();
+      if ((r & 63) >= 40 - k)
+        continue;
+
+      int32_t v = static_cast<int32_t>(1 + (r >> 8) % (1 + 32 / k));
+      zz[k] = static_cast<int16_t>((r & 64) ? -v : v);
+    }
+  }
+}
+
+static uint32_t dejpeg_test_last_nonzero(const int16_t* zz) {
+  uint32_t eob = 0;
+  for (uint32_t k = 1; k < 64; k++)
+    if (zz[k])
+      eob = k;
+  return eob;
+}
+
+// Generates `count` blocks (zig-zag order) to `blocks` and encodes them to
+// `dst` by using the standard luminance tables, returns the size of the scan.
+static size_t dejpeg_test_encode_scan(uint8_t* dst, int16_t* blocks, uint32_t count, uint32_t seed, bool stress) {
+  SimdRandom rnd(seed);
+
+  DeJpegTestHuffCodes dcCodes;
+  DeJpegTestHuffCodes acCodes;
+
+  dejpeg_test_huff_codes(&dcCodes, dejpeg_std_dc_luma_counts, dejpeg_std_dc_luma_values);
+  dejpeg_test_huff_codes(&acCodes, dejpeg_std_ac_luma_counts, dejpeg_std_ac_luma_values);
+
+  DeJpegTestBitWriter w = { dst, 0, 0 };
+  int32_t dcPred = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    dejpeg_test_random_block(rnd, blocks + i * 64, stress);
+    dejpeg_test_encode_block(&w, blocks + i * 64, &dcCodes, &acCodes, &dcPred);
+  }
+
+  dejpeg_test_bits_flush(&w);
+  return static_cast<size_t>(w.ptr - dst);
+}
+
+static void dejpeg_test_build_std_luma(DeJpegHuffTable* dcTable, DeJpegHuffTable* acTable) {
+  dejpeg_huff_build(dcTable, dejpeg_std_dc_luma_counts, dejpeg_std_dc_luma_values);
+  dejpeg_huff_build(acTable, dejpeg_std_ac_luma_counts, dejpeg_std_ac_luma_values);
+}
+
+static void dejpeg_check_huff_unstuff(const char* name, DeJpegHuffUnstuffFunc a, DeJpegHuffUnstuffFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  SimdRandom rnd(0x1234);
+
+  uint8_t src[256];
+  uint8_t aDst[256 + JPEG_HUFF_PADDING];
+  uint8_t bDst[256 + JPEG_HUFF_PADDING];
+
+  for (uint32_t i = 0; i < 20000; i++) {
+    size_t size = rnd.nextUInt32() % 257;
+    uint32_t density = 1 + rnd.nextUInt32() % 64;
+
+    // Stuffed data with an occasional marker.
+    for (size_t k = 0; k < size; k++) {
+      uint32_t r = rnd.nextUInt32();
+      src[k] = static_cast<uint8_t>(r);
+
+      if (r % density == 0) {
+        src[k] = 0xFF;
+        if (k + 1 < size)
+          src[++k] = (r >> 8) % 97 == 0 ? static_cast<uint8_t>(0xD0 + (r >> 16) % 8) : 0x00;
+      }
+    }
+
+    ::memset(aDst, 0xCD, sizeof(aDst));
+    ::memset(bDst, 0xCD, sizeof(bDst));
+
+    size_t aConsumed, bConsumed;
+    size_t aSize = a(aDst, src, size, &aConsumed);
+    size_t bSize = b(bDst, src, size, &bConsumed);
+
+    if (aSize != bSize || aConsumed != bConsumed || ::memcmp(aDst, bDst, aSize + JPEG_HUFF_PADDING) != 0) {
+      printf("FAILED [size=%u] a={size=%u consumed=%u} b={size=%u consumed=%u}\n",
+        unsigned(size), unsigned(aSize), unsigned(aConsumed), unsigned(bSize), unsigned(bConsumed));
+    }
+  }
+}
+
+static void dejpeg_check_huff_decode(const char* name, DeJpegHuffUnstuffFunc unstuff) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  const uint32_t kBlocks = 4096;
+
+  int16_t* blocks = static_cast<int16_t*>(::malloc(kBlocks * 64 * sizeof(int16_t)));
+  uint8_t* scan = static_cast<uint8_t*>(::malloc(kBlocks * 256 + 2));
+  uint8_t* data = static_cast<uint8_t*>(::malloc(kBlocks * 256 + 2 + JPEG_HUFF_PADDING));
+
+  DeJpegHuffTable dcTable;
+  DeJpegHuffTable acTable;
+  dejpeg_test_build_std_luma(&dcTable, &acTable);
+
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    bool stress = pass == 0;
+    size_t scanSize = dejpeg_test_encode_scan(scan, blocks, kBlocks, 0x5EED + pass, stress);
+
+    // Terminate the scan by EOI, which must not be consumed.
+    scan[scanSize + 0] = 0xFF;
+    scan[scanSize + 1] = 0xD9;
+
+    size_t consumed;
+    size_t dataSize = unstuff(data, scan, scanSize + 2, &consumed);
+
+    if (consumed != scanSize)
+      printf("FAILED [stress=%d] consumed=%u expected=%u\n", int(stress), unsigned(consumed), unsigned(scanSize));
+
+    DeJpegBitReader br;
+    dejpeg_bits_init(&br, data, dataSize);
+
+    int32_t dcPred = 0;
+    for (uint32_t i = 0; i < kBlocks; i++) {
+      const int16_t* zz = blocks + i * 64;
+
+      int16_t expected[64];
+      int16_t coeff[64];
+
+      dejpeg_dezigzag_ref(expected, zz);
+      uint32_t eob = dejpeg_huff_decode_block(&br, coeff, &dcTable, &acTable, &dcPred);
+
+      if (eob != dejpeg_test_last_nonzero(zz) || ::memcmp(coeff, expected, sizeof(coeff)) != 0) {
+        printf("FAILED [stress=%d block=%u] eob=%u expected=%u\n", int(stress), i, eob, dejpeg_test_last_nonzero(zz));
+        break;
+      }
+    }
+  }
+
+  // Garbage must decode without accessing memory out of bounds.
+  SimdRandom rnd(0xBAD);
+  for (uint32_t i = 0; i < 256; i++)
+    scan[i] = static_cast<uint8_t>(rnd.nextUInt32());
+
+  size_t consumed;
+  size_t dataSize = unstuff(data, scan, 256, &consumed);
+
+  DeJpegBitReader br;
+  dejpeg_bits_init(&br, data, dataSize);
+
+  int32_t dcPred = 0;
+  for (uint32_t i = 0; i < 1000; i++) {
+    int16_t coeff[64];
+    dejpeg_huff_decode_block(&br, coeff, &dcTable, &acTable, &dcPred);
+  }
+
+  ::free(data);
+  ::free(scan);
+  ::free(blocks);
+}
+
+static void dejpeg_print_huff_bench(const char* name, SimdBenchTime& best, size_t scanSize) {
+  double blocks = double(BENCH_HUFF) * double(BENCH_HUFF_BLOCKS);
+  double bytes = double(BENCH_HUFF) * double(scanSize);
+
+  printf("[BENCH] IMPL=%-15s %s\n", name, best.format(blocks, "block", bytes));
+}
+
+static void dejpeg_bench_huff_unstuff(const char* name, DeJpegHuffUnstuffFunc unstuff) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  int16_t* blocks = static_cast<int16_t*>(::malloc(BENCH_HUFF_BLOCKS * 64 * sizeof(int16_t)));
+  uint8_t* scan = static_cast<uint8_t*>(::malloc(BENCH_HUFF_BLOCKS * 256));
+  uint8_t* data = static_cast<uint8_t*>(::malloc(BENCH_HUFF_BLOCKS * 256 + JPEG_HUFF_PADDING));
+
+  size_t scanSize = dejpeg_test_encode_scan(scan, blocks, BENCH_HUFF_BLOCKS, 0xBE9C, false);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_HUFF; i++) {
+      size_t consumed;
+      unstuff(data, scan, scanSize, &consumed);
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  dejpeg_print_huff_bench(name, best, scanSize);
+
+  ::free(data);
+  ::free(scan);
+  ::free(blocks);
+}
+
+// Unstuffs and decodes a synthetic scan, the throughput is reported in bytes
+// of the compressed input.
+static void dejpeg_bench_huff_decode(const char* name, DeJpegHuffUnstuffFunc unstuff) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  // Dummy counter to prevent optimizations.
+  uint32_t dummy = 0;
+
+  int16_t* blocks = static_cast<int16_t*>(::malloc(BENCH_HUFF_BLOCKS * 64 * sizeof(int16_t)));
+  uint8_t* scan = static_cast<uint8_t*>(::malloc(BENCH_HUFF_BLOCKS * 256));
+  uint8_t* data = static_cast<uint8_t*>(::malloc(BENCH_HUFF_BLOCKS * 256 + JPEG_HUFF_PADDING));
+
+  size_t scanSize = dejpeg_test_encode_scan(scan, blocks, BENCH_HUFF_BLOCKS, 0xBE9C, false);
+
+  DeJpegHuffTable dcTable;
+  DeJpegHuffTable acTable;
+  dejpeg_test_build_std_luma(&dcTable, &acTable);
+
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_HUFF; i++) {
+      size_t consumed;
+      size_t dataSize = unstuff(data, scan, scanSize, &consumed);
+
+      DeJpegBitReader br;
+      dejpeg_bits_init(&br, data, dataSize);
+
+      int32_t dcPred = 0;
+      for (uint32_t k = 0; k < BENCH_HUFF_BLOCKS; k++)
+        dummy += dejpeg_huff_decode_block(&br, coeff, &dcTable, &acTable, &dcPred);
+      dummy += static_cast<uint32_t>(coeff[0]);
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  dejpeg_print_huff_bench(name, best, scanSize);
+  printf("        {scan=%u bytes, %.2f bits/pixel, dummy=%u}\n",
+    unsigned(scanSize), double(scanSize) * 8.0 / double(BENCH_HUFF_BLOCKS * 64), dummy);
+
+  ::free(data);
+  ::free(scan);
+  ::free(blocks);
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - Progressive]
+// ============================================================================
+
+static void dejpeg_check_nonzero_mask(const char* name, DeJpegNonZeroMaskFunc a, DeJpegNonZeroMaskFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  SIMD_ALIGN_VAR(int16_t, block[64], 16);
+  SimdRandom rnd(0x3A3A);
+
+  // Each position alone (including values having only the sign bit set), then
+  // random blocks of both kinds.
+  for (uint32_t i = 0; i < 64 * 3; i++) {
+    ::memset(block, 0, sizeof(block));
+    block[i % 64] = static_cast<int16_t>(i < 64 ? 1 : i < 128 ? -1 : -32768);
+
+    uint64_t ma = a(block);
+    uint64_t mb = b(block);
+
+    if (ma != mb || ma != uint64_t(1) << (i % 64))
+      printf("FAILED [position %u] ref=%016llX impl=%016llX\n", i % 64, static_cast<unsigned long long>(ma), static_cast<unsigned long long>(mb));
+  }
+
+  for (uint32_t i = 0; i < 10000; i++) {
+    dejpeg_test_random_block(rnd, block, (i & 1) != 0);
+
+    uint64_t ma = a(block);
+    uint64_t mb = b(block);
+
+    if (ma != mb) {
+      printf("FAILED [block %u] ref=%016llX impl=%016llX\n", i, static_cast<unsigned long long>(ma), static_cast<unsigned long long>(mb));
+      break;
+    }
+  }
+}
+
+static void dejpeg_bench_nonzero_mask(const char* name, DeJpegNonZeroMaskFunc func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  int16_t* blocks = static_cast<int16_t*>(::malloc(BENCH_MASK_BLOCKS * 64 * sizeof(int16_t)));
+  SimdRandom rnd(0x5E5E);
+
+  for (uint32_t i = 0; i < BENCH_MASK_BLOCKS; i++)
+    dejpeg_test_random_block(rnd, blocks + i * 64, false);
+
+  // Accumulated so the calls aren't optimized out.
+  uint64_t acc = 0;
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t n = 0; n < BENCH_MASK; n++)
+      for (uint32_t i = 0; i < BENCH_MASK_BLOCKS; i++)
+        acc += func(blocks + i * 64);
+    timer.stop();
+    best.update(timer);
+  }
+
+  double count = double(BENCH_MASK) * BENCH_MASK_BLOCKS;
+  printf("[BENCH] IMPL=%-15s %s {%u}\n", name, best.format(count, "block", count * 128.0), uint32_t(acc & 1));
+  ::free(blocks);
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - Forward]
+// ============================================================================
+
+#define DOWNSAMPLE_CHECK_WIDTH 160
+#define FDCT_CHECK_BLOCKS 10000
+
+// Checks all combinations of R and G, each row of 256 pixels has all B values.
+static void dejpeg_check_rgb_ycbcr(const char* name, RgbToYCbCrFunc a, RgbToYCbCrFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  uint32_t src[256];
+  uint8_t aDst[3][256];
+  uint8_t bDst[3][256];
+
+  for (uint32_t r = 0; r < 256; r++) {
+    for (uint32_t g = 0; g < 256; g++) {
+      for (uint32_t k = 0; k < 256; k++)
+        src[k] = 0xFF000000U | (r << 16) | (g << 8) | k;
+
+      a(aDst[0], aDst[1], aDst[2], reinterpret_cast<const uint8_t*>(src), 256);
+      b(bDst[0], bDst[1], bDst[2], reinterpret_cast<const uint8_t*>(src), 256);
+
+      for (uint32_t k = 0; k < 256; k++) {
+        if (aDst[0][k] != bDst[0][k] || aDst[1][k] != bDst[1][k] || aDst[2][k] != bDst[2][k]) {
+          printf("FAILED [r=%u g=%u b=%u] a=[%d %d %d] b=[%d %d %d]\n", r, g, k,
+            aDst[0][k], aDst[1][k], aDst[2][k],
+            bDst[0][k], bDst[1][k], bDst[2][k]);
+        }
+      }
+    }
+  }
+}
+
+// Checks that the reference conversion is within 1 of the exact one and that
+// converting the result back gives (almost) the original pixel.
+static void dejpeg_check_rgb_ycbcr_accuracy(const char* name, RgbToYCbCrFunc func) {
+  printf("[CHECK] IMPL=%-15s (accuracy)\n", name);
+
+  uint32_t src[256];
+  uint8_t yy[256];
+  uint8_t cb[256];
+  uint8_t cr[256];
+
+  uint32_t maxError = 0;
+  uint32_t maxRoundTrip = 0;
+
+  for (uint32_t r = 0; r < 256; r += 3) {
+    for (uint32_t g = 0; g < 256; g += 5) {
+      for (uint32_t k = 0; k < 256; k++)
+        src[k] = 0xFF000000U | (r << 16) | (g << 8) | k;
+
+      func(yy, cb, cr, reinterpret_cast<const uint8_t*>(src), 256);
+
+      for (uint32_t k = 0; k < 256; k++) {
+        double fy  =  0.29900 * r + 0.58700 * g + 0.11400 * k;
+        double fcb = -0.16874 * r - 0.33126 * g + 0.50000 * k + 128.0;
+        double fcr =  0.50000 * r - 0.41869 * g - 0.08131 * k + 128.0;
+
+        uint32_t e = static_cast<uint32_t>(fabs(fy - yy[k]) + 0.5);
+        e = SimdUtils::max<uint32_t>(e, static_cast<uint32_t>(fabs(fcb - cb[k]) + 0.5));
+        e = SimdUtils::max<uint32_t>(e, static_cast<uint32_t>(fabs(fcr - cr[k]) + 0.5));
+        maxError = SimdUtils::max<uint32_t>(maxError, e);
+
+        uint32_t p = dejpeg_ycbcr_to_rgb32_pixel(yy[k], cb[k], cr[k]);
+        int dr = static_cast<int>((p >> 16) & 0xFF) - static_cast<int>(r);
+        int dg = static_cast<int>((p >>  8) & 0xFF) - static_cast<int>(g);
+        int db = static_cast<int>((p      ) & 0xFF) - static_cast<int>(k);
+        maxRoundTrip = SimdUtils::max<uint32_t>(maxRoundTrip, static_cast<uint32_t>(SimdUtils::max(SimdUtils::max(abs(dr), abs(dg)), abs(db))));
+      }
+    }
+  }
+
+  if (maxError > 1)
+    printf("FAILED max error %u\n", maxError);
+
+  // The conversion loses precision (Cb and Cr have a larger range than the
+  // difference of two channels), so round trips of saturated colors are off
+  // by few units, like in libjpeg.
+  if (maxRoundTrip > 3)
+    printf("FAILED max round trip error %u\n", maxRoundTrip);
+}
+
+// Checks all widths from 1 to 100. Nothing may be written past `count`.
+static void dejpeg_check_rgb_ycbcr_widths(const char* name, RgbToYCbCrFunc a, RgbToYCbCrFunc b) {
+  printf("[CHECK] IMPL=%-15s (widths)\n", name);
+
+  uint32_t src[100];
+  uint8_t aDst[3][101];
+  uint8_t bDst[3][101];
+
+  for (uint32_t k = 0; k < 100; k++)
+    src[k] = (k * 0x9E3779B9U) ^ (k << 7);
+
+  for (uint32_t count = 1; count <= 100; count++) {
+    ::memset(aDst, 0xCD, sizeof(aDst));
+    ::memset(bDst, 0xCD, sizeof(bDst));
+
+    a(aDst[0], aDst[1], aDst[2], reinterpret_cast<const uint8_t*>(src), count);
+    b(bDst[0], bDst[1], bDst[2], reinterpret_cast<const uint8_t*>(src), count);
+
+    if (::memcmp(aDst, bDst, sizeof(aDst)) != 0)
+      printf("FAILED [count=%u] output mismatch\n", count);
+
+    if (bDst[0][count] != 0xCD || bDst[1][count] != 0xCD || bDst[2][count] != 0xCD)
+      printf("FAILED [count=%u] written past the end\n", count);
+  }
+}
+
+static void dejpeg_bench_rgb_ycbcr(const char* name, RgbToYCbCrFunc func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  // Dummy counter to prevent optimizations.
+  uint32_t dummy = 0;
+
+  SIMD_ALIGN_VAR(uint32_t, src[128], 16);
+  SIMD_ALIGN_VAR(uint8_t, yy[128], 16);
+  SIMD_ALIGN_VAR(uint8_t, cb[128], 16);
+  SIMD_ALIGN_VAR(uint8_t, cr[128], 16);
+
+  for (uint32_t k = 0; k < 128; k++)
+    src[k] = 0xFF000000U | (k << 16) | ((255 - k) << 8) | (64 + k);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_YCBCR; i++) {
+      func(yy, cb, cr, reinterpret_cast<const uint8_t*>(src), 128);
+      dummy += yy[0];
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  printf("[BENCH] IMPL=%-15s %s {dummy=%u}\n", name, best.format(BENCH_YCBCR * 128.0, "px", BENCH_YCBCR * 128.0 * 4.0), dummy);
+}
+
+// Checks all widths up to `DOWNSAMPLE_CHECK_WIDTH` (odd widths replicate the
+// last sample). Nothing may be written past `(count + 1) / 2`.
+static void dejpeg_check_downsample_h2v1(const char* name, DeJpegDownsampleH2V1Func a, DeJpegDownsampleH2V1Func b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  uint8_t src[DOWNSAMPLE_CHECK_WIDTH];
+  uint8_t out_a[DOWNSAMPLE_CHECK_WIDTH / 2 + 1];
+  uint8_t out_b[DOWNSAMPLE_CHECK_WIDTH / 2 + 1];
+
+  for (uint32_t count = 1; count <= DOWNSAMPLE_CHECK_WIDTH; count++) {
+    uint32_t n = (count + 1) / 2;
+
+    dejpeg_fill_upsample_row(src, count, count);
+    ::memset(out_a, 0xCD, sizeof(out_a));
+    ::memset(out_b, 0xCD, sizeof(out_b));
+
+    a(out_a, src, count);
+    b(out_b, src, count);
+
+    if (::memcmp(out_a, out_b, n) != 0)
+      printf("FAILED [count=%u] output mismatch\n", count);
+
+    if (n < sizeof(out_b) && out_b[n] != 0xCD)
+      printf("FAILED [count=%u] written past the end\n", count);
+  }
+}
+
+static void dejpeg_check_downsample_h2v2(const char* name, DeJpegDownsampleH2V2Func a, DeJpegDownsampleH2V2Func b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  uint8_t src0[DOWNSAMPLE_CHECK_WIDTH];
+  uint8_t src1[DOWNSAMPLE_CHECK_WIDTH];
+  uint8_t out_a[DOWNSAMPLE_CHECK_WIDTH / 2 + 1];
+  uint8_t out_b[DOWNSAMPLE_CHECK_WIDTH / 2 + 1];
+
+  for (uint32_t count = 1; count <= DOWNSAMPLE_CHECK_WIDTH; count++) {
+    uint32_t n = (count + 1) / 2;
+
+    dejpeg_fill_upsample_row(src0, count, count * 3);
+    dejpeg_fill_upsample_row(src1, count, count * 5);
+    ::memset(out_a, 0xCD, sizeof(out_a));
+    ::memset(out_b, 0xCD, sizeof(out_b));
+
+    a(out_a, src0, src1, count);
+    b(out_b, src0, src1, count);
+
+    if (::memcmp(out_a, out_b, n) != 0)
+      printf("FAILED [count=%u] output mismatch\n", count);
+
+    if (n < sizeof(out_b) && out_b[n] != 0xCD)
+      printf("FAILED [count=%u] written past the end\n", count);
+  }
+}
+
+static void dejpeg_bench_downsample_h2v1(const char* name, DeJpegDownsampleH2V1Func func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  SIMD_ALIGN_VAR(uint8_t, src[BENCH_UPSAMPLE_WIDTH * 2], 16);
+  SIMD_ALIGN_VAR(uint8_t, dst[BENCH_UPSAMPLE_WIDTH], 16);
+
+  dejpeg_fill_upsample_row(src, BENCH_UPSAMPLE_WIDTH * 2, 0);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_UPSAMPLE; i++) {
+      func(dst, src, BENCH_UPSAMPLE_WIDTH * 2);
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  // Reports source bytes, which is the same amount as upsampling produces.
+  dejpeg_print_upsample_bench(name, best, 1);
+}
+
+static void dejpeg_bench_downsample_h2v2(const char* name, DeJpegDownsampleH2V2Func func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  SIMD_ALIGN_VAR(uint8_t, src0[BENCH_UPSAMPLE_WIDTH * 2], 16);
+  SIMD_ALIGN_VAR(uint8_t, src1[BENCH_UPSAMPLE_WIDTH * 2], 16);
+  SIMD_ALIGN_VAR(uint8_t, dst[BENCH_UPSAMPLE_WIDTH], 16);
+
+  dejpeg_fill_upsample_row(src0, BENCH_UPSAMPLE_WIDTH * 2, 3);
+  dejpeg_fill_upsample_row(src1, BENCH_UPSAMPLE_WIDTH * 2, 5);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_UPSAMPLE; i++) {
+      func(dst, src0, src1, BENCH_UPSAMPLE_WIDTH * 2);
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  dejpeg_print_upsample_bench(name, best, 2);
+}
+
+// Fills an 8x8 block of samples (having `stride`) by one of the patterns that
+// stress the range of intermediates, or by random samples if `pattern` is out
+// of range.
+static void dejpeg_fill_fdct_block(uint8_t* dst, intptr_t stride, uint32_t pattern, uint32_t& seed) {
+  for (uint32_t y = 0; y < 8; y++) {
+    for (uint32_t x = 0; x < 8; x++) {
+      uint32_t v;
+      switch (pattern) {
+        case 0 : v = 0; break;
+        case 1 : v = 255; break;
+        case 2 : v = ((x ^ y) & 1) ? 255 : 0; break;
+        case 3 : v = (y & 1) ? 255 : 0; break;
+        case 4 : v = (x & 1) ? 255 : 0; break;
+        case 5 : v = (x < 4) == (y < 4) ? 255 : 0; break;
+        case 6 : v = (dejpeg_ieee1180_random(seed, 0, 1) != 0) ? 255 : 0; break;
+        default: v = static_cast<uint32_t>(dejpeg_ieee1180_random(seed, 0, 255)); break;
+      }
+      dst[y * stride + x] = static_cast<uint8_t>(v);
+    }
+  }
+}
+
+// Compares `a` and `b` on blocks quantized by several qualities (100 means all
+// divisors are 8, the worst case for the range of quantized coefficients).
+static void dejpeg_check_fdct(const char* name, DeJpegFDCTFunc a, DeJpegFDCTFunc b) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  static const uint32_t qualities[] = { 100, 95, 75, 50, 10, 1 };
+
+  SIMD_ALIGN_VAR(uint16_t, divisors[JPEG_FDCT_DIVISORS_SIZE], 16);
+  SIMD_ALIGN_VAR(int16_t, out_a[64], 16);
+  SIMD_ALIGN_VAR(int16_t, out_b[64], 16);
+
+  uint16_t qTable[64];
+
+  // Not aligned on purpose.
+  uint8_t pixels[8 * 13 + 3];
+  uint8_t* src = pixels + 3;
+
+  uint32_t seed = 1;
+  uint32_t failures = 0;
+
+  for (uint32_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+    dejpeg_accuracy_qtable(qTable, qualities[q]);
+    dejpeg_fdct_islow_divisors(divisors, qTable);
+
+    for (uint32_t i = 0; i < FDCT_CHECK_BLOCKS; i++) {
+      uint32_t pattern = i < 6 ? i : (i & 1) ? 6 : 7;
+      dejpeg_fill_fdct_block(src, 13, pattern, seed);
+
+      a(out_a, src, 13, divisors);
+      b(out_b, src, 13, divisors);
+
+      if (::memcmp(out_a, out_b, sizeof(out_a)) != 0 && ++failures <= 10) {
+        printf("FAILED [quality=%u block=%u]\n", qualities[q], i);
+        dejpeg_compare_data8x8(out_a, out_b);
+      }
+    }
+  }
+}
+
+// Checks the reference FDCT against the exact transform followed by rounded
+// division, all coefficients must be within 1.
+static void dejpeg_check_fdct_accuracy(const char* name, DeJpegFDCTFunc func) {
+  printf("[CHECK] IMPL=%-15s (accuracy)\n", name);
+
+  SIMD_ALIGN_VAR(uint16_t, divisors[JPEG_FDCT_DIVISORS_SIZE], 16);
+  SIMD_ALIGN_VAR(int16_t, out[64], 16);
+
+  uint16_t qTable[64];
+  uint8_t src[64];
+  double pixels[64];
+  double freq[64];
+
+  uint32_t seed = 7;
+  uint32_t maxError = 0;
+
+  for (uint32_t quality = 50; quality <= 100; quality += 50) {
+    dejpeg_accuracy_qtable(qTable, quality);
+    dejpeg_fdct_islow_divisors(divisors, qTable);
+
+    for (uint32_t i = 0; i < FDCT_CHECK_BLOCKS; i++) {
+      dejpeg_fill_fdct_block(src, 8, i < 7 ? i : 7, seed);
+      for (uint32_t k = 0; k < 64; k++)
+        pixels[k] = static_cast<double>(src[k]) - 128.0;
+
+      func(out, src, 8, divisors);
+      dejpeg_fdct_double(freq, pixels);
+
+      for (uint32_t k = 0; k < 64; k++) {
+        int32_t expected = static_cast<int32_t>(floor(freq[k] / static_cast<double>(qTable[k]) + 0.5));
+        maxError = SimdUtils::max<uint32_t>(maxError, static_cast<uint32_t>(abs(expected - out[k])));
+      }
+    }
+  }
+
+  if (maxError > 1)
+    printf("FAILED max error %u\n", maxError);
+}
+
+// Quantization by reciprocals must give exactly `(|x| + d / 2) / d` for all
+// divisors and all 16-bit magnitudes.
+static void dejpeg_check_fdct_divisors() {
+  printf("[CHECK] IMPL=%-15s\n", "fdct-divisors");
+
+  uint16_t qTable[64];
+  uint16_t divisors[JPEG_FDCT_DIVISORS_SIZE];
+
+  for (uint32_t q = 1; q <= 255; q++) {
+    for (uint32_t i = 0; i < 64; i++)
+      qTable[i] = static_cast<uint16_t>(q);
+    dejpeg_fdct_islow_divisors(divisors, qTable);
+
+    uint32_t d = q * 8;
+    for (uint32_t x = 0; x < 32768; x++) {
+      uint32_t expected = (x + d / 2) / d;
+      uint32_t actual = (((x + divisors[64]) * divisors[0]) >> 16) * divisors[128] >> 16;
+
+      if (actual != expected) {
+        printf("FAILED [q=%u x=%u] expected=%u actual=%u\n", q, x, expected, actual);
+        break;
+      }
+    }
+  }
+}
+
+static void dejpeg_bench_fdct(const char* name, DeJpegFDCTFunc func) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  // Dummy counter to prevent optimizations.
+  uint32_t dummy = 0;
+
+  SIMD_ALIGN_VAR(uint16_t, divisors[JPEG_FDCT_DIVISORS_SIZE], 16);
+  SIMD_ALIGN_VAR(int16_t, coeff[64], 16);
+
+  uint16_t qTable[64];
+  uint8_t pixels[64];
+  uint32_t seed = 3;
+
+  dejpeg_accuracy_qtable(qTable, 75);
+  dejpeg_fdct_islow_divisors(divisors, qTable);
+  dejpeg_fill_fdct_block(pixels, 8, 7, seed);
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < BENCH_ITER_IDCT; i++) {
+      func(coeff, pixels, 8, divisors);
+      dummy += static_cast<uint32_t>(coeff[0]);
+    }
+    timer.stop();
+    best.update(timer);
+  }
+
+  printf("[BENCH] IMPL=%-15s %s {dummy=%u}\n", name, best.format(BENCH_ITER_IDCT, "block", BENCH_ITER_IDCT * 64.0), dummy);
+}
+
+// Zig-zag followed by de-zig-zag must give the original block back, values
+// have both bytes non-zero and the sign bit set to catch mixed up halves.
+static void dejpeg_check_zigzag_roundtrip(const char* name, DeJpegZigZag8x8Func func) {
+  printf("[CHECK] IMPL=%-15s (roundtrip)\n", name);
+
+  SIMD_ALIGN_VAR(int16_t, data[64], 16);
+  SIMD_ALIGN_VAR(int16_t, zz[64], 16);
+  SIMD_ALIGN_VAR(int16_t, out[64], 16);
+
+  for (uint32_t i = 0; i < 64; i++)
+    data[i] = static_cast<int16_t>(0x8001 + i * 0x0403);
+
+  func(zz, data);
+  dejpeg_dezigzag_ref(out, zz);
+  dejpeg_compare_data8x8(data, out);
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - Decoder]
+// ============================================================================
+
+// Standard chrominance tables from Annex K.3.
+static const uint8_t dejpeg_std_dc_chroma_counts[16] = {
+  0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0
+};
+
+static const uint8_t dejpeg_std_dc_chroma_values[12] = {
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+static const uint8_t dejpeg_std_ac_chroma_counts[16] = {
+  0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77
+};
+
+static const uint8_t dejpeg_std_ac_chroma_values[162] = {
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+  0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+  0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+  0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+  0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+  0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+  0xF9, 0xFA
+};
+
+// Standard quantization tables from Annex K.1 (natural order).
+static const uint8_t dejpeg_std_luma_quant[64] = {
+  16, 11, 10, 16, 24 , 40 , 51 , 61 ,
+  12, 12, 14, 19, 26 , 58 , 60 , 55 ,
+  14, 13, 16, 24, 40 , 57 , 69 , 56 ,
+  14, 17, 22, 29, 51 , 87 , 80 , 62 ,
+  18, 22, 37, 56, 68 , 109, 103, 77 ,
+  24, 35, 55, 64, 81 , 104, 113, 92 ,
+  49, 64, 78, 87, 103, 121, 120, 101,
+  72, 92, 95, 98, 112, 100, 103, 99
+};
+
+static const uint8_t dejpeg_std_chroma_quant[64] = {
+  17, 18, 24, 47, 99, 99, 99, 99,
+  18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99,
+  47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99
+};
+
+enum DeJpegTestSampling {
+  kJpegTestGray = 0,
+  kJpegTest444  = 1,
+  kJpegTest422  = 2,
+  kJpegTest420  = 3
+};
+
+enum DeJpegTestProgression {
+  kJpegTestBaseline = 0,
+  // libjpeg's `jpeg_simple_progression()`.
+  kJpegTestSimple   = 1,
+  // Non-interleaved DC scans, DC and AC refined by several scans.
+  kJpegTestSpectral = 2
+};
+
+// Images the decoder is checked and benchmarked on. There are no image files
+// in the repository, the corpus is generated by a minimal encoder.
+struct DeJpegTestCorpusEntry {
+  const char* name;
+  uint32_t width;
+  uint32_t height;
+  uint32_t sampling;
+  uint32_t restartInterval;
+  uint32_t progression;
+  bool bench;
+};
+
+static const DeJpegTestCorpusEntry dejpeg_test_corpus[] = {
+  { "gray-640x480"          , 640 , 480 , kJpegTestGray, 0  , kJpegTestBaseline, true  },
+  { "444-640x480"           , 640 , 480 , kJpegTest444 , 0  , kJpegTestBaseline, true  },
+  { "422-640x480"           , 640 , 480 , kJpegTest422 , 0  , kJpegTestBaseline, true  },
+  { "420-640x480"           , 640 , 480 , kJpegTest420 , 0  , kJpegTestBaseline, true  },
+  { "420-1920x1080-rst"     , 1920, 1080, kJpegTest420 , 120, kJpegTestBaseline, true  },
+  { "gray-31x7"             , 31  , 7   , kJpegTestGray, 0  , kJpegTestBaseline, false },
+  { "444-17x9-rst1"         , 17  , 9   , kJpegTest444 , 1  , kJpegTestBaseline, false },
+  { "422-97x65-rst3"        , 97  , 65  , kJpegTest422 , 3  , kJpegTestBaseline, false },
+  { "420-333x251-rst7"      , 333 , 251 , kJpegTest420 , 7  , kJpegTestBaseline, false },
+  { "444-200x120-rst40"     , 200 , 120 , kJpegTest444 , 40 , kJpegTestBaseline, false },
+  { "420-400x304-rst60"     , 400 , 304 , kJpegTest420 , 60 , kJpegTestBaseline, false },
+  { "420-1x1"               , 1   , 1   , kJpegTest420 , 0  , kJpegTestBaseline, false },
+  { "prog-420-640x480"      , 640 , 480 , kJpegTest420 , 0  , kJpegTestSimple  , true  },
+  { "prog-gray-31x7"        , 31  , 7   , kJpegTestGray, 0  , kJpegTestSimple  , false },
+  { "prog-444-17x9-rst1"    , 17  , 9   , kJpegTest444 , 1  , kJpegTestSimple  , false },
+  { "prog-422-97x65"        , 97  , 65  , kJpegTest422 , 0  , kJpegTestSpectral, false },
+  { "prog-420-333x251-rst7" , 333 , 251 , kJpegTest420 , 7  , kJpegTestSpectral, false },
+  { "prog-420-400x304-rst60", 400 , 304 , kJpegTest420 , 60 , kJpegTestSimple  , false },
+  { "prog-420-1x1"          , 1   , 1   , kJpegTest420 , 0  , kJpegTestSpectral, false }
+};
+
+// Synthetic photo-like RGB24 image - smooth gradients, some edges and noise.
+static void dejpeg_test_random_image(uint8_t* rgb, uint32_t w, uint32_t h, uint32_t seed) {
+  SimdRandom rnd(seed);
+
+  for (uint32_t y = 0; y < h; y++) {
+    for (uint32_t x = 0; x < w; x++) {
+      double fx = double(x) / double(w);
+      double fy = double(y) / double(h);
+
+      int noise = static_cast<int>(rnd.nextUInt32() % 9) - 4;
+      int edge = ((x / 48) + (y / 32)) & 1 ? 24 : -24;
+
+      int r = static_cast<int>(128.0 + 90.0 * sin(fx * 9.0 + fy * 3.0)) + noise;
+      int g = static_cast<int>(40.0 + 170.0 * fx * fy) + edge + noise;
+      int b = static_cast<int>(200.0 - 150.0 * fy + 30.0 * cos(fx * 20.0)) + noise;
+
+      uint8_t* p = rgb + (y * w + x) * 3;
+      p[0] = clampToByte(r);
+      p[1] = clampToByte(g);
+      p[2] = clampToByte(b);
+    }
+  }
+}
+
+static void dejpeg_test_put_marker(uint8_t*& p, uint32_t marker, uint32_t length) {
+  p[0] = 0xFF;
+  p[1] = static_cast<uint8_t>(marker);
+  p[2] = static_cast<uint8_t>(length >> 8);
+  p[3] = static_cast<uint8_t>(length & 0xFF);
+  p += 4;
+}
+
+static void dejpeg_test_put_dht(uint8_t*& p, uint32_t tcth, const uint8_t* counts, const uint8_t* values) {
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < 16; i++)
+    n += counts[i];
+
+  dejpeg_test_put_marker(p, 0xC4, 2 + 17 + n);
+  *p++ = static_cast<uint8_t>(tcth);
+  ::memcpy(p, counts, 16);
+  ::memcpy(p + 16, values, n);
+  p += 16 + n;
+}
+
+// Returns a table mapping natural positions to zig-zag indexes, the inverse
+// of what `dejpeg_dezigzag_ref()` uses.
+static const uint8_t* dejpeg_test_zigzag_index() {
+  static uint8_t table[64];
+  static bool initialized = false;
+
+  if (!initialized) {
+    int16_t identity[64];
+    int16_t natural[64];
+
+    for (uint32_t i = 0; i < 64; i++)
+      identity[i] = static_cast<int16_t>(i);
+
+    dejpeg_dezigzag_ref(natural, identity);
+    for (uint32_t i = 0; i < 64; i++)
+      table[i] = static_cast<uint8_t>(natural[i]);
+    initialized = true;
+  }
+
+  return table;
+}
+
+// Float forward DCT of a block of samples centered around zero, quantized by
+// `q` (natural order) and stored to `zz` in zig-zag order.
+static void dejpeg_test_fdct(int16_t* zz, const double* src, const uint16_t* q) {
+  const uint8_t* zigzagIndex = dejpeg_test_zigzag_index();
+  double tmp[64];
+
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    const double* in = pass == 0 ? src : tmp;
+    double out[64];
+
+    // Rows of the first pass, columns of the second pass (transposed).
+    for (uint32_t i = 0; i < 8; i++) {
+      for (uint32_t u = 0; u < 8; u++) {
+        double sum = 0.0;
+        for (uint32_t x = 0; x < 8; x++)
+          sum += in[i * 8 + x] * cos(double(2 * x + 1) * double(u) * 3.14159265358979323846 / 16.0);
+        out[u * 8 + i] = sum * (u == 0 ? 0.35355339059327376 : 0.5);
+      }
+    }
+
+    ::memcpy(tmp, out, sizeof(out));
+  }
+
+  for (uint32_t i = 0; i < 64; i++) {
+    double v = tmp[i] / double(q[i]);
+    zz[zigzagIndex[i]] = static_cast<int16_t>(v < 0.0 ? -floor(-v + 0.5) : floor(v + 0.5));
+  }
+}
+
+// Progressive scripts, each scan is a mask of components, the spectral band
+// `[ss, se]` and the successive approximation `ah, al`. Scans of components
+// not present in the image are left out.
+struct DeJpegTestScanScript {
+  uint32_t components;
+  uint32_t ss, se;
+  uint32_t ah, al;
+};
+
+static const DeJpegTestScanScript dejpeg_test_simple_script[] = {
+  { 7, 0, 0 , 0, 1 },
+  { 1, 1, 5 , 0, 2 },
+  { 4, 1, 63, 0, 1 },
+  { 2, 1, 63, 0, 1 },
+  { 1, 6, 63, 0, 2 },
+  { 1, 1, 63, 2, 1 },
+  { 7, 0, 0 , 1, 0 },
+  { 4, 1, 63, 1, 0 },
+  { 2, 1, 63, 1, 0 },
+  { 1, 1, 63, 1, 0 },
+  { 0, 0, 0 , 0, 0 }
+};
+
+static const DeJpegTestScanScript dejpeg_test_spectral_script[] = {
+  { 1, 0, 0 , 0, 2 },
+  { 2, 0, 0 , 0, 0 },
+  { 4, 0, 0 , 0, 0 },
+  { 1, 1, 2 , 0, 0 },
+  { 1, 3, 63, 0, 3 },
+  { 1, 0, 0 , 2, 1 },
+  { 1, 3, 63, 3, 2 },
+  { 2, 1, 63, 0, 0 },
+  { 4, 1, 63, 0, 0 },
+  { 1, 0, 0 , 1, 0 },
+  { 1, 3, 63, 2, 1 },
+  { 1, 3, 63, 1, 0 },
+  { 0, 0, 0 , 0, 0 }
+};
+
+// Quantized coefficients (zig-zag order) of an image being encoded. Blocks of
+// each component are stored a block row after another and cover whole MCUs,
+// like the coefficient arenas of the decoder.
+struct DeJpegTestFrame {
+  uint32_t w, h, nc;
+  uint32_t hs, vs;
+  uint32_t mcusPerLine, mcuRows;
+  uint32_t restartInterval;
+
+  uint32_t blocksPerLine[3];
+  int16_t* coeffs[3];
+};
+
+static int16_t* dejpeg_test_frame_block(const DeJpegTestFrame* f, uint32_t c, uint32_t bx, uint32_t by) {
+  return f->coeffs[c] + (size_t(by) * f->blocksPerLine[c] + bx) * 64;
+}
+
+static void dejpeg_test_frame_init(DeJpegTestFrame* f, const uint8_t* rgb, uint32_t w, uint32_t h, uint32_t sampling, uint32_t restartInterval, uint16_t quant[2][64]) {
+  f->w = w;
+  f->h = h;
+  f->nc = sampling == kJpegTestGray ? 1 : 3;
+  f->hs = sampling == kJpegTest422 || sampling == kJpegTest420 ? 2 : 1;
+  f->vs = sampling == kJpegTest420 ? 2 : 1;
+  f->mcusPerLine = (w + f->hs * 8 - 1) / (f->hs * 8);
+  f->mcuRows = (h + f->vs * 8 - 1) / (f->vs * 8);
+  f->restartInterval = restartInterval;
+
+  // Full resolution planes converted as described by JFIF.
+  double* planes = static_cast<double*>(::malloc(w * h * 3 * sizeof(double)));
+  for (uint32_t i = 0; i < w * h; i++) {
+    double r = rgb[i * 3 + 0];
+    double g = rgb[i * 3 + 1];
+    double b = rgb[i * 3 + 2];
+
+    planes[i            ] =  0.29900 * r + 0.58700 * g + 0.11400 * b;
+    planes[i + w * h    ] = -0.16874 * r - 0.33126 * g + 0.50000 * b + 128.0;
+    planes[i + w * h * 2] =  0.50000 * r - 0.41869 * g - 0.08131 * b + 128.0;
+  }
+
+  for (uint32_t c = 0; c < f->nc; c++) {
+    uint32_t ch = c == 0 ? f->hs : 1;
+    uint32_t cv = c == 0 ? f->vs : 1;
+
+    // Size of a sample of this component in pixels.
+    uint32_t sx = f->hs / ch;
+    uint32_t sy = f->vs / cv;
+
+    uint32_t blockRows = f->mcuRows * cv;
+    f->blocksPerLine[c] = f->mcusPerLine * ch;
+    f->coeffs[c] = static_cast<int16_t*>(::malloc(size_t(f->blocksPerLine[c]) * blockRows * 64 * sizeof(int16_t)));
+
+    for (uint32_t by = 0; by < blockRows; by++) {
+      for (uint32_t bx = 0; bx < f->blocksPerLine[c]; bx++) {
+        double block[64];
+
+        for (uint32_t y = 0; y < 8; y++) {
+          for (uint32_t x = 0; x < 8; x++) {
+            uint32_t px = bx * 8 + x;
+            uint32_t py = by * 8 + y;
+            double sum = 0.0;
+
+            // Edge samples are replicated, subsampled chroma is averaged.
+            for (uint32_t yy = 0; yy < sy; yy++) {
+              for (uint32_t xx = 0; xx < sx; xx++) {
+                uint32_t ix = SimdUtils::min<uint32_t>(px * sx + xx, w - 1);
+                uint32_t iy = SimdUtils::min<uint32_t>(py * sy + yy, h - 1);
+                sum += planes[c * w * h + iy * w + ix];
+              }
+            }
+
+            block[y * 8 + x] = sum / double(sx * sy) - 128.0;
+          }
+        }
+
+        dejpeg_test_fdct(dejpeg_test_frame_block(f, c, bx, by), block, quant[c == 0 ? 0 : 1]);
+      }
+    }
+  }
+
+  ::free(planes);
+}
+
+static void dejpeg_test_frame_free(DeJpegTestFrame* f) {
+  for (uint32_t c = 0; c < f->nc; c++)
+    ::free(f->coeffs[c]);
+}
+
+static void dejpeg_test_put_rst(DeJpegTestBitWriter* bw, uint32_t index) {
+  dejpeg_test_bits_flush(bw);
+  bw->ptr[0] = 0xFF;
+  bw->ptr[1] = static_cast<uint8_t>(0xD0 + (index & 7));
+  bw->ptr += 2;
+}
+
+// Writes DHT (standard tables), SOS and a single interleaved scan.
+static uint8_t* dejpeg_test_put_baseline_scan(uint8_t* p, const DeJpegTestFrame* f) {
+  uint32_t nc = f->nc;
+  uint32_t i;
+
+  // DHT.
+  dejpeg_test_put_dht(p, 0x00, dejpeg_std_dc_luma_counts, dejpeg_std_dc_luma_values);
+  dejpeg_test_put_dht(p, 0x10, dejpeg_std_ac_luma_counts, dejpeg_std_ac_luma_values);
+  if (nc > 1) {
+    dejpeg_test_put_dht(p, 0x01, dejpeg_std_dc_chroma_counts, dejpeg_std_dc_chroma_values);
+    dejpeg_test_put_dht(p, 0x11, dejpeg_std_ac_chroma_counts, dejpeg_std_ac_chroma_values);
+  }
+
+  // SOS.
+  dejpeg_test_put_marker(p, 0xDA, 2 + 1 + nc * 2 + 3);
+  *p++ = static_cast<uint8_t>(nc);
+  for (i = 0; i < nc; i++) {
+    p[0] = static_cast<uint8_t>(i + 1);
+    p[1] = static_cast<uint8_t>(i == 0 ? 0x00 : 0x11);
+    p += 2;
+  }
+  p[0] = 0;
+  p[1] = 63;
+  p[2] = 0;
+  p += 3;
+
+  DeJpegTestHuffCodes dcCodes[2];
+  DeJpegTestHuffCodes acCodes[2];
+
+  dejpeg_test_huff_codes(&dcCodes[0], dejpeg_std_dc_luma_counts, dejpeg_std_dc_luma_values);
+  dejpeg_test_huff_codes(&acCodes[0], dejpeg_std_ac_luma_counts, dejpeg_std_ac_luma_values);
+  dejpeg_test_huff_codes(&dcCodes[1], dejpeg_std_dc_chroma_counts, dejpeg_std_dc_chroma_values);
+  dejpeg_test_huff_codes(&acCodes[1], dejpeg_std_ac_chroma_counts, dejpeg_std_ac_chroma_values);
+
+  DeJpegTestBitWriter bw = { p, 0, 0 };
+  int32_t dcPred[3] = { 0, 0, 0 };
+
+  uint32_t ri = f->restartInterval;
+  uint32_t mcuIndex = 0;
+
+  for (uint32_t my = 0; my < f->mcuRows; my++) {
+    for (uint32_t mx = 0; mx < f->mcusPerLine; mx++, mcuIndex++) {
+      if (ri && mcuIndex && mcuIndex % ri == 0) {
+        dejpeg_test_put_rst(&bw, mcuIndex / ri - 1);
+        dcPred[0] = dcPred[1] = dcPred[2] = 0;
+      }
+
+      for (uint32_t c = 0; c < nc; c++) {
+        uint32_t ch = c == 0 ? f->hs : 1;
+        uint32_t cv = c == 0 ? f->vs : 1;
+
+        for (uint32_t by = 0; by < cv; by++)
+          for (uint32_t bx = 0; bx < ch; bx++)
+            dejpeg_test_encode_block(&bw, dejpeg_test_frame_block(f, c, mx * ch + bx, my * cv + by), &dcCodes[c == 0 ? 0 : 1], &acCodes[c == 0 ? 0 : 1], &dcPred[c]);
+      }
+    }
+  }
+
+  dejpeg_test_bits_flush(&bw);
+  return bw.ptr;
+}
+
+// Port of libjpeg's `jpeg_gen_optimal_table()` - builds a DHT table limited to
+// 16-bit codes from symbol frequencies `freq` (257 entries, the last one is
+// reserved so no code consists of all ones).
+static void dejpeg_test_optimal_table(uint8_t* counts, uint8_t* values, const uint32_t* srcFreq) {
+  int64_t freq[257];
+  uint32_t codeSize[257];
+  int32_t others[257];
+  uint32_t bits[33];
+  int32_t i, j;
+
+  for (i = 0; i < 257; i++) {
+    freq[i] = srcFreq[i];
+    codeSize[i] = 0;
+    others[i] = -1;
+  }
+  freq[256] = 1;
+
+  for (;;) {
+    // The two least frequent symbols, ties go to the larger symbol.
+    int32_t c1 = -1;
+    int32_t c2 = -1;
+    int64_t v = int64_t(1) << 62;
+
+    for (i = 0; i < 257; i++) {
+      if (freq[i] && freq[i] <= v) {
+        v = freq[i];
+        c1 = i;
+      }
+    }
+
+    v = int64_t(1) << 62;
+    for (i = 0; i < 257; i++) {
+      if (freq[i] && freq[i] <= v && i != c1) {
+        v = freq[i];
+        c2 = i;
+      }
+    }
+
+    if (c2 < 0)
+      break;
+
+    freq[c1] += freq[c2];
+    freq[c2] = 0;
+
+    codeSize[c1]++;
+    while (others[c1] >= 0) {
+      c1 = others[c1];
+      codeSize[c1]++;
+    }
+    others[c1] = c2;
+
+    codeSize[c2]++;
+    while (others[c2] >= 0) {
+      c2 = others[c2];
+      codeSize[c2]++;
+    }
+  }
+
+  ::memset(bits, 0, sizeof(bits));
+  for (i = 0; i < 257; i++)
+    if (codeSize[i])
+      bits[codeSize[i]]++;
+
+  // Limits code lengths to 16 bits as described by K.2.
+  for (i = 32; i > 16; i--) {
+    while (bits[i] > 0) {
+      j = i - 2;
+      while (bits[j] == 0)
+        j--;
+
+      bits[i] -= 2;
+      bits[i - 1]++;
+      bits[j + 1] += 2;
+      bits[j]--;
+    }
+  }
+
+  // Removes the reserved symbol, which has the longest code.
+  while (bits[i] == 0)
+    i--;
+  bits[i]--;
+
+  for (i = 0; i < 16; i++)
+    counts[i] = static_cast<uint8_t>(bits[i + 1]);
+
+  uint32_t n = 0;
+  for (i = 1; i <= 32; i++)
+    for (j = 0; j < 256; j++)
+      if (codeSize[j] == uint32_t(i))
+        values[n++] = static_cast<uint8_t>(j);
+}
+
+// Progressive Huffman encoder, mirrors libjpeg's `jcphuff.c`. The first pass
+// only counts symbols of each table (`freq` is not NULL), the second pass
+// writes the scan by using optimal tables built from the counts.
+#define JPEG_TEST_MAX_CORR_BITS 1000
+
+struct DeJpegTestPhuff {
+  DeJpegTestBitWriter bw;
+  uint32_t (*freq)[257];
+  DeJpegTestHuffCodes codes[4];
+
+  // Current EOB run, buffered correction bits of the blocks in the run and
+  // the AC table of the scan (tables 0-1 are DC, 2-3 are AC).
+  uint32_t eobRun;
+  uint32_t be;
+  uint32_t acTable;
+  uint8_t corrBits[JPEG_TEST_MAX_CORR_BITS];
+};
+
+static void dejpeg_test_phuff_symbol(DeJpegTestPhuff* st, uint32_t table, uint32_t symbol) {
+  if (st->freq)
+    st->freq[table][symbol]++;
+  else
+    dejpeg_test_bits_put(&st->bw, st->codes[table].code[symbol], st->codes[table].size[symbol]);
+}
+
+static void dejpeg_test_phuff_bits(DeJpegTestPhuff* st, uint32_t bits, uint32_t n) {
+  if (!st->freq && n)
+    dejpeg_test_bits_put(&st->bw, bits, n);
+}
+
+static void dejpeg_test_phuff_corr_bits(DeJpegTestPhuff* st, const uint8_t* bits, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++)
+    dejpeg_test_phuff_bits(st, bits[i], 1);
+}
+
+static void dejpeg_test_phuff_eob_run(DeJpegTestPhuff* st) {
+  if (st->eobRun == 0)
+    return;
+
+  uint32_t n = dejpeg_test_bit_size(static_cast<int32_t>(st->eobRun)) - 1;
+  dejpeg_test_phuff_symbol(st, st->acTable, n << 4);
+  dejpeg_test_phuff_bits(st, st->eobRun, n);
+  st->eobRun = 0;
+
+  dejpeg_test_phuff_corr_bits(st, st->corrBits, st->be);
+  st->be = 0;
+}
+
+static void dejpeg_test_phuff_dc_first(DeJpegTestPhuff* st, const int16_t* zz, uint32_t table, int32_t* dcPred, uint32_t al) {
+  int32_t v = static_cast<int32_t>(zz[0]) >> al;
+  int32_t diff = v - *dcPred;
+  uint32_t s = dejpeg_test_bit_size(diff);
+
+  *dcPred = v;
+  dejpeg_test_phuff_symbol(st, table, s);
+  dejpeg_test_phuff_bits(st, static_cast<uint32_t>(diff < 0 ? diff - 1 : diff), s);
+}
+
+static void dejpeg_test_phuff_dc_refine(DeJpegTestPhuff* st, const int16_t* zz, uint32_t al) {
+  dejpeg_test_phuff_bits(st, static_cast<uint32_t>(zz[0] >> al) & 1, 1);
+}
+
+static void dejpeg_test_phuff_ac_first(DeJpegTestPhuff* st, const int16_t* zz, const DeJpegTestScanScript& scan) {
+  uint32_t run = 0;
+
+  for (uint32_t k = scan.ss; k <= scan.se; k++) {
+    int32_t v = zz[k];
+    int32_t a = (v < 0 ? -v : v) >> scan.al;
+
+    if (a == 0) {
+      run++;
+      continue;
+    }
+
+    dejpeg_test_phuff_eob_run(st);
+    for (; run > 15; run -= 16)
+      dejpeg_test_phuff_symbol(st, st->acTable, 0xF0);
+
+    uint32_t s = dejpeg_test_bit_size(a);
+    dejpeg_test_phuff_symbol(st, st->acTable, (run << 4) | s);
+    dejpeg_test_phuff_bits(st, static_cast<uint32_t>(v < 0 ? -a - 1 : a), s);
+    run = 0;
+  }
+
+  if (run && ++st->eobRun == 0x7FFF)
+    dejpeg_test_phuff_eob_run(st);
+}
+
+static void dejpeg_test_phuff_ac_refine(DeJpegTestPhuff* st, const int16_t* zz, const DeJpegTestScanScript& scan) {
+  uint32_t ss = scan.ss;
+  uint32_t se = scan.se;
+  uint32_t k;
+
+  // Magnitudes in the current bit position and the last one that becomes
+  // non-zero by this scan, ZRL isn't emitted after it.
+  int32_t a[64];
+  uint32_t eob = 0;
+
+  for (k = ss; k <= se; k++) {
+    a[k] = (zz[k] < 0 ? -zz[k] : zz[k]) >> scan.al;
+    if (a[k] == 1)
+      eob = k;
+  }
+
+  // Correction bits of this block are appended after the bits of the EOB run
+  // and emitted with the next symbol of this block.
+  uint8_t* br = st->corrBits + st->be;
+  uint32_t brCount = 0;
+  uint32_t run = 0;
+
+  for (k = ss; k <= se; k++) {
+    if (a[k] == 0) {
+      run++;
+      continue;
+    }
+
+    while (run > 15 && k <= eob) {
+      dejpeg_test_phuff_eob_run(st);
+      dejpeg_test_phuff_symbol(st, st->acTable, 0xF0);
+      run -= 16;
+
+      dejpeg_test_phuff_corr_bits(st, br, brCount);
+      br = st->corrBits;
+      brCount = 0;
+    }
+
+    // Previously non-zero coefficient, only its correction bit is sent.
+    if (a[k] > 1) {
+      br[brCount++] = static_cast<uint8_t>(a[k] & 1);
+      continue;
+    }
+
+    dejpeg_test_phuff_eob_run(st);
+    dejpeg_test_phuff_symbol(st, st->acTable, (run << 4) | 1);
+    dejpeg_test_phuff_bits(st, zz[k] < 0 ? 0 : 1, 1);
+
+    dejpeg_test_phuff_corr_bits(st, br, brCount);
+    br = st->corrBits;
+    brCount = 0;
+    run = 0;
+  }
+
+  if (run || brCount) {
+    st->eobRun++;
+    st->be += brCount;
+
+    if (st->eobRun == 0x7FFF || st->be > JPEG_TEST_MAX_CORR_BITS - 64 + 1)
+      dejpeg_test_phuff_eob_run(st);
+  }
+}
+
+// Encodes (or counts symbols of) a single scan of components `comps`.
+static void dejpeg_test_phuff_scan(DeJpegTestPhuff* st, const DeJpegTestFrame* f, const uint32_t* comps, uint32_t ns, const DeJpegTestScanScript& scan) {
+  uint32_t unitsPerLine = f->mcusPerLine;
+  uint32_t unitRows = f->mcuRows;
+
+  // Non-interleaved scans only cover blocks of the component (A.2.2).
+  if (ns == 1) {
+    uint32_t c = comps[0];
+    uint32_t ch = c == 0 ? f->hs : 1;
+    uint32_t cv = c == 0 ? f->vs : 1;
+    uint32_t compW = (f->w * ch + f->hs - 1) / f->hs;
+    uint32_t compH = (f->h * cv + f->vs - 1) / f->vs;
+
+    unitsPerLine = (compW + 7) / 8;
+    unitRows = (compH + 7) / 8;
+  }
+
+  uint32_t ri = f->restartInterval;
+  uint32_t unitIndex = 0;
+  int32_t dcPred[3] = { 0, 0, 0 };
+
+  st->eobRun = 0;
+  st->be = 0;
+  st->acTable = 2 + (comps[0] == 0 ? 0 : 1);
+
+  for (uint32_t uy = 0; uy < unitRows; uy++) {
+    for (uint32_t ux = 0; ux < unitsPerLine; ux++, unitIndex++) {
+      if (ri && unitIndex && unitIndex % ri == 0) {
+        dejpeg_test_phuff_eob_run(st);
+        if (!st->freq)
+          dejpeg_test_put_rst(&st->bw, unitIndex / ri - 1);
+        dcPred[0] = dcPred[1] = dcPred[2] = 0;
+      }
+
+      for (uint32_t i = 0; i < ns; i++) {
+        uint32_t c = comps[i];
+        uint32_t ch = ns == 1 ? 1 : (c == 0 ? f->hs : 1);
+        uint32_t cv = ns == 1 ? 1 : (c == 0 ? f->vs : 1);
+
+        for (uint32_t by = 0; by < cv; by++) {
+          for (uint32_t bx = 0; bx < ch; bx++) {
+            const int16_t* zz = dejpeg_test_frame_block(f, c, ux * ch + bx, uy * cv + by);
+
+            if (scan.ss == 0 && scan.ah == 0)
+              dejpeg_test_phuff_dc_first(st, zz, c == 0 ? 0 : 1, &dcPred[i], scan.al);
+            else if (scan.ss == 0)
+              dejpeg_test_phuff_dc_refine(st, zz, scan.al);
+            else if (scan.ah == 0)
+              dejpeg_test_phuff_ac_first(st, zz, scan);
+            else
+              dejpeg_test_phuff_ac_refine(st, zz, scan);
+          }
+        }
+      }
+    }
+  }
+
+  dejpeg_test_phuff_eob_run(st);
+}
+
+// Writes scans of `script` (DHT with optimal tables before each SOS).
+static uint8_t* dejpeg_test_put_progressive_scans(uint8_t* p, const DeJpegTestFrame* f, const DeJpegTestScanScript* script) {
+  DeJpegTestPhuff* st = static_cast<DeJpegTestPhuff*>(::malloc(sizeof(DeJpegTestPhuff)));
+  uint32_t freq[4][257];
+
+  for (; script->components; script++) {
+    const DeJpegTestScanScript& scan = *script;
+
+    uint32_t comps[3];
+    uint32_t ns = 0;
+    uint32_t i;
+
+    for (i = 0; i < f->nc; i++)
+      if (scan.components & (1U << i))
+        comps[ns++] = i;
+
+    if (ns == 0)
+      continue;
+
+    ::memset(freq, 0, sizeof(freq));
+    st->freq = freq;
+    dejpeg_test_phuff_scan(st, f, comps, ns, scan);
+
+    // DHT of tables used by the scan (DC refinement uses none).
+    for (uint32_t t = 0; t < 4; t++) {
+      bool used = false;
+      for (i = 0; i < 257; i++)
+        used |= freq[t][i] != 0;
+
+      if (!used)
+        continue;
+
+      uint8_t counts[16];
+      uint8_t values[256];
+
+      dejpeg_test_optimal_table(counts, values, freq[t]);
+      dejpeg_test_put_dht(p, t < 2 ? t : 0x10 | (t - 2), counts, values);
+      dejpeg_test_huff_codes(&st->codes[t], counts, values);
+    }
+
+    // SOS.
+    dejpeg_test_put_marker(p, 0xDA, 2 + 1 + ns * 2 + 3);
+    *p++ = static_cast<uint8_t>(ns);
+    for (i = 0; i < ns; i++) {
+      uint32_t table = comps[i] == 0 ? 0 : 1;
+      p[0] = static_cast<uint8_t>(comps[i] + 1);
+      p[1] = static_cast<uint8_t>(scan.ss == 0 ? table << 4 : table);
+      p += 2;
+    }
+    p[0] = static_cast<uint8_t>(scan.ss);
+    p[1] = static_cast<uint8_t>(scan.se);
+    p[2] = static_cast<uint8_t>((scan.ah << 4) | scan.al);
+    p += 3;
+
+    DeJpegTestBitWriter bw = { p, 0, 0 };
+    st->bw = bw;
+    st->freq = NULL;
+    dejpeg_test_phuff_scan(st, f, comps, ns, scan);
+
+    dejpeg_test_bits_flush(&st->bw);
+    p = st->bw.ptr;
+  }
+
+  ::free(st);
+  return p;
+}
+
+// Encodes `rgb` to a JPEG stored to `dst` and returns its size. The quality is
+// fixed to 75. Baseline images use the standard Huffman tables, progressive
+// images (`progression` is a DeJpegTestProgression) use optimal tables.
+static size_t dejpeg_test_encode_jpeg(uint8_t* dst, const uint8_t* rgb, uint32_t w, uint32_t h, uint32_t sampling, uint32_t restartInterval, uint32_t progression) {
+  // Quantization tables scaled to quality 75 like libjpeg does.
+  uint16_t quant[2][64];
+  for (uint32_t i = 0; i < 64; i++) {
+    quant[0][i] = static_cast<uint16_t>(SimdUtils::max<uint32_t>(1, (dejpeg_std_luma_quant[i] * 50 + 50) / 100));
+    quant[1][i] = static_cast<uint16_t>(SimdUtils::max<uint32_t>(1, (dejpeg_std_chroma_quant[i] * 50 + 50) / 100));
+  }
+
+  DeJpegTestFrame f;
+  dejpeg_test_frame_init(&f, rgb, w, h, sampling, restartInterval, quant);
+
+  uint32_t nc = f.nc;
+  uint8_t* p = dst;
+  uint32_t i, j;
+
+  // SOI, DQT.
+  p[0] = 0xFF;
+  p[1] = 0xD8;
+  p += 2;
+
+  const uint8_t* zigzagIndex = dejpeg_test_zigzag_index();
+  for (i = 0; i < (nc == 1 ? 1U : 2U); i++) {
+    dejpeg_test_put_marker(p, 0xDB, 2 + 65);
+    *p++ = static_cast<uint8_t>(i);
+
+    for (j = 0; j < 64; j++)
+      p[zigzagIndex[j]] = static_cast<uint8_t>(quant[i][j]);
+    p += 64;
+  }
+
+  // SOF0 or SOF2.
+  dejpeg_test_put_marker(p, progression == kJpegTestBaseline ? 0xC0 : 0xC2, 2 + 6 + nc * 3);
+  p[0] = 8;
+  p[1] = static_cast<uint8_t>(h >> 8);
+  p[2] = static_cast<uint8_t>(h & 0xFF);
+  p[3] = static_cast<uint8_t>(w >> 8);
+  p[4] = static_cast<uint8_t>(w & 0xFF);
+  p[5] = static_cast<uint8_t>(nc);
+  p += 6;
+
+  for (i = 0; i < nc; i++) {
+    p[0] = static_cast<uint8_t>(i + 1);
+    p[1] = static_cast<uint8_t>(i == 0 ? (f.hs << 4) | f.vs : 0x11);
+    p[2] = static_cast<uint8_t>(i == 0 ? 0 : 1);
+    p += 3;
+  }
+
+  // DRI.
+  if (restartInterval) {
+    dejpeg_test_put_marker(p, 0xDD, 4);
+    p[0] = static_cast<uint8_t>(restartInterval >> 8);
+    p[1] = static_cast<uint8_t>(restartInterval & 0xFF);
+    p += 2;
+  }
+
+  if (progression == kJpegTestBaseline)
+    p = dejpeg_test_put_baseline_scan(p, &f);
+  else
+    p = dejpeg_test_put_progressive_scans(p, &f, progression == kJpegTestSimple ? dejpeg_test_simple_script : dejpeg_test_spectral_script);
+
+  // EOI.
+  p[0] = 0xFF;
+  p[1] = 0xD9;
+  p += 2;
+
+  dejpeg_test_frame_free(&f);
+  return static_cast<size_t>(p - dst);
+}
+
+// PSNR of decoded `pixels` and the source `rgb`, which is compared by its luma
+// if the image is grayscale.
+static double dejpeg_test_psnr(const uint8_t* rgb, const uint32_t* pixels, uint32_t count, bool gray) {
+  double err = 0.0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t p = pixels[i];
+
+    double r = rgb[i * 3 + 0];
+    double g = rgb[i * 3 + 1];
+    double b = rgb[i * 3 + 2];
+
+    if (gray)
+      r = g = b = 0.299 * r + 0.587 * g + 0.114 * b;
+
+    double dr = r - double((p >> 16) & 0xFF);
+    double dg = g - double((p >>  8) & 0xFF);
+    double db = b - double((p      ) & 0xFF);
+    err += dr * dr + dg * dg + db * db;
+  }
+
+  err /= double(count) * 3.0;
+  return err > 0.0 ? 10.0 * log10(255.0 * 255.0 / err) : 99.0;
+}
+
+// Decodes `jpeg` to `pixels` (allocated by the caller), returns a DeJpegError.
+// The image is decoded by `dejpeg_decoder_decode_mt()` if `pool` is not NULL.
+static uint32_t dejpeg_test_decode(DeJpegDecoder* d, const uint8_t* jpeg, size_t size, uint32_t* pixels, void* workspace, DeJpegThreadPool* pool) {
+  uint32_t err = dejpeg_decoder_read_header(d, jpeg, size);
+  if (err != kJpegErrorOk)
+    return err;
+
+  intptr_t stride = static_cast<intptr_t>(d->width * 4);
+  if (pool)
+    return dejpeg_decoder_decode_mt(d, reinterpret_cast<uint8_t*>(pixels), stride, workspace, pool);
+  else
+    return dejpeg_decoder_decode(d, reinterpret_cast<uint8_t*>(pixels), stride, workspace);
+}
+
+// Decodes `jpeg` strip by strip by `dejpeg_decoder_stream_next()` to `pixels`.
+static uint32_t dejpeg_test_decode_stream(DeJpegDecoder* d, const uint8_t* jpeg, size_t size, uint32_t* pixels, void* workspace) {
+  uint32_t err = dejpeg_decoder_read_header(d, jpeg, size);
+  if (err != kJpegErrorOk)
+    return err;
+
+  DeJpegStream s;
+  err = dejpeg_decoder_stream_begin(d, &s, workspace);
+
+  while (err == kJpegErrorOk && (err = dejpeg_decoder_stream_next(&s)) == kJpegErrorOk && s.rows) {
+    for (uint32_t r = 0; r < s.rows; r++)
+      ::memcpy(pixels + size_t(s.y + r) * d->width, s.pixels + r * s.stride, d->width * 4);
+  }
+
+  return err;
+}
+
+struct DeJpegTestCorpusImage {
+  uint8_t* rgb;
+  uint8_t* jpeg;
+  size_t size;
+};
+
+static void dejpeg_test_corpus_image(DeJpegTestCorpusImage* img, const DeJpegTestCorpusEntry& entry, uint32_t seed) {
+  uint32_t w = entry.width;
+  uint32_t h = entry.height;
+
+  img->rgb = static_cast<uint8_t*>(::malloc(w * h * 3));
+  img->jpeg = static_cast<uint8_t*>(::malloc(w * h * 8 + 65536));
+
+  dejpeg_test_random_image(img->rgb, w, h, seed);
+  img->size = dejpeg_test_encode_jpeg(img->jpeg, img->rgb, w, h, entry.sampling, entry.restartInterval, entry.progression);
+}
+
+static void dejpeg_test_corpus_free(DeJpegTestCorpusImage* img) {
+  ::free(img->jpeg);
+  ::free(img->rgb);
+}
+
+// Decodes the corpus by both `funcs` and the reference kernels, the results
+// must be identical and close to the source image.
+static void dejpeg_check_decoder(const char* name, const DeJpegDecoderFuncs* funcs) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  DeJpegDecoder* dRef = static_cast<DeJpegDecoder*>(::malloc(sizeof(DeJpegDecoder)));
+  DeJpegDecoder* dImpl = static_cast<DeJpegDecoder*>(::malloc(sizeof(DeJpegDecoder)));
+
+  dejpeg_decoder_init(dRef, &dejpeg_decoder_funcs_ref);
+  dejpeg_decoder_init(dImpl, funcs);
+
+  for (uint32_t i = 0; i < sizeof(dejpeg_test_corpus) / sizeof(dejpeg_test_corpus[0]); i++) {
+    const DeJpegTestCorpusEntry& entry = dejpeg_test_corpus[i];
+    DeJpegTestCorpusImage img;
+    dejpeg_test_corpus_image(&img, entry, i);
+
+    uint32_t count = entry.width * entry.height;
+    uint32_t* aPixels = static_cast<uint32_t*>(::malloc(count * 4));
+    uint32_t* bPixels = static_cast<uint32_t*>(::malloc(count * 4));
+
+    dejpeg_decoder_read_header(dRef, img.jpeg, img.size);
+    size_t workspaceSize = dejpeg_decoder_workspace_size(dRef);
+    void* workspace = ::malloc(workspaceSize);
+
+    uint32_t aErr = dejpeg_test_decode(dRef, img.jpeg, img.size, aPixels, workspace, NULL);
+    uint32_t bErr = dejpeg_test_decode(dImpl, img.jpeg, img.size, bPixels, workspace, NULL);
+
+    if (aErr != kJpegErrorOk || bErr != kJpegErrorOk) {
+      printf("FAILED [%s] error ref=%u impl=%u\n", entry.name, aErr, bErr);
+    }
+    else {
+      double psnr = dejpeg_test_psnr(img.rgb, aPixels, count, entry.sampling == kJpegTestGray);
+      if (psnr < 30.0)
+        printf("FAILED [%s] PSNR=%.2f dB\n", entry.name, psnr);
+
+      if (::memcmp(aPixels, bPixels, count * 4) != 0)
+        printf("FAILED [%s] output differs from the reference\n", entry.name);
+    }
+
+    // Progressive images have the same coefficients as the baseline encoding
+    // of the same image, so the output must be identical.
+    if (entry.progression != kJpegTestBaseline && aErr == kJpegErrorOk) {
+      uint8_t* baseline = static_cast<uint8_t*>(::malloc(count * 8 + 65536));
+      size_t baselineSize = dejpeg_test_encode_jpeg(baseline, img.rgb, entry.width, entry.height, entry.sampling, entry.restartInterval, kJpegTestBaseline);
+
+      dejpeg_decoder_read_header(dImpl, baseline, baselineSize);
+      void* baselineWorkspace = ::malloc(dejpeg_decoder_workspace_size(dImpl));
+
+      bErr = dejpeg_test_decode(dImpl, baseline, baselineSize, bPixels, baselineWorkspace, NULL);
+      if (bErr != kJpegErrorOk || ::memcmp(aPixels, bPixels, count * 4) != 0)
+        printf("FAILED [%s] output differs from the baseline image\n", entry.name);
+
+      ::free(baselineWorkspace);
+      ::free(baseline);
+    }
+
+    // A truncated or corrupted image must either fail or decode without
+    // accessing memory out of bounds.
+    for (size_t cut = 2; cut < img.size; cut += img.size / 7 + 1)
+      dejpeg_test_decode(dImpl, img.jpeg, cut, bPixels, workspace, NULL);
+
+    // A corrupted header may grow the image beyond the buffers allocated for
+    // the original, so only decode when it still fits.
+    for (size_t pos = 2; pos < img.size; pos += img.size / 13 + 1) {
+      img.jpeg[pos] ^= 0x5A;
+      if (dejpeg_decoder_read_header(dImpl, img.jpeg, img.size) == kJpegErrorOk &&
+          dImpl->width * dImpl->height <= count &&
+          dejpeg_decoder_workspace_size(dImpl) <= workspaceSize) {
+        dejpeg_decoder_decode(dImpl, reinterpret_cast<uint8_t*>(bPixels), static_cast<intptr_t>(dImpl->width * 4), workspace);
+      }
+      img.jpeg[pos] ^= 0x5A;
+    }
+
+    ::free(workspace);
+    ::free(bPixels);
+    ::free(aPixels);
+    dejpeg_test_corpus_free(&img);
+  }
+
+  // Lossless images are not supported.
+  static const uint8_t lossless[] = {
+    0xFF, 0xD8, 0xFF, 0xC3, 0x00, 0x0B, 0x08, 0x00, 0x01, 0x00, 0x01, 0x01, 0x01, 0x11, 0x00, 0xFF, 0xD9
+  };
+
+  uint32_t err = dejpeg_decoder_read_header(dImpl, lossless, sizeof(lossless));
+  if (err != kJpegErrorUnsupported)
+    printf("FAILED [lossless] error=%u expected=%u\n", err, uint32_t(kJpegErrorUnsupported));
+
+  ::free(dImpl);
+  ::free(dRef);
+}
+
+// Decodes the corpus by pools of various sizes, the results must be identical
+// to single-threaded decoding.
+static void dejpeg_check_decoder_mt(const char* name, const DeJpegDecoderFuncs* funcs) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  static const uint32_t threadCounts[] = { 2, 3, 4, 7 };
+  const uint32_t poolCount = sizeof(threadCounts) / sizeof(threadCounts[0]);
+
+  DeJpegThreadPool* pools[poolCount];
+  for (uint32_t p = 0; p < poolCount; p++)
+    pools[p] = dejpeg_thread_pool_create(threadCounts[p]);
+
+  DeJpegDecoder* d = static_cast<DeJpegDecoder*>(::malloc(sizeof(DeJpegDecoder)));
+  dejpeg_decoder_init(d, funcs);
+
+  for (uint32_t i = 0; i < sizeof(dejpeg_test_corpus) / sizeof(dejpeg_test_corpus[0]); i++) {
+    const DeJpegTestCorpusEntry& entry = dejpeg_test_corpus[i];
+    DeJpegTestCorpusImage img;
+    dejpeg_test_corpus_image(&img, entry, i);
+
+    uint32_t count = entry.width * entry.height;
+    uint32_t* aPixels = static_cast<uint32_t*>(::malloc(count * 4));
+    uint32_t* bPixels = static_cast<uint32_t*>(::malloc(count * 4));
+
+    dejpeg_decoder_read_header(d, img.jpeg, img.size);
+    void* workspace = ::malloc(dejpeg_decoder_workspace_size_mt(d, threadCounts[poolCount - 1]));
+
+    uint32_t aErr = dejpeg_test_decode(d, img.jpeg, img.size, aPixels, workspace, NULL);
+    for (uint32_t p = 0; p < poolCount; p++) {
+      ::memset(bPixels, 0, count * 4);
+      uint32_t bErr = dejpeg_test_decode(d, img.jpeg, img.size, bPixels, workspace, pools[p]);
+
+      if (aErr != kJpegErrorOk || bErr != kJpegErrorOk)
+        printf("FAILED [%s] threads=%u error st=%u mt=%u\n", entry.name, threadCounts[p], aErr, bErr);
+      else if (::memcmp(aPixels, bPixels, count * 4) != 0)
+        printf("FAILED [%s] threads=%u output differs from single-threaded decoding\n", entry.name, threadCounts[p]);
+    }
+
+    // Truncated images must fail (or decode) without crashing in any band.
+    for (size_t cut = 2; cut < img.size; cut += img.size / 7 + 1)
+      dejpeg_test_decode(d, img.jpeg, cut, bPixels, workspace, pools[poolCount - 1]);
+
+    ::free(workspace);
+    ::free(bPixels);
+    ::free(aPixels);
+    dejpeg_test_corpus_free(&img);
+  }
+
+  ::free(d);
+  for (uint32_t p = 0; p < poolCount; p++)
+    dejpeg_thread_pool_destroy(pools[p]);
+}
+
+// Decodes the corpus strip by strip, the result must be identical to decoding
+// the whole image at once.
+static void dejpeg_check_decoder_stream(const char* name, const DeJpegDecoderFuncs* funcs) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  DeJpegDecoder* d = static_cast<DeJpegDecoder*>(::malloc(sizeof(DeJpegDecoder)));
+  dejpeg_decoder_init(d, funcs);
+
+  for (uint32_t i = 0; i < sizeof(dejpeg_test_corpus) / sizeof(dejpeg_test_corpus[0]); i++) {
+    const DeJpegTestCorpusEntry& entry = dejpeg_test_corpus[i];
+    DeJpegTestCorpusImage img;
+    dejpeg_test_corpus_image(&img, entry, i);
+
+    uint32_t count = entry.width * entry.height;
+    uint32_t* aPixels = static_cast<uint32_t*>(::malloc(count * 4));
+    uint32_t* bPixels = static_cast<uint32_t*>(::malloc(count * 4));
+
+    dejpeg_decoder_read_header(d, img.jpeg, img.size);
+    size_t workspaceSize = dejpeg_decoder_workspace_size(d);
+    size_t streamSize = dejpeg_decoder_stream_workspace_size(d);
+
+    void* workspace = ::malloc(workspaceSize);
+    void* streamWorkspace = ::malloc(streamSize);
+
+    ::memset(bPixels, 0, count * 4);
+    uint32_t aErr = dejpeg_test_decode(d, img.jpeg, img.size, aPixels, workspace, NULL);
+    uint32_t bErr = dejpeg_test_decode_stream(d, img.jpeg, img.size, bPixels, streamWorkspace);
+
+    if (aErr != kJpegErrorOk || bErr != kJpegErrorOk)
+      printf("FAILED [%s] error decode=%u stream=%u\n", entry.name, aErr, bErr);
+    else if (::memcmp(aPixels, bPixels, count * 4) != 0)
+      printf("FAILED [%s] output differs from decoding the whole image\n", entry.name);
+
+    // Only the window, a strip and MCU row buffers, which don't depend on the
+    // height of the image or the size of the scan.
+    size_t limit = 16384 + entry.width * 256 + 8192;
+    if (entry.progression == kJpegTestBaseline && streamSize > limit)
+      printf("FAILED [%s] stream workspace=%u exceeds %u\n", entry.name, uint32_t(streamSize), uint32_t(limit));
+
+    for (size_t cut = 2; cut < img.size; cut += img.size / 7 + 1)
+      dejpeg_test_decode_stream(d, img.jpeg, cut, bPixels, streamWorkspace);
+
+    for (size_t pos = 2; pos < img.size; pos += img.size / 13 + 1) {
+      img.jpeg[pos] ^= 0x5A;
+      if (dejpeg_decoder_read_header(d, img.jpeg, img.size) == kJpegErrorOk &&
+          d->width * d->height <= count &&
+          dejpeg_decoder_stream_workspace_size(d) <= streamSize) {
+        dejpeg_test_decode_stream(d, img.jpeg, img.size, bPixels, streamWorkspace);
+      }
+      img.jpeg[pos] ^= 0x5A;
+    }
+
+    ::free(streamWorkspace);
+    ::free(workspace);
+    ::free(bPixels);
+    ::free(aPixels);
+    dejpeg_test_corpus_free(&img);
+  }
+
+  ::free(d);
+}
+
+// Reports the time per decoded pixel and per byte of the compressed image.
+static void dejpeg_print_decoder_bench(const char* name, const char* image, SimdBenchTime& best, uint32_t iterations, uint32_t w, uint32_t h, size_t size) {
+  double pixels = double(iterations) * double(w) * double(h);
+  double bytes = double(iterations) * double(size);
+
+  printf("[BENCH] IMPL=%-15s %s %s\n", name, best.format(pixels, "px", bytes), image);
+}
+
+// Decodes `jpeg` `iterations` times, the decoder and all buffers are reused.
+static void dejpeg_bench_decoder_image(const char* name, const char* image, const DeJpegDecoderFuncs* funcs, const uint8_t* jpeg, size_t size, uint32_t iterations, DeJpegThreadPool* pool) {
+  SimdTimer timer;
+  SimdBenchTime best;
+
+  DeJpegDecoder* d = static_cast<DeJpegDecoder*>(::malloc(sizeof(DeJpegDecoder)));
+  dejpeg_decoder_init(d, funcs);
+
+  uint32_t err = dejpeg_decoder_read_header(d, jpeg, size);
+  if (err != kJpegErrorOk) {
+    printf("[BENCH] IMPL=%-15s {error=%u} %s\n", name, err, image);
+    ::free(d);
+    return;
+  }
+
+  uint32_t* pixels = static_cast<uint32_t*>(::malloc(d->width * d->height * 4));
+  void* workspace = ::malloc(dejpeg_decoder_workspace_size_mt(d, dejpeg_thread_pool_thread_count(pool)));
+
+  for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+    timer.start();
+    for (uint32_t i = 0; i < iterations; i++)
+      dejpeg_test_decode(d, jpeg, size, pixels, workspace, pool);
+    timer.stop();
+    best.update(timer);
+  }
+
+  dejpeg_print_decoder_bench(name, image, best, iterations, d->width, d->height, size);
+
+  ::free(workspace);
+  ::free(pixels);
+  ::free(d);
+}
+
+static void dejpeg_bench_decoder(const char* name, const DeJpegDecoderFuncs* funcs) {
+  for (uint32_t i = 0; i < sizeof(dejpeg_test_corpus) / sizeof(dejpeg_test_corpus[0]); i++) {
+    const DeJpegTestCorpusEntry& entry = dejpeg_test_corpus[i];
+    if (!entry.bench)
+      continue;
+
+    DeJpegTestCorpusImage img;
+    dejpeg_test_corpus_image(&img, entry, i);
+
+    uint32_t iterations = SimdUtils::max<uint32_t>(1, BENCH_DECODE_PIXELS / (entry.width * entry.height));
+    dejpeg_bench_decoder_image(name, entry.name, funcs, img.jpeg, img.size, iterations, NULL);
+
+    dejpeg_test_corpus_free(&img);
+  }
+}
+
+// Decodes each progressive image of the corpus and the baseline encoding of the
+// same image. The workspace is all the memory the decoder uses, progressive
+// images need it for coefficients of the whole image.
+static void dejpeg_bench_decoder_progressive(const char* name, const DeJpegDecoderFuncs* funcs) {
+  DeJpegDecoder* d = static_cast<DeJpegDecoder*>(::malloc(sizeof(DeJpegDecoder)));
+  dejpeg_decoder_init(d, funcs);
+
+  for (uint32_t i = 0; i < sizeof(dejpeg_test_corpus) / sizeof(dejpeg_test_corpus[0]); i++) {
+    const DeJpegTestCorpusEntry& entry = dejpeg_test_corpus[i];
+    if (!entry.bench || entry.progression == kJpegTestBaseline)
+      continue;
+
+    DeJpegTestCorpusImage img;
+    dejpeg_test_corpus_image(&img, entry, i);
+
+    uint8_t* baseline = static_cast<uint8_t*>(::malloc(entry.width * entry.height * 8 + 65536));
+    size_t baselineSize = dejpeg_test_encode_jpeg(baseline, img.rgb, entry.width, entry.height, entry.sampling, entry.restartInterval, kJpegTestBaseline);
+    uint32_t iterations = SimdUtils::max<uint32_t>(1, BENCH_DECODE_PIXELS / (entry.width * entry.height));
+
+    for (uint32_t k = 0; k < 2; k++) {
+      const uint8_t* jpeg = k == 0 ? baseline : img.jpeg;
+      size_t size = k == 0 ? baselineSize : img.size;
+
+      dejpeg_decoder_read_header(d, jpeg, size);
+
+      char desc[128];
+      snprintf(desc, sizeof(desc), "%s %s size=%uKB workspace=%uKB", entry.name, k == 0 ? "baseline" : "progressive",
+        uint32_t(size / 1024), uint32_t(dejpeg_decoder_workspace_size(d) / 1024));
+      dejpeg_bench_decoder_image(name, desc, funcs, jpeg, size, iterations, NULL);
+    }
+
+    ::free(baseline);
+    dejpeg_test_corpus_free(&img);
+  }
+
+  ::free(d);
+}
+
+// Decodes each benchmarked image of the corpus as a whole and strip by strip,
+// the consumer of strips does nothing, so only the decoder is measured.
+static void dejpeg_bench_decoder_stream(const char* name, const DeJpegDecoderFuncs* funcs) {
+  DeJpegDecoder* d = static_cast<DeJpegDecoder*>(::malloc(sizeof(DeJpegDecoder)));
+  dejpeg_decoder_init(d, funcs);
+
+  for (uint32_t i = 0; i < sizeof(dejpeg_test_corpus) / sizeof(dejpeg_test_corpus[0]); i++) {
+    const DeJpegTestCorpusEntry& entry = dejpeg_test_corpus[i];
+    if (!entry.bench)
+      continue;
+
+    DeJpegTestCorpusImage img;
+    dejpeg_test_corpus_image(&img, entry, i);
+
+    uint32_t iterations = SimdUtils::max<uint32_t>(1, BENCH_DECODE_PIXELS / (entry.width * entry.height));
+    char desc[128];
+
+    dejpeg_decoder_read_header(d, img.jpeg, img.size);
+    snprintf(desc, sizeof(desc), "%s workspace=%uKB", entry.name, uint32_t(dejpeg_decoder_workspace_size(d) / 1024));
+    dejpeg_bench_decoder_image(name, desc, funcs, img.jpeg, img.size, iterations, NULL);
+
+    size_t streamSize = dejpeg_decoder_stream_workspace_size(d);
+    void* workspace = ::malloc(streamSize);
+
+    SimdTimer timer;
+    SimdBenchTime best;
+
+    for (uint32_t z = 0; z < BENCH_COUNT; z++) {
+      timer.start();
+      for (uint32_t n = 0; n < iterations; n++) {
+        DeJpegStream s;
+        dejpeg_decoder_read_header(d, img.jpeg, img.size);
+        dejpeg_decoder_stream_begin(d, &s, workspace);
+        while (dejpeg_decoder_stream_next(&s) == kJpegErrorOk && s.rows)
+          continue;
+      }
+      timer.stop();
+      best.update(timer);
+    }
+
+    snprintf(desc, sizeof(desc), "%s stream workspace=%uKB", entry.name, uint32_t(streamSize / 1024));
+    dejpeg_print_decoder_bench(name, desc, best, iterations, entry.width, entry.height, img.size);
+
+    ::free(workspace);
+    dejpeg_test_corpus_free(&img);
+  }
+
+  ::free(d);
+}
+
+// Scaling of parallel decoding (restart intervals, or the IDCT and the color
+// conversion of progressive images) from 1 to N threads (at least 2 to also
+// measure the overhead of the pool on single-core machines).
+static void dejpeg_bench_decoder_mt(const char* name, const DeJpegDecoderFuncs* funcs, const uint8_t* jpeg, size_t size, const char* image, uint32_t iterations) {
+  uint32_t maxThreads = SimdUtils::max<uint32_t>(dejpeg_cpu_count(), 2);
+
+  for (uint32_t n = 1;; n *= 2) {
+    n = SimdUtils::min<uint32_t>(n, maxThreads);
+
+    char desc[128];
+    snprintf(desc, sizeof(desc), "%s threads=%u", image, n);
+
+    DeJpegThreadPool* pool = dejpeg_thread_pool_create(n);
+    dejpeg_bench_decoder_image(name, desc, funcs, jpeg, size, iterations, pool);
+    dejpeg_thread_pool_destroy(pool);
+
+    if (n == maxThreads)
+      break;
+  }
+}
+
+// `test_dejpeg decode [files...]` benchmarks the decoder on the given files or
+// on the generated corpus if there are none.
+static int dejpeg_decode_main(int argc, char* argv[]) {
+  bool hasAVX2 = (SimdCpu::features() & kSimdCpuAVX2) != 0;
+  const DeJpegDecoderFuncs* best = dejpeg_decoder_funcs_best();
+
+  if (argc == 0) {
+    dejpeg_check_decoder("decoder-sse2", &dejpeg_decoder_funcs_sse2);
+    if (hasAVX2)
+      dejpeg_check_decoder("decoder-avx2", &dejpeg_decoder_funcs_avx2);
+    else
+      printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "decoder-avx2");
+    if (SimdCpu::features() & kSimdCpuAVX512BW)
+      dejpeg_check_decoder("decoder-avx512", &dejpeg_decoder_funcs_avx512bw);
+    else
+      printf("[SKIP ] IMPL=%-15s (no AVX-512BW)\n", "decoder-avx512");
+    dejpeg_check_decoder("decoder-best", best);
+    dejpeg_check_decoder_mt("decoder-mt", best);
+    dejpeg_check_decoder_stream("stream-ref" , &dejpeg_decoder_funcs_ref);
+    dejpeg_check_decoder_stream("stream-best", best);
+    dejpeg_bench_decoder("decoder-ref" , &dejpeg_decoder_funcs_ref);
+    dejpeg_bench_decoder("decoder-sse2", &dejpeg_decoder_funcs_sse2);
+    if (hasAVX2)
+      dejpeg_bench_decoder("decoder-avx2", &dejpeg_decoder_funcs_avx2);
+    dejpeg_bench_decoder_progressive("decoder-ref" , &dejpeg_decoder_funcs_ref);
+    if (hasAVX2)
+      dejpeg_bench_decoder_progressive("decoder-avx2", &dejpeg_decoder_funcs_avx2);
+    dejpeg_bench_decoder_progressive("decoder-best", best);
+    dejpeg_bench_decoder_stream("decoder-best", best);
+
+    for (uint32_t i = 0; i < sizeof(dejpeg_test_corpus) / sizeof(dejpeg_test_corpus[0]); i++) {
+      const DeJpegTestCorpusEntry& entry = dejpeg_test_corpus[i];
+      if (!entry.bench || (!entry.restartInterval && entry.progression == kJpegTestBaseline))
+        continue;
+
+      DeJpegTestCorpusImage img;
+      dejpeg_test_corpus_image(&img, entry, i);
+
+      uint32_t iterations = SimdUtils::max<uint32_t>(1, BENCH_DECODE_PIXELS / (entry.width * entry.height));
+      dejpeg_bench_decoder_mt("decoder-best-mt", best, img.jpeg, img.size, entry.name, iterations);
+
+      dejpeg_test_corpus_free(&img);
+    }
+    return 0;
+  }
+
+  for (int i = 0; i < argc; i++) {
+    FILE* f = fopen(argv[i], "rb");
+    if (f == NULL) {
+      printf("Couldn't open '%s'\n", argv[i]);
+      return 1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size_t size = static_cast<size_t>(ftell(f));
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t* jpeg = static_cast<uint8_t*>(::malloc(size));
+    size = fread(jpeg, 1, size, f);
+    fclose(f);
+
+    uint32_t iterations = SimdUtils::max<uint32_t>(1, BENCH_DECODE_PIXELS / (1920 * 1080));
+    dejpeg_bench_decoder_image("decoder-ref" , argv[i], &dejpeg_decoder_funcs_ref , jpeg, size, iterations, NULL);
+    dejpeg_bench_decoder_image("decoder-sse2", argv[i], &dejpeg_decoder_funcs_sse2, jpeg, size, iterations, NULL);
+    if (hasAVX2)
+      dejpeg_bench_decoder_image("decoder-avx2", argv[i], &dejpeg_decoder_funcs_avx2, jpeg, size, iterations, NULL);
+    dejpeg_bench_decoder_mt("decoder-best-mt", best, jpeg, size, argv[i], iterations);
+
+    ::free(jpeg);
+  }
+
+  return 0;
+}
+
+// ============================================================================
+// [SimdTests::DeJPEG - Main]
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+  if (argc >= 2 && ::strcmp(argv[1], "decode") == 0)
+    return dejpeg_decode_main(argc - 2, argv + 2);
+
+  const SimdVariant<DeJpegIDCTFunc>* idct = dejpeg_idct_islow_dispatch();
+
+  bool hasSSSE3 = (SimdCpu::features() & kSimdCpuSSSE3) != 0;
+  bool hasAVX2 = (SimdCpu::features() & kSimdCpuAVX2) != 0;
+  bool hasAVX512BW = (SimdCpu::features() & kSimdCpuAVX512BW) != 0;
+
+  SimdCpu::printInfo();
+  SimdTimer::printInfo();
+  SimdCpu::printVariant("dejpeg_idct_islow", idct);
+  printf("\n");
+
+  if (hasSSSE3) {
+    dejpeg_check_dezigzag8x8("zzag-ssse3-v1", dejpeg_dezigzag_ref, dejpeg_dezigzag_ssse3_v1);
+    dejpeg_check_dezigzag8x8("zzag-ssse3-v2", dejpeg_dezigzag_ref, dejpeg_dezigzag_ssse3_v2);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no SSSE3)\n", "zzag-ssse3-v1");
+    printf("[SKIP ] IMPL=%-15s (no SSSE3)\n", "zzag-ssse3-v2");
+  }
+  dejpeg_bench_dezigzag8x8("zzag-ref"  , dejpeg_dezigzag_ref);
+  if (hasSSSE3) {
+    dejpeg_bench_dezigzag8x8("zzag-ssse3-v1", dejpeg_dezigzag_ssse3_v1);
+    dejpeg_bench_dezigzag8x8("zzag-ssse3-v2", dejpeg_dezigzag_ssse3_v2);
+  }
+
+  printf("\n");
+
+  if (hasAVX2)
+    dejpeg_check_dezigzag_eob("zzag-eob-avx2", dejpeg_dezigzag_eob_ref, dejpeg_dezigzag_eob_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "zzag-eob-avx2");
+  if (hasAVX512BW)
+    dejpeg_check_dezigzag_eob("zzag-eob-avx512", dejpeg_dezigzag_eob_ref, dejpeg_dezigzag_eob_avx512bw);
+  dejpeg_bench_dezigzag_eob("zzag-eob-ref"   , dejpeg_dezigzag_eob_ref);
+  if (hasAVX2)
+    dejpeg_bench_dezigzag_eob("zzag-eob-avx2"  , dejpeg_dezigzag_eob_avx2);
+  if (hasAVX512BW)
+    dejpeg_bench_dezigzag_eob("zzag-eob-avx512", dejpeg_dezigzag_eob_avx512bw);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX-512BW)\n", "zzag-eob-avx512");
+
+  printf("\n");
+
+  dejpeg_check_idct("islow-sse2", dejpeg_idct_islow_ref, dejpeg_idct_islow_sse2);
+  if (hasAVX2)
+    dejpeg_check_idct("islow-avx2", dejpeg_idct_islow_ref, dejpeg_idct_islow_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "islow-avx2");
+  dejpeg_check_idct("islow-best", dejpeg_idct_islow_ref, idct->func);
+  dejpeg_bench_idct("islow-ref" , dejpeg_idct_islow_ref);
+  dejpeg_bench_idct("islow-sse2", dejpeg_idct_islow_sse2);
+  if (hasAVX2)
+    dejpeg_bench_idct("islow-avx2", dejpeg_idct_islow_avx2);
+
+  printf("\n");
+
+  dejpeg_check_idct_batch("batch-sse2", dejpeg_idct_islow_batch_ref, dejpeg_idct_islow_batch_sse2);
+  if (hasAVX2)
+    dejpeg_check_idct_batch("batch-avx2", dejpeg_idct_islow_batch_ref, dejpeg_idct_islow_batch_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "batch-avx2");
+  dejpeg_bench_idct_batch("batch-ref" , dejpeg_idct_islow_batch_ref);
+  dejpeg_bench_idct_batch("batch-sse2", dejpeg_idct_islow_batch_sse2);
+  if (hasAVX2)
+    dejpeg_bench_idct_batch("batch-avx2", dejpeg_idct_islow_batch_avx2);
+
+  printf("\n");
+
+  dejpeg_check_idct_sparse("sparse-sse2", dejpeg_idct_islow_sparse_ref, dejpeg_idct_islow_sparse_sse2);
+  if (hasAVX2)
+    dejpeg_check_idct_sparse("sparse-avx2", dejpeg_idct_islow_sparse_ref, dejpeg_idct_islow_sparse_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "sparse-avx2");
+  for (uint32_t m = 0; m < sizeof(dejpeg_sparsity_mixes) / sizeof(dejpeg_sparsity_mixes[0]); m++) {
+    const DeJpegSparsityMix& mix = dejpeg_sparsity_mixes[m];
+    dejpeg_bench_idct_sparse("sparse-ref" , mix, dejpeg_idct_islow_sparse_ref);
+    dejpeg_bench_idct_sparse("full-sse2"  , mix, dejpeg_idct_islow_full_sse2);
+    dejpeg_bench_idct_sparse("sparse-sse2", mix, dejpeg_idct_islow_sparse_sse2);
+    if (hasAVX2)
+      dejpeg_bench_idct_sparse("sparse-avx2", mix, dejpeg_idct_islow_sparse_avx2);
+  }
+
+  printf("\n");
+
+  dejpeg_check_idct_scaled("scaled4x4-sse2", 4, dejpeg_idct_scaled4x4_ref, dejpeg_idct_scaled4x4_sse2);
+  dejpeg_check_idct_scaled("scaled2x2-sse2", 2, dejpeg_idct_scaled2x2_ref, dejpeg_idct_scaled2x2_sse2);
+  if (hasAVX2) {
+    dejpeg_check_idct_scaled("scaled4x4-avx2", 4, dejpeg_idct_scaled4x4_ref, dejpeg_idct_scaled4x4_avx2);
+    dejpeg_check_idct_scaled("scaled2x2-avx2", 2, dejpeg_idct_scaled2x2_ref, dejpeg_idct_scaled2x2_avx2);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "scaled4x4-avx2");
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "scaled2x2-avx2");
+  }
+  dejpeg_bench_idct("scaled4x4-ref" , dejpeg_idct_scaled4x4_ref);
+  dejpeg_bench_idct("scaled4x4-sse2", dejpeg_idct_scaled4x4_sse2);
+  if (hasAVX2)
+    dejpeg_bench_idct("scaled4x4-avx2", dejpeg_idct_scaled4x4_avx2);
+  dejpeg_bench_idct("scaled2x2-ref" , dejpeg_idct_scaled2x2_ref);
+  dejpeg_bench_idct("scaled2x2-sse2", dejpeg_idct_scaled2x2_sse2);
+  if (hasAVX2)
+    dejpeg_bench_idct("scaled2x2-avx2", dejpeg_idct_scaled2x2_avx2);
+  dejpeg_bench_idct("scaled1x1-ref" , dejpeg_idct_scaled1x1_ref);
+
+  printf("\n");
+
+  dejpeg_check_idct_ifast("ifast-sse2", dejpeg_idct_ifast_ref, dejpeg_idct_ifast_sse2);
+  dejpeg_check_idct_ifast_batch("ifast-batch-sse2", dejpeg_idct_ifast_batch_ref, dejpeg_idct_ifast_batch_sse2);
+  if (hasAVX2)
+    dejpeg_check_idct_ifast_batch("ifast-batch-avx2", dejpeg_idct_ifast_batch_ref, dejpeg_idct_ifast_batch_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "ifast-batch-avx2");
+  dejpeg_report_idct_accuracy("islow-ref", dejpeg_idct_islow_ref, false);
+  dejpeg_report_idct_accuracy("ifast-ref", dejpeg_idct_ifast_ref, true);
+  dejpeg_bench_idct("ifast-ref" , dejpeg_idct_ifast_ref);
+  dejpeg_bench_idct("ifast-sse2", dejpeg_idct_ifast_sse2);
+  dejpeg_bench_idct_batch("ifast-batch-ref" , dejpeg_idct_ifast_batch_ref);
+  dejpeg_bench_idct_batch("ifast-batch-sse2", dejpeg_idct_ifast_batch_sse2);
+  if (hasAVX2)
+    dejpeg_bench_idct_batch("ifast-batch-avx2", dejpeg_idct_ifast_batch_avx2);
+
+  printf("\n");
+
+  if (hasSSSE3)
+    dejpeg_check_idct_zigzag("zigzag-ssse3", dejpeg_idct_islow_zigzag_ref, dejpeg_idct_islow_zigzag_ssse3);
+  else
+    printf("[SKIP ] IMPL=%-15s (no SSSE3)\n", "zigzag-ssse3");
+  dejpeg_bench_idct("zigzag-ref"  , dejpeg_idct_islow_zigzag_ref);
+  if (hasSSSE3) {
+    dejpeg_bench_idct("zigzag-2pass", dejpeg_idct_islow_zigzag_2pass_ssse3);
+    dejpeg_bench_idct("zigzag-ssse3", dejpeg_idct_islow_zigzag_ssse3);
+  }
+
+  printf("\n");
+
+  dejpeg_check_upsample_h2v1("h2v1-sse2"      , dejpeg_upsample_h2v1_ref, dejpeg_upsample_h2v1_sse2);
+  dejpeg_check_upsample_h2v2("h2v2-sse2"      , dejpeg_upsample_h2v2_ref, dejpeg_upsample_h2v2_sse2);
+  dejpeg_check_upsample_h2v1("h2v1-fancy-sse2", dejpeg_upsample_h2v1_fancy_ref, dejpeg_upsample_h2v1_fancy_sse2);
+  dejpeg_check_upsample_h2v2("h2v2-fancy-sse2", dejpeg_upsample_h2v2_fancy_ref, dejpeg_upsample_h2v2_fancy_sse2);
+  if (hasAVX2) {
+    dejpeg_check_upsample_h2v1("h2v1-avx2"      , dejpeg_upsample_h2v1_ref, dejpeg_upsample_h2v1_avx2);
+    dejpeg_check_upsample_h2v2("h2v2-avx2"      , dejpeg_upsample_h2v2_ref, dejpeg_upsample_h2v2_avx2);
+    dejpeg_check_upsample_h2v1("h2v1-fancy-avx2", dejpeg_upsample_h2v1_fancy_ref, dejpeg_upsample_h2v1_fancy_avx2);
+    dejpeg_check_upsample_h2v2("h2v2-fancy-avx2", dejpeg_upsample_h2v2_fancy_ref, dejpeg_upsample_h2v2_fancy_avx2);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "h2v1-avx2");
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "h2v2-avx2");
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "h2v1-fancy-avx2");
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "h2v2-fancy-avx2");
+  }
+  dejpeg_bench_upsample_h2v1("h2v1-ref"       , dejpeg_upsample_h2v1_ref);
+  dejpeg_bench_upsample_h2v1("h2v1-sse2"      , dejpeg_upsample_h2v1_sse2);
+  if (hasAVX2)
+    dejpeg_bench_upsample_h2v1("h2v1-avx2"      , dejpeg_upsample_h2v1_avx2);
+  dejpeg_bench_upsample_h2v2("h2v2-ref"       , dejpeg_upsample_h2v2_ref);
+  dejpeg_bench_upsample_h2v2("h2v2-sse2"      , dejpeg_upsample_h2v2_sse2);
+  if (hasAVX2)
+    dejpeg_bench_upsample_h2v2("h2v2-avx2"      , dejpeg_upsample_h2v2_avx2);
+  dejpeg_bench_upsample_h2v1("h2v1-fancy-ref" , dejpeg_upsample_h2v1_fancy_ref);
+  dejpeg_bench_upsample_h2v1("h2v1-fancy-sse2", dejpeg_upsample_h2v1_fancy_sse2);
+  if (hasAVX2)
+    dejpeg_bench_upsample_h2v1("h2v1-fancy-avx2", dejpeg_upsample_h2v1_fancy_avx2);
+  dejpeg_bench_upsample_h2v2("h2v2-fancy-ref" , dejpeg_upsample_h2v2_fancy_ref);
+  dejpeg_bench_upsample_h2v2("h2v2-fancy-sse2", dejpeg_upsample_h2v2_fancy_sse2);
+  if (hasAVX2)
+    dejpeg_bench_upsample_h2v2("h2v2-fancy-avx2", dejpeg_upsample_h2v2_fancy_avx2);
+
+  printf("\n");
+
+  dejpeg_check_ycbcr_convert("ycbcr-rgb-sse2", kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_sse2);
+  dejpeg_check_ycbcr_widths("ycbcr-rgb-sse2" , kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_sse2);
+  if (hasSSSE3) {
+    dejpeg_check_ycbcr_convert("ycbcr-rgb-ssse3", kJpegPixelRGB32, dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_ssse3);
+    dejpeg_check_ycbcr_widths("ycbcr-rgb-ssse3", kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_ssse3);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no SSSE3)\n", "ycbcr-rgb-ssse3");
+  }
+  if (hasAVX2) {
+    dejpeg_check_ycbcr_convert("ycbcr-rgb-avx2", kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_avx2);
+    dejpeg_check_ycbcr_widths("ycbcr-rgb-avx2" , kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_avx2);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "ycbcr-rgb-avx2");
+  }
+  dejpeg_check_ycbcr_convert("ycbcr-vec-scalar", kJpegPixelRGB32, dejpeg_ycbcr_to_rgb32_ref, dejpeg_ycbcr_to_rgb32_vec_scalar);
+  dejpeg_check_ycbcr_convert("ycbcr-vec-sse2", kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_vec_sse2);
+  dejpeg_check_ycbcr_widths("ycbcr-vec-scalar", kJpegPixelRGB32, dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_vec_scalar);
+  dejpeg_check_ycbcr_widths("ycbcr-vec-sse2" , kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_vec_sse2);
+  if (hasAVX2) {
+    dejpeg_check_ycbcr_convert("ycbcr-vec-avx2", kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_vec_avx2);
+    dejpeg_check_ycbcr_widths("ycbcr-vec-avx2" , kJpegPixelRGB32 , dejpeg_ycbcr_to_rgb32_ref , dejpeg_ycbcr_to_rgb32_vec_avx2);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "ycbcr-vec-avx2");
+  }
+  dejpeg_check_ycbcr_convert("rgb24-sse2"    , kJpegPixelRGB24 , dejpeg_ycbcr_to_rgb24_ref , dejpeg_ycbcr_to_rgb24_sse2);
+  dejpeg_check_ycbcr_convert("bgr24-sse2"    , kJpegPixelBGR24 , dejpeg_ycbcr_to_bgr24_ref , dejpeg_ycbcr_to_bgr24_sse2);
+  dejpeg_check_ycbcr_convert("rgba32-sse2"   , kJpegPixelRGBA32, dejpeg_ycbcr_to_rgba32_ref, dejpeg_ycbcr_to_rgba32_sse2);
+  dejpeg_check_ycbcr_convert("argb32-sse2"   , kJpegPixelARGB32, dejpeg_ycbcr_to_argb32_ref, dejpeg_ycbcr_to_argb32_sse2);
+  dejpeg_check_ycbcr_convert("rgb565-sse2"   , kJpegPixelRGB565, dejpeg_ycbcr_to_rgb565_ref, dejpeg_ycbcr_to_rgb565_sse2);
+  dejpeg_check_ycbcr_convert("gray8-sse2"    , kJpegPixelGray8 , dejpeg_ycbcr_to_gray8_ref , dejpeg_ycbcr_to_gray8_sse2);
+  dejpeg_bench_ycbcr_convert("ycbcr-rgb-ref" , dejpeg_ycbcr_to_rgb32_ref);
+  dejpeg_bench_ycbcr_convert("ycbcr-rgb-sse2", dejpeg_ycbcr_to_rgb32_sse2);
+  if (hasSSSE3)
+    dejpeg_bench_ycbcr_convert("ycbcr-rgb-ssse3", dejpeg_ycbcr_to_rgb32_ssse3);
+  if (hasAVX2)
+    dejpeg_bench_ycbcr_convert("ycbcr-rgb-avx2", dejpeg_ycbcr_to_rgb32_avx2);
+  dejpeg_bench_ycbcr_convert("ycbcr-vec-sse2", dejpeg_ycbcr_to_rgb32_vec_sse2);
+  if (hasAVX2)
+    dejpeg_bench_ycbcr_convert("ycbcr-vec-avx2", dejpeg_ycbcr_to_rgb32_vec_avx2);
+  dejpeg_bench_ycbcr_convert("rgb24-ref"     , dejpeg_ycbcr_to_rgb24_ref);
+  dejpeg_bench_ycbcr_convert("rgb24-sse2"    , dejpeg_ycbcr_to_rgb24_sse2);
+  dejpeg_bench_ycbcr_convert("bgr24-ref"     , dejpeg_ycbcr_to_bgr24_ref);
+  dejpeg_bench_ycbcr_convert("bgr24-sse2"    , dejpeg_ycbcr_to_bgr24_sse2);
+  dejpeg_bench_ycbcr_convert("rgba32-ref"    , dejpeg_ycbcr_to_rgba32_ref);
+  dejpeg_bench_ycbcr_convert("rgba32-sse2"   , dejpeg_ycbcr_to_rgba32_sse2);
+  dejpeg_bench_ycbcr_convert("argb32-ref"    , dejpeg_ycbcr_to_argb32_ref);
+  dejpeg_bench_ycbcr_convert("argb32-sse2"   , dejpeg_ycbcr_to_argb32_sse2);
+  dejpeg_bench_ycbcr_convert("rgb565-ref"    , dejpeg_ycbcr_to_rgb565_ref);
+  dejpeg_bench_ycbcr_convert("rgb565-sse2"   , dejpeg_ycbcr_to_rgb565_sse2);
+  dejpeg_bench_ycbcr_convert("gray8-ref"     , dejpeg_ycbcr_to_gray8_ref);
+  dejpeg_bench_ycbcr_convert("gray8-sse2"    , dejpeg_ycbcr_to_gray8_sse2);
+
+  printf("\n");
+
+  dejpeg_check_ycbcr_h2v2_to_rgb32("merged-ref" , dejpeg_ycbcr_h2v2_to_rgb32_separate_ref, dejpeg_ycbcr_h2v2_to_rgb32_ref);
+  dejpeg_check_ycbcr_h2v2_to_rgb32("merged-sse2", dejpeg_ycbcr_h2v2_to_rgb32_ref, dejpeg_ycbcr_h2v2_to_rgb32_sse2);
+  dejpeg_bench_ycbcr_h2v2_to_rgb32("separate-ref" , dejpeg_ycbcr_h2v2_to_rgb32_separate_ref);
+  dejpeg_bench_ycbcr_h2v2_to_rgb32("separate-sse2", dejpeg_ycbcr_h2v2_to_rgb32_separate_sse2);
+  dejpeg_bench_ycbcr_h2v2_to_rgb32("merged-ref"   , dejpeg_ycbcr_h2v2_to_rgb32_ref);
+  dejpeg_bench_ycbcr_h2v2_to_rgb32("merged-sse2"  , dejpeg_ycbcr_h2v2_to_rgb32_sse2);
+
+  printf("\n");
+
+  dejpeg_check_huff_unstuff("unstuff-sse2", dejpeg_huff_unstuff_ref, dejpeg_huff_unstuff_sse2);
+  if (hasAVX2)
+    dejpeg_check_huff_unstuff("unstuff-avx2", dejpeg_huff_unstuff_ref, dejpeg_huff_unstuff_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "unstuff-avx2");
+  dejpeg_check_huff_decode("huff-ref" , dejpeg_huff_unstuff_ref);
+  dejpeg_check_huff_decode("huff-sse2", dejpeg_huff_unstuff_sse2);
+  if (hasAVX2)
+    dejpeg_check_huff_decode("huff-avx2", dejpeg_huff_unstuff_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "huff-avx2");
+  dejpeg_bench_huff_unstuff("unstuff-ref" , dejpeg_huff_unstuff_ref);
+  dejpeg_bench_huff_unstuff("unstuff-sse2", dejpeg_huff_unstuff_sse2);
+  if (hasAVX2)
+    dejpeg_bench_huff_unstuff("unstuff-avx2", dejpeg_huff_unstuff_avx2);
+  dejpeg_bench_huff_decode("huff-ref" , dejpeg_huff_unstuff_ref);
+  dejpeg_bench_huff_decode("huff-sse2", dejpeg_huff_unstuff_sse2);
+  if (hasAVX2)
+    dejpeg_bench_huff_decode("huff-avx2", dejpeg_huff_unstuff_avx2);
+
+  printf("\n");
+
+  dejpeg_check_nonzero_mask("nzmask-sse2", dejpeg_block_nonzero_mask_ref, dejpeg_block_nonzero_mask_sse2);
+  if (hasAVX2)
+    dejpeg_check_nonzero_mask("nzmask-avx2", dejpeg_block_nonzero_mask_ref, dejpeg_block_nonzero_mask_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "nzmask-avx2");
+  dejpeg_bench_nonzero_mask("nzmask-ref" , dejpeg_block_nonzero_mask_ref);
+  dejpeg_bench_nonzero_mask("nzmask-sse2", dejpeg_block_nonzero_mask_sse2);
+  if (hasAVX2)
+    dejpeg_bench_nonzero_mask("nzmask-avx2", dejpeg_block_nonzero_mask_avx2);
+
+  printf("\n");
+
+  dejpeg_check_rgb_ycbcr("rgb-ycbcr-sse2", dejpeg_rgb32_to_ycbcr_ref, dejpeg_rgb32_to_ycbcr_sse2);
+  dejpeg_check_rgb_ycbcr_accuracy("rgb-ycbcr-ref", dejpeg_rgb32_to_ycbcr_ref);
+  dejpeg_check_rgb_ycbcr_widths("rgb-ycbcr-sse2", dejpeg_rgb32_to_ycbcr_ref, dejpeg_rgb32_to_ycbcr_sse2);
+  if (hasAVX2) {
+    dejpeg_check_rgb_ycbcr("rgb-ycbcr-avx2", dejpeg_rgb32_to_ycbcr_ref, dejpeg_rgb32_to_ycbcr_avx2);
+    dejpeg_check_rgb_ycbcr_widths("rgb-ycbcr-avx2", dejpeg_rgb32_to_ycbcr_ref, dejpeg_rgb32_to_ycbcr_avx2);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "rgb-ycbcr-avx2");
+  }
+  dejpeg_bench_rgb_ycbcr("rgb-ycbcr-ref" , dejpeg_rgb32_to_ycbcr_ref);
+  dejpeg_bench_rgb_ycbcr("rgb-ycbcr-sse2", dejpeg_rgb32_to_ycbcr_sse2);
+  if (hasAVX2)
+    dejpeg_bench_rgb_ycbcr("rgb-ycbcr-avx2", dejpeg_rgb32_to_ycbcr_avx2);
+
+  printf("\n");
+
+  dejpeg_check_downsample_h2v1("down-h2v1-sse2", dejpeg_downsample_h2v1_ref, dejpeg_downsample_h2v1_sse2);
+  dejpeg_check_downsample_h2v2("down-h2v2-sse2", dejpeg_downsample_h2v2_ref, dejpeg_downsample_h2v2_sse2);
+  if (hasAVX2) {
+    dejpeg_check_downsample_h2v1("down-h2v1-avx2", dejpeg_downsample_h2v1_ref, dejpeg_downsample_h2v1_avx2);
+    dejpeg_check_downsample_h2v2("down-h2v2-avx2", dejpeg_downsample_h2v2_ref, dejpeg_downsample_h2v2_avx2);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "down-h2v1-avx2");
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "down-h2v2-avx2");
+  }
+  dejpeg_bench_downsample_h2v1("down-h2v1-ref" , dejpeg_downsample_h2v1_ref);
+  dejpeg_bench_downsample_h2v1("down-h2v1-sse2", dejpeg_downsample_h2v1_sse2);
+  if (hasAVX2)
+    dejpeg_bench_downsample_h2v1("down-h2v1-avx2", dejpeg_downsample_h2v1_avx2);
+  dejpeg_bench_downsample_h2v2("down-h2v2-ref" , dejpeg_downsample_h2v2_ref);
+  dejpeg_bench_downsample_h2v2("down-h2v2-sse2", dejpeg_downsample_h2v2_sse2);
+  if (hasAVX2)
+    dejpeg_bench_downsample_h2v2("down-h2v2-avx2", dejpeg_downsample_h2v2_avx2);
+
+  printf("\n");
+
+  dejpeg_check_fdct_divisors();
+  dejpeg_check_fdct_accuracy("fdct-ref", dejpeg_fdct_islow_ref);
+  dejpeg_check_fdct("fdct-sse2", dejpeg_fdct_islow_ref, dejpeg_fdct_islow_sse2);
+  if (hasAVX2)
+    dejpeg_check_fdct("fdct-avx2", dejpeg_fdct_islow_ref, dejpeg_fdct_islow_avx2);
+  else
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "fdct-avx2");
+  dejpeg_bench_fdct("fdct-ref" , dejpeg_fdct_islow_ref);
+  dejpeg_bench_fdct("fdct-sse2", dejpeg_fdct_islow_sse2);
+  if (hasAVX2)
+    dejpeg_bench_fdct("fdct-avx2", dejpeg_fdct_islow_avx2);
+
+  printf("\n");
+
+  dejpeg_check_zigzag_roundtrip("fzag-ref"  , dejpeg_zigzag_ref);
+  if (hasSSSE3) {
+    dejpeg_check_dezigzag8x8("fzag-ssse3", dejpeg_zigzag_ref, dejpeg_zigzag_ssse3);
+    dejpeg_check_zigzag_roundtrip("fzag-ssse3", dejpeg_zigzag_ssse3);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no SSSE3)\n", "fzag-ssse3");
+  }
+  if (hasAVX2) {
+    dejpeg_check_dezigzag8x8("fzag-avx2" , dejpeg_zigzag_ref, dejpeg_zigzag_avx2);
+    dejpeg_check_zigzag_roundtrip("fzag-avx2" , dejpeg_zigzag_avx2);
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "fzag-avx2");
+  }
+  dejpeg_bench_dezigzag8x8("fzag-ref"  , dejpeg_zigzag_ref);
+  if (hasSSSE3)
+    dejpeg_bench_dezigzag8x8("fzag-ssse3", dejpeg_zigzag_ssse3);
+  if (hasAVX2)
+    dejpeg_bench_dezigzag8x8("fzag-avx2" , dejpeg_zigzag_avx2);
 
   printf("\n");
 
-  dejpeg_check_ycbcr_to_rgb32("ycbcr-rgb-sse2", dejpeg_ycbcr_to_rgb32_ref, dejpeg_ycbcr_to_rgb32_sse2);
-  dejpeg_bench_ycbcr_to_rgb32("ycbcr-rgb-ref", dejpeg_ycbcr_to_rgb32_ref);
-  dejpeg_bench_ycbcr_to_rgb32("ycbcr-rgb-sse2", dejpeg_ycbcr_to_rgb32_sse2);
+  dejpeg_decode_main(0, NULL);
   return 0;
 }
@@ -0,0 +1,318 @@
+// [SimdTests - DeJPEG]
+// SIMD optimized JPEG decoding utilities.
+//
+// [License]
+// Public Domain <unlicense.org>
+#include "../simdglobals.h"
+#include "./dejpeg.h"
+
+#if !defined(_WIN32)
+# include <pthread.h>
+# include <unistd.h>
+#endif
+
+// ============================================================================
+// [Thread Pool - Port]
+// ============================================================================
+
+#if defined(_WIN32)
+typedef CRITICAL_SECTION DeJpegMutex;
+typedef CONDITION_VARIABLE DeJpegCond;
+typedef HANDLE DeJpegThread;
+
+static void dejpeg_mutex_init(DeJpegMutex* m) { InitializeCriticalSection(m); }
+static void dejpeg_mutex_destroy(DeJpegMutex* m) { DeleteCriticalSection(m); }
+static void dejpeg_mutex_lock(DeJpegMutex* m) { EnterCriticalSection(m); }
+static void dejpeg_mutex_unlock(DeJpegMutex* m) { LeaveCriticalSection(m); }
+
+static void dejpeg_cond_init(DeJpegCond* c) { InitializeConditionVariable(c); }
+static void dejpeg_cond_destroy(DeJpegCond* c) { (void)c; }
+static void dejpeg_cond_wait(DeJpegCond* c, DeJpegMutex* m) { SleepConditionVariableCS(c, m, INFINITE); }
+static void dejpeg_cond_broadcast(DeJpegCond* c) { WakeAllConditionVariable(c); }
+#else
+typedef pthread_mutex_t DeJpegMutex;
+typedef pthread_cond_t DeJpegCond;
+typedef pthread_t DeJpegThread;
+
+static void dejpeg_mutex_init(DeJpegMutex* m) { pthread_mutex_init(m, NULL); }
+static void dejpeg_mutex_destroy(DeJpegMutex* m) { pthread_mutex_destroy(m); }
+static void dejpeg_mutex_lock(DeJpegMutex* m) { pthread_mutex_lock(m); }
+static void dejpeg_mutex_unlock(DeJpegMutex* m) { pthread_mutex_unlock(m); }
+
+static void dejpeg_cond_init(DeJpegCond* c) { pthread_cond_init(c, NULL); }
+static void dejpeg_cond_destroy(DeJpegCond* c) { pthread_cond_destroy(c); }
+static void dejpeg_cond_wait(DeJpegCond* c, DeJpegMutex* m) { pthread_cond_wait(c, m); }
+static void dejpeg_cond_broadcast(DeJpegCond* c) { pthread_cond_broadcast(c); }
+#endif
+
+uint32_t dejpeg_cpu_count(void) {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? static_cast<uint32_t>(info.dwNumberOfProcessors) : 1;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? static_cast<uint32_t>(n) : 1;
+#endif
+}
+
+// ============================================================================
+// [Thread Pool - Core]
+// ============================================================================
+
+// Tasks `[begin, end)` not yet taken by any worker. The owner takes tasks from
+// the front, thieves take the back half.
+struct DeJpegWorkQueue {
+  DeJpegMutex lock;
+  uint32_t begin;
+  uint32_t end;
+};
+
+struct DeJpegPoolThread {
+  DeJpegThreadPool* pool;
+  uint32_t worker;
+  DeJpegThread handle;
+};
+
+struct DeJpegThreadPool {
+  uint32_t threadCount;
+
+  // Protects everything below, except queues.
+  DeJpegMutex lock;
+  DeJpegCond wakeCond;
+  DeJpegCond doneCond;
+
+  // Incremented by each `dejpeg_thread_pool_run()`, workers compare it with
+  // the last job they worked on to find out whether there is a new one.
+  uint32_t jobId;
+  // Number of threads still working on the current job.
+  uint32_t running;
+  bool quit;
+
+  DeJpegTaskFunc func;
+  void* data;
+
+  DeJpegWorkQueue* queues;
+  DeJpegPoolThread* threads;
+};
+
+static bool dejpeg_pool_pop(DeJpegThreadPool* pool, uint32_t worker, uint32_t* task) {
+  DeJpegWorkQueue* q = &pool->queues[worker];
+  bool found = false;
+
+  dejpeg_mutex_lock(&q->lock);
+  if (q->begin < q->end) {
+    *task = q->begin++;
+    found = true;
+  }
+  dejpeg_mutex_unlock(&q->lock);
+
+  return found;
+}
+
+// Steals the back half of the first non-empty queue of another worker. The
+// first stolen task is returned, the rest becomes the worker's own queue.
+static bool dejpeg_pool_steal(DeJpegThreadPool* pool, uint32_t worker, uint32_t* task) {
+  uint32_t n = pool->threadCount;
+
+  for (uint32_t i = 1; i < n; i++) {
+    DeJpegWorkQueue* victim = &pool->queues[(worker + i) % n];
+    uint32_t begin = 0;
+    uint32_t end = 0;
+
+    dejpeg_mutex_lock(&victim->lock);
+    if (victim->begin < victim->end) {
+      end = victim->end;
+      begin = end - (end - victim->begin + 1) / 2;
+      victim->end = begin;
+    }
+    dejpeg_mutex_unlock(&victim->lock);
+
+    if (begin != end) {
+      DeJpegWorkQueue* q = &pool->queues[worker];
+      dejpeg_mutex_lock(&q->lock);
+      q->begin = begin + 1;
+      q->end = end;
+      dejpeg_mutex_unlock(&q->lock);
+
+      *task = begin;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Tasks never create new tasks, so once no queue has anything left to steal
+// the worker is done (tasks taken by other workers are run by them).
+static void dejpeg_pool_work(DeJpegThreadPool* pool, uint32_t worker) {
+  DeJpegTaskFunc func = pool->func;
+  void* data = pool->data;
+
+  uint32_t task;
+  while (dejpeg_pool_pop(pool, worker, &task) || dejpeg_pool_steal(pool, worker, &task))
+    func(data, worker, task);
+}
+
+static void dejpeg_pool_thread_main(DeJpegPoolThread* t) {
+  DeJpegThreadPool* pool = t->pool;
+  uint32_t lastJobId = 0;
+
+  dejpeg_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->quit && pool->jobId == lastJobId)
+      dejpeg_cond_wait(&pool->wakeCond, &pool->lock);
+
+    if (pool->quit)
+      break;
+
+    lastJobId = pool->jobId;
+    dejpeg_mutex_unlock(&pool->lock);
+
+    dejpeg_pool_work(pool, t->worker);
+
+    dejpeg_mutex_lock(&pool->lock);
+    if (--pool->running == 0)
+      dejpeg_cond_broadcast(&pool->doneCond);
+  }
+  dejpeg_mutex_unlock(&pool->lock);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI dejpeg_pool_thread_entry(LPVOID arg) {
+  dejpeg_pool_thread_main(static_cast<DeJpegPoolThread*>(arg));
+  return 0;
+}
+#else
+static void* dejpeg_pool_thread_entry(void* arg) {
+  dejpeg_pool_thread_main(static_cast<DeJpegPoolThread*>(arg));
+  return NULL;
+}
+#endif
+
+// ============================================================================
+// [Thread Pool - API]
+// ============================================================================
+
+DeJpegThreadPool* dejpeg_thread_pool_create(uint32_t threadCount) {
+  if (threadCount == 0)
+    threadCount = dejpeg_cpu_count();
+
+  DeJpegThreadPool* pool = static_cast<DeJpegThreadPool*>(::malloc(sizeof(DeJpegThreadPool)));
+  if (pool == NULL)
+    return NULL;
+
+  pool->queues = static_cast<DeJpegWorkQueue*>(::malloc(threadCount * sizeof(DeJpegWorkQueue)));
+  pool->threads = static_cast<DeJpegPoolThread*>(::malloc(threadCount * sizeof(DeJpegPoolThread)));
+
+  if (pool->queues == NULL || pool->threads == NULL) {
+    ::free(pool->threads);
+    ::free(pool->queues);
+    ::free(pool);
+    return NULL;
+  }
+
+  dejpeg_mutex_init(&pool->lock);
+  dejpeg_cond_init(&pool->wakeCond);
+  dejpeg_cond_init(&pool->doneCond);
+
+  pool->threadCount = threadCount;
+  pool->jobId = 0;
+  pool->running = 0;
+  pool->quit = false;
+  pool->func = NULL;
+  pool->data = NULL;
+
+  // Worker 0 is the thread that calls `dejpeg_thread_pool_run()`. If a thread
+  // cannot be created the pool just uses fewer threads.
+  for (uint32_t i = 1; i < threadCount; i++) {
+    DeJpegPoolThread* t = &pool->threads[i];
+    t->pool = pool;
+    t->worker = i;
+#if defined(_WIN32)
+    t->handle = CreateThread(NULL, 0, dejpeg_pool_thread_entry, t, 0, NULL);
+    bool ok = t->handle != NULL;
+#else
+    bool ok = pthread_create(&t->handle, NULL, dejpeg_pool_thread_entry, t) == 0;
+#endif
+    if (!ok) {
+      pool->threadCount = i;
+      break;
+    }
+  }
+
+  // Queues are only accessed by `dejpeg_thread_pool_run()`.
+  for (uint32_t i = 0; i < pool->threadCount; i++) {
+    dejpeg_mutex_init(&pool->queues[i].lock);
+    pool->queues[i].begin = 0;
+    pool->queues[i].end = 0;
+  }
+
+  return pool;
+}
+
+void dejpeg_thread_pool_destroy(DeJpegThreadPool* pool) {
+  if (pool == NULL)
+    return;
+
+  dejpeg_mutex_lock(&pool->lock);
+  pool->quit = true;
+  dejpeg_cond_broadcast(&pool->wakeCond);
+  dejpeg_mutex_unlock(&pool->lock);
+
+  for (uint32_t i = 1; i < pool->threadCount; i++) {
+#if defined(_WIN32)
+    WaitForSingleObject(pool->threads[i].handle, INFINITE);
+    CloseHandle(pool->threads[i].handle);
+#else
+    pthread_join(pool->threads[i].handle, NULL);
+#endif
+  }
+
+  for (uint32_t i = 0; i < pool->threadCount; i++)
+    dejpeg_mutex_destroy(&pool->queues[i].lock);
+
+  dejpeg_cond_destroy(&pool->doneCond);
+  dejpeg_cond_destroy(&pool->wakeCond);
+  dejpeg_mutex_destroy(&pool->lock);
+
+  ::free(pool->threads);
+  ::free(pool->queues);
+  ::free(pool);
+}
+
+uint32_t dejpeg_thread_pool_thread_count(const DeJpegThreadPool* pool) {
+  return pool ? pool->threadCount : 1;
+}
+
+void dejpeg_thread_pool_run(DeJpegThreadPool* pool, DeJpegTaskFunc func, void* data, uint32_t taskCount) {
+  uint32_t n = dejpeg_thread_pool_thread_count(pool);
+
+  if (n == 1 || taskCount <= 1) {
+    for (uint32_t task = 0; task < taskCount; task++)
+      func(data, 0, task);
+    return;
+  }
+
+  // Initial split, workers are idle so the queues don't have to be locked,
+  // the pool lock below publishes them.
+  for (uint32_t i = 0; i < n; i++) {
+    pool->queues[i].begin = static_cast<uint32_t>(uint64_t(taskCount) * i / n);
+    pool->queues[i].end = static_cast<uint32_t>(uint64_t(taskCount) * (i + 1) / n);
+  }
+
+  dejpeg_mutex_lock(&pool->lock);
+  pool->func = func;
+  pool->data = data;
+  pool->running = n - 1;
+  pool->jobId++;
+  dejpeg_cond_broadcast(&pool->wakeCond);
+  dejpeg_mutex_unlock(&pool->lock);
+
+  dejpeg_pool_work(pool, 0);
+
+  dejpeg_mutex_lock(&pool->lock);
+  while (pool->running != 0)
+    dejpeg_cond_wait(&pool->doneCond, &pool->lock);
+  dejpeg_mutex_unlock(&pool->lock);
+}
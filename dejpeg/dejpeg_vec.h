@@ -0,0 +1,82 @@
+// [SimdTests - DeJPEG]
+// SIMD optimized JPEG decoding utilities.
+//
+// [License]
+// Public Domain <unlicense.org>
+#ifndef _SIMDDEJPEG_VEC_H
+#define _SIMDDEJPEG_VEC_H
+
+#include "../simdglobals.h"
+#include "./dejpeg.h"
+
+// ============================================================================
+// [SimdTests::DeJPEG - YCbCrToRGB32 - Vec]
+// ============================================================================
+
+// YCbCr to RGB32 written by using `SimdVec`, compiled for the instruction set
+// of the translation unit that includes this file. It's the same computation
+// as `dejpeg_ycbcr_convert_sse2_template`, so the result is bit-exact with the
+// reference, but it converts `i16xN::kLanes` pixels per iteration.
+static SIMD_INLINE SimdVec::Vec<SimdVec::i16xN> dejpeg_ycbcr_vec_pair(int lo, int hi) {
+  using namespace SimdVec;
+  return cast<i16xN>(set1<i32xN>(static_cast<int32_t>((static_cast<uint32_t>(hi) << 16) | (static_cast<uint32_t>(lo) & 0xFFFFu))));
+}
+
+static SIMD_INLINE void dejpeg_ycbcr_to_rgb32_vec(uint8_t* dst, const uint8_t* pY, const uint8_t* pCb, const uint8_t* pCr, uint32_t count) {
+  using namespace SimdVec;
+  enum { kPixels = i16xN::kLanes };
+
+  uint32_t i = count;
+
+  Vec<i16xN> tosigned = set1<i16xN>(-128);
+  Vec<i16xN> yycrMul = dejpeg_ycbcr_vec_pair(JPEG_YCBCR_SCALE(1),  JPEG_YCBCR_FIXED(1.40200));
+  Vec<i16xN> yycbMul = dejpeg_ycbcr_vec_pair(JPEG_YCBCR_SCALE(1),  JPEG_YCBCR_FIXED(1.77200));
+  Vec<i16xN> cbcrMul = dejpeg_ycbcr_vec_pair(-JPEG_YCBCR_FIXED(0.34414), -JPEG_YCBCR_FIXED(0.71414));
+  Vec<i32xN> round = set1<i32xN>(1 << (JPEG_YCBCR_PREC - 1));
+
+  Vec<i16xN> zero = SimdVec::zero<i16xN>();
+  Vec<u8xN> ones = set1<u8xN>(0xFF);
+
+  while (i >= kPixels) {
+    Vec<i16xN> yy = loadWidenU8<i16xN>(pY);
+    Vec<i16xN> cb = loadWidenU8<i16xN>(pCb) + tosigned;
+    Vec<i16xN> cr = loadWidenU8<i16xN>(pCr) + tosigned;
+
+    Vec<i32xN> r_l = madd(unpackLo(yy, cr), yycrMul) + round;
+    Vec<i32xN> r_h = madd(unpackHi(yy, cr), yycrMul) + round;
+
+    Vec<i32xN> b_l = madd(unpackLo(yy, cb), yycbMul) + round;
+    Vec<i32xN> b_h = madd(unpackHi(yy, cb), yycbMul) + round;
+
+    Vec<i32xN> g_l = madd(unpackLo(cb, cr), cbcrMul) + round + slli<JPEG_YCBCR_PREC>(cast<i32xN>(unpackLo(yy, zero)));
+    Vec<i32xN> g_h = madd(unpackHi(cb, cr), cbcrMul) + round + slli<JPEG_YCBCR_PREC>(cast<i32xN>(unpackHi(yy, zero)));
+
+    Vec<i16xN> r = packs(srai<JPEG_YCBCR_PREC>(r_l), srai<JPEG_YCBCR_PREC>(r_h));
+    Vec<i16xN> g = packs(srai<JPEG_YCBCR_PREC>(g_l), srai<JPEG_YCBCR_PREC>(g_h));
+    Vec<i16xN> b = packs(srai<JPEG_YCBCR_PREC>(b_l), srai<JPEG_YCBCR_PREC>(b_h));
+
+    // Packing duplicates each 128-bit lane, so unpacking the low halves gives
+    // B,G and R,A pairs of all pixels, which are in order within 128-bit lanes.
+    Vec<i16xN> bg = cast<i16xN>(unpackLo(packus(b, b), packus(g, g)));
+    Vec<i16xN> ra = cast<i16xN>(unpackLo(packus(r, r), ones));
+    storeuLanes(dst, unpackLo(bg, ra), unpackHi(bg, ra));
+
+    dst += kPixels * 4;
+    pY  += kPixels;
+    pCb += kPixels;
+    pCr += kPixels;
+    i   -= kPixels;
+  }
+
+  while (i) {
+    reinterpret_cast<uint32_t*>(dst)[0] = dejpeg_ycbcr_to_rgb32_pixel(pY[0], pCb[0], pCr[0]);
+
+    dst += 4;
+    pY  += 1;
+    pCb += 1;
+    pCr += 1;
+    i   -= 1;
+  }
+}
+
+#endif // _SIMDDEJPEG_VEC_H
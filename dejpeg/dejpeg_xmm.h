@@ -0,0 +1,176 @@
+// [SimdTests - DeJPEG]
+// SIMD optimized JPEG decoding utilities.
+//
+// [License]
+// Public Domain <unlicense.org>
+#ifndef _SIMDDEJPEG_XMM_H
+#define _SIMDDEJPEG_XMM_H
+
+#include "../simdglobals.h"
+#include "./dejpeg.h"
+
+// ============================================================================
+// [SimdTests::DeJPEG - IDCT - XMM]
+// ============================================================================
+
+// Islow IDCT passes shared by `dejpeg_idct_islow_sse2` and the fused SSSE3
+// kernel `dejpeg_idct_islow_zigzag_ssse3`. Only SSE2 instructions are used,
+// so this can be included by any translation unit compiled for SSE2 or more.
+struct DeJPEG_XmmIDCTConsts {
+  int16_t rot0_0[8], rot0_1[8];
+  int16_t rot1_0[8], rot1_1[8];
+  int16_t rot2_0[8], rot2_1[8];
+  int16_t rot3_0[8], rot3_1[8];
+
+  int32_t colBias[4];
+  int32_t rowBias[4];
+};
+
+#define DATA_4X(...) { __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__ }
+SIMD_ALIGN_VAR(static const DeJPEG_XmmIDCTConsts, dejpeg_xmm_idct_consts, 16) = {
+  DATA_4X(JPEG_IDCT_P_0_541196100                          , JPEG_IDCT_P_0_541196100 + JPEG_IDCT_M_1_847759065),
+  DATA_4X(JPEG_IDCT_P_0_541196100 + JPEG_IDCT_P_0_765366865, JPEG_IDCT_P_0_541196100                          ),
+  DATA_4X(JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_0_899976223, JPEG_IDCT_P_1_175875602                          ),
+  DATA_4X(JPEG_IDCT_P_1_175875602                          , JPEG_IDCT_P_1_175875602 + JPEG_IDCT_M_2_562915447),
+  DATA_4X(JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_0_298631336, JPEG_IDCT_M_1_961570560                          ),
+  DATA_4X(JPEG_IDCT_M_1_961570560                          , JPEG_IDCT_M_1_961570560 + JPEG_IDCT_P_3_072711026),
+  DATA_4X(JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_2_053119869, JPEG_IDCT_M_0_390180644                          ),
+  DATA_4X(JPEG_IDCT_M_0_390180644                          , JPEG_IDCT_M_0_390180644 + JPEG_IDCT_P_1_501321110),
+  DATA_4X(JPEG_IDCT_COL_BIAS),
+  DATA_4X(JPEG_IDCT_ROW_BIAS)
+};
+#undef DATA_4X
+
+#define JPEG_IDCT_CONST_XMM(x) (*(const __m128i*)(dejpeg_xmm_idct_consts.x))
+
+#define JPEG_IDCT_INTERLEAVE8_XMM(a, b) { __m128i t = a; a = _mm_unpacklo_epi8(a, b); b = _mm_unpackhi_epi8(t, b); }
+#define JPEG_IDCT_INTERLEAVE16_XMM(a, b) { __m128i t = a; a = _mm_unpacklo_epi16(a, b); b = _mm_unpackhi_epi16(t, b); }
+
+// out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+// out(1) = c1[even]*x + c1[odd]*y
+#define JPEG_IDCT_ROTATE_XMM(dst0, dst1, x, y, c0, c1) \
+  __m128i dst0##_xy_l = _mm_unpacklo_epi16(x, y); \
+  __m128i dst0##_xy_h = _mm_unpackhi_epi16(x, y); \
+  \
+  __m128i dst0##_l = _mm_madd_epi16(dst0##_xy_l, c0); \
+  __m128i dst0##_h = _mm_madd_epi16(dst0##_xy_h, c0); \
+  __m128i dst1##_l = _mm_madd_epi16(dst0##_xy_l, c1); \
+  __m128i dst1##_h = _mm_madd_epi16(dst0##_xy_h, c1);
+
+// out = in << 12  (in 16-bit, out 32-bit)
+#define JPEG_IDCT_WIDEN_XMM(dst, in) \
+  __m128i dst##_l = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), (in)), 4); \
+  __m128i dst##_h = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), (in)), 4);
+
+// wide add
+#define JPEG_IDCT_WADD_XMM(dst, a, b) \
+  __m128i dst##_l = _mm_add_epi32(a##_l, b##_l); \
+  __m128i dst##_h = _mm_add_epi32(a##_h, b##_h);
+
+// wide sub
+#define JPEG_IDCT_WSUB_XMM(dst, a, b) \
+  __m128i dst##_l = _mm_sub_epi32(a##_l, b##_l); \
+  __m128i dst##_h = _mm_sub_epi32(a##_h, b##_h);
+
+// butterfly a/b, add bias, then shift by `norm` and pack to 16-bit.
+#define JPEG_IDCT_BFLY_XMM(dst0, dst1, a, b, bias, norm) { \
+  __m128i abiased_l = _mm_add_epi32(a##_l, bias); \
+  __m128i abiased_h = _mm_add_epi32(a##_h, bias); \
+  \
+  JPEG_IDCT_WADD_XMM(sum, abiased, b) \
+  JPEG_IDCT_WSUB_XMM(diff, abiased, b) \
+  \
+  dst0 = _mm_packs_epi32(_mm_srai_epi32(sum_l, norm), _mm_srai_epi32(sum_h, norm)); \
+  dst1 = _mm_packs_epi32(_mm_srai_epi32(diff_l, norm), _mm_srai_epi32(diff_h, norm)); \
+}
+
+#define JPEG_IDCT_IDCT_PASS_XMM(bias, norm) { \
+  /* Even part. */ \
+  JPEG_IDCT_ROTATE_XMM(t2e, t3e, row2, row6, JPEG_IDCT_CONST_XMM(rot0_0), JPEG_IDCT_CONST_XMM(rot0_1)) \
+  \
+  __m128i sum04 = _mm_add_epi16(row0, row4); \
+  __m128i dif04 = _mm_sub_epi16(row0, row4); \
+  \
+  JPEG_IDCT_WIDEN_XMM(t0e, sum04) \
+  JPEG_IDCT_WIDEN_XMM(t1e, dif04) \
+  \
+  JPEG_IDCT_WADD_XMM(x0, t0e, t3e) \
+  JPEG_IDCT_WSUB_XMM(x3, t0e, t3e) \
+  JPEG_IDCT_WADD_XMM(x1, t1e, t2e) \
+  JPEG_IDCT_WSUB_XMM(x2, t1e, t2e) \
+  \
+  /* Odd part. */ \
+  JPEG_IDCT_ROTATE_XMM(y0o, y2o, row7, row3, JPEG_IDCT_CONST_XMM(rot2_0), JPEG_IDCT_CONST_XMM(rot2_1)) \
+  JPEG_IDCT_ROTATE_XMM(y1o, y3o, row5, row1, JPEG_IDCT_CONST_XMM(rot3_0), JPEG_IDCT_CONST_XMM(rot3_1)) \
+  __m128i sum17 = _mm_add_epi16(row1, row7); \
+  __m128i sum35 = _mm_add_epi16(row3, row5); \
+  JPEG_IDCT_ROTATE_XMM(y4o, y5o, sum17, sum35, JPEG_IDCT_CONST_XMM(rot1_0), JPEG_IDCT_CONST_XMM(rot1_1)) \
+  \
+  JPEG_IDCT_WADD_XMM(x4, y0o, y4o) \
+  JPEG_IDCT_WADD_XMM(x5, y1o, y5o) \
+  JPEG_IDCT_WADD_XMM(x6, y2o, y5o) \
+  JPEG_IDCT_WADD_XMM(x7, y3o, y4o) \
+  \
+  JPEG_IDCT_BFLY_XMM(row0, row7, x0, x7, bias, norm) \
+  JPEG_IDCT_BFLY_XMM(row1, row6, x1, x6, bias, norm) \
+  JPEG_IDCT_BFLY_XMM(row2, row5, x2, x5, bias, norm) \
+  JPEG_IDCT_BFLY_XMM(row3, row4, x3, x4, bias, norm) \
+}
+
+// Transpose 8x8 matrix of 16-bit integers held by `row0..row7`.
+#define JPEG_IDCT_TRANSPOSE_XMM() { \
+  JPEG_IDCT_INTERLEAVE16_XMM(row0, row4) /* [a0a4|b0b4|c0c4|d0d4] | [e0e4|f0f4|g0g4|h0h4] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row2, row6) /* [a2a6|b2b6|c2c6|d2d6] | [e2e6|f2f6|g2g6|h2h6] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row1, row5) /* [a1a5|b1b5|c2c5|d1d5] | [e1e5|f1f5|g1g5|h1h5] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row3, row7) /* [a3a7|b3b7|c3c7|d3d7] | [e3e7|f3f7|g3g7|h3h7] */ \
+  \
+  JPEG_IDCT_INTERLEAVE16_XMM(row0, row2) /* [a0a2|a4a6|b0b2|b4b6] | [c0c2|c4c6|d0d2|d4d6] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row1, row3) /* [a1a3|a5a7|b1b3|b5b7] | [c1c3|c5c7|d1d3|d5d7] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row4, row6) /* [e0e2|e4e6|f0f2|f4f6] | [g0g2|g4g6|h0h2|h4h6] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row5, row7) /* [e1e3|e5e7|f1f3|f5f7] | [g1g3|g5g7|h1h3|h5h7] */ \
+  \
+  JPEG_IDCT_INTERLEAVE16_XMM(row0, row1) /* [a0a1|a2a3|a4a5|a6a7] | [b0b1|b2b3|b4b5|b6b7] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row2, row3) /* [c0c1|c2c3|c4c5|c6c7] | [d0d1|d2d3|d4d5|d6d7] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row4, row5) /* [e0e1|e2e3|e4e5|e6e7] | [f0f1|f2f3|f4f5|f6f7] */ \
+  JPEG_IDCT_INTERLEAVE16_XMM(row6, row7) /* [g0g1|g2g3|g4g5|g6g7] | [h0h1|h2h3|h4h5|h6h7] */ \
+}
+
+// Pack 8 rows of 16-bit integers produced by the row pass to 8-bit integers,
+// transpose, and store.
+static SIMD_INLINE void dejpeg_idct_store_sse2(uint8_t* dst, intptr_t dstStride,
+  __m128i row0, __m128i row1, __m128i row2, __m128i row3,
+  __m128i row4, __m128i row5, __m128i row6, __m128i row7) {
+
+  // Pack to 8-bit integers, also saturates the result to 0..255.
+  row0 = _mm_packus_epi16(row0, row1);   // [a0a1a2a3|a4a5a6a7|b0b1b2b3|b4b5b6b7]
+  row2 = _mm_packus_epi16(row2, row3);   // [c0c1c2c3|c4c5c6c7|d0d1d2d3|d4d5d6d7]
+  row4 = _mm_packus_epi16(row4, row5);   // [e0e1e2e3|e4e5e6e7|f0f1f2f3|f4f5f6f7]
+  row6 = _mm_packus_epi16(row6, row7);   // [g0g1g2g3|g4g5g6g7|h0h1h2h3|h4h5h6h7]
+
+  // Transpose.
+  JPEG_IDCT_INTERLEAVE8_XMM(row0, row4); // [a0e0a1e1|a2e2a3e3|a4e4a5e5|a6e6a7e7] | [b0f0b1f1|b2f2b3f3|b4f4b5f5|b6f6b7f7]
+  JPEG_IDCT_INTERLEAVE8_XMM(row2, row6); // [c0g0c1g1|c2g2c3g3|c4g4c5g5|c6g6c7g7] | [d0h0d1h1|d2h2d3h3|d4h4d5h5|d6h6d7h7]
+  JPEG_IDCT_INTERLEAVE8_XMM(row0, row2); // [a0c0e0g0|a1c1e1g1|a2c2e2g2|a3c3e3g3] | [a4c4e4g4|a5c5e5g5|a6c6e6g6|a7c7e7g7]
+  JPEG_IDCT_INTERLEAVE8_XMM(row4, row6); // [b0d0f0h0|b1d1f1h1|b2d2f2h2|b3d3f3h3| | [b4d4f4h4|b5d5f5h5|b6d6f6h6|b7d7f7h7]
+  JPEG_IDCT_INTERLEAVE8_XMM(row0, row4); // [a0b0c0d0|e0f0g0h0|a1b1c1d1|e1f1g1h1] | [a2b2c2d2|e2f2g2h2|a3b3c3d3|e3f3g3h3]
+  JPEG_IDCT_INTERLEAVE8_XMM(row2, row6); // [a4b4c4d4|e4f4g4h4|a5b5c5d5|e5f5g5h5] | [a6b6c6d6|e6f6g6h6|a7b7c7d7|e7f7g7h7]
+
+  // Store.
+  uint8_t* dst0 = dst;
+  uint8_t* dst1 = dst + dstStride;
+  intptr_t dstStride2 = dstStride * 2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row0)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row0)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row4)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row4)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row2)); dst0 += dstStride2;
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row2)); dst1 += dstStride2;
+
+  _mm_storel_pi((__m64 *)dst0, _mm_castsi128_ps(row6));
+  _mm_storeh_pi((__m64 *)dst1, _mm_castsi128_ps(row6));
+}
+
+#endif // _SIMDDEJPEG_XMM_H
@@ -121,6 +121,14 @@ enum PngFilterType {
   kPngFilterCount = 5
 };
 
+// Avg and Paeth depend on both the left and the upper pixel, so a row can't
+// be decoded faster than one pixel after another. Two consecutive rows using
+// these filters can be decoded together in a wavefront order instead, where
+// the second row follows the first one a few pixels behind.
+static SIMD_INLINE bool depng_wavefront_filter(uint32_t filter) {
+  return filter == kPngFilterAvg || filter == kPngFilterPaeth;
+}
+
 // ============================================================================
 // [SimdTests::DePNG - FilterFunc]
 // ============================================================================
@@ -130,5 +138,141 @@ typedef void (*DePngFilterFunc)(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t b
 void depng_filter_ref(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl);
 void depng_filter_opt(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl);
 void depng_filter_sse2(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl);
+void depng_filter_sse4_1(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl);
+void depng_filter_avx2(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl);
+
+// Reverse filter of a single row of `len` BYTEs (not including its filter
+// BYTE) that reads the filtered row from `src` and writes the reconstructed
+// row to `dst`, which is either equal to `src` (in-place) or doesn't overlap
+// it. `prev` is the already reconstructed previous row and none of these has
+// to be adjacent to each other, so a row can be filtered straight into a
+// strided framebuffer. `prev` can only be NULL if `filter` is None or Sub.
+typedef void (*DePngRowFunc)(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len);
+
+void depng_filter_row_ref(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len);
+void depng_filter_row_opt(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len);
+void depng_filter_row_sse2(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len);
+void depng_filter_row_sse4_1(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len);
+void depng_filter_row_avx2(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len);
+
+// In-place reverse filter of `h` rows `p` (including their filter BYTEs) that
+// uses `u` as the row preceding `p`. AVX2 uses it to decode two Avg or Paeth
+// rows by SSE4.1 in a wavefront order.
+void depng_filter_rows_sse4_1(uint8_t* p, const uint8_t* u, uint32_t h, uint32_t bpp, uint32_t bpl);
+
+// Variant of `depng_filter_...` selected by `SimdCpu::tier()`, `opt` is used
+// if there is no SIMD.
+const SimdVariant<DePngFilterFunc>* depng_filter_dispatch(void);
+const SimdVariant<DePngRowFunc>* depng_filter_row_dispatch(void);
+
+// ============================================================================
+// [SimdTests::DePNG - Decoder]
+// ============================================================================
+
+// Streaming decoder of non-interlaced PNG images that fuses inflate and the
+// reverse filter. The zlib stream (concatenated IDAT chunks) is inflated to a
+// window that keeps the last 32kB of the output (the farthest DEFLATE match),
+// and each complete row is reverse filtered from the window to a ring of two
+// rows (by using the other row of the ring as its upper row) while both are
+// still in L1 cache. Neither the inflated nor the filtered image is ever held as a
+// whole, so the workspace is the window, two rows, and Huffman tables. Rows
+// are delivered as stored in the image, without any transformation.
+//
+// The Adler-32 checksum of the zlib stream is verified, chunk CRCs are not.
+//
+//   DePngStream s;
+//   err = depng_decoder_stream_begin(d, &s, workspace);
+//   while (err == kPngErrorOk && (err = depng_decoder_stream_next(&s)) == kPngErrorOk && s.rows)
+//     consume(s.pixels, s.y);
+enum DePngError {
+  kPngErrorOk          = 0,
+  kPngErrorInvalidData = 1,
+  kPngErrorUnsupported = 2
+};
+
+// Number of bits used to index `DePngHuffTable::fast`.
+#define PNG_HUFF_LOOKUP_BITS 10
+
+// Huffman table of DEFLATE code lengths built by `depng_huff_build()`.
+struct DePngHuffTable {
+  // Lookahead table indexed by the next `PNG_HUFF_LOOKUP_BITS` bits (DEFLATE
+  // stores codes starting at the LSB), the entry contains the symbol (bits
+  // 4..15) and the code length (bits 0..3), zero if the code is longer.
+  uint16_t fast[1 << PNG_HUFF_LOOKUP_BITS];
+  // Codes of length `i` (MSB first) left-justified to 16 bits are less than
+  // `maxCode[i]`, `maxCode[16]` is a sentinel.
+  uint32_t maxCode[17];
+  // Symbol of code `c` of length `i` is `symbols[c + symOffset[i]]`.
+  int32_t symOffset[16];
+  uint16_t symbols[288];
+};
+
+// Builds `table` from code lengths of `count` symbols, fails if the lengths
+// describe an over-subscribed code. Incomplete codes are allowed, but their
+// unused codes fail to decode.
+bool depng_huff_build(DePngHuffTable* table, const uint8_t* lengths, uint32_t count);
+
+struct DePngDecoder {
+  DePngRowFunc filter;
+
+  uint32_t width;
+  uint32_t height;
+  uint32_t bitDepth;
+  uint32_t colorType;
+
+  // Bytes per complete pixel used by the reverse filter (at least one), and
+  // bytes per row including its filter BYTE.
+  uint32_t bpp;
+  uint32_t bpl;
+
+  // The first IDAT chunk (its length) and the end of the input.
+  const uint8_t* idat;
+  const uint8_t* end;
+};
+
+void depng_decoder_init(DePngDecoder* d, DePngRowFunc filter);
+
+// Parses chunks up to the first IDAT. On success the image size is known and
+// the stream can begin. Interlaced images are not supported.
+uint32_t depng_decoder_read_header(DePngDecoder* d, const uint8_t* data, size_t size);
+
+// Size of the workspace required by `depng_decoder_stream_begin()`, which is
+// O(bpl) and doesn't depend on the height of the image.
+size_t depng_decoder_stream_workspace_size(const DePngDecoder* d);
+
+struct DePngStream {
+  // Row `y` (not including its filter BYTE) decoded by the last call to
+  // `depng_decoder_stream_next()`, valid until the next call. `rows` is one,
+  // or zero after the last row.
+  const uint8_t* pixels;
+  uint32_t y;
+  uint32_t rows;
+
+  // Decoding state - the rest of the current IDAT chunk, the bit reader, the
+  // DEFLATE block being decoded, and positions of the output and of the next
+  // row in the window.
+  DePngDecoder* d;
+  void* workspace;
+  const uint8_t* src;
+  const uint8_t* srcEnd;
+  uint64_t bitBuf;
+  uint32_t bitCount;
+  uint32_t overrun;
+  uint32_t blockState;
+  uint32_t blockLast;
+  uint32_t storedLeft;
+  uint32_t adler;
+  size_t outPos;
+  size_t rowPos;
+};
+
+// Starts decoding the image whose header was read by `d`. The decoder, the
+// input and the workspace must stay valid until the stream ends.
+uint32_t depng_decoder_stream_begin(DePngDecoder* d, DePngStream* s, void* workspace);
+
+// Decodes the next row, `s->rows` is zero after the last one, which is also
+// when the checksum is verified. A stream that failed doesn't deliver any
+// more rows.
+uint32_t depng_decoder_stream_next(DePngStream* s);
 
 #endif // _DEPNG_H
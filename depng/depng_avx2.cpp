@@ -0,0 +1,380 @@
+// [SimdTests - DePNG]
+// SIMD optimized "PNG Reverse Filter" implementation.
+//
+// [License]
+// Public Domain <unlicense.org>
+#define USE_AVX2
+
+#include "../simdglobals.h"
+#include "./depng.h"
+
+// ============================================================================
+// [SimdTests::DePNG - Filter - AVX2]
+// ============================================================================
+
+// Returns a PSHUFB predicate that replicates the last `bpp` BYTEs of a lane
+// across a whole lane, so a BYTE at index `j` receives a BYTE at index
+// `16 - bpp + (j % bpp)`. The high lane is shifted by `offset` BYTEs, which
+// is needed if the distance between the source and destination is not a
+// multiple of `bpp` (i.e. 3 and 6 BPP).
+template<uint32_t bpp>
+static SIMD_INLINE __m256i depng_avx2_period_mask(uint32_t offset) {
+  SIMD_ALIGN_VAR(uint8_t, data[32], 32);
+
+  for (uint32_t j = 0; j < 16; j++) {
+    data[j     ] = static_cast<uint8_t>(16 - bpp + ((j         ) % bpp));
+    data[j + 16] = static_cast<uint8_t>(16 - bpp + ((j + offset) % bpp));
+  }
+
+  return _mm256_load_si256(reinterpret_cast<__m256i*>(data));
+}
+
+// Returns a PSHUFB predicate that moves a periodic pattern of `bpp` BYTEs by
+// 32 BYTEs forward, i.e. what was at index `j` is now at `j - (32 % bpp)`. The
+// pattern is moved within each lane, which is possible as `bpp` is at most 8.
+template<uint32_t bpp>
+static SIMD_INLINE __m256i depng_avx2_rotate_mask() {
+  SIMD_ALIGN_VAR(uint8_t, data[32], 32);
+
+  for (uint32_t j = 0; j < 16; j++) {
+    uint32_t k = j + (32 % bpp);
+    if (k >= 16) k -= bpp;
+
+    data[j     ] = static_cast<uint8_t>(k);
+    data[j + 16] = static_cast<uint8_t>(k);
+  }
+
+  return _mm256_load_si256(reinterpret_cast<__m256i*>(data));
+}
+
+// Sub filter of 32 BYTEs that doesn't depend on the previous pixel. PSLLDQ
+// only shifts within 128-bit lanes, so the log-step shifts are done per lane
+// first and then the last pixel of the low lane is added to the high lane.
+template<uint32_t bpp>
+static SIMD_INLINE __m256i depng_avx2_sub_local(__m256i x, __m256i laneMask) {
+  x = _mm256_add_epi8(x, _mm256_slli_si256(x, bpp));
+  if (bpp < 8) x = _mm256_add_epi8(x, _mm256_slli_si256(x, (bpp * 2) & 15));
+  if (bpp < 4) x = _mm256_add_epi8(x, _mm256_slli_si256(x, (bpp * 4) & 15));
+  if (bpp < 2) x = _mm256_add_epi8(x, _mm256_slli_si256(x, (bpp * 8) & 15));
+
+  __m256i lo = _mm256_permute2x128_si256(x, x, 0x08);
+  return _mm256_add_epi8(x, _mm256_shuffle_epi8(lo, laneMask));
+}
+
+// Replicates the last pixel of `x` to all pixels of the next 32 BYTE chunk.
+static SIMD_INLINE __m256i depng_avx2_sub_carry(__m256i x, __m256i carryMask) {
+  __m256i hi = _mm256_permute2x128_si256(x, x, 0x11);
+  return _mm256_shuffle_epi8(hi, carryMask);
+}
+
+template<uint32_t bpp>
+static SIMD_INLINE void depng_filter_avx2_row_template(uint8_t* p, const uint8_t* s, const uint8_t* u, uint32_t filter, uint32_t len) {
+  uint32_t i;
+
+  switch (filter) {
+    // ------------------------------------------------------------------------
+    // [None]
+    // ------------------------------------------------------------------------
+
+    case kPngFilterNone:
+      if (p != s)
+        ::memcpy(p, s, len);
+      break;
+
+    // ------------------------------------------------------------------------
+    // [Sub]
+    // ------------------------------------------------------------------------
+
+    // The same prefix sum as in `depng_filter_sse2`, but the 256-bit shifts
+    // are lane-local, so the result of the log-step shifts is fixed by one
+    // cross-lane permutation. Each 32 BYTE chunk is then summed without
+    // knowing the previous chunk and the carry, which is the sum of all
+    // previous pixels replicated to all pixels of a chunk, is added last:
+    //
+    //     X'[n]      = Local(X[n]) + Carry[n]
+    //     Carry[n+1] = Rotate(Carry[n]) + Replicate(Local(X[n]))
+    //
+    // This leaves only VPADDB (and VPSHUFB for 3 and 6 BPP, where 32 is not
+    // a multiple of BPP and the carry has to be rotated) as the sequential
+    // dependency between chunks.
+
+    case kPngFilterSub: {
+      for (i = 0; i < bpp; i++)
+        p[i] = s[i];
+
+      i = len - bpp;
+
+      if (i >= 64) {
+        __m256i laneMask = depng_avx2_period_mask<bpp>(0);
+        __m256i carryMask = depng_avx2_period_mask<bpp>(16);
+        __m256i rotateMask = depng_avx2_rotate_mask<bpp>();
+
+        // Align to 32-BYTE boundary.
+        uint32_t j = SimdUtils::alignDiff(p + bpp, 32);
+        for (i -= j; j != 0; j--, p++, s++)
+          p[bpp] = depng_sum(s[bpp], p[0]);
+
+        // The last decoded pixel, replicated.
+        __m256i carry = _mm256_broadcastsi128_si256(
+          _mm_slli_si128(_mm_loadl_epi64(reinterpret_cast<__m128i*>(p)), 16 - bpp));
+        carry = _mm256_shuffle_epi8(carry, carryMask);
+
+        // Process 64 BYTEs at a time.
+        while (i >= 64) {
+          __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + bpp));
+          __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + bpp + 32));
+
+          p0 = depng_avx2_sub_local<bpp>(p0, laneMask);
+          p1 = depng_avx2_sub_local<bpp>(p1, laneMask);
+
+          __m256i c0 = depng_avx2_sub_carry(p0, carryMask);
+          __m256i c1 = depng_avx2_sub_carry(p1, carryMask);
+
+          p0 = _mm256_add_epi8(p0, carry);
+          if (32 % bpp != 0) carry = _mm256_shuffle_epi8(carry, rotateMask);
+          carry = _mm256_add_epi8(carry, c0);
+
+          p1 = _mm256_add_epi8(p1, carry);
+          if (32 % bpp != 0) carry = _mm256_shuffle_epi8(carry, rotateMask);
+          carry = _mm256_add_epi8(carry, c1);
+
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p + bpp), p0);
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p + bpp + 32), p1);
+
+          p += 64;
+          s += 64;
+          i -= 64;
+        }
+
+        // Process 32 BYTEs at a time.
+        while (i >= 32) {
+          __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + bpp));
+
+          p0 = depng_avx2_sub_local<bpp>(p0, laneMask);
+          __m256i c0 = depng_avx2_sub_carry(p0, carryMask);
+
+          p0 = _mm256_add_epi8(p0, carry);
+          if (32 % bpp != 0) carry = _mm256_shuffle_epi8(carry, rotateMask);
+          carry = _mm256_add_epi8(carry, c0);
+
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p + bpp), p0);
+
+          p += 32;
+          s += 32;
+          i -= 32;
+        }
+      }
+
+      for (; i != 0; i--, p++, s++)
+        p[bpp] = depng_sum(s[bpp], p[0]);
+      break;
+    }
+
+    // ------------------------------------------------------------------------
+    // [Up]
+    // ------------------------------------------------------------------------
+
+    case kPngFilterUp: {
+      i = len;
+
+      if (i >= 64) {
+        // Align to 32-BYTE boundary.
+        uint32_t j = SimdUtils::alignDiff(p, 32);
+        for (i -= j; j != 0; j--, p++, s++, u++)
+          p[0] = depng_sum(s[0], u[0]);
+
+        // Process 128 BYTEs at a time.
+        while (i >= 128) {
+          __m256i u0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u));
+          __m256i u1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u + 32));
+          __m256i u2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u + 64));
+          __m256i u3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u + 96));
+
+          __m256i p0 = _mm256_add_epi8(u0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)));
+          __m256i p1 = _mm256_add_epi8(u1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32)));
+          __m256i p2 = _mm256_add_epi8(u2, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 64)));
+          __m256i p3 = _mm256_add_epi8(u3, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 96)));
+
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p     ), p0);
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p + 32), p1);
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p + 64), p2);
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p + 96), p3);
+
+          p += 128;
+          s += 128;
+          u += 128;
+          i -= 128;
+        }
+
+        // Process 32 BYTEs at a time.
+        while (i >= 32) {
+          __m256i u0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u));
+          __m256i p0 = _mm256_add_epi8(u0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)));
+
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p), p0);
+
+          p += 32;
+          s += 32;
+          u += 32;
+          i -= 32;
+        }
+
+        // Process 8 BYTEs at a time.
+        while (i >= 8) {
+          __m128i u0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u));
+          __m128i p0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s));
+
+          p0 = _mm_add_epi8(p0, u0);
+          _mm_storel_epi64(reinterpret_cast<__m128i*>(p), p0);
+
+          p += 8;
+          s += 8;
+          u += 8;
+          i -= 8;
+        }
+      }
+
+      for (; i != 0; i--, p++, s++, u++)
+        p[0] = depng_sum(s[0], u[0]);
+      break;
+    }
+
+    // ------------------------------------------------------------------------
+    // [Avg]
+    // ------------------------------------------------------------------------
+
+    // Unlike Sub, the truncating average makes Avg non-associative, so it
+    // can't be resolved by log-step shifts and each pixel still waits for
+    // the previous one. For 8 BPP a whole pixel widened to 16-bit words fits
+    // a 128-bit lane, so 32 BYTEs are fetched and unpacked at once and the
+    // sequential part is shortened by precomputing `A = 2*Y + U - 1`:
+    //
+    //     Y' = byte(Y + ((U + Last) >> 1))
+    //        = byte((A + Last + 1) >> 1)
+    //        = PAVGW(A, Last) & 0xFF
+    //
+    // When `A` is -1 (0xFFFF) PAVGW yields 0x8000 + (Last >> 1), which is
+    // still correct after masking. Other BPPs don't gain anything from wider
+    // registers and use the SSE4.1 implementation.
+
+    case kPngFilterAvg: {
+      if (bpp != 8) {
+        depng_filter_row_sse4_1(p, u, s, filter, bpp, len);
+        break;
+      }
+
+      for (i = 0; i < bpp; i++)
+        p[i] = depng_sum(s[i], u[i] >> 1);
+
+      i = len - bpp;
+      u += bpp;
+
+      if (i >= 64) {
+        // Align to 32-BYTE boundary.
+        uint32_t j = SimdUtils::alignDiff(p + bpp, 32);
+        for (i -= j; j != 0; j--, p++, s++, u++)
+          p[bpp] = depng_sum(s[bpp], depng_avg(p[0], u[0]));
+
+        __m256i m00FF = _mm256_set1_epi16(0x00FF);
+        __m256i mFFFF = _mm256_set1_epi16(-1);
+        __m128i t1 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<__m128i*>(p)));
+
+        // Process 32 BYTEs at a time.
+        while (i >= 32) {
+          __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 8));
+          __m256i u0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u));
+
+          __m256i aLo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(p0));
+          __m256i aHi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(p0, 1));
+
+          aLo = _mm256_add_epi16(_mm256_add_epi16(aLo, aLo), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(u0)));
+          aHi = _mm256_add_epi16(_mm256_add_epi16(aHi, aHi), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(u0, 1)));
+
+          aLo = _mm256_add_epi16(aLo, mFFFF);
+          aHi = _mm256_add_epi16(aHi, mFFFF);
+
+          __m128i y0, y1, y2, y3;
+          y0 = _mm_and_si128(_mm_avg_epu16(_mm256_castsi256_si128(aLo), t1), _mm256_castsi256_si128(m00FF));
+          y1 = _mm_and_si128(_mm_avg_epu16(_mm256_extracti128_si256(aLo, 1), y0), _mm256_castsi256_si128(m00FF));
+          y2 = _mm_and_si128(_mm_avg_epu16(_mm256_castsi256_si128(aHi), y1), _mm256_castsi256_si128(m00FF));
+          y3 = _mm_and_si128(_mm_avg_epu16(_mm256_extracti128_si256(aHi, 1), y2), _mm256_castsi256_si128(m00FF));
+
+          p0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_packus_epi16(y0, y1)), _mm_packus_epi16(y2, y3), 1);
+          _mm256_store_si256(reinterpret_cast<__m256i*>(p + 8), p0);
+          t1 = y3;
+
+          p += 32;
+          s += 32;
+          u += 32;
+          i -= 32;
+        }
+      }
+
+      for (; i != 0; i--, p++, s++, u++)
+        p[bpp] = depng_sum(s[bpp], depng_avg(p[0], u[0]));
+      break;
+    }
+
+    // ------------------------------------------------------------------------
+    // [Paeth]
+    // ------------------------------------------------------------------------
+
+    // Paeth has the same sequential dependency as Avg and has to widen to
+    // 16-bit words as well, so it uses the SSE4.1 implementation.
+
+    case kPngFilterPaeth: {
+      depng_filter_row_sse4_1(p, u, s, filter, bpp, len);
+      break;
+    }
+  }
+}
+
+template<uint32_t bpp>
+static SIMD_INLINE void depng_filter_avx2_template(uint8_t* p, const uint8_t* u, uint32_t h, uint32_t bpl) {
+  uint32_t y = h;
+
+  // Subtract one BYTE that is used to store the `filter` ID.
+  bpl--;
+
+  do {
+    uint32_t filter = *p++;
+
+    // Two Avg/Paeth rows of 3 and 4 BPP images are decoded together by SSE4.1
+    // (wavefront), see `depng_filter_rows_sse4_1()`.
+    if ((bpp == 3 || bpp == 4) && y >= 2 && depng_wavefront_filter(filter) && depng_wavefront_filter(p[bpl])) {
+      depng_filter_rows_sse4_1(p - 1, u, 2, bpp, bpl + 1);
+
+      u = p + bpl + 1;
+      p += bpl * 2 + 1;
+      y--;
+      continue;
+    }
+
+    depng_filter_avx2_row_template<bpp>(p, p, u, filter, bpl);
+
+    u = p;
+    p += bpl;
+  } while (--y != 0);
+}
+
+void depng_filter_avx2(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl) {
+  switch (bpp) {
+    case 1: depng_filter_avx2_template<1>(p, NULL, h, bpl); break;
+    case 2: depng_filter_avx2_template<2>(p, NULL, h, bpl); break;
+    case 3: depng_filter_avx2_template<3>(p, NULL, h, bpl); break;
+    case 4: depng_filter_avx2_template<4>(p, NULL, h, bpl); break;
+    case 6: depng_filter_avx2_template<6>(p, NULL, h, bpl); break;
+    case 8: depng_filter_avx2_template<8>(p, NULL, h, bpl); break;
+  }
+}
+
+void depng_filter_row_avx2(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len) {
+  switch (bpp) {
+    case 1: depng_filter_avx2_row_template<1>(dst, src, prev, filter, len); break;
+    case 2: depng_filter_avx2_row_template<2>(dst, src, prev, filter, len); break;
+    case 3: depng_filter_avx2_row_template<3>(dst, src, prev, filter, len); break;
+    case 4: depng_filter_avx2_row_template<4>(dst, src, prev, filter, len); break;
+    case 6: depng_filter_avx2_row_template<6>(dst, src, prev, filter, len); break;
+    case 8: depng_filter_avx2_row_template<8>(dst, src, prev, filter, len); break;
+  }
+}
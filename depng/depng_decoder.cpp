@@ -0,0 +1,759 @@
+// [SimdTests - DePNG]
+// SIMD optimized "PNG Reverse Filter" implementation.
+//
+// [License]
+// Public Domain <unlicense.org>
+#include "../simdglobals.h"
+#include "./depng.h"
+
+// ============================================================================
+// [Decoder - Huffman]
+// ============================================================================
+
+// Returned by `depng_huff_decode()` on corrupt data.
+#define PNG_HUFF_INVALID 0xFFFFFFFFU
+
+static SIMD_INLINE uint32_t depng_reverse_bits(uint32_t x, uint32_t n) {
+  x = ((x & 0x5555U) << 1) | ((x >> 1) & 0x5555U);
+  x = ((x & 0x3333U) << 2) | ((x >> 2) & 0x3333U);
+  x = ((x & 0x0F0FU) << 4) | ((x >> 4) & 0x0F0FU);
+  x = ((x & 0x00FFU) << 8) | ((x >> 8) & 0x00FFU);
+  return x >> (16 - n);
+}
+
+bool depng_huff_build(DePngHuffTable* table, const uint8_t* lengths, uint32_t count) {
+  uint32_t i;
+  uint32_t counts[16];
+  uint32_t next[16];
+  uint32_t code = 0;
+  uint32_t k = 0;
+
+  ::memset(counts, 0, sizeof(counts));
+  ::memset(table->fast, 0, sizeof(table->fast));
+
+  for (i = 0; i < count; i++)
+    counts[lengths[i]]++;
+
+  // Generate canonical codes as described by RFC 1951 3.2.2, `next` is the
+  // first code of each length.
+  table->maxCode[0] = 0;
+  table->symOffset[0] = 0;
+
+  for (i = 1; i < 16; i++) {
+    next[i] = code;
+    table->symOffset[i] = static_cast<int32_t>(k) - static_cast<int32_t>(code);
+
+    code += counts[i];
+    k += counts[i];
+
+    if (code > (1U << i))
+      return false;
+
+    table->maxCode[i] = code << (16 - i);
+    code <<= 1;
+  }
+  table->maxCode[16] = 0xFFFFFFFFU;
+
+  // Symbols are sorted by their codes. Each code of length `len` occupies all
+  // entries of the lookahead table that end with it (reversed).
+  for (i = 0; i < count; i++) {
+    uint32_t len = lengths[i];
+    if (len == 0)
+      continue;
+
+    uint32_t c = next[len]++;
+    table->symbols[static_cast<int32_t>(c) + table->symOffset[len]] = static_cast<uint16_t>(i);
+
+    if (len <= PNG_HUFF_LOOKUP_BITS) {
+      uint16_t e = static_cast<uint16_t>((i << 4) | len);
+      for (uint32_t j = depng_reverse_bits(c, len); j < (1U << PNG_HUFF_LOOKUP_BITS); j += 1U << len)
+        table->fast[j] = e;
+    }
+  }
+
+  return true;
+}
+
+// ============================================================================
+// [Decoder - Bits]
+// ============================================================================
+
+// Bits are consumed from the LSB of `bitBuf`. A fast refill loads 8 BYTEs of
+// the current IDAT chunk, bits above `bitCount` are then the BYTEs that follow
+// and the next refill ORs the same BYTEs there again. The slow refill crosses
+// chunks a BYTE at a time and feeds zeros after the end of the data, which is
+// counted by `overrun`.
+static SIMD_INLINE uint64_t depng_load64le(const uint8_t* p) {
+  uint64_t x;
+  ::memcpy(&x, p, 8);
+  return x;
+}
+
+static SIMD_INLINE uint32_t depng_read_u32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) <<  8) | (static_cast<uint32_t>(p[3])      );
+}
+
+// Moves `s->src` to the data of the IDAT chunk that follows the current one,
+// returns false if there is none (the data of a truncated chunk is clamped).
+static bool depng_decoder_next_idat(DePngStream* s) {
+  const uint8_t* p = s->srcEnd + 4;
+  const uint8_t* end = s->d->end;
+
+  if (p > end || static_cast<size_t>(end - p) < 8 || ::memcmp(p + 4, "IDAT", 4) != 0)
+    return false;
+
+  uint32_t length = depng_read_u32(p);
+  p += 8;
+
+  s->src = p;
+  s->srcEnd = p + SimdUtils::min<size_t>(length, static_cast<size_t>(end - p));
+  return true;
+}
+
+static void depng_bits_refill_slow(DePngStream* s) {
+  s->bitBuf &= (uint64_t(1) << s->bitCount) - 1;
+
+  while (s->bitCount <= 56) {
+    while (s->src == s->srcEnd && depng_decoder_next_idat(s))
+      continue;
+
+    uint32_t b = 0;
+    if (s->src != s->srcEnd)
+      b = *s->src++;
+    else
+      s->overrun++;
+
+    s->bitBuf |= uint64_t(b) << s->bitCount;
+    s->bitCount += 8;
+  }
+}
+
+// Makes sure there are at least 56 bits in `s->bitBuf`.
+static SIMD_INLINE void depng_bits_refill(DePngStream* s) {
+  if (static_cast<size_t>(s->srcEnd - s->src) >= 8) {
+    s->bitBuf |= depng_load64le(s->src) << s->bitCount;
+    s->src += (63 - s->bitCount) >> 3;
+    s->bitCount |= 56;
+  }
+  else {
+    depng_bits_refill_slow(s);
+  }
+}
+
+static SIMD_INLINE uint32_t depng_bits_get(DePngStream* s, uint32_t n) {
+  uint32_t x = static_cast<uint32_t>(s->bitBuf) & ((1U << n) - 1);
+  s->bitBuf >>= n;
+  s->bitCount -= n;
+  return x;
+}
+
+// Decodes a symbol, or returns `PNG_HUFF_INVALID`. The caller refills `s`.
+static SIMD_INLINE uint32_t depng_huff_decode(DePngStream* s, const DePngHuffTable* table) {
+  uint32_t e = table->fast[s->bitBuf & ((1U << PNG_HUFF_LOOKUP_BITS) - 1)];
+
+  if (e) {
+    depng_bits_get(s, e & 15);
+    return e >> 4;
+  }
+
+  uint32_t code = depng_reverse_bits(static_cast<uint32_t>(s->bitBuf) & 0xFFFF, 16);
+  uint32_t len = PNG_HUFF_LOOKUP_BITS + 1;
+
+  while (code >= table->maxCode[len])
+    len++;
+
+  if (len > 15)
+    return PNG_HUFF_INVALID;
+
+  depng_bits_get(s, len);
+  return table->symbols[static_cast<int32_t>(code >> (16 - len)) + table->symOffset[len]];
+}
+
+// ============================================================================
+// [Decoder - Workspace]
+// ============================================================================
+
+// Window is the output of inflate that is kept for matches and rows that are
+// not complete yet. Rows of the ring hold reconstructed pixels only.
+struct DePngWorkspace {
+  DePngHuffTable* litTable;
+  DePngHuffTable* distTable;
+  uint8_t* window;
+  uint8_t* rows[2];
+};
+
+// The farthest distance of a DEFLATE match.
+#define PNG_INFLATE_HISTORY 32768
+// Inflate stops after the symbol that reaches its target, a match can then
+// write up to 258 BYTEs plus 8 BYTEs of its last copy past the target.
+#define PNG_INFLATE_MARGIN 512
+
+// Window holds at least the history and a row. One more history is added so
+// the window slides once per `PNG_INFLATE_HISTORY` BYTEs of the output.
+static size_t depng_decoder_window_size(const DePngDecoder* d) {
+  return 2 * PNG_INFLATE_HISTORY + d->bpl + PNG_INFLATE_MARGIN;
+}
+
+// Assigns `ws` pointers relative to `base` and returns the size of the whole
+// workspace, `base` can be NULL to only calculate the size.
+static size_t depng_decoder_layout(const DePngDecoder* d, DePngWorkspace* ws, uint8_t* base) {
+  size_t offset = 0;
+
+# define PNG_WORKSPACE_ALLOC(dst, type, size) \
+  do { \
+    dst = reinterpret_cast<type*>(base + offset); \
+    offset = SimdUtils::align<size_t>(offset + (size), 64); \
+  } while (0)
+
+  // The workspace provided by the caller doesn't have to be aligned.
+  offset = SimdUtils::alignDiff<uint8_t*>(base, 64);
+
+  PNG_WORKSPACE_ALLOC(ws->litTable, DePngHuffTable, sizeof(DePngHuffTable));
+  PNG_WORKSPACE_ALLOC(ws->distTable, DePngHuffTable, sizeof(DePngHuffTable));
+  PNG_WORKSPACE_ALLOC(ws->window, uint8_t, depng_decoder_window_size(d));
+
+  for (uint32_t i = 0; i < 2; i++)
+    PNG_WORKSPACE_ALLOC(ws->rows[i], uint8_t, d->bpl - 1);
+
+# undef PNG_WORKSPACE_ALLOC
+  return offset;
+}
+
+size_t depng_decoder_stream_workspace_size(const DePngDecoder* d) {
+  DePngWorkspace ws;
+  return depng_decoder_layout(d, &ws, NULL) + 64;
+}
+
+// ============================================================================
+// [Decoder - Inflate]
+// ============================================================================
+
+enum DePngBlockState {
+  kPngBlockHeader  = 0,
+  kPngBlockStored  = 1,
+  kPngBlockHuffman = 2,
+  kPngBlockEnd     = 3
+};
+
+static const uint16_t depng_length_base[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t depng_length_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t depng_dist_base[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t depng_dist_extra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Order of code length code lengths in the header of a dynamic block.
+static const uint8_t depng_cl_order[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static bool depng_inflate_fixed(const DePngWorkspace* ws) {
+  uint8_t lengths[288];
+  uint32_t i;
+
+  for (i = 0; i < 144; i++) lengths[i] = 8;
+  for (; i < 256; i++) lengths[i] = 9;
+  for (; i < 280; i++) lengths[i] = 7;
+  for (; i < 288; i++) lengths[i] = 8;
+
+  if (!depng_huff_build(ws->litTable, lengths, 288))
+    return false;
+
+  // Distance codes 30 and 31 are never valid, they are left out of the code.
+  for (i = 0; i < 30; i++) lengths[i] = 5;
+  return depng_huff_build(ws->distTable, lengths, 30);
+}
+
+static bool depng_inflate_dynamic(DePngStream* s, const DePngWorkspace* ws) {
+  uint8_t lengths[286 + 30];
+  uint8_t clLengths[19];
+  uint32_t i;
+
+  depng_bits_refill(s);
+  uint32_t hlit = depng_bits_get(s, 5) + 257;
+  uint32_t hdist = depng_bits_get(s, 5) + 1;
+  uint32_t hclen = depng_bits_get(s, 4) + 4;
+
+  if (hlit > 286 || hdist > 30)
+    return false;
+
+  ::memset(clLengths, 0, sizeof(clLengths));
+  for (i = 0; i < hclen; i++) {
+    depng_bits_refill(s);
+    clLengths[depng_cl_order[i]] = static_cast<uint8_t>(depng_bits_get(s, 3));
+  }
+
+  // The code length code is decoded by using the literal table.
+  DePngHuffTable* clTable = ws->litTable;
+  if (!depng_huff_build(clTable, clLengths, 19))
+    return false;
+
+  i = 0;
+  while (i < hlit + hdist) {
+    depng_bits_refill(s);
+    uint32_t sym = depng_huff_decode(s, clTable);
+
+    if (sym < 16) {
+      lengths[i++] = static_cast<uint8_t>(sym);
+      continue;
+    }
+
+    uint32_t value = 0;
+    uint32_t n;
+
+    if (sym == 16) {
+      if (i == 0)
+        return false;
+      value = lengths[i - 1];
+      n = 3 + depng_bits_get(s, 2);
+    }
+    else if (sym == 17) {
+      n = 3 + depng_bits_get(s, 3);
+    }
+    else if (sym == 18) {
+      n = 11 + depng_bits_get(s, 7);
+    }
+    else {
+      return false;
+    }
+
+    if (n > hlit + hdist - i)
+      return false;
+
+    ::memset(lengths + i, static_cast<int>(value), n);
+    i += n;
+  }
+
+  // End of block must have a code.
+  if (lengths[256] == 0)
+    return false;
+
+  return depng_huff_build(ws->litTable, lengths, hlit) &&
+         depng_huff_build(ws->distTable, lengths + hlit, hdist);
+}
+
+// Copies a match of `len` BYTEs from `dist` BYTEs back. Matches that don't
+// overlap within 8 BYTEs are copied 8 BYTEs at a time, which can write up to
+// 7 BYTEs past the match.
+static SIMD_INLINE uint8_t* depng_inflate_copy(uint8_t* out, uint32_t dist, uint32_t len) {
+  const uint8_t* src = out - dist;
+  uint8_t* end = out + len;
+
+  if (dist >= 8) {
+    do {
+      ::memcpy(out, src, 8);
+      out += 8;
+      src += 8;
+    } while (out < end);
+  }
+  else if (dist == 1) {
+    ::memset(out, src[0], len);
+  }
+  else {
+    do {
+      *out++ = *src++;
+    } while (out < end);
+  }
+
+  return end;
+}
+
+// Inflates until the output reaches `target` BYTEs of the window (it can go
+// up to `PNG_INFLATE_MARGIN` BYTEs further) or the zlib stream ends, which is
+// when `s->adler` is replaced by the checksum stored in the stream.
+static uint32_t depng_inflate(DePngStream* s, const DePngWorkspace* ws, size_t target) {
+  uint8_t* window = ws->window;
+  uint8_t* out = window + s->outPos;
+  uint8_t* outEnd = window + target;
+
+  while (out < outEnd) {
+    switch (s->blockState) {
+      case kPngBlockHeader: {
+        if (s->blockLast) {
+          // Skip to a BYTE boundary and read the Adler-32 (big endian).
+          depng_bits_get(s, s->bitCount & 7);
+          depng_bits_refill(s);
+
+          uint32_t adler = 0;
+          for (uint32_t i = 0; i < 4; i++)
+            adler = (adler << 8) | depng_bits_get(s, 8);
+
+          s->adler = adler;
+          s->blockState = kPngBlockEnd;
+          break;
+        }
+
+        depng_bits_refill(s);
+        s->blockLast = depng_bits_get(s, 1);
+
+        switch (depng_bits_get(s, 2)) {
+          case 0: {
+            depng_bits_get(s, s->bitCount & 7);
+            depng_bits_refill(s);
+
+            uint32_t len = depng_bits_get(s, 16);
+            uint32_t nlen = depng_bits_get(s, 16);
+
+            if ((len ^ 0xFFFF) != nlen)
+              return kPngErrorInvalidData;
+
+            s->storedLeft = len;
+            s->blockState = kPngBlockStored;
+            break;
+          }
+
+          case 1:
+            if (!depng_inflate_fixed(ws))
+              return kPngErrorInvalidData;
+            s->blockState = kPngBlockHuffman;
+            break;
+
+          case 2:
+            if (!depng_inflate_dynamic(s, ws))
+              return kPngErrorInvalidData;
+            s->blockState = kPngBlockHuffman;
+            break;
+
+          default:
+            return kPngErrorInvalidData;
+        }
+        break;
+      }
+
+      // BYTEs already in the bit buffer go first, the rest is copied from the
+      // IDAT chunks directly.
+      case kPngBlockStored: {
+        while (s->storedLeft && s->bitCount && out < outEnd) {
+          *out++ = static_cast<uint8_t>(depng_bits_get(s, 8));
+          s->storedLeft--;
+        }
+
+        if (s->bitCount == 0)
+          s->bitBuf = 0;
+
+        while (s->storedLeft && out < outEnd) {
+          if (s->src == s->srcEnd && !depng_decoder_next_idat(s))
+            return kPngErrorInvalidData;
+
+          size_t n = SimdUtils::min<size_t>(
+            SimdUtils::min<size_t>(s->storedLeft, static_cast<size_t>(s->srcEnd - s->src)),
+            static_cast<size_t>(outEnd - out));
+
+          ::memcpy(out, s->src, n);
+          out += n;
+          s->src += n;
+          s->storedLeft -= static_cast<uint32_t>(n);
+        }
+
+        if (s->storedLeft == 0)
+          s->blockState = kPngBlockHeader;
+        break;
+      }
+
+      // At most 48 bits (15+5 of length and 15+13 of distance) are consumed
+      // by a symbol, so a single refill per symbol is enough.
+      case kPngBlockHuffman: {
+        const DePngHuffTable* litTable = ws->litTable;
+        const DePngHuffTable* distTable = ws->distTable;
+
+        do {
+          depng_bits_refill(s);
+          uint32_t sym = depng_huff_decode(s, litTable);
+
+          if (sym < 256) {
+            *out++ = static_cast<uint8_t>(sym);
+            continue;
+          }
+
+          if (sym == 256) {
+            s->blockState = kPngBlockHeader;
+            break;
+          }
+
+          sym -= 257;
+          if (sym >= 29)
+            return kPngErrorInvalidData;
+          uint32_t len = depng_length_base[sym] + depng_bits_get(s, depng_length_extra[sym]);
+
+          sym = depng_huff_decode(s, distTable);
+          if (sym >= 30)
+            return kPngErrorInvalidData;
+          uint32_t dist = depng_dist_base[sym] + depng_bits_get(s, depng_dist_extra[sym]);
+
+          if (dist > static_cast<size_t>(out - window))
+            return kPngErrorInvalidData;
+
+          out = depng_inflate_copy(out, dist, len);
+        } while (out < outEnd);
+        break;
+      }
+
+      case kPngBlockEnd:
+        s->outPos = static_cast<size_t>(out - window);
+        return kPngErrorOk;
+    }
+
+    // Zeros fed after the end of the data can't be more than a refill.
+    if (s->overrun > 8)
+      return kPngErrorInvalidData;
+  }
+
+  s->outPos = static_cast<size_t>(out - window);
+  return s->overrun > 8 ? kPngErrorInvalidData : kPngErrorOk;
+}
+
+// ============================================================================
+// [Decoder - Adler32]
+// ============================================================================
+
+static uint32_t depng_adler32(uint32_t adler, const uint8_t* p, size_t size) {
+  uint32_t a = adler & 0xFFFF;
+  uint32_t b = adler >> 16;
+
+  // 5552 is the largest `n` for which `b` doesn't overflow 32 bits.
+  while (size) {
+    size_t n = SimdUtils::min<size_t>(size, 5552);
+    size -= n;
+
+    for (; n >= 4; n -= 4, p += 4) {
+      a += p[0]; b += a;
+      a += p[1]; b += a;
+      a += p[2]; b += a;
+      a += p[3]; b += a;
+    }
+
+    for (; n != 0; n--, p++) {
+      a += p[0]; b += a;
+    }
+
+    a %= 65521;
+    b %= 65521;
+  }
+
+  return (b << 16) | a;
+}
+
+// ============================================================================
+// [Decoder - Header]
+// ============================================================================
+
+void depng_decoder_init(DePngDecoder* d, DePngRowFunc filter) {
+  ::memset(d, 0, sizeof(DePngDecoder));
+  d->filter = filter;
+}
+
+uint32_t depng_decoder_read_header(DePngDecoder* d, const uint8_t* data, size_t size) {
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+  DePngRowFunc filter = d->filter;
+  depng_decoder_init(d, filter);
+
+  if (size < 8 + 8 + 13 || ::memcmp(data, signature, 8) != 0)
+    return kPngErrorInvalidData;
+
+  const uint8_t* p = data + 8;
+  const uint8_t* end = data + size;
+
+  if (depng_read_u32(p) != 13 || ::memcmp(p + 4, "IHDR", 4) != 0)
+    return kPngErrorInvalidData;
+
+  const uint8_t* ihdr = p + 8;
+  uint32_t width = depng_read_u32(ihdr);
+  uint32_t height = depng_read_u32(ihdr + 4);
+  uint32_t bitDepth = ihdr[8];
+  uint32_t colorType = ihdr[9];
+
+  if (width == 0 || height == 0 || width > 0x7FFFFFFFU || height > 0x7FFFFFFFU)
+    return kPngErrorInvalidData;
+
+  // Allowed bit depths of each color type, as bit masks.
+  uint32_t channels;
+  uint32_t depths;
+
+  switch (colorType) {
+    case 0: channels = 1; depths = 0x1 | 0x2 | 0x8 | 0x80 | 0x8000; break;
+    case 2: channels = 3; depths = 0x80 | 0x8000; break;
+    case 3: channels = 1; depths = 0x1 | 0x2 | 0x8 | 0x80; break;
+    case 4: channels = 2; depths = 0x80 | 0x8000; break;
+    case 6: channels = 4; depths = 0x80 | 0x8000; break;
+    default:
+      return kPngErrorInvalidData;
+  }
+
+  if (bitDepth == 0 || bitDepth > 16 || !(depths & (1U << (bitDepth - 1))) || ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] > 1)
+    return kPngErrorInvalidData;
+
+  if (ihdr[12] != 0)
+    return kPngErrorUnsupported;
+
+  uint64_t rowBytes = (uint64_t(width) * channels * bitDepth + 7) / 8;
+  if (rowBytes >= 0x10000000U)
+    return kPngErrorUnsupported;
+
+  // Find the first IDAT, it must precede IEND.
+  p = ihdr + 13 + 4;
+  for (;;) {
+    if (static_cast<size_t>(end - p) < 12)
+      return kPngErrorInvalidData;
+
+    uint32_t length = depng_read_u32(p);
+    if (::memcmp(p + 4, "IDAT", 4) == 0)
+      break;
+
+    if (::memcmp(p + 4, "IEND", 4) == 0 || length > static_cast<size_t>(end - p) - 12)
+      return kPngErrorInvalidData;
+
+    p += 12 + length;
+  }
+
+  d->width = width;
+  d->height = height;
+  d->bitDepth = bitDepth;
+  d->colorType = colorType;
+  d->bpp = SimdUtils::max<uint32_t>(channels * bitDepth / 8, 1);
+  d->bpl = static_cast<uint32_t>(rowBytes) + 1;
+  d->idat = p;
+  d->end = end;
+
+  return kPngErrorOk;
+}
+
+// ============================================================================
+// [Decoder - Stream]
+// ============================================================================
+
+uint32_t depng_decoder_stream_begin(DePngDecoder* d, DePngStream* s, void* workspace) {
+  if (d->idat == NULL)
+    return kPngErrorInvalidData;
+
+  DePngWorkspace ws;
+  depng_decoder_layout(d, &ws, static_cast<uint8_t*>(workspace));
+
+  s->pixels = NULL;
+  s->y = 0;
+  s->rows = 0;
+
+  s->d = d;
+  s->workspace = workspace;
+  s->bitBuf = 0;
+  s->bitCount = 0;
+  s->overrun = 0;
+  s->blockState = kPngBlockHeader;
+  s->blockLast = 0;
+  s->storedLeft = 0;
+  s->adler = 1;
+  s->outPos = 0;
+  s->rowPos = 0;
+
+  // Upper row of the first row is zero.
+  ::memset(ws.rows[1], 0, d->bpl - 1);
+
+  // The stream starts at the data of the first IDAT, which `srcEnd` points
+  // to when advancing to the next chunk (minus its CRC).
+  s->src = d->idat - 4;
+  s->srcEnd = d->idat - 4;
+
+  depng_bits_refill(s);
+  uint32_t cmf = depng_bits_get(s, 8);
+  uint32_t flg = depng_bits_get(s, 8);
+
+  // Preset dictionary is not allowed by PNG.
+  if ((cmf & 15) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20) || s->overrun) {
+    s->y = d->height + 1;
+    return kPngErrorInvalidData;
+  }
+
+  return kPngErrorOk;
+}
+
+uint32_t depng_decoder_stream_next(DePngStream* s) {
+  const DePngDecoder* d = s->d;
+  uint32_t bpl = d->bpl;
+  uint32_t y = s->pixels ? s->y + 1 : s->y;
+  uint32_t err;
+
+  DePngWorkspace ws;
+  depng_decoder_layout(d, &ws, static_cast<uint8_t*>(s->workspace));
+
+  s->rows = 0;
+  if (y > d->height)
+    return kPngErrorOk;
+
+  if (y == d->height) {
+    // All rows were delivered, the stream must end exactly here.
+    s->y = d->height + 1;
+
+    if (s->outPos != s->rowPos)
+      return kPngErrorInvalidData;
+
+    // Any output from now on is an error, so the window doesn't have to keep
+    // anything, inflate only has to reach the end of the stream.
+    uint32_t computed = s->adler;
+
+    while (s->blockState != kPngBlockEnd) {
+      s->rowPos = s->outPos = 0;
+      err = depng_inflate(s, &ws, 1);
+
+      if (err != kPngErrorOk || s->outPos != 0)
+        return kPngErrorInvalidData;
+    }
+
+    return s->adler == computed ? kPngErrorOk : kPngErrorInvalidData;
+  }
+
+  if (s->outPos - s->rowPos < bpl) {
+    size_t windowSize = depng_decoder_window_size(d);
+
+    // Slide the window, keeping the history and the incomplete row.
+    if (s->rowPos + bpl + PNG_INFLATE_MARGIN > windowSize) {
+      size_t keep = s->outPos > PNG_INFLATE_HISTORY ? s->outPos - PNG_INFLATE_HISTORY : size_t(0);
+      keep = SimdUtils::min<size_t>(keep, s->rowPos);
+
+      ::memmove(ws.window, ws.window + keep, s->outPos - keep);
+      s->outPos -= keep;
+      s->rowPos -= keep;
+    }
+
+    err = depng_inflate(s, &ws, s->rowPos + bpl);
+    if (err == kPngErrorOk && s->outPos - s->rowPos < bpl)
+      err = kPngErrorInvalidData;
+
+    if (err != kPngErrorOk) {
+      s->y = d->height + 1;
+      return err;
+    }
+  }
+
+  const uint8_t* row = ws.window + s->rowPos;
+  if (row[0] >= kPngFilterCount) {
+    s->y = d->height + 1;
+    return kPngErrorInvalidData;
+  }
+
+  uint8_t* dst = ws.rows[y & 1];
+  const uint8_t* prev = ws.rows[(y & 1) ^ 1];
+
+  // The row is filtered straight from the window to the ring.
+  s->adler = depng_adler32(s->adler, row, bpl);
+  d->filter(dst, prev, row + 1, row[0], d->bpp, bpl - 1);
+
+  s->rowPos += bpl;
+  s->pixels = dst;
+  s->y = y;
+  s->rows = 1;
+  return kPngErrorOk;
+}
@@ -10,61 +10,68 @@
 // [SimdTests::DePNG - Filter - Ref]
 // ============================================================================
 
-void depng_filter_ref(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl) {
-  uint32_t y = h;
-  uint8_t* u = NULL;
-
-  // Subtract one BYTE that is used to store the `filter` ID.
-  bpl--;
-
-  do {
-    uint32_t i;
-    uint32_t filter = *p++;
-
-    switch (filter) {
-      case kPngFilterNone:
-        p += bpl;
-        break;
-
-      case kPngFilterSub: {
-        for (i = bpl - bpp; i != 0; i--, p++)
-          p[bpp] = depng_sum(p[bpp], p[0]);
+void depng_filter_row_ref(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len) {
+  uint32_t i;
+
+  uint8_t* p = dst;
+  const uint8_t* s = src;
+  const uint8_t* u = prev;
+
+  switch (filter) {
+    case kPngFilterNone:
+      for (i = 0; i < len; i++)
+        p[i] = s[i];
+      break;
+
+    case kPngFilterSub: {
+      for (i = 0; i < bpp; i++)
+        p[i] = s[i];
+
+      for (i = len - bpp; i != 0; i--, p++, s++)
+        p[bpp] = depng_sum(s[bpp], p[0]);
+      break;
+    }
 
-        p += bpp;
-        break;
-      }
+    case kPngFilterUp: {
+      for (i = len; i != 0; i--, p++, s++, u++)
+        p[0] = depng_sum(s[0], u[0]);
+      break;
+    }
 
-      case kPngFilterUp: {
-        for (i = bpl; i != 0; i--, p++, u++)
-          p[0] = depng_sum(p[0], u[0]);
-        break;
-      }
+    case kPngFilterAvg: {
+      for (i = 0; i < bpp; i++)
+        p[i] = depng_sum(s[i], u[i] >> 1);
 
-      case kPngFilterAvg: {
-        for (i = 0; i < bpp; i++)
-          p[i] = depng_sum(p[i], u[i] >> 1);
+      u += bpp;
+      for (i = len - bpp; i != 0; i--, p++, s++, u++)
+        p[bpp] = depng_sum(s[bpp], depng_avg(p[0], u[0]));
+      break;
+    }
 
-        u += bpp;
-        for (i = bpl - bpp; i != 0; i--, p++, u++)
-          p[bpp] = depng_sum(p[bpp], depng_avg(p[0], u[0]));
+    case kPngFilterPaeth: {
+      for (i = 0; i < bpp; i++)
+        p[i] = depng_sum(s[i], u[i]);
 
-        p += bpp;
-        break;
-      }
+      for (i = len - bpp; i != 0; i--, p++, s++, u++)
+        p[bpp] = depng_sum(s[bpp], depng_paeth_ref(p[0], u[bpp], u[0]));
+      break;
+    }
+  }
+}
 
-      case kPngFilterPaeth: {
-        for (i = 0; i < bpp; i++)
-          p[i] = depng_sum(p[i], u[i]);
+void depng_filter_ref(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl) {
+  uint8_t* u = NULL;
+  uint32_t y = h;
 
-        for (i = bpl - bpp; i != 0; i--, p++, u++)
-          p[bpp] = depng_sum(p[bpp], depng_paeth_ref(p[0], u[bpp], u[0]));
+  // Subtract one BYTE that is used to store the `filter` ID.
+  bpl--;
 
-        p += bpp;
-        break;
-      }
-    }
+  do {
+    uint32_t filter = *p++;
+    depng_filter_row_ref(p, u, p, filter, bpp, bpl);
 
-    u = p - bpl;
+    u = p;
+    p += bpl;
   } while (--y != 0);
 }
 
@@ -76,71 +83,121 @@ void depng_filter_ref(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl) {
 // `bpp` being constant, so the C++ compiler has more information for making
 // certain optimizations not possible in reference implementation.
 template<uint32_t bpp>
-static SIMD_INLINE void depng_filter_opt_template(uint8_t* p, uint32_t h, uint32_t bpl) {
+static SIMD_INLINE void depng_filter_opt_row_template(uint8_t* p, const uint8_t* s, const uint8_t* u, uint32_t filter, uint32_t len) {
+  uint32_t i;
+
+  switch (filter) {
+    case kPngFilterNone:
+      if (p != s)
+        ::memcpy(p, s, len);
+      break;
+
+    case kPngFilterSub: {
+      for (i = 0; i < bpp; i++)
+        p[i] = s[i];
+
+      for (i = len - bpp; i != 0; i--, p++, s++)
+        p[bpp] = depng_sum(s[bpp], p[0]);
+      break;
+    }
+
+    case kPngFilterUp: {
+      for (i = len; i != 0; i--, p++, s++, u++)
+        p[0] = depng_sum(s[0], u[0]);
+      break;
+    }
+
+    case kPngFilterAvg: {
+      for (i = 0; i < bpp; i++)
+        p[i] = depng_sum(s[i], u[i] >> 1);
+
+      u += bpp;
+      for (i = len - bpp; i != 0; i--, p++, s++, u++)
+        p[bpp] = depng_sum(s[bpp], depng_avg(p[0], u[0]));
+      break;
+    }
+
+    case kPngFilterPaeth: {
+      for (i = 0; i < bpp; i++)
+        p[i] = depng_sum(s[i], u[i]);
+
+      for (i = len - bpp; i != 0; i--, p++, s++, u++)
+        p[bpp] = depng_sum(s[bpp], depng_paeth_opt(p[0], u[bpp], u[0]));
+      break;
+    }
+  }
+}
+
+template<uint32_t bpp>
+static SIMD_INLINE void depng_filter_opt_template(uint8_t* p, const uint8_t* u, uint32_t h, uint32_t bpl) {
   uint32_t y = h;
-  uint8_t* u = NULL;
 
   // Subtract one BYTE that is used to store the `filter` ID.
   bpl--;
 
   do {
-    uint32_t i;
     uint32_t filter = *p++;
+    depng_filter_opt_row_template<bpp>(p, p, u, filter, bpl);
 
-    switch (filter) {
-      case kPngFilterNone:
-        p += bpl;
-        break;
-
-      case kPngFilterSub: {
-        for (i = bpl - bpp; i != 0; i--, p++)
-          p[bpp] = depng_sum(p[bpp], p[0]);
-
-        p += bpp;
-        break;
-      }
+    u = p;
+    p += bpl;
+  } while (--y != 0);
+}
 
-      case kPngFilterUp: {
-        for (i = bpl; i != 0; i--, p++, u++)
-          p[0] = depng_sum(p[0], u[0]);
-        break;
-      }
+void depng_filter_opt(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl) {
+  switch (bpp) {
+    case 1: depng_filter_opt_template<1>(p, NULL, h, bpl); break;
+    case 2: depng_filter_opt_template<2>(p, NULL, h, bpl); break;
+    case 3: depng_filter_opt_template<3>(p, NULL, h, bpl); break;
+    case 4: depng_filter_opt_template<4>(p, NULL, h, bpl); break;
+    case 6: depng_filter_opt_template<6>(p, NULL, h, bpl); break;
+    case 8: depng_filter_opt_template<8>(p, NULL, h, bpl); break;
+  }
+}
 
-      case kPngFilterAvg: {
-        for (i = 0; i < bpp; i++)
-          p[i] = depng_sum(p[i], u[i] >> 1);
+void depng_filter_row_opt(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len) {
+  switch (bpp) {
+    case 1: depng_filter_opt_row_template<1>(dst, src, prev, filter, len); break;
+    case 2: depng_filter_opt_row_template<2>(dst, src, prev, filter, len); break;
+    case 3: depng_filter_opt_row_template<3>(dst, src, prev, filter, len); break;
+    case 4: depng_filter_opt_row_template<4>(dst, src, prev, filter, len); break;
+    case 6: depng_filter_opt_row_template<6>(dst, src, prev, filter, len); break;
+    case 8: depng_filter_opt_row_template<8>(dst, src, prev, filter, len); break;
+  }
+}
 
-        u += bpp;
-        for (i = bpl - bpp; i != 0; i--, p++, u++)
-          p[bpp] = depng_sum(p[bpp], depng_avg(p[0], u[0]));
+// ============================================================================
+// [SimdTests::DePNG - Filter - Dispatch]
+// ============================================================================
 
-        p += bpp;
-        break;
-      }
+static const SimdVariant<DePngFilterFunc> depng_filter_variants[] = {
+  { kSimdTierRef   , "revfilter-ref"   , depng_filter_ref    },
+  { kSimdTierRef   , "revfilter-opt"   , depng_filter_opt    },
+  { kSimdTierSSE2  , "revfilter-sse2"  , depng_filter_sse2   },
+  { kSimdTierSSE4_1, "revfilter-sse4.1", depng_filter_sse4_1 },
+  { kSimdTierAVX2  , "revfilter-avx2"  , depng_filter_avx2   }
+};
 
-      case kPngFilterPaeth: {
-        for (i = 0; i < bpp; i++)
-          p[i] = depng_sum(p[i], u[i]);
+const SimdVariant<DePngFilterFunc>* depng_filter_dispatch(void) {
+  static const SimdVariant<DePngFilterFunc>* selected;
 
-        for (i = bpl - bpp; i != 0; i--, p++, u++)
-          p[bpp] = depng_sum(p[bpp], depng_paeth_opt(p[0], u[bpp], u[0]));
+  if (selected == NULL)
+    selected = SimdCpu::select(depng_filter_variants, sizeof(depng_filter_variants) / sizeof(depng_filter_variants[0]));
+  return selected;
+}
 
-        p += bpp;
-        break;
-      }
-    }
+static const SimdVariant<DePngRowFunc> depng_filter_row_variants[] = {
+  { kSimdTierRef   , "revfilter-ref"   , depng_filter_row_ref    },
+  { kSimdTierRef   , "revfilter-opt"   , depng_filter_row_opt    },
+  { kSimdTierSSE2  , "revfilter-sse2"  , depng_filter_row_sse2   },
+  { kSimdTierSSE4_1, "revfilter-sse4.1", depng_filter_row_sse4_1 },
+  { kSimdTierAVX2  , "revfilter-avx2"  , depng_filter_row_avx2   }
+};
 
-    u = p - bpl;
-  } while (--y != 0);
-}
+const SimdVariant<DePngRowFunc>* depng_filter_row_dispatch(void) {
+  static const SimdVariant<DePngRowFunc>* selected;
 
-void depng_filter_opt(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl) {
-  switch (bpp) {
-    case 1: depng_filter_opt_template<1>(p, h, bpl); break;
-    case 2: depng_filter_opt_template<2>(p, h, bpl); break;
-    case 3: depng_filter_opt_template<3>(p, h, bpl); break;
-    case 4: depng_filter_opt_template<4>(p, h, bpl); break;
-    case 6: depng_filter_opt_template<6>(p, h, bpl); break;
-    case 8: depng_filter_opt_template<8>(p, h, bpl); break;
-  }
+  if (selected == NULL)
+    selected = SimdCpu::select(depng_filter_row_variants, sizeof(depng_filter_row_variants) / sizeof(depng_filter_row_variants[0]));
+  return selected;
 }
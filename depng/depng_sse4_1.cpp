@@ -0,0 +1,417 @@
+// [SimdTests - DePNG]
+// SIMD optimized "PNG Reverse Filter" implementation.
+//
+// [License]
+// Public Domain <unlicense.org>
+#define USE_SSE4_1
+
+#include "../simdglobals.h"
+#include "./depng.h"
+
+// ============================================================================
+// [SimdTests::DePNG - Filter - SSE4.1]
+// ============================================================================
+
+// 3 and 4 BPP pixels are processed as 16-bit words, one pixel per 64-bit half
+// of a register, so two consecutive pixels `[X0 X1]` share a register. 4 BPP
+// pixels are simply unpacked, 3 BPP pixels are spread by PSHUFB (the fourth
+// word is always zero) and compressed back after packing.
+template<uint32_t bpp>
+static SIMD_INLINE void depng_sse4_1_load(__m128i& x01, __m128i& x23, const uint8_t* src) {
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+
+  if (bpp == 3) {
+    x01 = _mm_shuffle_epi8(x, _mm_setr_epi8(0, -1, 1, -1, 2, -1, -1, -1, 3, -1, 4, -1, 5, -1, -1, -1));
+    x23 = _mm_shuffle_epi8(x, _mm_setr_epi8(6, -1, 7, -1, 8, -1, -1, -1, 9, -1, 10, -1, 11, -1, -1, -1));
+  }
+  else {
+    x01 = _mm_cvtepu8_epi16(x);
+    x23 = _mm_unpackhi_epi8(x, _mm_setzero_si128());
+  }
+}
+
+// Stores 4 pixels. 3 BPP stores only 12 BYTEs (as 8 + 4), because a wider
+// store would overlap with the next load and its store forwarding would fail.
+template<uint32_t bpp>
+static SIMD_INLINE void depng_sse4_1_store(uint8_t* dst, __m128i y01, __m128i y23) {
+  __m128i y = _mm_packus_epi16(y01, y23);
+
+  if (bpp == 3) {
+    y = _mm_shuffle_epi8(y, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), y);
+    reinterpret_cast<uint32_t*>(dst + 8)[0] = static_cast<uint32_t>(_mm_extract_epi32(y, 2));
+  }
+  else {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), y);
+  }
+}
+
+// Returns `p + Paeth(a, b, c)` of 16-bit words that hold BYTEs. This follows
+// the original Paeth definition (see `depng_paeth_ref()`) instead of using
+// `depng_paeth_opt()`, because PABSW and PBLENDVB make it shorter than the
+// division by 3. Everything that doesn't depend on `a` is precomputed as it
+// doesn't contribute to the sequential dependency between pixels:
+//
+//   paS - `b - c` (signed).
+//   pa  - `|b - c|`.
+//   pb_ - `p + b` (BYTE addition).
+//   pc_ - `p + c` (BYTE addition).
+static SIMD_INLINE __m128i depng_sse4_1_paeth(__m128i a, __m128i c, __m128i p, __m128i pa, __m128i paS, __m128i pb_, __m128i pc_) {
+  __m128i pbS = _mm_sub_epi16(a, c);
+  __m128i pcS = _mm_add_epi16(paS, pbS);
+
+  __m128i pb = _mm_abs_epi16(pbS);
+  __m128i pc = _mm_abs_epi16(pcS);
+  __m128i m = _mm_min_epi16(_mm_min_epi16(pa, pb), pc);
+
+  __m128i y = _mm_blendv_epi8(pc_, pb_, _mm_cmpeq_epi16(m, pb));
+  return _mm_blendv_epi8(y, _mm_add_epi8(p, a), _mm_cmpeq_epi16(m, pa));
+}
+
+// ============================================================================
+// [SimdTests::DePNG - Filter - SSE4.1 - Wavefront]
+// ============================================================================
+
+// Returns `p + Avg(a, b)` or `p + Paeth(a, b, c)` of 16-bit words that hold
+// BYTEs, see the Avg and Paeth cases of `depng_filter_sse4_1_row_template()`.
+template<uint32_t filter>
+static SIMD_INLINE __m128i depng_sse4_1_wavefront_one(__m128i a, __m128i p, __m128i b, __m128i c) {
+  if (filter == kPngFilterAvg) {
+    __m128i x = _mm_add_epi16(_mm_add_epi16(p, p), _mm_add_epi16(b, _mm_set1_epi16(-1)));
+    return _mm_and_si128(_mm_avg_epu16(x, a), _mm_set1_epi16(0x00FF));
+  }
+  else {
+    __m128i paS = _mm_sub_epi16(b, c);
+    return depng_sse4_1_paeth(a, c, p, _mm_abs_epi16(paS), paS, _mm_add_epi8(p, b), _mm_add_epi8(p, c));
+  }
+}
+
+// The low half of the register belongs to the first row and the high half to
+// the second one. If the rows use different filters both are computed and the
+// halves are blended, which adds only one PBLENDW to the critical path.
+template<uint32_t loFilter, uint32_t hiFilter>
+static SIMD_INLINE __m128i depng_sse4_1_wavefront_step(__m128i a, __m128i p, __m128i b, __m128i c) {
+  __m128i y = depng_sse4_1_wavefront_one<loFilter>(a, p, b, c);
+  if (loFilter != hiFilter)
+    y = _mm_blend_epi16(y, depng_sse4_1_wavefront_one<hiFilter>(a, p, b, c), 0xF0);
+  return y;
+}
+
+// Decodes two consecutive rows `p0` and `p1` (not including their filter
+// BYTEs) that use Avg or Paeth filters. A single row is a chain of dependent
+// pixels and SSE4.1 code can't do more than a pixel per step, which leaves
+// the upper half of each register unused. Here the upper half decodes the
+// second row one chunk (4 pixels) behind the first one, so its upper pixels
+// are always the results of the previous chunk (wavefront order):
+//
+//   Step  | Low half           | High half
+//   ------+--------------------+--------------------------
+//   s     | p0[4*k + s]        | p1[4*k - 4 + s]
+//
+// Each step uses the result of the previous step as its left pixel `a`, so
+// there is no shuffle on the critical path and two pixels are decoded per
+// step. The second row starts with a chunk of zeros, which decodes to zeros
+// and so it also provides zero `a` and `c` for its first pixel.
+//
+// Requires `bpl >= 16 + bpp * 4` so at least two chunks are processed.
+template<uint32_t bpp, uint32_t loFilter, uint32_t hiFilter>
+static void depng_sse4_1_wavefront(uint8_t* p0, uint8_t* p1, const uint8_t* u, uint32_t bpl) {
+  uint32_t i;
+  uint32_t k = 0;
+  uint32_t n = (bpl - 16) / (bpp * 4) + 1;
+
+  __m128i zero = _mm_setzero_si128();
+  __m128i r3 = zero;
+
+  __m128i q01 = zero, q23 = zero;
+  __m128i b23Prev = zero;
+
+  __m128i y01 = zero, y23 = zero;
+  __m128i y23Prev = zero;
+
+  for (;;) {
+    __m128i p01, p23;
+    __m128i b01, b23;
+    __m128i c01, c23;
+    __m128i d01, d23;
+    __m128i r0, r1, r2;
+
+    depng_sse4_1_load<bpp>(p01, p23, p0);
+    depng_sse4_1_load<bpp>(b01, b23, u);
+
+    // Upper-left pixels of the first row come from the previous row, upper
+    // and upper-left pixels of the second row are results of the last chunk.
+    c01 = _mm_alignr_epi8(b01, b23Prev, 8);
+    c23 = _mm_alignr_epi8(b23, b01, 8);
+    d01 = _mm_alignr_epi8(y01, y23Prev, 8);
+    d23 = _mm_alignr_epi8(y23, y01, 8);
+
+    r0 = depng_sse4_1_wavefront_step<loFilter, hiFilter>(r3,
+      _mm_unpacklo_epi64(p01, q01), _mm_unpacklo_epi64(b01, y01), _mm_unpacklo_epi64(c01, d01));
+    r1 = depng_sse4_1_wavefront_step<loFilter, hiFilter>(r0,
+      _mm_unpackhi_epi64(p01, q01), _mm_unpackhi_epi64(b01, y01), _mm_unpackhi_epi64(c01, d01));
+    r2 = depng_sse4_1_wavefront_step<loFilter, hiFilter>(r1,
+      _mm_unpacklo_epi64(p23, q23), _mm_unpacklo_epi64(b23, y23), _mm_unpacklo_epi64(c23, d23));
+    r3 = depng_sse4_1_wavefront_step<loFilter, hiFilter>(r2,
+      _mm_unpackhi_epi64(p23, q23), _mm_unpackhi_epi64(b23, y23), _mm_unpackhi_epi64(c23, d23));
+
+    b23Prev = b23;
+    y23Prev = y23;
+
+    y01 = _mm_unpacklo_epi64(r0, r1);
+    y23 = _mm_unpacklo_epi64(r2, r3);
+    depng_sse4_1_store<bpp>(p0, y01, y23);
+
+    // The first chunk of the second row is made of zeros, there is nothing to store.
+    if (k != 0) {
+      depng_sse4_1_store<bpp>(p1, _mm_unpackhi_epi64(r0, r1), _mm_unpackhi_epi64(r2, r3));
+      p1 += bpp * 4;
+    }
+
+    p0 += bpp * 4;
+    u += bpp * 4;
+
+    if (++k == n)
+      break;
+    depng_sse4_1_load<bpp>(q01, q23, p1);
+  }
+
+  // Finish the first row and then the second one, which is a chunk behind.
+  // The upper row of `p1` starts `bpl + 1` BYTEs before it (filter BYTE).
+  p0 -= bpp;
+  u -= bpp;
+
+  for (i = bpl - n * bpp * 4; i != 0; i--, p0++, u++) {
+    if (loFilter == kPngFilterAvg)
+      p0[bpp] = depng_sum(p0[bpp], depng_avg(p0[0], u[bpp]));
+    else
+      p0[bpp] = depng_sum(p0[bpp], depng_paeth_opt(p0[0], u[bpp], u[0]));
+  }
+
+  p1 -= bpp;
+  u = p1 - bpl - 1;
+
+  for (i = bpl - (n - 1) * bpp * 4; i != 0; i--, p1++, u++) {
+    if (hiFilter == kPngFilterAvg)
+      p1[bpp] = depng_sum(p1[bpp], depng_avg(p1[0], u[bpp]));
+    else
+      p1[bpp] = depng_sum(p1[bpp], depng_paeth_opt(p1[0], u[bpp], u[0]));
+  }
+}
+
+// ============================================================================
+// [SimdTests::DePNG - Filter - SSE4.1 - Template]
+// ============================================================================
+
+template<uint32_t bpp>
+static SIMD_INLINE void depng_filter_sse4_1_row_template(uint8_t* p, const uint8_t* s, const uint8_t* u, uint32_t filter, uint32_t len) {
+  uint32_t i;
+
+  switch (filter) {
+    // ------------------------------------------------------------------------
+    // [Avg]
+    // ------------------------------------------------------------------------
+
+    // The sequential dependency is the same as in SSE2, but a pixel fits
+    // into a 64-bit half, so 3 BPP doesn't need a scalar loop. The chain is
+    // shortened to PAVGW+PAND+PUNPCKLQDQ per pixel by precomputing
+    // `A = 2*Y + U - 1`, as `byte(Y + ((U + Last) >> 1))` equals to
+    // `PAVGW(A, Last) & 0xFF` (see `depng_filter_avx2`).
+
+    case kPngFilterAvg: {
+      if (bpp != 3 && bpp != 4) {
+        depng_filter_row_sse2(p, u, s, filter, bpp, len);
+        break;
+      }
+
+      for (i = 0; i < bpp; i++)
+        p[i] = depng_sum(s[i], u[i] >> 1);
+
+      i = len - bpp;
+      u += bpp;
+
+      if (i >= 16) {
+        __m128i m00FF = _mm_set1_epi16(0x00FF);
+        __m128i mFFFF = _mm_set1_epi16(-1);
+        __m128i pz = _mm_cvtepu8_epi16(_mm_cvtsi32_si128(reinterpret_cast<uint32_t*>(p)[0]));
+
+        // Process 4 pixels at a time.
+        while (i >= 16) {
+          __m128i a01, a23;
+          __m128i u01, u23;
+          __m128i y0, y1, y2, y3;
+
+          depng_sse4_1_load<bpp>(a01, a23, s + bpp);
+          depng_sse4_1_load<bpp>(u01, u23, u);
+
+          a01 = _mm_add_epi16(_mm_add_epi16(a01, a01), _mm_add_epi16(u01, mFFFF));
+          a23 = _mm_add_epi16(_mm_add_epi16(a23, a23), _mm_add_epi16(u23, mFFFF));
+
+          y0 = _mm_and_si128(_mm_avg_epu16(a01, pz), m00FF);
+          y1 = _mm_and_si128(_mm_avg_epu16(a01, _mm_unpacklo_epi64(y0, y0)), m00FF);
+          y2 = _mm_and_si128(_mm_avg_epu16(a23, _mm_unpackhi_epi64(y1, y1)), m00FF);
+          y3 = _mm_and_si128(_mm_avg_epu16(a23, _mm_unpacklo_epi64(y2, y2)), m00FF);
+          pz = _mm_unpackhi_epi64(y3, y3);
+
+          depng_sse4_1_store<bpp>(p + bpp, _mm_blend_epi16(y0, y1, 0xF0), _mm_blend_epi16(y2, y3, 0xF0));
+
+          p += bpp * 4;
+          s += bpp * 4;
+          u += bpp * 4;
+          i -= bpp * 4;
+        }
+      }
+
+      for (; i != 0; i--, p++, s++, u++)
+        p[bpp] = depng_sum(s[bpp], depng_avg(p[0], u[0]));
+      break;
+    }
+
+    // ------------------------------------------------------------------------
+    // [Paeth]
+    // ------------------------------------------------------------------------
+
+    // Each pixel waits for the previous one, but only 7 instructions of
+    // `depng_sse4_1_paeth()` and one PUNPCKxQDQ are on the critical path,
+    // the rest is computed from the previous row in advance.
+
+    case kPngFilterPaeth: {
+      if (bpp != 3 && bpp != 4) {
+        depng_filter_row_sse2(p, u, s, filter, bpp, len);
+        break;
+      }
+
+      for (i = 0; i < bpp; i++)
+        p[i] = depng_sum(s[i], u[i]);
+
+      i = len - bpp;
+
+      if (i >= 16) {
+        __m128i pz = _mm_cvtepu8_epi16(_mm_cvtsi32_si128(reinterpret_cast<uint32_t*>(p)[0]));
+
+        // Process 4 pixels at a time.
+        while (i >= 16) {
+          __m128i p01, p23;
+          __m128i b01, b23;
+          __m128i c01, c23;
+          __m128i y0, y1, y2, y3;
+
+          depng_sse4_1_load<bpp>(p01, p23, s + bpp);
+          depng_sse4_1_load<bpp>(b01, b23, u + bpp);
+          depng_sse4_1_load<bpp>(c01, c23, u);
+
+          __m128i paS01 = _mm_sub_epi16(b01, c01);
+          __m128i paS23 = _mm_sub_epi16(b23, c23);
+          __m128i pa01 = _mm_abs_epi16(paS01);
+          __m128i pa23 = _mm_abs_epi16(paS23);
+
+          __m128i pb01 = _mm_add_epi8(b01, p01);
+          __m128i pb23 = _mm_add_epi8(b23, p23);
+          __m128i pc01 = _mm_add_epi8(c01, p01);
+          __m128i pc23 = _mm_add_epi8(c23, p23);
+
+          y0 = depng_sse4_1_paeth(pz                        , c01, p01, pa01, paS01, pb01, pc01);
+          y1 = depng_sse4_1_paeth(_mm_unpacklo_epi64(y0, y0), c01, p01, pa01, paS01, pb01, pc01);
+          y2 = depng_sse4_1_paeth(_mm_unpackhi_epi64(y1, y1), c23, p23, pa23, paS23, pb23, pc23);
+          y3 = depng_sse4_1_paeth(_mm_unpacklo_epi64(y2, y2), c23, p23, pa23, paS23, pb23, pc23);
+          pz = _mm_unpackhi_epi64(y3, y3);
+
+          depng_sse4_1_store<bpp>(p + bpp, _mm_blend_epi16(y0, y1, 0xF0), _mm_blend_epi16(y2, y3, 0xF0));
+
+          p += bpp * 4;
+          s += bpp * 4;
+          u += bpp * 4;
+          i -= bpp * 4;
+        }
+      }
+
+      for (; i != 0; i--, p++, s++, u++)
+        p[bpp] = depng_sum(s[bpp], depng_paeth_opt(p[0], u[bpp], u[0]));
+      break;
+    }
+
+    // ------------------------------------------------------------------------
+    // [Default]
+    // ------------------------------------------------------------------------
+
+    // None, Sub and Up don't have anything that SSE4.1 would improve.
+
+    default:
+      depng_filter_row_sse2(p, u, s, filter, bpp, len);
+      break;
+  }
+}
+
+template<uint32_t bpp>
+static SIMD_INLINE void depng_filter_sse4_1_template(uint8_t* p, const uint8_t* u, uint32_t h, uint32_t bpl) {
+  uint32_t y = h;
+
+  // Subtract one BYTE that is used to store the `filter` ID.
+  bpl--;
+
+  do {
+    uint32_t filter = *p++;
+
+    // Decode this and the next row together if both are Avg or Paeth.
+    if ((bpp == 3 || bpp == 4) && y >= 2 && u != NULL && bpl >= 16 + bpp * 4 &&
+        depng_wavefront_filter(filter) && depng_wavefront_filter(p[bpl])) {
+      uint8_t* p1 = p + bpl + 1;
+
+      if (filter == kPngFilterAvg) {
+        if (p[bpl] == kPngFilterAvg)
+          depng_sse4_1_wavefront<bpp, kPngFilterAvg, kPngFilterAvg>(p, p1, u, bpl);
+        else
+          depng_sse4_1_wavefront<bpp, kPngFilterAvg, kPngFilterPaeth>(p, p1, u, bpl);
+      }
+      else {
+        if (p[bpl] == kPngFilterAvg)
+          depng_sse4_1_wavefront<bpp, kPngFilterPaeth, kPngFilterAvg>(p, p1, u, bpl);
+        else
+          depng_sse4_1_wavefront<bpp, kPngFilterPaeth, kPngFilterPaeth>(p, p1, u, bpl);
+      }
+
+      p = p1 + bpl;
+      u = p1;
+      y--;
+      continue;
+    }
+
+    depng_filter_sse4_1_row_template<bpp>(p, p, u, filter, bpl);
+
+    u = p;
+    p += bpl;
+  } while (--y != 0);
+}
+
+void depng_filter_sse4_1(uint8_t* p, uint32_t h, uint32_t bpp, uint32_t bpl) {
+  switch (bpp) {
+    case 1: depng_filter_sse4_1_template<1>(p, NULL, h, bpl); break;
+    case 2: depng_filter_sse4_1_template<2>(p, NULL, h, bpl); break;
+    case 3: depng_filter_sse4_1_template<3>(p, NULL, h, bpl); break;
+    case 4: depng_filter_sse4_1_template<4>(p, NULL, h, bpl); break;
+    case 6: depng_filter_sse4_1_template<6>(p, NULL, h, bpl); break;
+    case 8: depng_filter_sse4_1_template<8>(p, NULL, h, bpl); break;
+  }
+}
+
+void depng_filter_rows_sse4_1(uint8_t* p, const uint8_t* u, uint32_t h, uint32_t bpp, uint32_t bpl) {
+  switch (bpp) {
+    case 1: depng_filter_sse4_1_template<1>(p, u, h, bpl); break;
+    case 2: depng_filter_sse4_1_template<2>(p, u, h, bpl); break;
+    case 3: depng_filter_sse4_1_template<3>(p, u, h, bpl); break;
+    case 4: depng_filter_sse4_1_template<4>(p, u, h, bpl); break;
+    case 6: depng_filter_sse4_1_template<6>(p, u, h, bpl); break;
+    case 8: depng_filter_sse4_1_template<8>(p, u, h, bpl); break;
+  }
+}
+
+void depng_filter_row_sse4_1(uint8_t* dst, const uint8_t* prev, const uint8_t* src, uint32_t filter, uint32_t bpp, uint32_t len) {
+  switch (bpp) {
+    case 1: depng_filter_sse4_1_row_template<1>(dst, src, prev, filter, len); break;
+    case 2: depng_filter_sse4_1_row_template<2>(dst, src, prev, filter, len); break;
+    case 3: depng_filter_sse4_1_row_template<3>(dst, src, prev, filter, len); break;
+    case 4: depng_filter_sse4_1_row_template<4>(dst, src, prev, filter, len); break;
+    case 6: depng_filter_sse4_1_row_template<6>(dst, src, prev, filter, len); break;
+    case 8: depng_filter_sse4_1_row_template<8>(dst, src, prev, filter, len); break;
+  }
+}
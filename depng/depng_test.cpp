@@ -10,8 +10,19 @@
 // [SimdTests::DePNG - Constants]
 // ============================================================================
 
+// Images generated by `depng_random_image()` use either a single filter or
+// one of the following patterns, which follow the filter IDs.
+//
+//   Mixed    - Cycles through all filters.
+//   AvgPaeth - Only Avg and Paeth rows, in all four combinations of pairs.
+enum DePngImageType {
+  kDePngImageMixed = kPngFilterCount,
+  kDePngImageAvgPaeth = kPngFilterCount + 1,
+  kDePngImageCount = kPngFilterCount + 2
+};
+
 static const char* depng_filter_names[] = {
-  "None", "Sub", "Up", "Avg", "Paeth", "Mixed"
+  "None", "Sub", "Up", "Avg", "Paeth", "Mixed", "AvgPaeth"
 };
 
 static const uint32_t depng_bpp_data[] = {
@@ -79,6 +90,12 @@ static uint8_t* depng_random_image(uint32_t w, uint32_t h, uint32_t bpp, uint32_
     else if (filter < kPngFilterCount) {
       *p++ = static_cast<uint8_t>(filter);
     }
+    else if (filter == kDePngImageAvgPaeth) {
+      // Pairs of rows are Avg+Avg, Avg+Paeth, Paeth+Avg and Paeth+Paeth.
+      uint32_t pair = (y - 1) >> 1;
+      uint32_t bit = ((y - 1) & 1) ? pair : pair >> 1;
+      *p++ = static_cast<uint8_t>((bit & 1) ? kPngFilterPaeth : kPngFilterAvg);
+    }
     else {
       if (++f >= kPngFilterCount) f = 0;
       *p++ = static_cast<uint8_t>(f);
@@ -156,7 +173,7 @@ static bool depng_check(const char* name, DePngFilterFunc ref, DePngFilterFunc o
   printf("[CHECK] IMPL=%-15s\n", name);
 
   uint32_t seed = 0;
-  for (uint32_t filter = 0; filter <= kPngFilterCount; filter++) {
+  for (uint32_t filter = 0; filter < kDePngImageCount; filter++) {
     for (uint32_t h = 1; h < 20; h++) {
       for (uint32_t w = 1; w < 100; w++) {
         for (uint32_t bppIndex = 0; bppIndex < 6; bppIndex++) {
@@ -186,6 +203,74 @@ static bool depng_check(const char* name, DePngFilterFunc ref, DePngFilterFunc o
   return true;
 }
 
+// Reverse filters each row of random images separately from its own source
+// buffer to its own destination buffer, which starts at a varying alignment
+// and contains garbage, and then in-place. Both must match `ref`.
+static bool depng_check_row(const char* name, DePngFilterFunc ref, DePngRowFunc func) {
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  uint32_t seed = 0;
+  for (uint32_t filter = 0; filter < kDePngImageCount; filter++) {
+    for (uint32_t h = 1; h < 6; h++) {
+      for (uint32_t w = 1; w < 100; w++) {
+        for (uint32_t bppIndex = 0; bppIndex < 6; bppIndex++) {
+          uint32_t bpp = depng_bpp_data[bppIndex];
+          uint32_t len = w * bpp;
+          uint32_t bpl = len + 1;
+
+          uint8_t* pRef = depng_random_image(w, h, bpp, filter, seed);
+          uint8_t* pOpt = depng_random_image(w, h, bpp, filter, seed);
+          uint8_t** rows = static_cast<uint8_t**>(::malloc(h * sizeof(uint8_t*)));
+
+          ref(pRef, h, bpp, bpl);
+
+          bool ok = true;
+          for (uint32_t y = 0; y < h; y++) {
+            uint32_t srcOffset = (seed + y * 7) % 32;
+            uint32_t dstOffset = (seed * 3 + y) % 32;
+
+            // Allocations end where rows end, so reads past them are detectable.
+            uint8_t* src = static_cast<uint8_t*>(::malloc(srcOffset + len));
+            rows[y] = static_cast<uint8_t*>(::malloc(dstOffset + len));
+
+            ::memcpy(src + srcOffset, pOpt + size_t(y) * bpl + 1, len);
+            ::memset(rows[y], static_cast<int>(0xA5 ^ seed), dstOffset + len);
+            rows[y] += dstOffset;
+
+            func(rows[y], y ? rows[y - 1] : NULL, src + srcOffset, pOpt[size_t(y) * bpl], bpp, len);
+            ::free(src);
+
+            if (ok && ::memcmp(rows[y], pRef + size_t(y) * bpl + 1, len) != 0) {
+              printf("[ERROR] IMPL=%-15s  [%ux%u|bpp:%u|bpl=%u at Y=%u] Row differs (%s)\n",
+                name, w, h, bpp, bpl, y, depng_filter_names[pOpt[size_t(y) * bpl]]);
+              ok = false;
+            }
+          }
+
+          for (uint32_t y = 0; y < h; y++) {
+            uint8_t* row = pOpt + size_t(y) * bpl + 1;
+            func(row, y ? row - bpl : NULL, row, row[-1], bpp, len);
+            ::free(rows[y] - (seed * 3 + y) % 32);
+          }
+
+          ok = ok && depng_compare(name, pRef, pOpt, w, h, bpp, bpl);
+
+          ::free(rows);
+          ::free(pRef);
+          ::free(pOpt);
+
+          if (!ok)
+            return false;
+
+          seed++;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
 // ============================================================================
 // [SimdTests::DePNG - Bench]
 // ============================================================================
@@ -196,16 +281,24 @@ static void depng_bench(const char* name, DePngFilterFunc func) {
   uint32_t w = 256;
   uint32_t h = 256;
   uint32_t quantity = 1000;
-  uint32_t totalTime = 0;
 
-  for (uint32_t filter = 1; filter <= kPngFilterCount; filter++) {
-    uint32_t filterTime = 0;
+  // Pixels have different sizes, so the sums are reported per byte of all
+  // scanlines (including filter bytes), and per pixel only for a single bpp.
+  double pixels = double(w) * double(h) * quantity;
+  double totalBytes = 0.0;
+  SimdBenchTime totalTime;
+
+  for (uint32_t filter = 1; filter < kDePngImageCount; filter++) {
+    double filterBytes = 0.0;
+    SimdBenchTime filterTime;
 
     for (uint32_t bppIndex = 0; bppIndex < 6; bppIndex++) {
       uint32_t bpp = depng_bpp_data[bppIndex];
       uint32_t bpl = w * bpp + 1;
+      double bytes = double(bpl) * double(h) * quantity;
 
       uint8_t* pImage = depng_random_image(w, h, bpp, filter, 0);
+      SimdBenchTime time;
 
       timer.start();
       for (uint32_t i = 0; i < quantity; i++) {
@@ -213,21 +306,691 @@ static void depng_bench(const char* name, DePngFilterFunc func) {
       }
       timer.stop();
 
-      filterTime += timer.get();
-      totalTime += timer.get();
+      time.add(timer);
+      filterTime.add(timer);
+      filterBytes += bytes;
 
-      printf("[BENCH] IMPL=%-15s  [%.2u.%.3u s] [%s:%u]\n",
-        name, timer.get() / 1000, timer.get() % 1000, depng_filter_names[filter], bpp);
+      printf("[BENCH] IMPL=%-15s  %s [%s:%u]\n",
+        name, time.format(pixels, "px", bytes), depng_filter_names[filter], bpp);
 
       ::free(pImage);
     }
 
-    printf("[BENCH] IMPL=%-15s  [%.2u.%.3u s] [%s:ALL]\n",
-      name, filterTime / 1000, filterTime % 1000, depng_filter_names[filter]);
+    printf("[BENCH] IMPL=%-15s  %s [%s:ALL]\n",
+      name, filterTime.format(filterBytes, "B"), depng_filter_names[filter]);
+
+    totalTime.add(filterTime);
+    totalBytes += filterBytes;
+  }
+
+  printf("[BENCH] IMPL=%-15s  %s [Total]\n\n",
+    name, totalTime.format(totalBytes, "B"));
+}
+
+// ============================================================================
+// [SimdTests::DePNG - Encoder]
+// ============================================================================
+
+// Minimal PNG encoder used to test the decoder. It compresses the filtered
+// image by stored, fixed or dynamic Huffman DEFLATE blocks (greedy LZ77 with
+// a single candidate per hash) and splits the zlib stream to IDAT chunks of
+// the given size.
+enum DePngTestBlocks {
+  kPngTestStored  = 0,
+  kPngTestFixed   = 1,
+  kPngTestDynamic = 2,
+  kPngTestBlocksCount = 3
+};
+
+// Input BYTEs per DEFLATE block.
+#define PNG_TEST_BLOCK_SIZE 16384
+
+static const uint16_t depng_test_length_base[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t depng_test_length_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t depng_test_dist_base[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t depng_test_dist_extra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const uint8_t depng_test_cl_order[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static uint32_t depng_test_crc32(uint32_t crc, const uint8_t* p, size_t size) {
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= p[i];
+    for (uint32_t k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static uint32_t depng_test_adler32(const uint8_t* p, size_t size) {
+  uint32_t a = 1;
+  uint32_t b = 0;
+
+  for (size_t i = 0; i < size; i++) {
+    a = (a + p[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+
+  return (b << 16) | a;
+}
+
+static void depng_test_write_u32(uint8_t* p, uint32_t x) {
+  p[0] = static_cast<uint8_t>(x >> 24);
+  p[1] = static_cast<uint8_t>(x >> 16);
+  p[2] = static_cast<uint8_t>(x >>  8);
+  p[3] = static_cast<uint8_t>(x      );
+}
+
+struct DePngTestBitWriter {
+  uint8_t* p;
+  uint64_t bitBuf;
+  uint32_t bitCount;
+};
+
+static void depng_test_put_bits(DePngTestBitWriter* bw, uint32_t value, uint32_t n) {
+  bw->bitBuf |= uint64_t(value) << bw->bitCount;
+  bw->bitCount += n;
+
+  while (bw->bitCount >= 8) {
+    *bw->p++ = static_cast<uint8_t>(bw->bitBuf);
+    bw->bitBuf >>= 8;
+    bw->bitCount -= 8;
+  }
+}
+
+// Huffman codes are stored starting at their MSB.
+static void depng_test_put_code(DePngTestBitWriter* bw, uint32_t code, uint32_t len) {
+  uint32_t r = 0;
+  for (uint32_t i = 0; i < len; i++)
+    r |= ((code >> i) & 1) << (len - 1 - i);
+  depng_test_put_bits(bw, r, len);
+}
+
+static void depng_test_align(DePngTestBitWriter* bw) {
+  if (bw->bitCount)
+    depng_test_put_bits(bw, 0, 8 - bw->bitCount);
+}
+
+// Builds Huffman code lengths of at most `maxLen` bits, frequencies are halved
+// until the longest code fits.
+static void depng_test_huff_lengths(uint8_t* lengths, const uint32_t* freqs, uint32_t count, uint32_t maxLen) {
+  uint32_t f[288];
+  uint32_t weight[576];
+  int32_t parent[576];
+  bool used[576];
+  uint32_t i;
+
+  ::memcpy(f, freqs, count * sizeof(uint32_t));
+
+  for (;;) {
+    uint32_t n = count;
+    uint32_t leaves = 0;
+
+    ::memset(lengths, 0, count);
+    for (i = 0; i < count; i++) {
+      weight[i] = f[i];
+      parent[i] = -1;
+      used[i] = f[i] == 0;
+      leaves += f[i] != 0;
+    }
+
+    if (leaves <= 1) {
+      for (i = 0; i < count; i++)
+        if (f[i]) lengths[i] = 1;
+      return;
+    }
+
+    // Join two lightest nodes until only the root is left.
+    for (;;) {
+      int32_t a = -1;
+      int32_t b = -1;
+
+      for (i = 0; i < n; i++) {
+        if (used[i])
+          continue;
+
+        if (a < 0 || weight[i] < weight[a]) {
+          b = a;
+          a = static_cast<int32_t>(i);
+        }
+        else if (b < 0 || weight[i] < weight[b]) {
+          b = static_cast<int32_t>(i);
+        }
+      }
+
+      if (b < 0)
+        break;
+
+      weight[n] = weight[a] + weight[b];
+      parent[n] = -1;
+      used[n] = false;
+      used[a] = used[b] = true;
+      parent[a] = parent[b] = static_cast<int32_t>(n);
+      n++;
+    }
+
+    uint32_t longest = 0;
+    for (i = 0; i < count; i++) {
+      if (!f[i])
+        continue;
+
+      uint32_t depth = 0;
+      for (int32_t j = static_cast<int32_t>(i); parent[j] >= 0; j = parent[j])
+        depth++;
+
+      lengths[i] = static_cast<uint8_t>(depth);
+      longest = SimdUtils::max<uint32_t>(longest, depth);
+    }
+
+    if (longest <= maxLen)
+      return;
+
+    for (i = 0; i < count; i++)
+      f[i] = (f[i] + 1) >> 1;
+  }
+}
+
+static void depng_test_huff_codes(uint16_t* codes, const uint8_t* lengths, uint32_t count) {
+  uint32_t counts[16];
+  uint32_t next[16];
+  uint32_t code = 0;
+  uint32_t i;
+
+  ::memset(counts, 0, sizeof(counts));
+  for (i = 0; i < count; i++)
+    counts[lengths[i]]++;
+  counts[0] = 0;
+
+  for (i = 1; i < 16; i++) {
+    code = (code + counts[i - 1]) << 1;
+    next[i] = code;
+  }
+
+  for (i = 0; i < count; i++)
+    codes[i] = lengths[i] ? static_cast<uint16_t>(next[lengths[i]]++) : uint16_t(0);
+}
+
+static uint32_t depng_test_length_code(uint32_t len) {
+  uint32_t i = 28;
+  while (depng_test_length_base[i] > len)
+    i--;
+  return i;
+}
+
+static uint32_t depng_test_dist_code(uint32_t dist) {
+  uint32_t i = 29;
+  while (depng_test_dist_base[i] > dist)
+    i--;
+  return i;
+}
+
+// Tokens are literals or `0x80000000 | (len << 16) | dist` matches. Positions
+// in `head` can refer to previous blocks.
+static uint32_t depng_test_lz77(uint32_t* tokens, const uint8_t* src, size_t start, size_t end, int32_t* head) {
+  uint32_t n = 0;
+  size_t pos = start;
+
+  while (pos < end) {
+    uint32_t len = 0;
+    uint32_t dist = 0;
+
+    if (end - pos >= 3) {
+      uint32_t h = ((src[pos] << 10) ^ (src[pos + 1] << 5) ^ src[pos + 2]) & 0x7FFF;
+      int32_t cand = head[h];
+      head[h] = static_cast<int32_t>(pos);
+
+      if (cand >= 0 && pos - static_cast<size_t>(cand) <= 32768) {
+        uint32_t maxLen = static_cast<uint32_t>(SimdUtils::min<size_t>(258, end - pos));
+        while (len < maxLen && src[cand + len] == src[pos + len])
+          len++;
+        dist = static_cast<uint32_t>(pos - static_cast<size_t>(cand));
+      }
+    }
+
+    if (len >= 3) {
+      tokens[n++] = 0x80000000U | (len << 16) | dist;
+      pos += len;
+    }
+    else {
+      tokens[n++] = src[pos++];
+    }
+  }
+
+  return n;
+}
+
+static void depng_test_deflate_block(DePngTestBitWriter* bw, const uint32_t* tokens, uint32_t n, uint32_t blocks, bool last) {
+  uint8_t lengths[288 + 32];
+  uint16_t litCodes[288];
+  uint16_t distCodes[32];
+  uint32_t i;
+
+  uint8_t* litLengths = lengths;
+  uint8_t* distLengths = lengths + 288;
+  uint32_t hlit = 288;
+  uint32_t hdist = 32;
+
+  if (blocks == kPngTestFixed) {
+    for (i = 0; i < 288; i++) litLengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    for (i = 0; i < 32; i++) distLengths[i] = 5;
+  }
+  else {
+    uint32_t litFreqs[288];
+    uint32_t distFreqs[32];
+
+    ::memset(litFreqs, 0, sizeof(litFreqs));
+    ::memset(distFreqs, 0, sizeof(distFreqs));
+
+    for (i = 0; i < n; i++) {
+      uint32_t t = tokens[i];
+      if (t & 0x80000000U) {
+        litFreqs[257 + depng_test_length_code((t >> 16) & 0x1FF)]++;
+        distFreqs[depng_test_dist_code(t & 0xFFFF)]++;
+      }
+      else {
+        litFreqs[t]++;
+      }
+    }
+    litFreqs[256]++;
+
+    depng_test_huff_lengths(litLengths, litFreqs, 286, 15);
+    depng_test_huff_lengths(distLengths, distFreqs, 30, 15);
+
+    for (hlit = 286; hlit > 257 && litLengths[hlit - 1] == 0; hlit--) continue;
+    for (hdist = 30; hdist > 1 && distLengths[hdist - 1] == 0; hdist--) continue;
+
+    // Code lengths of both codes are run-length encoded as a single sequence.
+    uint8_t all[286 + 30];
+    uint16_t cl[286 + 30];
+    uint32_t clCount = 0;
+    uint32_t clFreqs[19];
+    uint8_t clLengths[19];
+    uint16_t clCodes[19];
+
+    ::memcpy(all, litLengths, hlit);
+    ::memcpy(all + hlit, distLengths, hdist);
+    ::memset(clFreqs, 0, sizeof(clFreqs));
+
+    for (i = 0; i < hlit + hdist;) {
+      uint32_t v = all[i];
+      uint32_t run = 1;
+      while (i + run < hlit + hdist && all[i + run] == v)
+        run++;
+
+      if (v == 0 && run >= 3) {
+        uint32_t r = SimdUtils::min<uint32_t>(run, 138);
+        cl[clCount++] = r >= 11 ? static_cast<uint16_t>(18 | ((r - 11) << 8)) : static_cast<uint16_t>(17 | ((r - 3) << 8));
+        i += r;
+      }
+      else if (v != 0 && run >= 4) {
+        uint32_t r = SimdUtils::min<uint32_t>(run - 1, 6);
+        cl[clCount++] = static_cast<uint16_t>(v);
+        cl[clCount++] = static_cast<uint16_t>(16 | ((r - 3) << 8));
+        i += 1 + r;
+      }
+      else {
+        cl[clCount++] = static_cast<uint16_t>(v);
+        i++;
+      }
+    }
+
+    for (i = 0; i < clCount; i++)
+      clFreqs[cl[i] & 0xFF]++;
+
+    depng_test_huff_lengths(clLengths, clFreqs, 19, 7);
+    depng_test_huff_codes(clCodes, clLengths, 19);
+
+    uint32_t hclen = 19;
+    while (hclen > 4 && clLengths[depng_test_cl_order[hclen - 1]] == 0)
+      hclen--;
+
+    depng_test_put_bits(bw, last, 1);
+    depng_test_put_bits(bw, 2, 2);
+    depng_test_put_bits(bw, hlit - 257, 5);
+    depng_test_put_bits(bw, hdist - 1, 5);
+    depng_test_put_bits(bw, hclen - 4, 4);
+
+    for (i = 0; i < hclen; i++)
+      depng_test_put_bits(bw, clLengths[depng_test_cl_order[i]], 3);
+
+    for (i = 0; i < clCount; i++) {
+      uint32_t sym = cl[i] & 0xFF;
+      depng_test_put_code(bw, clCodes[sym], clLengths[sym]);
+
+      if (sym == 16) depng_test_put_bits(bw, cl[i] >> 8, 2);
+      if (sym == 17) depng_test_put_bits(bw, cl[i] >> 8, 3);
+      if (sym == 18) depng_test_put_bits(bw, cl[i] >> 8, 7);
+    }
+  }
+
+  if (blocks == kPngTestFixed) {
+    depng_test_put_bits(bw, last, 1);
+    depng_test_put_bits(bw, 1, 2);
+  }
+
+  depng_test_huff_codes(litCodes, litLengths, hlit);
+  depng_test_huff_codes(distCodes, distLengths, hdist);
+
+  for (i = 0; i < n; i++) {
+    uint32_t t = tokens[i];
+
+    if (t & 0x80000000U) {
+      uint32_t len = (t >> 16) & 0x1FF;
+      uint32_t dist = t & 0xFFFF;
+      uint32_t lc = depng_test_length_code(len);
+      uint32_t dc = depng_test_dist_code(dist);
+
+      depng_test_put_code(bw, litCodes[257 + lc], litLengths[257 + lc]);
+      depng_test_put_bits(bw, len - depng_test_length_base[lc], depng_test_length_extra[lc]);
+      depng_test_put_code(bw, distCodes[dc], distLengths[dc]);
+      depng_test_put_bits(bw, dist - depng_test_dist_base[dc], depng_test_dist_extra[dc]);
+    }
+    else {
+      depng_test_put_code(bw, litCodes[t], litLengths[t]);
+    }
+  }
+
+  depng_test_put_code(bw, litCodes[256], litLengths[256]);
+}
+
+// Compresses `src` to a zlib stream at `dst`, which must have a room for
+// `size * 2 + 64` BYTEs.
+static size_t depng_test_zlib(uint8_t* dst, const uint8_t* src, size_t size, uint32_t blocks) {
+  DePngTestBitWriter bw = { dst, 0, 0 };
+  uint32_t* tokens = static_cast<uint32_t*>(::malloc(PNG_TEST_BLOCK_SIZE * sizeof(uint32_t)));
+  int32_t* head = static_cast<int32_t*>(::malloc(32768 * sizeof(int32_t)));
+
+  for (uint32_t i = 0; i < 32768; i++)
+    head[i] = -1;
+
+  // CMF (DEFLATE, 32kB window) and FLG (no dictionary, check bits).
+  depng_test_put_bits(&bw, 0x78, 8);
+  depng_test_put_bits(&bw, 0x01, 8);
+
+  size_t pos = 0;
+  do {
+    size_t end = SimdUtils::min<size_t>(pos + PNG_TEST_BLOCK_SIZE, size);
+    bool last = end == size;
+
+    if (blocks == kPngTestStored) {
+      uint32_t len = static_cast<uint32_t>(end - pos);
+
+      depng_test_put_bits(&bw, last, 1);
+      depng_test_put_bits(&bw, 0, 2);
+      depng_test_align(&bw);
+      depng_test_put_bits(&bw, len, 16);
+      depng_test_put_bits(&bw, len ^ 0xFFFF, 16);
+
+      ::memcpy(bw.p, src + pos, len);
+      bw.p += len;
+    }
+    else {
+      uint32_t n = depng_test_lz77(tokens, src, pos, end, head);
+      depng_test_deflate_block(&bw, tokens, n, blocks, last);
+    }
+
+    pos = end;
+  } while (pos < size);
+
+  depng_test_align(&bw);
+
+  uint32_t adler = depng_test_adler32(src, size);
+  depng_test_write_u32(bw.p, adler);
+  bw.p += 4;
+
+  ::free(head);
+  ::free(tokens);
+  return static_cast<size_t>(bw.p - dst);
+}
+
+static uint8_t* depng_test_put_chunk(uint8_t* p, const char* type, const uint8_t* data, uint32_t size) {
+  depng_test_write_u32(p, size);
+  ::memcpy(p + 4, type, 4);
+  ::memmove(p + 8, data, size);
+  depng_test_write_u32(p + 8 + size, depng_test_crc32(0, p + 4, size + 4));
+  return p + 12 + size;
+}
+
+// Maximum size of a PNG written by `depng_test_encode_png()`.
+static size_t depng_test_png_capacity(size_t filteredSize, uint32_t idatSize) {
+  size_t zlibSize = filteredSize * 2 + 64;
+  return 8 + 25 + zlibSize + (zlibSize / idatSize + 1) * 12 + 12;
+}
+
+// Writes a PNG of the `filtered` image (rows including their filter BYTEs).
+static size_t depng_test_encode_png(uint8_t* dst, const uint8_t* filtered, uint32_t w, uint32_t h, uint32_t colorType, uint32_t bitDepth, uint32_t bpl, uint32_t blocks, uint32_t idatSize) {
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+  size_t filteredSize = size_t(bpl) * h;
+  uint8_t* zlib = static_cast<uint8_t*>(::malloc(filteredSize * 2 + 64));
+  size_t zlibSize = depng_test_zlib(zlib, filtered, filteredSize, blocks);
+
+  uint8_t ihdr[13];
+  depng_test_write_u32(ihdr, w);
+  depng_test_write_u32(ihdr + 4, h);
+  ihdr[8] = static_cast<uint8_t>(bitDepth);
+  ihdr[9] = static_cast<uint8_t>(colorType);
+  ihdr[10] = 0;
+  ihdr[11] = 0;
+  ihdr[12] = 0;
+
+  uint8_t* p = dst;
+  ::memcpy(p, signature, 8);
+  p = depng_test_put_chunk(p + 8, "IHDR", ihdr, 13);
+
+  for (size_t pos = 0; pos < zlibSize; pos += idatSize) {
+    uint32_t n = static_cast<uint32_t>(SimdUtils::min<size_t>(idatSize, zlibSize - pos));
+    p = depng_test_put_chunk(p, "IDAT", zlib + pos, n);
+  }
+
+  p = depng_test_put_chunk(p, "IEND", NULL, 0);
+
+  ::free(zlib);
+  return static_cast<size_t>(p - dst);
+}
+
+// ============================================================================
+// [SimdTests::DePNG - Decoder]
+// ============================================================================
+
+struct DePngTestFormat {
+  uint32_t colorType;
+  uint32_t bitDepth;
+};
+
+// Formats covering all BPPs of the reverse filter and sub-BYTE pixels.
+static const DePngTestFormat depng_test_formats[] = {
+  { 0,  8 }, { 4,  8 }, { 2,  8 }, { 6,  8 }, { 2, 16 }, { 6, 16 }, { 0,  1 }, { 3,  4 }
+};
+
+// Decodes `png` row by row by `depng_decoder_stream_next()` to `pixels` (rows
+// without filter BYTEs).
+static uint32_t depng_test_decode_stream(DePngDecoder* d, const uint8_t* png, size_t size, uint8_t* pixels, void* workspace) {
+  uint32_t err = depng_decoder_read_header(d, png, size);
+  if (err != kPngErrorOk)
+    return err;
+
+  DePngStream s;
+  err = depng_decoder_stream_begin(d, &s, workspace);
+
+  while (err == kPngErrorOk && (err = depng_decoder_stream_next(&s)) == kPngErrorOk && s.rows)
+    ::memcpy(pixels + size_t(s.y) * (d->bpl - 1), s.pixels, d->bpl - 1);
+
+  return err;
+}
+
+// Generates a filtered image of `format`, its first row uses the same filter
+// as the rest of the image (Paeth if mixed), which is decoded by using a zero
+// upper row. Returns the image and its reference decoding in `ref`.
+static uint8_t* depng_test_decoder_image(uint8_t** ref, const DePngTestFormat& format, uint32_t w, uint32_t h, uint32_t filter, uint32_t seed, uint32_t* bppOut, uint32_t* bplOut) {
+  uint32_t channels = format.colorType == 2 ? 3 : format.colorType == 4 ? 2 : format.colorType == 6 ? 4 : 1;
+  uint32_t rowBytes = (w * channels * format.bitDepth + 7) / 8;
+  uint32_t bpp = SimdUtils::max<uint32_t>(channels * format.bitDepth / 8, 1);
+  uint32_t bpl = rowBytes + 1;
+
+  uint8_t* image = depng_random_image(rowBytes / bpp, h, bpp, filter, seed);
+  image[0] = static_cast<uint8_t>(filter < kPngFilterCount ? filter : uint32_t(kPngFilterPaeth));
+
+  uint8_t* zero = static_cast<uint8_t*>(::calloc(bpl, 1));
+  *ref = static_cast<uint8_t*>(::malloc(size_t(bpl) * h));
+  ::memcpy(*ref, image, size_t(bpl) * h);
+
+  const uint8_t* prev = zero;
+  for (uint32_t y = 0; y < h; y++) {
+    uint8_t* row = *ref + size_t(y) * bpl + 1;
+    depng_filter_row_ref(row, prev, row, row[-1], bpp, bpl - 1);
+    prev = row;
+  }
+
+  ::free(zero);
+
+  *bppOut = bpp;
+  *bplOut = bpl;
+  return image;
+}
+
+static bool depng_check_decoder(const char* name, DePngRowFunc filter) {
+  static const uint32_t widths[] = { 1, 3, 17, 65 };
+  static const uint32_t heights[] = { 1, 4 };
+
+  printf("[CHECK] IMPL=%-15s\n", name);
+
+  DePngDecoder d;
+  depng_decoder_init(&d, filter);
+
+  uint32_t seed = 0;
+  for (uint32_t f = 0; f < sizeof(depng_test_formats) / sizeof(depng_test_formats[0]); f++) {
+    const DePngTestFormat& format = depng_test_formats[f];
+
+    for (uint32_t type = 0; type < kDePngImageCount; type++) {
+      for (uint32_t wi = 0; wi < sizeof(widths) / sizeof(widths[0]); wi++) {
+        for (uint32_t hi = 0; hi < sizeof(heights) / sizeof(heights[0]); hi++) {
+          for (uint32_t blocks = 0; blocks < kPngTestBlocksCount; blocks++, seed++) {
+            uint32_t w = widths[wi];
+            uint32_t h = heights[hi];
+            uint32_t bpp, bpl;
+            uint32_t idatSize = 1 + (seed * 37) % 300;
+
+            uint8_t* ref;
+            uint8_t* image = depng_test_decoder_image(&ref, format, w, h, type, seed, &bpp, &bpl);
+
+            uint8_t* png = static_cast<uint8_t*>(::malloc(depng_test_png_capacity(size_t(bpl) * h, idatSize)));
+            size_t size = depng_test_encode_png(png, image, w, h, format.colorType, format.bitDepth, bpl, blocks, idatSize);
+
+            depng_decoder_read_header(&d, png, size);
+            void* workspace = ::malloc(depng_decoder_stream_workspace_size(&d));
+            uint8_t* pixels = static_cast<uint8_t*>(::malloc(size_t(bpl) * h));
+
+            uint32_t err = depng_test_decode_stream(&d, png, size, pixels, workspace);
+            bool ok = err == kPngErrorOk;
+
+            if (!ok) {
+              printf("[ERROR] IMPL=%-15s  [%ux%u|type:%u|depth:%u|blocks:%u] Error %u\n",
+                name, w, h, format.colorType, format.bitDepth, blocks, err);
+            }
+
+            for (uint32_t y = 0; ok && y < h; y++) {
+              if (::memcmp(pixels + size_t(y) * (bpl - 1), ref + size_t(y) * bpl + 1, bpl - 1) != 0) {
+                printf("[ERROR] IMPL=%-15s  [%ux%u|type:%u|depth:%u|blocks:%u at Y=%u] Row differs (%s)\n",
+                  name, w, h, format.colorType, format.bitDepth, blocks, y, depng_filter_names[type]);
+                ok = false;
+              }
+            }
+
+            // Truncated and corrupted images must fail without crashing.
+            for (size_t cut = 1; ok && cut < size; cut += size / 5 + 1)
+              depng_test_decode_stream(&d, png, cut, pixels, workspace);
+
+            for (size_t pos = 33; ok && pos < size; pos += size / 11 + 1) {
+              png[pos] ^= 0x5A;
+              depng_test_decode_stream(&d, png, size, pixels, workspace);
+              png[pos] ^= 0x5A;
+            }
+
+            ::free(pixels);
+            ::free(workspace);
+            ::free(png);
+            ::free(ref);
+            ::free(image);
+
+            if (!ok)
+              return false;
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+// Decodes 256x256 images of each BPP compressed by dynamic Huffman blocks.
+// The time includes inflate, the reverse filter and the checksum, the memory
+// used by the decoder is its workspace.
+static void depng_bench_decoder(const char* name, DePngRowFunc filter) {
+  SimdTimer timer;
+
+  uint32_t w = 256;
+  uint32_t h = 256;
+  uint32_t quantity = 20;
+
+  DePngDecoder d;
+  depng_decoder_init(&d, filter);
+
+  for (uint32_t f = 0; f < 6; f++) {
+    const DePngTestFormat& format = depng_test_formats[f];
+    uint32_t bpp, bpl;
+
+    uint8_t* ref;
+    uint8_t* image = depng_test_decoder_image(&ref, format, w, h, kDePngImageMixed, 0, &bpp, &bpl);
+
+    uint8_t* png = static_cast<uint8_t*>(::malloc(depng_test_png_capacity(size_t(bpl) * h, 8192)));
+    size_t size = depng_test_encode_png(png, image, w, h, format.colorType, format.bitDepth, bpl, kPngTestDynamic, 8192);
+
+    depng_decoder_read_header(&d, png, size);
+    size_t workspaceSize = depng_decoder_stream_workspace_size(&d);
+    void* workspace = ::malloc(workspaceSize);
+    uint8_t* pixels = static_cast<uint8_t*>(::malloc(size_t(bpl) * h));
+
+    SimdBenchTime time;
+    for (uint32_t z = 0; z < 3; z++) {
+      timer.start();
+      for (uint32_t i = 0; i < quantity; i++)
+        depng_test_decode_stream(&d, png, size, pixels, workspace);
+      timer.stop();
+      time.update(timer);
+    }
+
+    double pixelCount = double(w) * double(h) * quantity;
+    printf("[BENCH] IMPL=%-15s  %s [Mixed:%u] {workspace=%ukB image=%ukB}\n",
+      name, time.format(pixelCount, "px", double(bpl) * h * quantity), bpp,
+      static_cast<unsigned int>(workspaceSize / 1024), static_cast<unsigned int>(size_t(bpl) * h / 1024));
+
+    ::free(pixels);
+    ::free(workspace);
+    ::free(png);
+    ::free(ref);
+    ::free(image);
   }
 
-  printf("[BENCH] IMPL=%-15s  [%.2u.%.3u s] [Total]\n\n",
-    name, totalTime / 1000, totalTime % 1000);
+  printf("\n");
 }
 
 // ============================================================================
@@ -235,12 +998,84 @@ static void depng_bench(const char* name, DePngFilterFunc func) {
 // ============================================================================
 
 int main(int argc, char* argv[]) {
+  const SimdVariant<DePngFilterFunc>* filter = depng_filter_dispatch();
+  const SimdVariant<DePngRowFunc>* row = depng_filter_row_dispatch();
+
+  SimdCpu::printInfo();
+  SimdTimer::printInfo();
+  SimdCpu::printVariant("depng_filter", filter);
+  SimdCpu::printVariant("depng_filter_row", row);
+
   if (!depng_check("revfilter-opt" , depng_filter_ref, depng_filter_opt )) return 1;
   if (!depng_check("revfilter-sse2", depng_filter_ref, depng_filter_sse2)) return 1;
 
+  if (SimdCpu::features() & kSimdCpuSSE4_1) {
+    if (!depng_check("revfilter-sse4.1", depng_filter_ref, depng_filter_sse4_1)) return 1;
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no SSE4.1)\n", "revfilter-sse4.1");
+  }
+
+  if (SimdCpu::features() & kSimdCpuAVX2) {
+    if (!depng_check("revfilter-avx2", depng_filter_ref, depng_filter_avx2)) return 1;
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "revfilter-avx2");
+  }
+
+  if (!depng_check("revfilter-best", depng_filter_ref, filter->func     )) return 1;
+
+  if (!depng_check_row("row-ref" , depng_filter_ref, depng_filter_row_ref )) return 1;
+  if (!depng_check_row("row-opt" , depng_filter_ref, depng_filter_row_opt )) return 1;
+  if (!depng_check_row("row-sse2", depng_filter_ref, depng_filter_row_sse2)) return 1;
+
+  if (SimdCpu::features() & kSimdCpuSSE4_1) {
+    if (!depng_check_row("row-sse4.1", depng_filter_ref, depng_filter_row_sse4_1)) return 1;
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no SSE4.1)\n", "row-sse4.1");
+  }
+
+  if (SimdCpu::features() & kSimdCpuAVX2) {
+    if (!depng_check_row("row-avx2", depng_filter_ref, depng_filter_row_avx2)) return 1;
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "row-avx2");
+  }
+
+  if (!depng_check_row("row-best", depng_filter_ref, row->func)) return 1;
+
+  if (!depng_check_decoder("decoder-opt" , depng_filter_row_opt )) return 1;
+  if (!depng_check_decoder("decoder-sse2", depng_filter_row_sse2)) return 1;
+
+  if (SimdCpu::features() & kSimdCpuSSE4_1) {
+    if (!depng_check_decoder("decoder-sse4.1", depng_filter_row_sse4_1)) return 1;
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no SSE4.1)\n", "decoder-sse4.1");
+  }
+
+  if (SimdCpu::features() & kSimdCpuAVX2) {
+    if (!depng_check_decoder("decoder-avx2", depng_filter_row_avx2)) return 1;
+  }
+  else {
+    printf("[SKIP ] IMPL=%-15s (no AVX2)\n", "decoder-avx2");
+  }
+
+  if (!depng_check_decoder("decoder-best", row->func)) return 1;
+
   depng_bench("revfilter-ref" , depng_filter_ref);
   depng_bench("revfilter-opt" , depng_filter_opt);
   depng_bench("revfilter-sse2", depng_filter_sse2);
 
+  if (SimdCpu::features() & kSimdCpuSSE4_1)
+    depng_bench("revfilter-sse4.1", depng_filter_sse4_1);
+
+  if (SimdCpu::features() & kSimdCpuAVX2)
+    depng_bench("revfilter-avx2", depng_filter_avx2);
+
+  depng_bench_decoder("decoder-ref" , depng_filter_row_ref);
+  depng_bench_decoder("decoder-best", row->func);
+
   return 0;
 }
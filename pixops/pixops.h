@@ -6,7 +6,7 @@
 #ifndef _SIMDDEJPEG_H
 #define _SIMDDEJPEG_H
 
-#include <stdint.h>
+#include "../simdglobals.h"
 
 // ============================================================================
 // [SimdTests::PixOps - CrossFade]
@@ -18,4 +18,13 @@ void pixops_crossfade_ref(void* dst, intptr_t dstStride, const void* src, intptr
 void pixops_crossfade_sse2(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha);
 void pixops_crossfade_ssse3(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha);
 
+// Crossfade implemented once by using `SimdVec` (see pixops_vec.h) and compiled
+// for each backend.
+void pixops_crossfade_vec_scalar(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha);
+void pixops_crossfade_vec_sse2(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha);
+void pixops_crossfade_vec_avx2(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha);
+
+// Variant of `pixops_crossfade_...` selected by `SimdCpu::tier()`.
+const SimdVariant<PixelOpFunc>* pixops_crossfade_dispatch(void);
+
 #endif // _SIMDDEJPEG_H
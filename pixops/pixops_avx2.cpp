@@ -0,0 +1,14 @@
+// [SimdPixel]
+// Playground for SIMD pixel manipulation.
+//
+// [License]
+// Public Domain <unlicense.org>
+#define USE_AVX2
+
+#include "../simdglobals.h"
+#include "./pixops.h"
+#include "./pixops_vec.h"
+
+void pixops_crossfade_vec_avx2(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha) {
+  pixops_crossfade_vec(dst, dstStride, src, srcStride, w, h, alpha);
+}
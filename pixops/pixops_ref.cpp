@@ -5,6 +5,7 @@
 // Public Domain <unlicense.org>
 #include "../simdglobals.h"
 #include "./pixops.h"
+#include "./pixops_vec.h"
 
 void pixops_crossfade_ref(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha) {
   uint8_t* pDstRow = static_cast<uint8_t*>(dst);
@@ -30,3 +31,22 @@ void pixops_crossfade_ref(void* dst, intptr_t dstStride, const void* src, intptr
     }
   }
 }
+
+void pixops_crossfade_vec_scalar(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha) {
+  pixops_crossfade_vec(dst, dstStride, src, srcStride, w, h, alpha);
+}
+
+static const SimdVariant<PixelOpFunc> pixops_crossfade_variants[] = {
+  { kSimdTierRef  , "crossfade-ref"     , pixops_crossfade_ref      },
+  { kSimdTierSSE2 , "crossfade-sse2"    , pixops_crossfade_sse2     },
+  { kSimdTierSSSE3, "crossfade-ssse3"   , pixops_crossfade_ssse3    },
+  { kSimdTierAVX2 , "crossfade-vec-avx2", pixops_crossfade_vec_avx2 }
+};
+
+const SimdVariant<PixelOpFunc>* pixops_crossfade_dispatch(void) {
+  static const SimdVariant<PixelOpFunc>* selected;
+
+  if (selected == NULL)
+    selected = SimdCpu::select(pixops_crossfade_variants, sizeof(pixops_crossfade_variants) / sizeof(pixops_crossfade_variants[0]));
+  return selected;
+}
@@ -7,6 +7,7 @@
 
 #include "../simdglobals.h"
 #include "./pixops.h"
+#include "./pixops_vec.h"
 
 static inline uint32_t expand16(uint32_t x) { return x | (x << 16); }
 
@@ -127,3 +128,6 @@ void pixops_crossfade_sse2(void* dst, intptr_t dstStride, const void* src, intpt
   }
 }
 
+void pixops_crossfade_vec_sse2(void* dst, intptr_t dstStride, const void* src, intptr_t srcStride, uint32_t w, uint32_t h, uint32_t alpha) {
+  pixops_crossfade_vec(dst, dstStride, src, srcStride, w, h, alpha);
+}
@@ -79,7 +79,7 @@ static void pixops_check(const char* name, PixelOpFunc a, PixelOpFunc b) {
 
 static void pixops_bench(const char* name, PixelOpFunc func) {
   SimdTimer timer;
-  uint32_t best = 0xFFFFFFFFU;
+  SimdBenchTime best;
 
   enum {
     kW = 1000,
@@ -109,13 +109,11 @@ static void pixops_bench(const char* name, PixelOpFunc func) {
     }
     timer.stop();
 
-    if (timer.get() < best)
-      best = timer.get();
+    best.update(timer);
   }
 
-  uint32_t mbps = static_cast<uint32_t>(
-    ((static_cast<uint64_t>(kCount * 4) * BENCH_ITER * 1000) / best) / (1024 * 1024));
-  printf("[BENCH] IMPL=%-20s [%.2u.%.3u s] (%u MB/s) {dummy=%u}\n", name, best / 1000, best % 1000, mbps, dummy);
+  double pixels = double(kCount) * BENCH_ITER;
+  printf("[BENCH] IMPL=%-20s %s {dummy=%u}\n", name, best.format(pixels, "px", pixels * 4.0), dummy);
 
   ::free(dst);
   ::free(src);
@@ -126,12 +124,31 @@ static void pixops_bench(const char* name, PixelOpFunc func) {
 // ============================================================================
 
 int main(int argc, char* argv[]) {
+  const SimdVariant<PixelOpFunc>* crossfade = pixops_crossfade_dispatch();
+
+  SimdCpu::printInfo();
+  SimdTimer::printInfo();
+  SimdCpu::printVariant("pixops_crossfade", crossfade);
+
   pixops_check("crossfade-sse2" , pixops_crossfade_ref, pixops_crossfade_sse2);
   pixops_check("crossfade-ssse3", pixops_crossfade_ref, pixops_crossfade_ssse3);
+  pixops_check("crossfade-vec-scalar", pixops_crossfade_ref, pixops_crossfade_vec_scalar);
+  pixops_check("crossfade-vec-sse2"  , pixops_crossfade_ref, pixops_crossfade_vec_sse2);
+
+  if (SimdCpu::features() & kSimdCpuAVX2)
+    pixops_check("crossfade-vec-avx2", pixops_crossfade_ref, pixops_crossfade_vec_avx2);
+  else
+    printf("[SKIP ] IMPL=%-20s (no AVX2)\n", "crossfade-vec-avx2");
+
+  pixops_check("crossfade-best" , pixops_crossfade_ref, crossfade->func);
 
   pixops_bench("crossfade-ref"  , pixops_crossfade_ref);
   pixops_bench("crossfade-sse2" , pixops_crossfade_sse2);
   pixops_bench("crossfade-ssse3", pixops_crossfade_ssse3);
+  pixops_bench("crossfade-vec-sse2"  , pixops_crossfade_vec_sse2);
+
+  if (SimdCpu::features() & kSimdCpuAVX2)
+    pixops_bench("crossfade-vec-avx2", pixops_crossfade_vec_avx2);
 
   return 0;
 }
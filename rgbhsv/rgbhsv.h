@@ -19,4 +19,8 @@ void argb_from_ahsv_hq(float* dst, const float* src, int length);
 void ahsv_from_argb_sse2(float* dst, const float* src, int length);
 void argb_from_ahsv_sse2(float* dst, const float* src, int length);
 
+// Variants selected by `SimdCpu::tier()` (`hq` is never selected).
+const SimdVariant<ArgbAhsvFunc>* ahsv_from_argb_dispatch(void);
+const SimdVariant<ArgbAhsvFunc>* argb_from_ahsv_dispatch(void);
+
 #endif // _RGBHSV_H
@@ -101,3 +101,33 @@ void ahsv_from_argb_hq(float* dst, const float* src, int length) {
 void argb_from_ahsv_hq(float* dst, const float* src, int length) {
   argb_from_ahsv_t<double>(dst, src, length);
 }
+
+// ============================================================================
+// [Dispatch]
+// ============================================================================
+
+static const SimdVariant<ArgbAhsvFunc> ahsv_from_argb_variants[] = {
+  { kSimdTierRef , "ref" , ahsv_from_argb_ref  },
+  { kSimdTierSSE2, "sse2", ahsv_from_argb_sse2 }
+};
+
+static const SimdVariant<ArgbAhsvFunc> argb_from_ahsv_variants[] = {
+  { kSimdTierRef , "ref" , argb_from_ahsv_ref  },
+  { kSimdTierSSE2, "sse2", argb_from_ahsv_sse2 }
+};
+
+const SimdVariant<ArgbAhsvFunc>* ahsv_from_argb_dispatch(void) {
+  static const SimdVariant<ArgbAhsvFunc>* selected;
+
+  if (selected == NULL)
+    selected = SimdCpu::select(ahsv_from_argb_variants, sizeof(ahsv_from_argb_variants) / sizeof(ahsv_from_argb_variants[0]));
+  return selected;
+}
+
+const SimdVariant<ArgbAhsvFunc>* argb_from_ahsv_dispatch(void) {
+  static const SimdVariant<ArgbAhsvFunc>* selected;
+
+  if (selected == NULL)
+    selected = SimdCpu::select(argb_from_ahsv_variants, sizeof(argb_from_ahsv_variants) / sizeof(argb_from_ahsv_variants[0]));
+  return selected;
+}
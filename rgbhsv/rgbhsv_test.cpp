@@ -152,15 +152,22 @@ void rgbhsv_bench(
   SimdTimer timer;
   rgbhsv_fill(argb, length);
 
+  // Each pixel is 4 floats.
+  double pixels = double(length) * quantity;
+
+  SimdBenchTime toHsv;
   timer.start();
   for (i = 0; i < quantity; i++) ahsv_from_argb(ahsv, argb, length);
   timer.stop();
-  printf("[BENCH] IMPL=%-4s ARGB -> AHSV: %.2u.%.3u s\n", name, timer.get() / 1000, timer.get() % 1000);
+  toHsv.update(timer);
+  printf("[BENCH] IMPL=%-4s ARGB -> AHSV: %s\n", name, toHsv.format(pixels, "px", pixels * 16.0));
 
+  SimdBenchTime toArgb;
   timer.start();
   for (i = 0; i < quantity; i++) argb_from_ahsv(argb, ahsv, length);
   timer.stop();
-  printf("[BENCH] IMPL=%-4s AHSV -> ARGB: %.2u.%.3u s\n", name, timer.get() / 1000, timer.get() % 1000);
+  toArgb.update(timer);
+  printf("[BENCH] IMPL=%-4s AHSV -> ARGB: %s\n", name, toArgb.format(pixels, "px", pixels * 16.0));
 }
 
 // ============================================================================
@@ -170,6 +177,14 @@ void rgbhsv_bench(
 int main(int argc, char* argv[]) {
   int length = 1000000;
 
+  const SimdVariant<ArgbAhsvFunc>* ahsvFromArgb = ahsv_from_argb_dispatch();
+  const SimdVariant<ArgbAhsvFunc>* argbFromAhsv = argb_from_ahsv_dispatch();
+
+  SimdCpu::printInfo();
+  SimdTimer::printInfo();
+  SimdCpu::printVariant("ahsv_from_argb", ahsvFromArgb);
+  SimdCpu::printVariant("argb_from_ahsv", argbFromAhsv);
+
   float* argb_data = static_cast<float*>(::malloc(length * 4 * sizeof(float) + 16));
   float* ahsv_data = static_cast<float*>(::malloc(length * 4 * sizeof(float) + 16));
 
@@ -182,6 +197,16 @@ int main(int argc, char* argv[]) {
   rgbhsv_fill(argb, length);
   rgbhsv_check("sse2", ahsv_from_argb_sse2, argb_from_ahsv_sse2, argb, length);
 
+  // The selected variant is one of the above unless a new tier is added, check
+  // it only in that case so its errors are not reported twice.
+  bool bestChecked = (ahsvFromArgb->func == ahsv_from_argb_ref  && argbFromAhsv->func == argb_from_ahsv_ref ) ||
+                     (ahsvFromArgb->func == ahsv_from_argb_sse2 && argbFromAhsv->func == argb_from_ahsv_sse2);
+
+  if (!bestChecked) {
+    rgbhsv_fill(argb, length);
+    rgbhsv_check("best", ahsvFromArgb->func, argbFromAhsv->func, argb, length);
+  }
+
   rgbhsv_bench("ref" , ahsv_from_argb_ref , argb_from_ahsv_ref , argb, ahsv, length);
   rgbhsv_bench("sse2", ahsv_from_argb_sse2, argb_from_ahsv_sse2, argb, ahsv, length);
 
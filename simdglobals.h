@@ -15,7 +15,14 @@
 #if defined(_WIN32)
 # include <windows.h>
 #else
-# include <sys/time.h>
+# include <time.h>
+#endif
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#else
+# include <cpuid.h>
+# include <x86intrin.h>
 #endif
 
 // ============================================================================
@@ -42,6 +49,14 @@
 # include <smmintrin.h>
 #endif // USE_SSE4_1
 
+#if defined(USE_AVX2)
+# include <immintrin.h>
+#endif // USE_AVX2
+
+#if defined(USE_AVX512BW)
+# include <immintrin.h>
+#endif // USE_AVX512BW
+
 // ============================================================================
 // [Port]
 // ============================================================================
@@ -151,7 +166,7 @@
 // [Simd128]
 // ============================================================================
 
-#if defined(USE_SSE2) || defined(USE_SSSE3) || defined(USE_SSE4_1)
+#if defined(USE_SSE2) || defined(USE_SSSE3) || defined(USE_SSE4_1) || defined(USE_AVX2) || defined(USE_AVX512BW)
 namespace Simd128 {
   static SIMD_INLINE __m128d m128roundeven(__m128d x) {
 #if defined USE_SSE4_1
@@ -243,28 +258,1137 @@ namespace SimdUtils {
   }
 };
 
+// ============================================================================
+// [SimdCpu]
+// ============================================================================
+
+//! CPU features, see `SimdCpu::features()`.
+enum SimdCpuFeature {
+  kSimdCpuSSE2       = 0x00000001U,
+  kSimdCpuSSE3       = 0x00000002U,
+  kSimdCpuSSSE3      = 0x00000004U,
+  kSimdCpuSSE4_1     = 0x00000008U,
+  kSimdCpuSSE4_2     = 0x00000010U,
+  kSimdCpuAVX        = 0x00000020U,
+  kSimdCpuAVX2       = 0x00000040U,
+  kSimdCpuFMA        = 0x00000080U,
+  kSimdCpuBMI2       = 0x00000100U,
+  kSimdCpuAVX512F    = 0x00000200U,
+  kSimdCpuAVX512BW   = 0x00000400U,
+  kSimdCpuAVX512VBMI = 0x00000800U
+};
+
+//! Dispatch tiers, each one implies all the previous ones. They match the
+//! `_sse2`, `_ssse3`, ... suffixes of implementations.
+enum SimdCpuTier {
+  kSimdTierRef      = 0,
+  kSimdTierSSE2     = 1,
+  kSimdTierSSSE3    = 2,
+  kSimdTierSSE4_1   = 3,
+  kSimdTierAVX2     = 4,
+  kSimdTierAVX512BW = 5,
+  kSimdTierCount    = 6
+};
+
+//! A variant of a function (`Func` is a function pointer) that requires the
+//! given tier.
+template<typename Func>
+struct SimdVariant {
+  uint32_t tier;
+  const char* name;
+  Func func;
+};
+
+//! CPU detection (CPUID) and selection of variants.
+//!
+//! The selected tier can be lowered by `SIMD_TIER` environment variable (one
+//! of "ref", "sse2", "ssse3", "sse4.1", "avx2", "avx512bw"), which is useful
+//! for A/B benchmarks of the same binary. It never goes above the detected
+//! tier.
+struct SimdCpu {
+  // --------------------------------------------------------------------------
+  // [Detection]
+  // --------------------------------------------------------------------------
+
+  static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t* regs) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (uint32_t i = 0; i < 4; i++)
+      regs[i] = static_cast<uint32_t>(r[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+  }
+
+  //! Register state enabled by the OS (XCR0), only valid if OSXSAVE is set.
+  static uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+  }
+
+  static uint32_t detect() {
+    uint32_t regs[4];
+    uint32_t features = 0;
+
+    cpuid(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+    if (maxLeaf < 1)
+      return 0;
+
+    cpuid(1, 0, regs);
+    if (regs[3] & (1U << 26)) features |= kSimdCpuSSE2;
+    if (regs[2] & (1U <<  0)) features |= kSimdCpuSSE3;
+    if (regs[2] & (1U <<  9)) features |= kSimdCpuSSSE3;
+    if (regs[2] & (1U << 19)) features |= kSimdCpuSSE4_1;
+    if (regs[2] & (1U << 20)) features |= kSimdCpuSSE4_2;
+
+    // AVX requires OSXSAVE and XMM|YMM state, AVX-512 also requires opmask,
+    // ZMM_Hi256 and Hi16_ZMM state.
+    bool hasYmm = false;
+    bool hasZmm = false;
+
+    if ((regs[2] & 0x18000000U) == 0x18000000U) {
+      uint64_t xcr0 = xgetbv0();
+      hasYmm = (xcr0 & 0x06) == 0x06;
+      hasZmm = (xcr0 & 0xE6) == 0xE6;
+    }
+
+    if (hasYmm) {
+      features |= kSimdCpuAVX;
+      if (regs[2] & (1U << 12)) features |= kSimdCpuFMA;
+    }
+
+    if (maxLeaf >= 7) {
+      cpuid(7, 0, regs);
+      if (regs[1] & (1U << 8)) features |= kSimdCpuBMI2;
+
+      if (hasYmm && (regs[1] & (1U << 5)))
+        features |= kSimdCpuAVX2;
+
+      if (hasZmm && (regs[1] & (1U << 16))) {
+        features |= kSimdCpuAVX512F;
+        if (regs[1] & (1U << 30)) features |= kSimdCpuAVX512BW;
+        if (regs[2] & (1U <<  1)) features |= kSimdCpuAVX512VBMI;
+      }
+    }
+
+    return features;
+  }
+
+  //! Features supported by both the CPU and the OS, detected once.
+  static uint32_t features() {
+    // All threads compute the same value, so racing on it is harmless.
+    static volatile uint32_t cached = 0xFFFFFFFFU;
+
+    uint32_t f = cached;
+    if (f == 0xFFFFFFFFU) {
+      f = detect();
+      cached = f;
+    }
+    return f;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Tiers]
+  // --------------------------------------------------------------------------
+
+  static const char* tierName(uint32_t tier) {
+    static const char* names[kSimdTierCount] = {
+      "ref", "sse2", "ssse3", "sse4.1", "avx2", "avx512bw"
+    };
+    return tier < kSimdTierCount ? names[tier] : "unknown";
+  }
+
+  //! The highest tier supported by the CPU.
+  static uint32_t detectedTier() {
+    uint32_t f = features();
+    uint32_t avx512 = kSimdCpuAVX512F | kSimdCpuAVX512BW;
+
+    if (!(f & kSimdCpuSSE2  )) return kSimdTierRef;
+    if (!(f & kSimdCpuSSSE3 )) return kSimdTierSSE2;
+    if (!(f & kSimdCpuSSE4_1)) return kSimdTierSSSE3;
+    if (!(f & kSimdCpuAVX2  )) return kSimdTierSSE4_1;
+    if ((f & avx512) != avx512) return kSimdTierAVX2;
+    return kSimdTierAVX512BW;
+  }
+
+  //! The tier used by dispatch, `detectedTier()` limited by `SIMD_TIER`.
+  static uint32_t tier() {
+    static volatile uint32_t cached = 0xFFFFFFFFU;
+
+    uint32_t t = cached;
+    if (t == 0xFFFFFFFFU) {
+      t = detectedTier();
+
+      const char* env = ::getenv("SIMD_TIER");
+      if (env != NULL) {
+        for (uint32_t i = 0; i < kSimdTierCount; i++) {
+          if (::strcmp(env, tierName(i)) == 0) {
+            t = SimdUtils::min<uint32_t>(t, i);
+            break;
+          }
+        }
+      }
+
+      cached = t;
+    }
+    return t;
+  }
+
+  // --------------------------------------------------------------------------
+  // [Dispatch]
+  // --------------------------------------------------------------------------
+
+  //! Selects the last of `variants` that doesn't require more than `tier()`.
+  //! Variants must be sorted by tier and the first must be `kSimdTierRef`.
+  template<typename Func>
+  static const SimdVariant<Func>* select(const SimdVariant<Func>* variants, size_t count) {
+    uint32_t t = tier();
+    size_t i = 0;
+
+    while (i + 1 < count && variants[i + 1].tier <= t)
+      i++;
+    return &variants[i];
+  }
+
+  static void printInfo() {
+    static const char* names[] = {
+      "sse2", "sse3", "ssse3", "sse4.1", "sse4.2", "avx", "avx2", "fma", "bmi2",
+      "avx512f", "avx512bw", "avx512vbmi"
+    };
+
+    uint32_t f = features();
+    printf("[CPU  ] FEATURES=");
+    for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+      if (f & (1U << i))
+        printf("%s ", names[i]);
+    }
+    printf("\n[CPU  ] TIER=%s (detected %s)\n", tierName(tier()), tierName(detectedTier()));
+  }
+
+  template<typename Func>
+  static void printVariant(const char* func, const SimdVariant<Func>* variant) {
+    printf("[CPU  ] %s -> %s\n", func, variant->name);
+  }
+};
+
+// ============================================================================
+// [SimdVec]
+// ============================================================================
+
+// Thin wrapper of SIMD registers, which makes it possible to write a kernel
+// once and compile it for several instruction sets. The backend is selected by
+// `USE_...` macros of the translation unit (or `SIMD_VEC_SCALAR`, which forces
+// the scalar backend). Each backend lives in its own namespace, which prevents
+// translation units compiled for different instruction sets from sharing the
+// same inline functions, and `SimdVec` is an alias of the selected one.
+//
+// Types are named by lane type and count, like `Vec<u8x16>` or `Vec<f64x2>`.
+// The AVX2 backend also provides 256-bit types (`Vec<u8x32>`, ...), and all
+// backends define `u8xN`, `i16xN`, ..., which are the widest types available.
+// Kernels that use `...xN` types scale with the backend.
+//
+// Unpacking and packing works within 128-bit lanes, exactly like instructions
+// it maps to. Kernels that unpack and pack back get the original order, the
+// rest can use `storeuLanes()`, which stores two registers interleaved by
+// 128-bit lanes (that is just two stores if registers are 128-bit).
+//
+// The scalar backend implements the same semantics by loops over lanes. It's
+// meant for testing kernels, not for speed, and it has only 128-bit types.
+#if defined(SIMD_VEC_SCALAR)
+# define SIMD_VEC_NS SimdVecScalar
+#elif defined(USE_AVX2) || defined(USE_AVX512BW)
+# define SIMD_VEC_NS SimdVecAVX2
+# define SIMD_VEC_X86
+# define SIMD_VEC_SSSE3
+# define SIMD_VEC_SSE4_1
+# define SIMD_VEC_AVX2
+#elif defined(USE_SSE4_1)
+# define SIMD_VEC_NS SimdVecSSE4_1
+# define SIMD_VEC_X86
+# define SIMD_VEC_SSSE3
+# define SIMD_VEC_SSE4_1
+#elif defined(USE_SSSE3)
+# define SIMD_VEC_NS SimdVecSSSE3
+# define SIMD_VEC_X86
+# define SIMD_VEC_SSSE3
+#elif defined(USE_SSE2) || defined(USE_SSE3)
+# define SIMD_VEC_NS SimdVecSSE2
+# define SIMD_VEC_X86
+#else
+# define SIMD_VEC_NS SimdVecScalar
+#endif
+
+namespace SIMD_VEC_NS {
+
+// ----------------------------------------------------------------------------
+// [Types]
+// ----------------------------------------------------------------------------
+
+#if defined(SIMD_VEC_X86)
+typedef __m128i Reg128I;
+typedef __m128  Reg128F;
+typedef __m128d Reg128D;
+#else
+template<typename T, int N>
+struct Lanes { T x[N]; };
+
+typedef Lanes<uint8_t, 16> Reg128I;
+typedef Lanes<float  ,  4> Reg128F;
+typedef Lanes<double ,  2> Reg128D;
+#endif
+
+#define SIMD_VEC_TYPE(name, lane, count, reg, width) \
+  struct name { \
+    typedef lane Lane; \
+    typedef reg Reg; \
+    enum { kLanes = count, kWidth = width }; \
+  };
+
+SIMD_VEC_TYPE(u8x16 , uint8_t , 16, Reg128I, 128)
+SIMD_VEC_TYPE(i16x8 , int16_t ,  8, Reg128I, 128)
+SIMD_VEC_TYPE(u16x8 , uint16_t,  8, Reg128I, 128)
+SIMD_VEC_TYPE(i32x4 , int32_t ,  4, Reg128I, 128)
+SIMD_VEC_TYPE(f32x4 , float   ,  4, Reg128F, 128)
+SIMD_VEC_TYPE(f64x2 , double  ,  2, Reg128D, 128)
+
+#if defined(SIMD_VEC_AVX2)
+SIMD_VEC_TYPE(u8x32 , uint8_t , 32, __m256i, 256)
+SIMD_VEC_TYPE(i16x16, int16_t , 16, __m256i, 256)
+SIMD_VEC_TYPE(u16x16, uint16_t, 16, __m256i, 256)
+SIMD_VEC_TYPE(i32x8 , int32_t ,  8, __m256i, 256)
+SIMD_VEC_TYPE(f32x8 , float   ,  8, __m256 , 256)
+SIMD_VEC_TYPE(f64x4 , double  ,  4, __m256d, 256)
+
+typedef u8x32  u8xN;
+typedef i16x16 i16xN;
+typedef u16x16 u16xN;
+typedef i32x8  i32xN;
+typedef f32x8  f32xN;
+typedef f64x4  f64xN;
+#else
+typedef u8x16  u8xN;
+typedef i16x8  i16xN;
+typedef u16x8  u16xN;
+typedef i32x4  i32xN;
+typedef f32x4  f32xN;
+typedef f64x2  f64xN;
+#endif
+
+#undef SIMD_VEC_TYPE
+
+template<typename T>
+struct Vec {
+  typedef T Type;
+  typedef typename T::Lane Lane;
+  typedef typename T::Reg Reg;
+  enum { kLanes = T::kLanes, kWidth = T::kWidth };
+
+  Reg v;
+};
+
+template<typename T>
+static SIMD_INLINE Vec<T> vec(typename T::Reg v) {
+  Vec<T> r;
+  r.v = v;
+  return r;
+}
+
+#if defined(SIMD_VEC_X86)
+// ----------------------------------------------------------------------------
+// [X86 - Init / Cast]
+// ----------------------------------------------------------------------------
+
+// Conversion between registers of the same width, through integer ones.
+template<int W> struct RegOfWidth {};
+template<> struct RegOfWidth<128> {
+  static SIMD_INLINE __m128i zeroI() { return _mm_setzero_si128(); }
+  static SIMD_INLINE __m128i castI(__m128i x) { return x; }
+  static SIMD_INLINE __m128i castI(__m128  x) { return _mm_castps_si128(x); }
+  static SIMD_INLINE __m128i castI(__m128d x) { return _mm_castpd_si128(x); }
+  static SIMD_INLINE void fromI(__m128i& dst, __m128i x) { dst = x; }
+  static SIMD_INLINE void fromI(__m128 & dst, __m128i x) { dst = _mm_castsi128_ps(x); }
+  static SIMD_INLINE void fromI(__m128d& dst, __m128i x) { dst = _mm_castsi128_pd(x); }
+
+  template<typename R> static SIMD_INLINE __m128i lowI(R x) { return castI(x); }
+  template<typename R> static SIMD_INLINE void fromLowI(R& dst, __m128i x) { fromI(dst, x); }
+};
+
+#if defined(SIMD_VEC_AVX2)
+template<> struct RegOfWidth<256> {
+  static SIMD_INLINE __m256i zeroI() { return _mm256_setzero_si256(); }
+  static SIMD_INLINE __m256i castI(__m256i x) { return x; }
+  static SIMD_INLINE __m256i castI(__m256  x) { return _mm256_castps_si256(x); }
+  static SIMD_INLINE __m256i castI(__m256d x) { return _mm256_castpd_si256(x); }
+  static SIMD_INLINE void fromI(__m256i& dst, __m256i x) { dst = x; }
+  static SIMD_INLINE void fromI(__m256 & dst, __m256i x) { dst = _mm256_castsi256_ps(x); }
+  static SIMD_INLINE void fromI(__m256d& dst, __m256i x) { dst = _mm256_castsi256_pd(x); }
+
+  template<typename R> static SIMD_INLINE __m128i lowI(R x) { return _mm256_castsi256_si128(castI(x)); }
+  template<typename R> static SIMD_INLINE void fromLowI(R& dst, __m128i x) { fromI(dst, _mm256_inserti128_si256(_mm256_setzero_si256(), x, 0)); }
+};
+#endif
+
+// Reinterprets `x` as `T` (both must have the same width).
+template<typename T, typename S>
+static SIMD_INLINE Vec<T> cast(const Vec<S>& x) {
+  Vec<T> r;
+  RegOfWidth<T::kWidth>::fromI(r.v, RegOfWidth<S::kWidth>::castI(x.v));
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> zero() {
+  Vec<T> r;
+  RegOfWidth<T::kWidth>::fromI(r.v, RegOfWidth<T::kWidth>::zeroI());
+  return r;
+}
+
+template<typename T> static SIMD_INLINE Vec<T> set1(typename T::Lane x);
+
+template<> SIMD_INLINE Vec<u8x16> set1<u8x16>(uint8_t  x) { return vec<u8x16>(_mm_set1_epi8(static_cast<char>(x))); }
+template<> SIMD_INLINE Vec<i16x8> set1<i16x8>(int16_t  x) { return vec<i16x8>(_mm_set1_epi16(x)); }
+template<> SIMD_INLINE Vec<u16x8> set1<u16x8>(uint16_t x) { return vec<u16x8>(_mm_set1_epi16(static_cast<int16_t>(x))); }
+template<> SIMD_INLINE Vec<i32x4> set1<i32x4>(int32_t  x) { return vec<i32x4>(_mm_set1_epi32(x)); }
+template<> SIMD_INLINE Vec<f32x4> set1<f32x4>(float    x) { return vec<f32x4>(_mm_set1_ps(x)); }
+template<> SIMD_INLINE Vec<f64x2> set1<f64x2>(double   x) { return vec<f64x2>(_mm_set1_pd(x)); }
+
+#if defined(SIMD_VEC_AVX2)
+template<> SIMD_INLINE Vec<u8x32 > set1<u8x32 >(uint8_t  x) { return vec<u8x32 >(_mm256_set1_epi8(static_cast<char>(x))); }
+template<> SIMD_INLINE Vec<i16x16> set1<i16x16>(int16_t  x) { return vec<i16x16>(_mm256_set1_epi16(x)); }
+template<> SIMD_INLINE Vec<u16x16> set1<u16x16>(uint16_t x) { return vec<u16x16>(_mm256_set1_epi16(static_cast<int16_t>(x))); }
+template<> SIMD_INLINE Vec<i32x8 > set1<i32x8 >(int32_t  x) { return vec<i32x8 >(_mm256_set1_epi32(x)); }
+template<> SIMD_INLINE Vec<f32x8 > set1<f32x8 >(float    x) { return vec<f32x8 >(_mm256_set1_ps(x)); }
+template<> SIMD_INLINE Vec<f64x4 > set1<f64x4 >(double   x) { return vec<f64x4 >(_mm256_set1_pd(x)); }
+#endif
+
+// ----------------------------------------------------------------------------
+// [X86 - Load / Store]
+// ----------------------------------------------------------------------------
+
+template<int W> struct MemOfWidth {};
+template<> struct MemOfWidth<128> {
+  static SIMD_INLINE __m128i load (const void* p) { return _mm_load_si128(static_cast<const __m128i*>(p)); }
+  static SIMD_INLINE __m128i loadu(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+  static SIMD_INLINE void store (void* p, __m128i x) { _mm_store_si128(static_cast<__m128i*>(p), x); }
+  static SIMD_INLINE void storeu(void* p, __m128i x) { _mm_storeu_si128(static_cast<__m128i*>(p), x); }
+
+  // Stores `a` and `b`, 128-bit registers have just one lane.
+  static SIMD_INLINE void storeuLanes(void* p, __m128i a, __m128i b) {
+    _mm_storeu_si128(static_cast<__m128i*>(p) + 0, a);
+    _mm_storeu_si128(static_cast<__m128i*>(p) + 1, b);
+  }
+};
+
+#if defined(SIMD_VEC_AVX2)
+template<> struct MemOfWidth<256> {
+  static SIMD_INLINE __m256i load (const void* p) { return _mm256_load_si256(static_cast<const __m256i*>(p)); }
+  static SIMD_INLINE __m256i loadu(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+  static SIMD_INLINE void store (void* p, __m256i x) { _mm256_store_si256(static_cast<__m256i*>(p), x); }
+  static SIMD_INLINE void storeu(void* p, __m256i x) { _mm256_storeu_si256(static_cast<__m256i*>(p), x); }
+
+  static SIMD_INLINE void storeuLanes(void* p, __m256i a, __m256i b) {
+    _mm256_storeu_si256(static_cast<__m256i*>(p) + 0, _mm256_permute2x128_si256(a, b, 0x20));
+    _mm256_storeu_si256(static_cast<__m256i*>(p) + 1, _mm256_permute2x128_si256(a, b, 0x31));
+  }
+};
+#endif
+
+template<typename T>
+static SIMD_INLINE Vec<T> load(const void* p) {
+  Vec<T> r;
+  RegOfWidth<T::kWidth>::fromI(r.v, MemOfWidth<T::kWidth>::load(p));
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> loadu(const void* p) {
+  Vec<T> r;
+  RegOfWidth<T::kWidth>::fromI(r.v, MemOfWidth<T::kWidth>::loadu(p));
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE void store(void* p, const Vec<T>& x) {
+  MemOfWidth<T::kWidth>::store(p, RegOfWidth<T::kWidth>::castI(x.v));
+}
+
+template<typename T>
+static SIMD_INLINE void storeu(void* p, const Vec<T>& x) {
+  MemOfWidth<T::kWidth>::storeu(p, RegOfWidth<T::kWidth>::castI(x.v));
+}
+
+// Stores the first 128-bit lane of `a`, then of `b`, then the second lane of
+// `a`, and so on. This reverts the order produced by in-lane unpacking.
+template<typename T>
+static SIMD_INLINE void storeuLanes(void* p, const Vec<T>& a, const Vec<T>& b) {
+  MemOfWidth<T::kWidth>::storeuLanes(p, RegOfWidth<T::kWidth>::castI(a.v), RegOfWidth<T::kWidth>::castI(b.v));
+}
+
+// Loads / stores the low 32 or 64 bits, the rest of the register is zeroed.
+template<typename T>
+static SIMD_INLINE Vec<T> loadu32(const void* p) {
+  int32_t x;
+  ::memcpy(&x, p, 4);
+
+  Vec<T> r;
+  RegOfWidth<T::kWidth>::fromLowI(r.v, _mm_cvtsi32_si128(x));
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> loadu64(const void* p) {
+  Vec<T> r;
+  RegOfWidth<T::kWidth>::fromLowI(r.v, _mm_loadl_epi64(static_cast<const __m128i*>(p)));
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE void storeu32(void* p, const Vec<T>& x) {
+  int32_t v = _mm_cvtsi128_si32(RegOfWidth<T::kWidth>::lowI(x.v));
+  ::memcpy(p, &v, 4);
+}
+
+template<typename T>
+static SIMD_INLINE void storeu64(void* p, const Vec<T>& x) {
+  _mm_storel_epi64(static_cast<__m128i*>(p), RegOfWidth<T::kWidth>::lowI(x.v));
+}
+
+// Loads `T::kLanes` bytes and zero extends them to 16-bit lanes, in order.
+template<typename T> static SIMD_INLINE Vec<T> loadWidenU8(const uint8_t* p);
+
+template<>
+SIMD_INLINE Vec<i16x8> loadWidenU8<i16x8>(const uint8_t* p) {
+  __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+#if defined(SIMD_VEC_SSE4_1)
+  return vec<i16x8>(_mm_cvtepu8_epi16(x));
+#else
+  return vec<i16x8>(_mm_unpacklo_epi8(x, _mm_setzero_si128()));
+#endif
+}
+
+#if defined(SIMD_VEC_AVX2)
+template<>
+SIMD_INLINE Vec<i16x16> loadWidenU8<i16x16>(const uint8_t* p) {
+  return vec<i16x16>(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// [X86 - Integer]
+// ----------------------------------------------------------------------------
+
+#define SIMD_VEC_OP(T, name, expr) \
+  static SIMD_INLINE Vec<T> name(const Vec<T>& a, const Vec<T>& b) { return vec<T>(expr); }
+
+#define SIMD_VEC_SHIFT(T, name, expr) \
+  template<int N> \
+  static SIMD_INLINE Vec<T> name(const Vec<T>& a) { return vec<T>(expr); }
+
+#define SIMD_VEC_INT_OPS(T, P, S) \
+  SIMD_VEC_OP(T, operator&, P##_and_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, operator|, P##_or_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, operator^, P##_xor_##S(a.v, b.v)) \
+  /* Computes `~a & b`. */ \
+  SIMD_VEC_OP(T, andnot, P##_andnot_##S(a.v, b.v))
+
+#define SIMD_VEC_INT_TYPES(u8, i16, u16, i32, P, S, ZERO) \
+  SIMD_VEC_INT_OPS(u8, P, S) \
+  SIMD_VEC_INT_OPS(i16, P, S) \
+  SIMD_VEC_INT_OPS(u16, P, S) \
+  SIMD_VEC_INT_OPS(i32, P, S) \
+  \
+  SIMD_VEC_OP(u8 , operator+, P##_add_epi8(a.v, b.v)) \
+  SIMD_VEC_OP(i16, operator+, P##_add_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u16, operator+, P##_add_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(i32, operator+, P##_add_epi32(a.v, b.v)) \
+  SIMD_VEC_OP(u8 , operator-, P##_sub_epi8(a.v, b.v)) \
+  SIMD_VEC_OP(i16, operator-, P##_sub_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u16, operator-, P##_sub_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(i32, operator-, P##_sub_epi32(a.v, b.v)) \
+  \
+  SIMD_VEC_OP(u8 , adds, P##_adds_epu8(a.v, b.v)) \
+  SIMD_VEC_OP(i16, adds, P##_adds_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u16, adds, P##_adds_epu16(a.v, b.v)) \
+  SIMD_VEC_OP(u8 , subs, P##_subs_epu8(a.v, b.v)) \
+  SIMD_VEC_OP(i16, subs, P##_subs_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u16, subs, P##_subs_epu16(a.v, b.v)) \
+  \
+  SIMD_VEC_OP(u8 , min, P##_min_epu8(a.v, b.v)) \
+  SIMD_VEC_OP(i16, min, P##_min_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u8 , max, P##_max_epu8(a.v, b.v)) \
+  SIMD_VEC_OP(i16, max, P##_max_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u8 , avg, P##_avg_epu8(a.v, b.v)) \
+  \
+  SIMD_VEC_OP(i16, mullo, P##_mullo_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u16, mullo, P##_mullo_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(i16, mulhi, P##_mulhi_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u16, mulhi, P##_mulhi_epu16(a.v, b.v)) \
+  \
+  SIMD_VEC_OP(u8 , cmpeq, P##_cmpeq_epi8(a.v, b.v)) \
+  SIMD_VEC_OP(i16, cmpeq, P##_cmpeq_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(i32, cmpeq, P##_cmpeq_epi32(a.v, b.v)) \
+  SIMD_VEC_OP(i16, cmpgt, P##_cmpgt_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(i32, cmpgt, P##_cmpgt_epi32(a.v, b.v)) \
+  \
+  SIMD_VEC_OP(u8 , unpackLo, P##_unpacklo_epi8(a.v, b.v)) \
+  SIMD_VEC_OP(u8 , unpackHi, P##_unpackhi_epi8(a.v, b.v)) \
+  SIMD_VEC_OP(i16, unpackLo, P##_unpacklo_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(i16, unpackHi, P##_unpackhi_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u16, unpackLo, P##_unpacklo_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(u16, unpackHi, P##_unpackhi_epi16(a.v, b.v)) \
+  SIMD_VEC_OP(i32, unpackLo, P##_unpacklo_epi32(a.v, b.v)) \
+  SIMD_VEC_OP(i32, unpackHi, P##_unpackhi_epi32(a.v, b.v)) \
+  \
+  SIMD_VEC_SHIFT(i16, slli, P##_slli_epi16(a.v, N)) \
+  SIMD_VEC_SHIFT(u16, slli, P##_slli_epi16(a.v, N)) \
+  SIMD_VEC_SHIFT(i32, slli, P##_slli_epi32(a.v, N)) \
+  SIMD_VEC_SHIFT(u16, srli, P##_srli_epi16(a.v, N)) \
+  SIMD_VEC_SHIFT(i16, srai, P##_srai_epi16(a.v, N)) \
+  SIMD_VEC_SHIFT(i32, srai, P##_srai_epi32(a.v, N)) \
+  \
+  /* Multiplies 16-bit lanes and adds adjacent pairs of 32-bit products. */ \
+  static SIMD_INLINE Vec<i32> madd(const Vec<i16>& a, const Vec<i16>& b) { return vec<i32>(P##_madd_epi16(a.v, b.v)); } \
+  \
+  /* Saturating packs, `a` goes to the low half of each 128-bit lane. */ \
+  static SIMD_INLINE Vec<i16> packs(const Vec<i32>& a, const Vec<i32>& b) { return vec<i16>(P##_packs_epi32(a.v, b.v)); } \
+  static SIMD_INLINE Vec<u8> packus(const Vec<i16>& a, const Vec<i16>& b) { return vec<u8>(P##_packus_epi16(a.v, b.v)); } \
+  static SIMD_INLINE Vec<u8> packus(const Vec<u16>& a, const Vec<u16>& b) { return vec<u8>(P##_packus_epi16(a.v, b.v)); } \
+  \
+  /* Zero extends the low / high half of each 128-bit lane. */ \
+  static SIMD_INLINE Vec<u16> widenLo(const Vec<u8>& a) { return vec<u16>(P##_unpacklo_epi8(a.v, ZERO)); } \
+  static SIMD_INLINE Vec<u16> widenHi(const Vec<u8>& a) { return vec<u16>(P##_unpackhi_epi8(a.v, ZERO)); }
+
+SIMD_VEC_INT_TYPES(u8x16, i16x8, u16x8, i32x4, _mm, si128, _mm_setzero_si128())
+#if defined(SIMD_VEC_AVX2)
+SIMD_VEC_INT_TYPES(u8x32, i16x16, u16x16, i32x8, _mm256, si256, _mm256_setzero_si256())
+#endif
+
+// Absolute value of signed 16-bit lanes.
+static SIMD_INLINE Vec<i16x8> abs(const Vec<i16x8>& a) {
+#if defined(SIMD_VEC_SSSE3)
+  return vec<i16x8>(_mm_abs_epi16(a.v));
+#else
+  return vec<i16x8>(_mm_max_epi16(a.v, _mm_sub_epi16(_mm_setzero_si128(), a.v)));
+#endif
+}
+
+// Unsigned 16-bit min / max (SSE2 computes them by saturated subtraction).
+static SIMD_INLINE Vec<u16x8> min(const Vec<u16x8>& a, const Vec<u16x8>& b) {
+#if defined(SIMD_VEC_SSE4_1)
+  return vec<u16x8>(_mm_min_epu16(a.v, b.v));
+#else
+  return vec<u16x8>(_mm_sub_epi16(a.v, _mm_subs_epu16(a.v, b.v)));
+#endif
+}
+
+static SIMD_INLINE Vec<u16x8> max(const Vec<u16x8>& a, const Vec<u16x8>& b) {
+#if defined(SIMD_VEC_SSE4_1)
+  return vec<u16x8>(_mm_max_epu16(a.v, b.v));
+#else
+  return vec<u16x8>(_mm_add_epi16(b.v, _mm_subs_epu16(a.v, b.v)));
+#endif
+}
+
+// 32-bit multiplication keeping the low 32 bits of each product.
+static SIMD_INLINE Vec<i32x4> mullo(const Vec<i32x4>& a, const Vec<i32x4>& b) {
+#if defined(SIMD_VEC_SSE4_1)
+  return vec<i32x4>(_mm_mullo_epi32(a.v, b.v));
+#else
+  __m128i even = _mm_mul_epu32(a.v, b.v);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.v, 32), _mm_srli_epi64(b.v, 32));
+  return vec<i32x4>(_mm_unpacklo_epi32(
+    _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+    _mm_shuffle_epi32(odd , _MM_SHUFFLE(0, 0, 2, 0))));
+#endif
+}
+
+#if defined(SIMD_VEC_AVX2)
+static SIMD_INLINE Vec<i16x16> abs(const Vec<i16x16>& a) { return vec<i16x16>(_mm256_abs_epi16(a.v)); }
+static SIMD_INLINE Vec<u16x16> min(const Vec<u16x16>& a, const Vec<u16x16>& b) { return vec<u16x16>(_mm256_min_epu16(a.v, b.v)); }
+static SIMD_INLINE Vec<u16x16> max(const Vec<u16x16>& a, const Vec<u16x16>& b) { return vec<u16x16>(_mm256_max_epu16(a.v, b.v)); }
+static SIMD_INLINE Vec<i32x8> mullo(const Vec<i32x8>& a, const Vec<i32x8>& b) { return vec<i32x8>(_mm256_mullo_epi32(a.v, b.v)); }
+#endif
+
+// ----------------------------------------------------------------------------
+// [X86 - Float]
+// ----------------------------------------------------------------------------
+
+#define SIMD_VEC_FLOAT_OPS(T, P, S) \
+  SIMD_VEC_OP(T, operator+, P##_add_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, operator-, P##_sub_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, operator*, P##_mul_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, operator/, P##_div_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, operator&, P##_and_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, operator|, P##_or_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, operator^, P##_xor_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, min, P##_min_##S(a.v, b.v)) \
+  SIMD_VEC_OP(T, max, P##_max_##S(a.v, b.v)) \
+  static SIMD_INLINE Vec<T> sqrt(const Vec<T>& a) { return vec<T>(P##_sqrt_##S(a.v)); }
+
+SIMD_VEC_FLOAT_OPS(f32x4, _mm, ps)
+SIMD_VEC_FLOAT_OPS(f64x2, _mm, pd)
+
+// Conversion between 32-bit integers and floats (rounds to nearest even).
+static SIMD_INLINE Vec<f32x4> cvtF32(const Vec<i32x4>& a) { return vec<f32x4>(_mm_cvtepi32_ps(a.v)); }
+static SIMD_INLINE Vec<i32x4> cvtI32(const Vec<f32x4>& a) { return vec<i32x4>(_mm_cvtps_epi32(a.v)); }
+
+#if defined(SIMD_VEC_AVX2)
+SIMD_VEC_FLOAT_OPS(f32x8, _mm256, ps)
+SIMD_VEC_FLOAT_OPS(f64x4, _mm256, pd)
+
+static SIMD_INLINE Vec<f32x8> cvtF32(const Vec<i32x8>& a) { return vec<f32x8>(_mm256_cvtepi32_ps(a.v)); }
+static SIMD_INLINE Vec<i32x8> cvtI32(const Vec<f32x8>& a) { return vec<i32x8>(_mm256_cvtps_epi32(a.v)); }
+#endif
+
+#undef SIMD_VEC_FLOAT_OPS
+#undef SIMD_VEC_INT_TYPES
+#undef SIMD_VEC_INT_OPS
+#undef SIMD_VEC_SHIFT
+#undef SIMD_VEC_OP
+
+#else
+// ----------------------------------------------------------------------------
+// [Scalar - Lanes]
+// ----------------------------------------------------------------------------
+
+// Registers are stored as bytes and reinterpreted by lanes of `T`, which has
+// the same semantics as SIMD registers, including overflow of integer lanes.
+template<typename T>
+struct LaneArray { typename T::Lane x[T::kLanes]; };
+
+template<typename T, typename S>
+static SIMD_INLINE Vec<T> cast(const Vec<S>& x) {
+  Vec<T> r;
+  ::memcpy(&r.v, &x.v, 16);
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE LaneArray<T> lanesOf(const Vec<T>& x) {
+  LaneArray<T> r;
+  ::memcpy(&r, &x.v, 16);
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> fromLanes(const LaneArray<T>& x) {
+  Vec<T> r;
+  ::memcpy(&r.v, &x, 16);
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> zero() {
+  Vec<T> r;
+  ::memset(&r.v, 0, 16);
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> set1(typename T::Lane x) {
+  LaneArray<T> r;
+  for (int i = 0; i < T::kLanes; i++)
+    r.x[i] = x;
+  return fromLanes<T>(r);
+}
+
+// ----------------------------------------------------------------------------
+// [Scalar - Load / Store]
+// ----------------------------------------------------------------------------
+
+template<typename T>
+static SIMD_INLINE Vec<T> loadu(const void* p) {
+  Vec<T> r;
+  ::memcpy(&r.v, p, 16);
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> load(const void* p) { return loadu<T>(p); }
+
+template<typename T>
+static SIMD_INLINE void storeu(void* p, const Vec<T>& x) { ::memcpy(p, &x.v, 16); }
+
+template<typename T>
+static SIMD_INLINE void store(void* p, const Vec<T>& x) { storeu<T>(p, x); }
+
+template<typename T>
+static SIMD_INLINE void storeuLanes(void* p, const Vec<T>& a, const Vec<T>& b) {
+  ::memcpy(static_cast<uint8_t*>(p) +  0, &a.v, 16);
+  ::memcpy(static_cast<uint8_t*>(p) + 16, &b.v, 16);
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> loadu32(const void* p) {
+  Vec<T> r = zero<T>();
+  ::memcpy(&r.v, p, 4);
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> loadu64(const void* p) {
+  Vec<T> r = zero<T>();
+  ::memcpy(&r.v, p, 8);
+  return r;
+}
+
+template<typename T>
+static SIMD_INLINE void storeu32(void* p, const Vec<T>& x) { ::memcpy(p, &x.v, 4); }
+
+template<typename T>
+static SIMD_INLINE void storeu64(void* p, const Vec<T>& x) { ::memcpy(p, &x.v, 8); }
+
+template<typename T>
+static SIMD_INLINE Vec<T> loadWidenU8(const uint8_t* p) {
+  LaneArray<T> r;
+  for (int i = 0; i < T::kLanes; i++)
+    r.x[i] = static_cast<typename T::Lane>(p[i]);
+  return fromLanes<T>(r);
+}
+
+// ----------------------------------------------------------------------------
+// [Scalar - Operations]
+// ----------------------------------------------------------------------------
+
+template<typename T>
+static SIMD_INLINE T scalarSat(int32_t x, int32_t lo, int32_t hi) {
+  return static_cast<T>(x < lo ? lo : x > hi ? hi : x);
+}
+
+// Integer lanes are computed in `int32_t` (or `int64_t`) and truncated back.
+#define SIMD_VEC_LANEWISE(T, name, expr) \
+  static SIMD_INLINE Vec<T> name(const Vec<T>& va, const Vec<T>& vb) { \
+    typedef T::Lane Lane; \
+    LaneArray<T> a = lanesOf(va), b = lanesOf(vb), r; \
+    for (int i = 0; i < T::kLanes; i++) \
+      r.x[i] = static_cast<Lane>(expr); \
+    return fromLanes<T>(r); \
+  }
+
+#define SIMD_VEC_SHIFT(T, name, expr) \
+  template<int N> \
+  static SIMD_INLINE Vec<T> name(const Vec<T>& va) { \
+    typedef T::Lane Lane; \
+    LaneArray<T> a = lanesOf(va), r; \
+    for (int i = 0; i < T::kLanes; i++) \
+      r.x[i] = static_cast<Lane>(expr); \
+    return fromLanes<T>(r); \
+  }
+
+#define SIMD_VEC_BITWISE(T) \
+  SIMD_VEC_LANEWISE(T, operator&, a.x[i] & b.x[i]) \
+  SIMD_VEC_LANEWISE(T, operator|, a.x[i] | b.x[i]) \
+  SIMD_VEC_LANEWISE(T, operator^, a.x[i] ^ b.x[i]) \
+  SIMD_VEC_LANEWISE(T, andnot, ~a.x[i] & b.x[i])
+
+#define SIMD_VEC_ARITH(T) \
+  SIMD_VEC_LANEWISE(T, operator+, static_cast<uint32_t>(a.x[i]) + static_cast<uint32_t>(b.x[i])) \
+  SIMD_VEC_LANEWISE(T, operator-, static_cast<uint32_t>(a.x[i]) - static_cast<uint32_t>(b.x[i])) \
+  SIMD_VEC_LANEWISE(T, min, a.x[i] < b.x[i] ? a.x[i] : b.x[i]) \
+  SIMD_VEC_LANEWISE(T, max, a.x[i] > b.x[i] ? a.x[i] : b.x[i])
+
+#define SIMD_VEC_CMP(T) \
+  SIMD_VEC_LANEWISE(T, cmpeq, a.x[i] == b.x[i] ? -1 : 0)
+
+SIMD_VEC_BITWISE(u8x16)
+SIMD_VEC_BITWISE(i16x8)
+SIMD_VEC_BITWISE(u16x8)
+SIMD_VEC_BITWISE(i32x4)
+
+SIMD_VEC_ARITH(u8x16)
+SIMD_VEC_ARITH(i16x8)
+SIMD_VEC_ARITH(u16x8)
+SIMD_VEC_LANEWISE(i32x4, operator+, static_cast<uint32_t>(a.x[i]) + static_cast<uint32_t>(b.x[i]))
+SIMD_VEC_LANEWISE(i32x4, operator-, static_cast<uint32_t>(a.x[i]) - static_cast<uint32_t>(b.x[i]))
+
+SIMD_VEC_CMP(u8x16)
+SIMD_VEC_CMP(i16x8)
+SIMD_VEC_CMP(i32x4)
+SIMD_VEC_LANEWISE(i16x8, cmpgt, a.x[i] > b.x[i] ? -1 : 0)
+SIMD_VEC_LANEWISE(i32x4, cmpgt, a.x[i] > b.x[i] ? -1 : 0)
+
+SIMD_VEC_LANEWISE(u8x16, adds, scalarSat<Lane>(int32_t(a.x[i]) + int32_t(b.x[i]), 0, 255))
+SIMD_VEC_LANEWISE(i16x8, adds, scalarSat<Lane>(int32_t(a.x[i]) + int32_t(b.x[i]), -32768, 32767))
+SIMD_VEC_LANEWISE(u16x8, adds, scalarSat<Lane>(int32_t(a.x[i]) + int32_t(b.x[i]), 0, 65535))
+SIMD_VEC_LANEWISE(u8x16, subs, scalarSat<Lane>(int32_t(a.x[i]) - int32_t(b.x[i]), 0, 255))
+SIMD_VEC_LANEWISE(i16x8, subs, scalarSat<Lane>(int32_t(a.x[i]) - int32_t(b.x[i]), -32768, 32767))
+SIMD_VEC_LANEWISE(u16x8, subs, scalarSat<Lane>(int32_t(a.x[i]) - int32_t(b.x[i]), 0, 65535))
+SIMD_VEC_LANEWISE(u8x16, avg, (uint32_t(a.x[i]) + uint32_t(b.x[i]) + 1) >> 1)
+
+SIMD_VEC_LANEWISE(i16x8, mullo, uint32_t(a.x[i]) * uint32_t(b.x[i]))
+SIMD_VEC_LANEWISE(u16x8, mullo, uint32_t(a.x[i]) * uint32_t(b.x[i]))
+SIMD_VEC_LANEWISE(i32x4, mullo, uint32_t(a.x[i]) * uint32_t(b.x[i]))
+SIMD_VEC_LANEWISE(i16x8, mulhi, (int32_t(a.x[i]) * int32_t(b.x[i])) >> 16)
+SIMD_VEC_LANEWISE(u16x8, mulhi, (uint32_t(a.x[i]) * uint32_t(b.x[i])) >> 16)
+
+SIMD_VEC_SHIFT(i16x8, slli, uint32_t(a.x[i]) << N)
+SIMD_VEC_SHIFT(u16x8, slli, uint32_t(a.x[i]) << N)
+SIMD_VEC_SHIFT(i32x4, slli, uint32_t(a.x[i]) << N)
+SIMD_VEC_SHIFT(u16x8, srli, a.x[i] >> N)
+SIMD_VEC_SHIFT(i16x8, srai, a.x[i] >> N)
+SIMD_VEC_SHIFT(i32x4, srai, a.x[i] >> N)
+
+static SIMD_INLINE Vec<i16x8> abs(const Vec<i16x8>& va) {
+  LaneArray<i16x8> a = lanesOf(va), r;
+  for (int i = 0; i < 8; i++)
+    r.x[i] = static_cast<int16_t>(a.x[i] < 0 ? -a.x[i] : a.x[i]);
+  return fromLanes<i16x8>(r);
+}
+
+static SIMD_INLINE Vec<i32x4> madd(const Vec<i16x8>& va, const Vec<i16x8>& vb) {
+  LaneArray<i16x8> a = lanesOf(va), b = lanesOf(vb);
+  LaneArray<i32x4> r;
+  for (int i = 0; i < 4; i++)
+    r.x[i] = static_cast<int32_t>(
+      static_cast<uint32_t>(int32_t(a.x[i * 2 + 0]) * int32_t(b.x[i * 2 + 0])) +
+      static_cast<uint32_t>(int32_t(a.x[i * 2 + 1]) * int32_t(b.x[i * 2 + 1])));
+  return fromLanes<i32x4>(r);
+}
+
+template<typename T>
+static SIMD_INLINE Vec<T> scalarUnpack(const Vec<T>& va, const Vec<T>& vb, int offset) {
+  LaneArray<T> a = lanesOf(va), b = lanesOf(vb), r;
+  for (int i = 0; i < T::kLanes / 2; i++) {
+    r.x[i * 2 + 0] = a.x[offset + i];
+    r.x[i * 2 + 1] = b.x[offset + i];
+  }
+  return fromLanes<T>(r);
+}
+
+#define SIMD_VEC_UNPACK(T) \
+  static SIMD_INLINE Vec<T> unpackLo(const Vec<T>& a, const Vec<T>& b) { return scalarUnpack<T>(a, b, 0); } \
+  static SIMD_INLINE Vec<T> unpackHi(const Vec<T>& a, const Vec<T>& b) { return scalarUnpack<T>(a, b, T::kLanes / 2); }
+
+SIMD_VEC_UNPACK(u8x16)
+SIMD_VEC_UNPACK(i16x8)
+SIMD_VEC_UNPACK(u16x8)
+SIMD_VEC_UNPACK(i32x4)
+
+static SIMD_INLINE Vec<u16x8> widenLo(const Vec<u8x16>& a) { return cast<u16x8>(unpackLo(a, zero<u8x16>())); }
+static SIMD_INLINE Vec<u16x8> widenHi(const Vec<u8x16>& a) { return cast<u16x8>(unpackHi(a, zero<u8x16>())); }
+
+static SIMD_INLINE Vec<i16x8> packs(const Vec<i32x4>& va, const Vec<i32x4>& vb) {
+  LaneArray<i32x4> a = lanesOf(va), b = lanesOf(vb);
+  LaneArray<i16x8> r;
+  for (int i = 0; i < 4; i++) {
+    r.x[i + 0] = scalarSat<int16_t>(a.x[i], -32768, 32767);
+    r.x[i + 4] = scalarSat<int16_t>(b.x[i], -32768, 32767);
+  }
+  return fromLanes<i16x8>(r);
+}
+
+static SIMD_INLINE Vec<u8x16> packus(const Vec<i16x8>& va, const Vec<i16x8>& vb) {
+  LaneArray<i16x8> a = lanesOf(va), b = lanesOf(vb);
+  LaneArray<u8x16> r;
+  for (int i = 0; i < 8; i++) {
+    r.x[i + 0] = scalarSat<uint8_t>(a.x[i], 0, 255);
+    r.x[i + 8] = scalarSat<uint8_t>(b.x[i], 0, 255);
+  }
+  return fromLanes<u8x16>(r);
+}
+
+// Like `_mm_packus_epi16()`, 16-bit lanes are treated as signed.
+static SIMD_INLINE Vec<u8x16> packus(const Vec<u16x8>& a, const Vec<u16x8>& b) {
+  return packus(cast<i16x8>(a), cast<i16x8>(b));
+}
+
+#define SIMD_VEC_FLOAT_OPS(T) \
+  SIMD_VEC_LANEWISE(T, operator+, a.x[i] + b.x[i]) \
+  SIMD_VEC_LANEWISE(T, operator-, a.x[i] - b.x[i]) \
+  SIMD_VEC_LANEWISE(T, operator*, a.x[i] * b.x[i]) \
+  SIMD_VEC_LANEWISE(T, operator/, a.x[i] / b.x[i]) \
+  SIMD_VEC_LANEWISE(T, min, a.x[i] < b.x[i] ? a.x[i] : b.x[i]) \
+  SIMD_VEC_LANEWISE(T, max, a.x[i] > b.x[i] ? a.x[i] : b.x[i]) \
+  \
+  static SIMD_INLINE Vec<T> sqrt(const Vec<T>& va) { \
+    LaneArray<T> a = lanesOf(va), r; \
+    for (int i = 0; i < T::kLanes; i++) \
+      r.x[i] = ::sqrt(a.x[i]); \
+    return fromLanes<T>(r); \
+  }
+
+SIMD_VEC_FLOAT_OPS(f32x4)
+SIMD_VEC_FLOAT_OPS(f64x2)
+
+static SIMD_INLINE Vec<f32x4> cvtF32(const Vec<i32x4>& va) {
+  LaneArray<i32x4> a = lanesOf(va);
+  LaneArray<f32x4> r;
+  for (int i = 0; i < 4; i++)
+    r.x[i] = static_cast<float>(a.x[i]);
+  return fromLanes<f32x4>(r);
+}
+
+static SIMD_INLINE Vec<i32x4> cvtI32(const Vec<f32x4>& va) {
+  LaneArray<f32x4> a = lanesOf(va);
+  LaneArray<i32x4> r;
+  for (int i = 0; i < 4; i++)
+    r.x[i] = static_cast<int32_t>(::nearbyintf(a.x[i]));
+  return fromLanes<i32x4>(r);
+}
+
+#undef SIMD_VEC_FLOAT_OPS
+#undef SIMD_VEC_UNPACK
+#undef SIMD_VEC_CMP
+#undef SIMD_VEC_ARITH
+#undef SIMD_VEC_BITWISE
+#undef SIMD_VEC_SHIFT
+#undef SIMD_VEC_LANEWISE
+#endif
+
+} // SIMD_VEC_NS namespace
+
+namespace SimdVec = SIMD_VEC_NS;
+
+#undef SIMD_VEC_AVX2
+#undef SIMD_VEC_SSE4_1
+#undef SIMD_VEC_SSSE3
+#undef SIMD_VEC_X86
+#undef SIMD_VEC_NS
+
 // ============================================================================
 // [SimdTimer]
 // ============================================================================
 
+// Benchmark timer measuring both nanoseconds and TSC cycles of an interval.
+//
+// Nanoseconds come from `CLOCK_MONOTONIC_RAW` (QueryPerformanceCounter on
+// Windows), which isn't slewed by NTP. RDTSC itself doesn't wait for previous
+// instructions to finish, so `start()` surrounds it by LFENCE and `stop()` uses
+// RDTSCP followed by LFENCE, which keeps the measured code inside the interval.
+// TSC ticks at a constant rate on all CPUs we care about, so the cycles are
+// reference cycles - they differ from core cycles if the CPU runs at a turbo
+// or power-saving frequency.
 struct SimdTimer {
-  SIMD_INLINE SimdTimer() : _cnt(0) {}
+  SIMD_INLINE SimdTimer() : _ns(0), _cycles(0) {}
 
-  SIMD_INLINE uint32_t get() const { return _cnt; }
-  SIMD_INLINE void start() { _cnt = now(); }
-  SIMD_INLINE void stop() { _cnt = now() - _cnt; }
+  SIMD_INLINE uint64_t ns() const { return _ns; }
+  SIMD_INLINE uint64_t cycles() const { return _cycles; }
 
-  static SIMD_INLINE uint32_t now() {
+  SIMD_INLINE void start() {
+    _ns = nowNs();
+    _cycles = tscStart();
+  }
+
+  SIMD_INLINE void stop() {
+    _cycles = tscStop() - _cycles;
+    _ns = nowNs() - _ns;
+  }
+
+  static SIMD_INLINE uint64_t nowNs() {
 #if defined(_WIN32)
-    return GetTickCount();
+    LARGE_INTEGER cnt, freq;
+    QueryPerformanceCounter(&cnt);
+    QueryPerformanceFrequency(&freq);
+    return static_cast<uint64_t>(static_cast<double>(cnt.QuadPart) * 1e9 / static_cast<double>(freq.QuadPart));
+#elif defined(CLOCK_MONOTONIC_RAW)
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
 #else
-    timeval ts;
-    gettimeofday(&ts,0);
-    return (uint32_t)(ts.tv_sec * 1000 + (ts.tv_usec / 1000));
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
 #endif
   }
 
-  uint32_t _cnt;
+  static SIMD_INLINE uint64_t tscStart() {
+    _mm_lfence();
+    uint64_t tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+  }
+
+  static SIMD_INLINE uint64_t tscStop() {
+    unsigned int aux;
+    uint64_t tsc = __rdtscp(&aux);
+    _mm_lfence();
+    return tsc;
+  }
+
+  // TSC ticks per nanosecond (TSC frequency in GHz), calibrated once against
+  // `nowNs()` by spinning for 20ms.
+  static double tscPerNs() {
+    static double ratio;
+
+    if (ratio == 0.0) {
+      uint64_t ns0 = nowNs();
+      uint64_t tsc0 = tscStart();
+      uint64_t ns1;
+
+      do {
+        ns1 = nowNs();
+      } while (ns1 - ns0 < 20000000u);
+
+      uint64_t tsc1 = tscStop();
+      ratio = static_cast<double>(tsc1 - tsc0) / static_cast<double>(ns1 - ns0);
+    }
+
+    return ratio;
+  }
+
+  static void printInfo() {
+    printf("[TIMER] TSC=%.3f GHz\n", tscPerNs());
+  }
+
+  uint64_t _ns;
+  uint64_t _cycles;
+};
+
+// Time of one or more runs of a benchmark, formatted per processed element and
+// per byte, like `[ 1.234 ns/px  3.456 cyc/px  0.864 cyc/B]`.
+struct SimdBenchTime {
+  SIMD_INLINE SimdBenchTime() : _ns(0), _cycles(0), _runs(0) {}
+
+  SIMD_INLINE uint64_t ns() const { return _ns; }
+  SIMD_INLINE uint64_t cycles() const { return _cycles; }
+
+  // Keeps the fastest run, which is the least disturbed by other processes.
+  SIMD_INLINE void update(const SimdTimer& timer) {
+    if (_runs++ == 0 || timer.ns() < _ns) {
+      _ns = timer.ns();
+      _cycles = timer.cycles();
+    }
+  }
+
+  // Sums all runs.
+  SIMD_INLINE void add(const SimdTimer& timer) {
+    _ns += timer.ns();
+    _cycles += timer.cycles();
+    _runs++;
+  }
+
+  SIMD_INLINE void add(const SimdBenchTime& other) {
+    _ns += other._ns;
+    _cycles += other._cycles;
+    _runs += other._runs;
+  }
+
+  // Formats the time per `count` elements named `unit` and per `bytes`, which
+  // is omitted if zero. The result is valid until the next call.
+  const char* format(double count, const char* unit, double bytes = 0.0) {
+    int n = snprintf(_buffer, sizeof(_buffer), "[%8.3f ns/%s %8.3f cyc/%s",
+      static_cast<double>(_ns) / count, unit,
+      static_cast<double>(_cycles) / count, unit);
+
+    if (bytes > 0.0)
+      snprintf(_buffer + n, sizeof(_buffer) - n, " %7.3f cyc/B]", static_cast<double>(_cycles) / bytes);
+    else
+      snprintf(_buffer + n, sizeof(_buffer) - n, "]");
+
+    return _buffer;
+  }
+
+  uint64_t _ns;
+  uint64_t _cycles;
+  uint32_t _runs;
+  char _buffer[96];
 };
 
 // ============================================================================
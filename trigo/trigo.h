@@ -16,4 +16,13 @@ void trigo_vsin_math_h(double* dst, const double* src, size_t length);
 void trigo_vsin_cephes_sse2(double* dst, const double* src, size_t length);
 void trigo_vsin_vml_sse2(double* dst, const double* src, size_t length);
 
+// Variant of `trigo_vsin_...` selected by `SimdCpu::tier()`, `precise` is too
+// slow to be ever selected.
+//
+// NOTE: On SSE2 hosts this selects `trigo_vsin_cephes_sse2`, which is only
+// correct for inputs in [-1686629712, 1686629712] (the quadrant is computed
+// by `_mm_cvttpd_epi32()`). Call `trigo_vsin_math_h` directly if the inputs
+// may fall outside of it.
+const SimdVariant<TrigoFuncD>* trigo_vsin_dispatch(void);
+
 #endif // _TRIGO_H
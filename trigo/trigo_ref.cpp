@@ -34,3 +34,20 @@ void trigo_vsin_math_h(double* dst, const double* src, size_t length) {
   for (size_t i = 0; i < length; i++)
     dst[i] = ::sin(src[i]);
 }
+
+// ============================================================================
+// [Dispatch]
+// ============================================================================
+
+static const SimdVariant<TrigoFuncD> trigo_vsin_variants[] = {
+  { kSimdTierRef , "sin (math.h)"     , trigo_vsin_math_h      },
+  { kSimdTierSSE2, "sin (Cephes-SSE2)", trigo_vsin_cephes_sse2 }
+};
+
+const SimdVariant<TrigoFuncD>* trigo_vsin_dispatch(void) {
+  static const SimdVariant<TrigoFuncD>* selected;
+
+  if (selected == NULL)
+    selected = SimdCpu::select(trigo_vsin_variants, sizeof(trigo_vsin_variants) / sizeof(trigo_vsin_variants[0]));
+  return selected;
+}
@@ -80,7 +80,7 @@ static void trigo_bench(
   const double* inputs, size_t length) {
 
   SimdTimer timer;
-  uint32_t best = 0xFFFFFFFFU;
+  SimdBenchTime best;
 
   // Dummy counter to prevent optimizations.
   double* outputs = static_cast<double*>(malloc(length * sizeof(double)));
@@ -96,11 +96,11 @@ static void trigo_bench(
     }
     timer.stop();
 
-    if (timer.get() < best)
-      best = timer.get();
+    best.update(timer);
   }
 
-  printf("[BENCH] IMPL=%-20s [%.2u.%.3u s] {dummy=%f}\n", name, best / 1000, best % 1000, dummy);
+  double values = double(length) * BENCH_ITER;
+  printf("[BENCH] IMPL=%-20s %s {dummy=%f}\n", name, best.format(values, "val", values * sizeof(double)), dummy);
   ::free(outputs);
 }
 
@@ -118,6 +118,7 @@ static void trigo_do_domain(size_t count, double a, double b) {
   trigo_check("sin (math.h)"     , trigo_vsin_math_h      , inputs, ref, count);
   trigo_check("sin (Cephes-SSE2)", trigo_vsin_cephes_sse2 , inputs, ref, count);
   trigo_check("sin (VML-SSE2)"   , trigo_vsin_vml_sse2, inputs, ref, count);
+  trigo_check("sin (best)"       , trigo_vsin_dispatch()->func, inputs, ref, count);
 
   trigo_bench("sin (math.h)"     , trigo_vsin_math_h      , inputs, count);
   trigo_bench("sin (Cephes-SSE2)", trigo_vsin_cephes_sse2 , inputs, count);
@@ -139,6 +140,11 @@ int main(int argc, char* argv[]) {
   size_t count = 1000000;
   const double PI = 3.141592653589793238;
 
+  SimdCpu::printInfo();
+  SimdTimer::printInfo();
+  SimdCpu::printVariant("trigo_vsin", trigo_vsin_dispatch());
+  printf("\n");
+
   trigo_do_domain(count, -PI, 0);
   trigo_do_domain(count, 0, PI);
   trigo_do_domain(count, -100.0, 0.0);